@@ -0,0 +1,445 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include <evse_security/certificate/x509_bundle.hpp>
+#include <evse_security/certificate/x509_hierarchy.hpp>
+#include <evse_security/certificate/x509_wrapper.hpp>
+#include <evse_security/crypto/evse_crypto.hpp>
+#include <evse_security/crypto/openssl/openssl_types.hpp>
+#include <evse_security/evse_security.hpp>
+#include <evse_security/storage/in_memory_storage.hpp>
+#include <evse_security/utils/evse_filesystem.hpp>
+
+#include "allocation_counter.hpp"
+
+using namespace evse_security;
+
+namespace {
+
+const fs::path BENCHMARK_DIRECTORY = "benchmark_certificates";
+
+/// @brief Sets the 'allocs/op' and 'crypto_allocs/op' counters of the benchmark, with the allocations made since
+/// @p start averaged over the iterations. To be called after the benchmark loop, that does not allocate itself
+void report_allocations(benchmark::State& state, const AllocationCount& start) {
+    const AllocationCount end = get_allocation_count();
+
+    state.counters["allocs/op"] =
+        benchmark::Counter(static_cast<double>(end.heap - start.heap), benchmark::Counter::kAvgIterations);
+
+    if (is_counting_crypto_allocations()) {
+        state.counters["crypto_allocs/op"] =
+            benchmark::Counter(static_cast<double>(end.crypto - start.crypto), benchmark::Counter::kAvgIterations);
+    }
+}
+
+/// @brief Shape of a generated hierarchy of 'count' certificates
+enum class HierarchyShape {
+    Chain,  ///< One root, each following certificate issued by the previous one
+    Wide,   ///< One root that issued all other certificates
+    Forest, ///< One root for every four certificates, each root issued the three others
+};
+
+struct GeneratedCertificate {
+    X509_ptr x509;
+    EVP_PKEY_ptr key;
+};
+
+void add_extension(X509* certificate, X509V3_CTX* context, int nid, const char* value) {
+    X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, context, nid, value);
+    X509_add_ext(certificate, extension, -1);
+    X509_EXTENSION_free(extension);
+}
+
+/// @brief Generates a P-256 certificate with key identifiers and an OCSP responder URL, self signed if @p issuer is
+/// not set
+GeneratedCertificate generate_certificate(const std::string& common_name, const GeneratedCertificate* issuer,
+                                          bool is_ca) {
+    static long serial = 1;
+
+    GeneratedCertificate generated;
+    generated.key = EVP_PKEY_ptr(EVP_EC_gen("P-256"));
+    generated.x509 = X509_ptr(X509_new());
+
+    X509* certificate = generated.x509.get();
+    X509_set_version(certificate, X509_VERSION_3);
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), serial++);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), -24 * 60 * 60);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 10L * 365 * 24 * 60 * 60);
+    X509_set_pubkey(certificate, generated.key.get());
+
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(common_name.c_str()),
+                               -1, -1, 0);
+    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("EVerest"), -1, -1, 0);
+
+    X509* issuer_certificate = issuer ? issuer->x509.get() : certificate;
+    EVP_PKEY* issuer_key = issuer ? issuer->key.get() : generated.key.get();
+    X509_set_issuer_name(certificate, X509_get_subject_name(issuer_certificate));
+
+    X509V3_CTX context;
+    X509V3_set_ctx(&context, issuer_certificate, certificate, nullptr, nullptr, 0);
+    add_extension(certificate, &context, NID_basic_constraints, is_ca ? "critical,CA:TRUE" : "critical,CA:FALSE");
+    add_extension(certificate, &context, NID_subject_key_identifier, "hash");
+    add_extension(certificate, &context, NID_authority_key_identifier, "keyid:always");
+    add_extension(certificate, &context, NID_info_access, "OCSP;URI:http://ocsp.example.com");
+
+    X509_sign(certificate, issuer_key, EVP_sha256());
+    return generated;
+}
+
+std::string to_pem(X509* certificate) {
+    BIO_ptr bio(BIO_new(BIO_s_mem()));
+    PEM_write_bio_X509(bio.get(), certificate);
+
+    char* data = nullptr;
+    const long length = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, length);
+}
+
+std::string to_pem(EVP_PKEY* key) {
+    BIO_ptr bio(BIO_new(BIO_s_mem()));
+    PEM_write_bio_PrivateKey(bio.get(), key, nullptr, nullptr, 0, nullptr, nullptr);
+
+    char* data = nullptr;
+    const long length = BIO_get_mem_data(bio.get(), &data);
+    return std::string(data, length);
+}
+
+std::string to_der(X509* certificate) {
+    unsigned char* data = nullptr;
+    const int length = i2d_X509(certificate, &data);
+    std::string der(reinterpret_cast<char*>(data), length);
+    OPENSSL_free(data);
+    return der;
+}
+
+/// @brief Generates @p count certificates of the @p shape, in PEM and with the issuers first
+std::vector<std::string> generate_hierarchy(HierarchyShape shape, std::size_t count) {
+    std::vector<GeneratedCertificate> generated;
+    std::vector<std::string> certificates;
+
+    for (std::size_t i = 0; i < count; i++) {
+        const std::string common_name = "BenchCert" + std::to_string(i);
+
+        if (i == 0 || (shape == HierarchyShape::Forest && i % 4 == 0)) {
+            generated.push_back(generate_certificate(common_name, nullptr, true));
+        } else if (shape == HierarchyShape::Chain) {
+            generated.push_back(generate_certificate(common_name, &generated.back(), i + 1 < count));
+        } else if (shape == HierarchyShape::Wide) {
+            generated.push_back(generate_certificate(common_name, &generated.front(), false));
+        } else {
+            generated.push_back(generate_certificate(common_name, &generated[i - i % 4], false));
+        }
+
+        certificates.push_back(to_pem(generated.back().x509.get()));
+    }
+
+    return certificates;
+}
+
+std::string concatenate(const std::vector<std::string>& certificates) {
+    std::string bundle;
+    for (const auto& certificate : certificates) {
+        bundle += certificate;
+    }
+    return bundle;
+}
+
+/// @brief Root and leaf issued by it, for the single certificate benchmarks
+struct CertificatePair {
+    GeneratedCertificate root;
+    GeneratedCertificate leaf;
+
+    CertificatePair() :
+        root(generate_certificate("BenchRoot", nullptr, true)),
+        leaf(generate_certificate("BenchLeaf", &root, false)) {
+    }
+};
+
+const CertificatePair& get_certificate_pair() {
+    static const CertificatePair pair;
+    return pair;
+}
+
+X509Wrapper get_leaf() {
+    return X509Wrapper(to_pem(get_certificate_pair().leaf.x509.get()), EncodingFormat::PEM);
+}
+
+X509Wrapper get_root() {
+    return X509Wrapper(to_pem(get_certificate_pair().root.x509.get()), EncodingFormat::PEM);
+}
+
+/// @brief In memory store with @p roots V2G roots, each of which issued a SECC leaf through a sub CA. Every leaf is
+/// stored as a chain file and a single file, with its key
+std::unique_ptr<EvseSecurity> create_multi_root_store(std::size_t roots) {
+    auto storage = std::make_shared<InMemoryStorage>();
+
+    FilePaths file_paths;
+    file_paths.csms_ca_bundle = "ca/csms/CSMS_CA_BUNDLE.pem";
+    file_paths.mf_ca_bundle = "ca/mf/MF_CA_BUNDLE.pem";
+    file_paths.mo_ca_bundle = "ca/mo/MO_CA_BUNDLE.pem";
+    file_paths.v2g_ca_bundle = "ca/v2g/V2G_CA_BUNDLE.pem";
+    file_paths.directories.csms_leaf_cert_directory = "client/csms";
+    file_paths.directories.csms_leaf_key_directory = "client/csms";
+    file_paths.directories.secc_leaf_cert_directory = "client/cso";
+    file_paths.directories.secc_leaf_key_directory = "client/cso";
+
+    for (const auto& directory : {"ca/csms", "ca/mf", "ca/mo", "ca/v2g", "client/csms", "client/cso"}) {
+        storage->create_directories(directory);
+    }
+
+    std::string root_bundle;
+    for (std::size_t i = 0; i < roots; i++) {
+        const std::string suffix = std::to_string(i);
+        const auto root = generate_certificate("BenchRoot" + suffix, nullptr, true);
+        const auto sub_ca = generate_certificate("BenchSubCA" + suffix, &root, true);
+        const auto leaf = generate_certificate("BenchLeaf" + suffix, &sub_ca, false);
+
+        root_bundle += to_pem(root.x509.get());
+
+        const std::string leaf_pem = to_pem(leaf.x509.get());
+        storage->write("client/cso/SECC_LEAF_" + suffix + ".pem", leaf_pem, false);
+        storage->write("client/cso/CPO_CERT_SECC_LEAF_CHAIN_" + suffix + ".pem",
+                       leaf_pem + to_pem(sub_ca.x509.get()), false);
+        storage->write("client/cso/SECC_LEAF_" + suffix + ".key", to_pem(leaf.key.get()), false);
+    }
+    storage->write(file_paths.v2g_ca_bundle, root_bundle, false);
+
+    return std::make_unique<EvseSecurity>(file_paths, std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+                                          std::nullopt, storage);
+}
+
+} // namespace
+
+static void BM_wrapper_from_pem(benchmark::State& state) {
+    const std::string pem = to_pem(get_certificate_pair().leaf.x509.get());
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        X509Wrapper certificate(pem, EncodingFormat::PEM);
+        benchmark::DoNotOptimize(certificate.get());
+    }
+
+    report_allocations(state, start);
+}
+BENCHMARK(BM_wrapper_from_pem);
+
+static void BM_wrapper_from_der(benchmark::State& state) {
+    const std::string der = to_der(get_certificate_pair().leaf.x509.get());
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        X509Wrapper certificate(der, EncodingFormat::DER);
+        benchmark::DoNotOptimize(certificate.get());
+    }
+
+    report_allocations(state, start);
+}
+BENCHMARK(BM_wrapper_from_der);
+
+/// @brief Benchmarks a getter of the leaf certificate, or of the root if @p on_root is set
+template <typename Getter> void benchmark_getter(benchmark::State& state, Getter getter, bool on_root = false) {
+    const X509Wrapper certificate = on_root ? get_root() : get_leaf();
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(getter(certificate));
+    }
+
+    report_allocations(state, start);
+}
+
+BENCHMARK_CAPTURE(benchmark_getter, common_name, [](const X509Wrapper& c) { return c.get_common_name(); });
+BENCHMARK_CAPTURE(benchmark_getter, issuer_name_hash, [](const X509Wrapper& c) { return c.get_issuer_name_hash(); });
+// Only defined for self signed certificates, like the hash data without an issuer
+BENCHMARK_CAPTURE(benchmark_getter, issuer_key_hash, [](const X509Wrapper& c) { return c.get_issuer_key_hash(); },
+                  true);
+BENCHMARK_CAPTURE(benchmark_getter, key_hash, [](const X509Wrapper& c) { return c.get_key_hash(); });
+BENCHMARK_CAPTURE(benchmark_getter, subject_hash, [](const X509Wrapper& c) { return c.get_subject_hash(); });
+BENCHMARK_CAPTURE(benchmark_getter, issuer_hash, [](const X509Wrapper& c) { return c.get_issuer_hash(); });
+BENCHMARK_CAPTURE(benchmark_getter, key_identifier, [](const X509Wrapper& c) { return c.get_key_identifier(); });
+BENCHMARK_CAPTURE(benchmark_getter, serial_number, [](const X509Wrapper& c) { return c.get_serial_number(); });
+BENCHMARK_CAPTURE(benchmark_getter, responder_url, [](const X509Wrapper& c) { return c.get_responder_url(); });
+BENCHMARK_CAPTURE(benchmark_getter, export_string, [](const X509Wrapper& c) { return c.get_export_string(); });
+BENCHMARK_CAPTURE(benchmark_getter, certificate_hash_data,
+                  [](const X509Wrapper& c) { return c.get_certificate_hash_data(); }, true);
+
+static void BM_is_child(benchmark::State& state) {
+    const X509Wrapper leaf = get_leaf();
+    const X509Wrapper root = get_root();
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(leaf.is_child(root));
+    }
+
+    report_allocations(state, start);
+}
+BENCHMARK(BM_is_child);
+
+static void BM_is_selfsigned(benchmark::State& state) {
+    const X509Wrapper root = get_root();
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(root.is_selfsigned());
+    }
+
+    report_allocations(state, start);
+}
+BENCHMARK(BM_is_selfsigned);
+
+// The certificates are inserted in reverse order, the leafs before their issuers
+static void BM_build_hierarchy(benchmark::State& state) {
+    std::vector<X509Wrapper> certificates;
+    for (const auto& pem : generate_hierarchy(static_cast<HierarchyShape>(state.range(0)), state.range(1))) {
+        certificates.emplace_back(pem, EncodingFormat::PEM);
+    }
+
+    auto start = get_allocation_count();
+    for (auto _ : state) {
+        // The build consumes its input, the copy is excluded from the time and the allocations
+        state.PauseTiming();
+        const auto before_copy = get_allocation_count();
+        std::vector<X509Wrapper> input = certificates;
+        const auto after_copy = get_allocation_count();
+        start.heap += after_copy.heap - before_copy.heap;
+        start.crypto += after_copy.crypto - before_copy.crypto;
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(X509CertificateHierarchy::build_hierarchy(input));
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_build_hierarchy)
+    ->ArgNames({"shape", "count"})
+    ->ArgsProduct({{static_cast<int>(HierarchyShape::Chain), static_cast<int>(HierarchyShape::Wide),
+                    static_cast<int>(HierarchyShape::Forest)},
+                   {8, 64, 256}});
+
+static void BM_load_certificates(benchmark::State& state) {
+    const std::string bundle = concatenate(generate_hierarchy(HierarchyShape::Wide, state.range(0)));
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CryptoSupplier::load_certificates(bundle, EncodingFormat::PEM));
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_load_certificates)->Arg(1)->Arg(64)->Arg(256);
+
+static void BM_load_bundle_file(benchmark::State& state) {
+    const fs::path file = BENCHMARK_DIRECTORY / "BUNDLE.pem";
+    fs::remove_all(BENCHMARK_DIRECTORY);
+    fs::create_directories(BENCHMARK_DIRECTORY);
+    filesystem_utils::write_to_file(file, concatenate(generate_hierarchy(HierarchyShape::Wide, state.range(0))),
+                                    std::ios::out);
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        X509CertificateBundle bundle(file, EncodingFormat::PEM);
+        benchmark::DoNotOptimize(bundle.get_certificate_count());
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_load_bundle_file)->Arg(8)->Arg(64)->Arg(256);
+
+static void BM_load_bundle_directory(benchmark::State& state) {
+    fs::remove_all(BENCHMARK_DIRECTORY);
+    fs::create_directories(BENCHMARK_DIRECTORY);
+
+    const auto certificates = generate_hierarchy(HierarchyShape::Wide, state.range(0));
+    for (std::size_t i = 0; i < certificates.size(); i++) {
+        filesystem_utils::write_to_file(BENCHMARK_DIRECTORY / ("CERT_" + std::to_string(i) + ".pem"),
+                                        certificates[i], std::ios::out);
+    }
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        X509CertificateBundle bundle(BENCHMARK_DIRECTORY, EncodingFormat::PEM);
+        benchmark::DoNotOptimize(bundle.get_certificate_count());
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_load_bundle_directory)->Arg(8)->Arg(64)->Arg(256);
+
+// Rewrite of an unchanged file bundle
+static void BM_export_bundle_file(benchmark::State& state) {
+    const fs::path file = BENCHMARK_DIRECTORY / "BUNDLE.pem";
+    fs::remove_all(BENCHMARK_DIRECTORY);
+    fs::create_directories(BENCHMARK_DIRECTORY);
+    filesystem_utils::write_to_file(file, concatenate(generate_hierarchy(HierarchyShape::Wide, state.range(0))),
+                                    std::ios::out);
+
+    X509CertificateBundle bundle(file, EncodingFormat::PEM);
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bundle.export_certificates());
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_export_bundle_file)->Arg(8)->Arg(64)->Arg(256);
+
+// Rewrite of an unchanged directory bundle, one file per certificate
+static void BM_export_bundle_directory(benchmark::State& state) {
+    fs::remove_all(BENCHMARK_DIRECTORY);
+    fs::create_directories(BENCHMARK_DIRECTORY);
+
+    const auto certificates = generate_hierarchy(HierarchyShape::Wide, state.range(0));
+    for (std::size_t i = 0; i < certificates.size(); i++) {
+        filesystem_utils::write_to_file(BENCHMARK_DIRECTORY / ("CERT_" + std::to_string(i) + ".pem"),
+                                        certificates[i], std::ios::out);
+    }
+
+    X509CertificateBundle bundle(BENCHMARK_DIRECTORY, EncodingFormat::PEM);
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bundle.export_certificates());
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_export_bundle_directory)->Arg(8)->Arg(64)->Arg(256);
+
+// The newest valid leaf of each root, with its root and OCSP data
+static void BM_get_all_valid_certificates_info(benchmark::State& state) {
+    const auto evse_security = create_multi_root_store(state.range(0));
+
+    const auto start = get_allocation_count();
+    for (auto _ : state) {
+        const auto result =
+            evse_security->get_all_valid_certificates_info(LeafCertificateType::V2G, EncodingFormat::PEM, true);
+        if (result.info.size() != static_cast<std::size_t>(state.range(0))) {
+            state.SkipWithError("Not all the leafs were returned");
+            break;
+        }
+    }
+
+    report_allocations(state, start);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_get_all_valid_certificates_info)->ArgName("roots")->Arg(1)->Arg(4)->Arg(16);
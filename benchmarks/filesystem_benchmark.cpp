@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include <evse_security/certificate/x509_bundle.hpp>
+#include <evse_security/detail/file_content_cache.hpp>
+#include <evse_security/storage/posix_storage.hpp>
+#include <evse_security/utils/evse_filesystem.hpp>
+
+#include "latency_storage.hpp"
+
+using namespace evse_security;
+
+namespace {
+
+// Self signed P-256 certificate, only used as file content
+const std::string BENCHMARK_CERTIFICATE = R"(-----BEGIN CERTIFICATE-----
+MIIBvjCCAWOgAwIBAgIUF2/9ts5kAQ1vpdNdgxiaKNqucYswCgYIKoZIzj0EAwIw
+MzESMBAGA1UEAwwJQmVuY2hMZWFmMRAwDgYDVQQKDAdFVmVyZXN0MQswCQYDVQQG
+EwJERTAgFw0yNjEwMTgwOTQ4MTRaGA8yMTI2MDkyNDA5NDgxNFowMzESMBAGA1UE
+AwwJQmVuY2hMZWFmMRAwDgYDVQQKDAdFVmVyZXN0MQswCQYDVQQGEwJERTBZMBMG
+ByqGSM49AgEGCCqGSM49AwEHA0IABIRGMEDeHm7/y4/NWs+pB8I89VFEHKl/kFM1
+pAB7vJ8IAQT8ntGG97mAeOlKn17DnPlF7tHEocm2Oz3M6iK3NK6jUzBRMB0GA1Ud
+DgQWBBSMlTqFTdeROhVDSaTzdeFbD/4EqDAfBgNVHSMEGDAWgBSMlTqFTdeROhVD
+SaTzdeFbD/4EqDAPBgNVHRMBAf8EBTADAQH/MAoGCCqGSM49BAMCA0kAMEYCIQD/
+IECHh52vMvLK/uFl1JpBldPkhJ9Rvu1opH2ktr3dIQIhAPdlBFa0X2C5Ni2/06j/
+N3rATvv/Ek5KLvL1gR3clsh0
+-----END CERTIFICATE-----
+)";
+
+const fs::path BENCHMARK_DIRECTORY = "benchmark_certs";
+
+/// @brief Creates a directory with @p count certificate files
+std::vector<fs::path> create_certificate_directory(std::size_t count) {
+    fs::remove_all(BENCHMARK_DIRECTORY);
+    fs::create_directories(BENCHMARK_DIRECTORY);
+
+    std::vector<fs::path> files;
+    for (std::size_t i = 0; i < count; i++) {
+        files.push_back(BENCHMARK_DIRECTORY / ("CERT_" + std::to_string(i) + ".pem"));
+        filesystem_utils::write_to_file(files.back(), BENCHMARK_CERTIFICATE, std::ios::out);
+    }
+
+    return files;
+}
+
+/// @brief Enables the read cache if the second benchmark argument is set
+void set_read_cache(const benchmark::State& state) {
+    PosixStorage::set_read_cache_capacity(state.range(1) ? DEFAULT_FILE_CONTENT_CACHE_CAPACITY : 0);
+}
+
+/// @brief Filesystem storage with the latency of the charger storage selected by the @p profile argument: 0 for
+/// eMMC, 1 for SD card
+std::shared_ptr<CertificateStorage> create_slow_flash_storage(std::int64_t profile) {
+    return std::make_shared<LatencyStorage>(std::make_shared<PosixStorage>(), profile == 0
+                                                                                  ? StorageLatencyProfile::emmc()
+                                                                                  : StorageLatencyProfile::sd_card());
+}
+
+} // namespace
+
+// Reference, one blocking read after the other. With the read cache an unchanged file costs a stat
+static void BM_read_files_blocking(benchmark::State& state) {
+    const auto files = create_certificate_directory(state.range(0));
+    set_read_cache(state);
+
+    for (auto _ : state) {
+        for (const auto& file : files) {
+            std::string data;
+            benchmark::DoNotOptimize(filesystem_utils::read_from_file(file, data));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_read_files_blocking)->Args({1000, 0})->Args({1000, 1});
+
+// Batched read, uses io_uring when built with LIBEVSE_SECURITY_USE_IO_URING
+static void BM_read_files_batched(benchmark::State& state) {
+    const auto files = create_certificate_directory(state.range(0));
+    set_read_cache(state);
+
+    for (auto _ : state) {
+        std::vector<std::optional<std::string>> data;
+        benchmark::DoNotOptimize(filesystem_utils::read_from_files(files, data));
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_read_files_batched)->Args({1000, 0})->Args({1000, 1});
+
+// Complete directory bundle load, including the certificate parsing
+static void BM_load_directory_bundle(benchmark::State& state) {
+    create_certificate_directory(state.range(0));
+
+    for (auto _ : state) {
+        X509CertificateBundle bundle(BENCHMARK_DIRECTORY, EncodingFormat::PEM);
+        benchmark::DoNotOptimize(bundle.get_certificate_chains_count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_load_directory_bundle)->Arg(1000);
+
+// Reads of the same files on slow flash, one after the other or batched. The injected latency is not CPU time
+static void BM_read_files_slow_flash(benchmark::State& state) {
+    const auto files = create_certificate_directory(state.range(0));
+    set_read_cache(state);
+    const auto storage = create_slow_flash_storage(state.range(2));
+    ScopedStorage scoped_storage(storage);
+
+    for (auto _ : state) {
+        if (state.range(3)) {
+            std::vector<std::optional<std::string>> data;
+            benchmark::DoNotOptimize(filesystem_utils::read_from_files(files, data));
+        } else {
+            for (const auto& file : files) {
+                benchmark::DoNotOptimize(filesystem_utils::read_shared_from_file(file));
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_read_files_slow_flash)
+    ->ArgNames({"files", "read_cache", "profile", "batched"})
+    ->ArgsProduct({{100}, {0, 1}, {0, 1}, {0, 1}})
+    ->UseRealTime();
+
+// Complete directory bundle load on slow flash
+static void BM_load_directory_bundle_slow_flash(benchmark::State& state) {
+    create_certificate_directory(state.range(0));
+    set_read_cache(state);
+    const auto storage = create_slow_flash_storage(state.range(2));
+    ScopedStorage scoped_storage(storage);
+
+    for (auto _ : state) {
+        X509CertificateBundle bundle(BENCHMARK_DIRECTORY, EncodingFormat::PEM);
+        benchmark::DoNotOptimize(bundle.get_certificate_chains_count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(BENCHMARK_DIRECTORY);
+}
+BENCHMARK(BM_load_directory_bundle_slow_flash)
+    ->ArgNames({"files", "read_cache", "profile"})
+    ->ArgsProduct({{100}, {0, 1}, {0, 1}})
+    ->UseRealTime();
@@ -0,0 +1,66 @@
+# evse_security_embed_trust_anchors(<target> NAME <name> [DIRECTORY <dir>] [FILES <files>...])
+#
+# Compiles the PEM roots of DIRECTORY (all '*.pem' files) and FILES into <target>, as the
+# 'evse_security::trust_anchors::<name>' set declared in the generated '<name>.hpp'. The set can be
+# passed to 'EvseSecurity' as the read-only store of a 'CaCertificateType', so that the roots are
+# neither read from the filesystem nor parsed from PEM at runtime.
+#
+# The generator is a host tool built and installed with the library, consumers of the installed
+# package get it as 'everest::evse_security_embed_trust_anchors'. When cross compiling, set
+# EVSE_SECURITY_EMBED_TRUST_ANCHORS_TOOL to the 'evse_security_embed_trust_anchors' of a host build.
+function(evse_security_embed_trust_anchors TARGET)
+    cmake_parse_arguments(ARG "" "NAME;DIRECTORY" "FILES" ${ARGN})
+
+    if(NOT ARG_NAME)
+        message(FATAL_ERROR "evse_security_embed_trust_anchors: NAME is required")
+    endif()
+
+    set(PEM_FILES)
+
+    if(ARG_DIRECTORY)
+        file(GLOB DIRECTORY_PEM_FILES CONFIGURE_DEPENDS "${ARG_DIRECTORY}/*.pem")
+        list(SORT DIRECTORY_PEM_FILES)
+        list(APPEND PEM_FILES ${DIRECTORY_PEM_FILES})
+    endif()
+
+    foreach(FILE ${ARG_FILES})
+        get_filename_component(ABSOLUTE_FILE "${FILE}" ABSOLUTE)
+        list(APPEND PEM_FILES ${ABSOLUTE_FILE})
+    endforeach()
+
+    if(NOT PEM_FILES)
+        message(FATAL_ERROR "evse_security_embed_trust_anchors: no PEM files for ${ARG_NAME}")
+    endif()
+
+    if(EVSE_SECURITY_EMBED_TRUST_ANCHORS_TOOL)
+        set(TOOL ${EVSE_SECURITY_EMBED_TRUST_ANCHORS_TOOL})
+    elseif(TARGET evse_security_embed_trust_anchors)
+        set(TOOL evse_security_embed_trust_anchors)
+    elseif(TARGET everest::evse_security_embed_trust_anchors)
+        set(TOOL everest::evse_security_embed_trust_anchors)
+    else()
+        message(FATAL_ERROR "evse_security_embed_trust_anchors: the generator is not built when cross compiling, "
+                            "set EVSE_SECURITY_EMBED_TRUST_ANCHORS_TOOL")
+    endif()
+
+    set(OUTPUT_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}/trust_anchors/${TARGET})
+    file(MAKE_DIRECTORY ${OUTPUT_DIRECTORY})
+
+    add_custom_command(
+        OUTPUT
+            ${OUTPUT_DIRECTORY}/${ARG_NAME}.hpp
+            ${OUTPUT_DIRECTORY}/${ARG_NAME}.cpp
+        COMMAND ${TOOL} ${ARG_NAME} ${OUTPUT_DIRECTORY} ${PEM_FILES}
+        DEPENDS ${TOOL} ${PEM_FILES}
+        COMMENT "Embedding trust anchors ${ARG_NAME}"
+        VERBATIM
+    )
+
+    target_sources(${TARGET} PRIVATE
+        ${OUTPUT_DIRECTORY}/${ARG_NAME}.cpp
+    )
+
+    target_include_directories(${TARGET} PRIVATE
+        ${OUTPUT_DIRECTORY}
+    )
+endfunction()
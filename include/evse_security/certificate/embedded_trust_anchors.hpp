@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace evse_security {
+
+/// @brief Root certificate compiled into the binary, generated by the 'evse_security_embed_trust_anchors'
+/// CMake function. The metadata is computed at build time so that it does not require decoding the certificate
+struct EmbeddedTrustAnchor {
+    const std::uint8_t* der;      ///< DER encoded certificate
+    std::size_t der_size;         ///< Size of the DER encoding in bytes
+    const char* common_name;      ///< Subject common name
+    const char* issuer_name_hash; ///< SHA256 hash data of the root, in the 'CertificateHashData' format
+    const char* issuer_key_hash;
+    const char* serial_number;
+    std::int64_t not_before; ///< Start of the validity, seconds since epoch
+    std::int64_t not_after;  ///< End of the validity, seconds since epoch
+};
+
+/// @brief Set of embedded roots, used as a read-only CA store for a 'CaCertificateType'
+struct EmbeddedTrustAnchorSet {
+    const EmbeddedTrustAnchor* anchors;
+    std::size_t count;
+
+    constexpr const EmbeddedTrustAnchor* begin() const {
+        return anchors;
+    }
+
+    constexpr const EmbeddedTrustAnchor* end() const {
+        return anchors + count;
+    }
+};
+
+} // namespace evse_security
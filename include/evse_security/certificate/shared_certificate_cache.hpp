@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <evse_security/storage/certificate_storage.hpp>
+#include <evse_security/utils/evse_filesystem_types.hpp>
+
+namespace evse_security {
+
+// Default size of the shared segment, enough for a few thousand certificates
+constexpr std::size_t DEFAULT_SHARED_CERTIFICATE_CACHE_SIZE = 4 * 1024 * 1024;
+
+/// @brief Optional cache of the parsed certificate files shared by all the processes on the same device, so
+/// that the modules using the same certificate directories parse each file version once. The segment is a
+/// memory mapped file (e.g. in /dev/shm) that holds the DER encoding of the certificates of each file version,
+/// indexed by (device, inode, modification time, size).
+///
+/// The process holding the '<segment>.lock' lock file is the only writer, the others map the segment read-only
+/// and take over the lock once the writer exits. Readers do not lock, the writer makes the generation odd while
+/// it modifies the segment, a lookup is only used if the generation was even and did not change during it.
+///
+/// Both files are created readable by their owner only, and are rejected unless they are regular files owned
+/// by the effective user of this process and not writable by its group or others
+class SharedCertificateCache {
+public:
+    static SharedCertificateCache& instance();
+    ~SharedCertificateCache();
+
+    /// @brief Maps the segment, used by the certificate bundles of this process from now on
+    /// @param size size of the segment if this process creates it, an existing segment is never shrunk
+    /// @return true if the segment is mapped, as writer or reader
+    bool open(const fs::path& segment_path, std::size_t size = DEFAULT_SHARED_CERTIFICATE_CACHE_SIZE);
+    void close();
+
+    bool is_open();
+    /// @brief If this process holds the lock file and publishes the parsed files
+    bool is_writer();
+    std::uint64_t get_generation();
+
+    /// @brief Returns the DER encoded certificates of the file version with the @p status
+    bool find(const StorageStatus& status, std::vector<std::string>& out_der);
+    /// @brief Publishes the DER encoded certificates of a file version, only done by the writer. All the
+    /// entries are dropped once the segment is full
+    bool insert(const StorageStatus& status, const std::vector<std::string>& der);
+
+private:
+    SharedCertificateCache() = default;
+
+    bool map_segment(bool writable, std::size_t size);
+    void unmap_segment();
+    /// @brief Becomes the writer if the lock file is not held by another process
+    bool try_become_writer();
+    bool find_internal(const StorageStatus& status, std::vector<std::string>* out_der);
+
+    std::mutex mutex;
+    fs::path segment_path;
+    std::size_t requested_size{0};
+    int segment_fd{-1};
+    int lock_fd{-1};
+    bool writer{false};
+    std::uint8_t* segment{nullptr};
+    std::size_t segment_size{0};
+};
+
+} // namespace evse_security
@@ -5,8 +5,10 @@
 #include <algorithm>
 #include <map>
 
+#include <evse_security/certificate/embedded_trust_anchors.hpp>
 #include <evse_security/certificate/x509_hierarchy.hpp>
 #include <evse_security/certificate/x509_wrapper.hpp>
+#include <evse_security/storage/certificate_storage.hpp>
 
 namespace evse_security {
 
@@ -38,6 +40,9 @@ class X509CertificateBundle {
 public:
     X509CertificateBundle(const fs::path& path, const EncodingFormat encoding);
     X509CertificateBundle(const std::string& certificate, const EncodingFormat encoding);
+    /// @brief Read-only bundle of embedded roots, decoded from their DER encoding without any file access
+    /// @param path configured bundle path, only used for the related files (e.g. the OCSP cache)
+    X509CertificateBundle(const EmbeddedTrustAnchorSet& anchors, const fs::path& path);
 
     X509CertificateBundle(X509CertificateBundle&& other) = default;
     X509CertificateBundle(const X509CertificateBundle& other) = delete;
@@ -55,6 +60,11 @@ public:
         return (source == X509CertificateSource::DIRECTORY);
     }
 
+    /// @brief Gets if this certificate bundle comes from embedded trust anchors, that can not be exported
+    bool is_using_embedded() const {
+        return (source == X509CertificateSource::EMBEDDED);
+    }
+
     /// @return True if multiple certificates are contained within
     bool is_bundle() const {
         return (get_certificate_count() > 1);
@@ -178,9 +188,10 @@ public:
     /// @brief Returns the latest valid certif that we might contain
     static X509Wrapper get_latest_valid_certificate(const std::vector<X509Wrapper>& certificates);
 
-    static bool is_certificate_file(const fs::path& file) {
-        return fs::is_regular_file(file) &&
-               ((file.extension() == PEM_EXTENSION) || (file.extension() == DER_EXTENSION));
+    static bool is_certificate_file(const fs::path& file);
+
+    static bool is_certificate_extension(const fs::path& file) {
+        return (file.extension() == PEM_EXTENSION) || (file.extension() == DER_EXTENSION);
     }
 
 private:
@@ -188,6 +199,13 @@ private:
     /// @return number of added certificates
     void add_certificates(const std::string& data, const EncodingFormat encoding, const std::optional<fs::path>& path);
 
+    /// @brief Adds the certificates of the file from the 'SharedCertificateCache', if it is open and has them
+    /// @param out_status status of the file at the lookup, used to publish it once parsed
+    /// @return false if the file has to be read and parsed
+    bool add_shared_certificates(const fs::path& file, StorageStatus& out_status);
+    /// @brief Publishes the parsed certificates of a file that was not found by 'add_shared_certificates'
+    void publish_shared_certificates(const fs::path& file, const StorageStatus& status);
+
     /// @brief operation to be executed after each add/delete to this bundle
     void invalidate_hierarchy();
 
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <evse_security/certificate/x509_wrapper.hpp>
+#include <evse_security/evse_types.hpp>
+
+namespace evse_security {
+
+/// @brief Index of the certificates of a trust store by subject hash and key identifier. Used to reject the chains
+/// that the full verification would certainly reject, without building an OpenSSL store: an expired leaf, or a chain
+/// in which no certificate can be issued by a trusted certificate (e.g. a certificate of another PKI)
+class X509TrustIndex {
+public:
+    X509TrustIndex() = default;
+    explicit X509TrustIndex(const std::vector<X509Wrapper>& trusted_certificates);
+
+    /// @brief Checks the chain against the index, the leaf first followed by the untrusted intermediates
+    /// @return 'Expired' or 'IssuerNotFound' if the chain can be rejected, 'Valid' if it requires the full
+    /// verification. The name hashes are truncated, a collision only results in a full verification
+    CertificateValidationResult precheck(const std::vector<X509Wrapper>& chain) const;
+
+    std::size_t size() const {
+        return count;
+    }
+
+private:
+    /// @brief If the key identifiers do not exclude the issuer, as checked by OpenSSL
+    static bool is_key_identifier_match(const std::string& authority_key_identifier,
+                                        const std::string& key_identifier);
+    /// @brief If the @p certificate is trusted or can be issued by a trusted certificate
+    bool is_anchored(const X509Wrapper& certificate) const;
+
+    // Key identifiers of the trusted certificates by subject hash
+    std::unordered_map<std::string, std::vector<std::string>> key_identifiers;
+    std::size_t count{0};
+};
+
+} // namespace evse_security
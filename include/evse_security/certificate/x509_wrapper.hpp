@@ -18,7 +18,9 @@ enum class X509CertificateSource {
     // Built from a directory of certificates
     DIRECTORY,
     // Build from a raw string
-    STRING
+    STRING,
+    // Built from the trust anchors embedded at build time, read-only
+    EMBEDDED
 };
 
 /// @brief Convenience wrapper around openssl X509 certificate
@@ -85,6 +87,19 @@ public:
     /// @result
     std::string get_key_hash() const;
 
+    /// @brief Gets the hash of the canonical subject name, the OpenSSL 'subject hash'
+    std::string get_subject_hash() const;
+
+    /// @brief Gets the hash of the canonical issuer name, same as the subject hash of the issuer
+    std::string get_issuer_hash() const;
+
+    /// @brief Gets the subject key identifier, empty if the extension is not present
+    std::string get_key_identifier() const;
+
+    /// @brief Gets the authority key identifier, that is the key identifier of the issuer. Empty if the
+    /// extension is not present
+    std::string get_authority_key_identifier() const;
+
     /// @brief Gets serial number of certificate
     /// @result
     std::string get_serial_number() const;
@@ -34,11 +34,19 @@ public:
 
 public: // X509 certificate utilities
     static std::string x509_to_string(X509Handle* handle);
+    /// @brief Returns the DER encoding of the certificate, empty on failure
+    static std::string x509_to_der(X509Handle* handle);
     static std::string x509_get_responder_url(X509Handle* handle);
     static std::string x509_get_key_hash(X509Handle* handle);
     static std::string x509_get_serial_number(X509Handle* handle);
     static std::string x509_get_issuer_name_hash(X509Handle* handle);
     static std::string x509_get_common_name(X509Handle* handle);
+    /// @brief Returns the hash of the canonical subject/issuer name, as used by the OpenSSL 'hash.0' file names
+    static std::string x509_get_subject_hash(X509Handle* handle);
+    static std::string x509_get_issuer_hash(X509Handle* handle);
+    /// @brief Returns the subject/authority key identifier extension in hex, empty if it is not present
+    static std::string x509_get_key_identifier(X509Handle* handle);
+    static std::string x509_get_authority_key_identifier(X509Handle* handle);
 
     /// @brief Returns the time validity for a certificate
     /// @param out_valid_in Valid in amount of seconds. A negative value is in the past, a positive one is in the future
@@ -72,9 +80,28 @@ public: // X509 certificate utilities
     static bool x509_verify_signature(X509Handle* handle, const std::vector<std::uint8_t>& signature,
                                       const std::vector<std::uint8_t>& data);
 
-    /// @brief Generates a certificate signing request with the provided parameters
+    /// @brief Generates a certificate signing request with the provided parameters. Suppliers can prepare
+    /// the subject and the extensions once per subject, so that a new request only requires a new key and signature
     static CertificateSignRequestResult x509_generate_csr(const CertificateSigningRequestInfo& generation_info,
                                                           std::string& out_csr);
+    /// @brief Returns the public key hash of a PEM CSR, in the same format as 'x509_get_key_hash' so that
+    /// the request can be matched with the certificate issued for it
+    static std::string x509_get_csr_key_hash(const std::string& csr);
+
+public: // Certificate revocation lists
+    /// @brief Loads all the PEM encoded revocation lists of @p data, false if none or an invalid one was found
+    static bool x509_crl_load(const std::string& data, std::vector<CertificateRevocationList>& out_crls);
+    /// @brief Verifies that the revocation list was issued and signed by the @p issuer certificate
+    static bool x509_crl_verify(const CertificateRevocationList& crl, X509Handle* issuer);
+
+public: // OCSP
+    /// @brief Verifies the DER encoded OCSP @p response for @p certificate: the signature of the responder, issued by
+    /// @p issuer or the issuer itself, the certificate ID and the validity window
+    /// @param out_next_update next update of the response as seconds since epoch, if it has one
+    /// @return status of the certificate, 'Invalid' if the response could not be verified
+    static OCSPCertificateStatus x509_verify_ocsp_response(const std::string& response, X509Handle* certificate,
+                                                           X509Handle* issuer,
+                                                           std::optional<std::int64_t>& out_next_update);
 
 public: // Digesting/decoding utils
     static bool digest_file_sha256(const fs::path& path, std::vector<std::uint8_t>& out_digest);
@@ -3,10 +3,12 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace evse_security {
 
@@ -67,6 +69,16 @@ struct CertificateSigningRequestInfo {
 
     KeyGenerationInfo key_info;
 };
+
+/// @brief Certificate revocation list decoded by the crypto supplier
+struct CertificateRevocationList {
+    std::string issuer_name_hash; ///< Same format as the 'issuer_name_hash' of the revoked certificates
+    std::vector<std::string> revoked_serial_numbers; ///< Same format as the 'serial_number' of the certificates
+    std::int64_t last_update;                        ///< Issue time, seconds since epoch
+    std::optional<std::int64_t> next_update;         ///< Time of the next list, seconds since epoch
+    std::string pem;                                 ///< PEM encoding of the list
+};
+
 class CertificateLoadException : public std::runtime_error {
 public:
     using std::runtime_error::runtime_error;
@@ -24,11 +24,16 @@ public:
 
 public:
     static std::string x509_to_string(X509Handle* handle);
+    static std::string x509_to_der(X509Handle* handle);
     static std::string x509_get_responder_url(X509Handle* handle);
     static std::string x509_get_key_hash(X509Handle* handle);
     static std::string x509_get_serial_number(X509Handle* handle);
     static std::string x509_get_issuer_name_hash(X509Handle* handle);
     static std::string x509_get_common_name(X509Handle* handle);
+    static std::string x509_get_subject_hash(X509Handle* handle);
+    static std::string x509_get_issuer_hash(X509Handle* handle);
+    static std::string x509_get_key_identifier(X509Handle* handle);
+    static std::string x509_get_authority_key_identifier(X509Handle* handle);
     static bool x509_get_validity(X509Handle* handle, std::int64_t& out_valid_in, std::int64_t& out_valid_to);
     static bool x509_is_selfsigned(X509Handle* handle);
     static bool x509_is_child(X509Handle* child, X509Handle* parent);
@@ -45,6 +50,16 @@ public:
 
     static CertificateSignRequestResult x509_generate_csr(const CertificateSigningRequestInfo& csr_info,
                                                           std::string& out_csr);
+    static std::string x509_get_csr_key_hash(const std::string& csr);
+
+public:
+    static bool x509_crl_load(const std::string& data, std::vector<CertificateRevocationList>& out_crls);
+    static bool x509_crl_verify(const CertificateRevocationList& crl, X509Handle* issuer);
+
+public:
+    static OCSPCertificateStatus x509_verify_ocsp_response(const std::string& response, X509Handle* certificate,
+                                                           X509Handle* issuer,
+                                                           std::optional<std::int64_t>& out_next_update);
 
 public:
     static bool digest_file_sha256(const fs::path& path, std::vector<std::uint8_t>& out_digest);
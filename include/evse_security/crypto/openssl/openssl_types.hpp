@@ -5,6 +5,7 @@
 #ifdef LIBEVSE_CRYPTO_SUPPLIER_OPENSSL
 
 #include <memory>
+#include <openssl/ocsp.h>
 #include <openssl/x509v3.h>
 
 template <> class std::default_delete<X509> {
@@ -14,6 +15,34 @@ public:
     }
 };
 
+template <> class std::default_delete<X509_CRL> {
+public:
+    void operator()(X509_CRL* ptr) const {
+        ::X509_CRL_free(ptr);
+    }
+};
+
+template <> class std::default_delete<OCSP_RESPONSE> {
+public:
+    void operator()(OCSP_RESPONSE* ptr) const {
+        ::OCSP_RESPONSE_free(ptr);
+    }
+};
+
+template <> class std::default_delete<OCSP_BASICRESP> {
+public:
+    void operator()(OCSP_BASICRESP* ptr) const {
+        ::OCSP_BASICRESP_free(ptr);
+    }
+};
+
+template <> class std::default_delete<OCSP_CERTID> {
+public:
+    void operator()(OCSP_CERTID* ptr) const {
+        ::OCSP_CERTID_free(ptr);
+    }
+};
+
 template <> class std::default_delete<X509_STORE> {
 public:
     void operator()(X509_STORE* ptr) const {
@@ -80,7 +109,11 @@ public:
 namespace evse_security {
 
 using X509_ptr = std::unique_ptr<X509>;
+using X509_CRL_ptr = std::unique_ptr<X509_CRL>;
 using X509_STORE_ptr = std::unique_ptr<X509_STORE>;
+using OCSP_RESPONSE_ptr = std::unique_ptr<OCSP_RESPONSE>;
+using OCSP_BASICRESP_ptr = std::unique_ptr<OCSP_BASICRESP>;
+using OCSP_CERTID_ptr = std::unique_ptr<OCSP_CERTID>;
 using X509_STORE_CTX_ptr = std::unique_ptr<X509_STORE_CTX>;
 // Unsafe since it does not free contained elements, only the stack, the element
 // cleanup has to be done manually
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <evse_security/daemon/protocol.hpp>
+#include <evse_security/evse_types.hpp>
+
+namespace evse_security {
+
+/// @brief Custom exception that is thrown when the 'EvseSecurityServer' can not be reached
+class DaemonConnectionException : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// @brief Thin client of an 'EvseSecurityServer', with the same API as 'EvseSecurity'. The calls are forwarded
+/// to the daemon, failures of the daemon API are thrown as 'std::runtime_error'.
+///
+/// The results that only depend on the content of the certificate stores (see 'daemon::is_cacheable') are cached
+/// until the daemon pushes a new generation, the results that also depend on the time are always requested.
+///
+/// The expiry watches are checked by the daemon, that pushes their notifications. The client has no thread of its
+/// own: the notifications are received and their callbacks called by the next call of this client, or by
+/// 'process_notifications'
+class EvseSecurityClient {
+public:
+    /// @brief The connection is established on the first call, and re-established if the daemon restarted
+    explicit EvseSecurityClient(const fs::path& socket_path);
+    ~EvseSecurityClient();
+
+    InstallCertificateResult install_ca_certificate(const std::string& certificate, CaCertificateType certificate_type);
+    DeleteCertificateResult delete_certificate(const CertificateHashData& certificate_hash_data);
+    CertificateValidationResult verify_certificate(const std::string& certificate_chain,
+                                                   const LeafCertificateType certificate_type);
+    InstallCertificateResult update_leaf_certificate(const std::string& certificate_chain,
+                                                     LeafCertificateType certificate_type);
+    GetInstalledCertificatesResult get_installed_certificate(CertificateType certificate_type);
+    GetInstalledCertificatesResult get_installed_certificates(const std::vector<CertificateType>& certificate_types);
+    int get_count_of_installed_certificates(const std::vector<CertificateType>& certificate_types);
+    OCSPRequestDataList get_v2g_ocsp_request_data();
+    OCSPRequestDataList get_mo_ocsp_request_data(const std::string& certificate_chain);
+    void update_ocsp_cache(const CertificateHashData& certificate_hash_data, const std::string& ocsp_response);
+    std::optional<fs::path> retrieve_ocsp_cache(const CertificateHashData& certificate_hash_data);
+    std::optional<OCSPVerdict> get_ocsp_verdict(const CertificateHashData& certificate_hash_data);
+    InstallCertificateResult install_crl(const std::string& crl, CaCertificateType certificate_type);
+    std::optional<std::chrono::system_clock::time_point> get_crl_next_update(CaCertificateType certificate_type);
+    bool is_ca_certificate_installed(CaCertificateType certificate_type);
+    void certificate_signing_request_failed(const std::string& csr, LeafCertificateType certificate_type);
+    GetCertificateSignRequestResult generate_certificate_signing_request(LeafCertificateType certificate_type,
+                                                                         const std::string& country,
+                                                                         const std::string& organization,
+                                                                         const std::string& common,
+                                                                         bool use_custom_provider);
+    GetCertificateSignRequestResult generate_certificate_signing_request(LeafCertificateType certificate_type,
+                                                                         const std::string& country,
+                                                                         const std::string& organization,
+                                                                         const std::string& common);
+    GetCertificateInfoResult get_leaf_certificate_info(LeafCertificateType certificate_type, EncodingFormat encoding,
+                                                       bool include_ocsp = false);
+    GetCertificateFullInfoResult get_all_valid_certificates_info(LeafCertificateType certificate_type,
+                                                                 EncodingFormat encoding, bool include_ocsp = false);
+    std::shared_ptr<const OCSPStaplingPayload> get_ocsp_stapling_payload(LeafCertificateType certificate_type);
+    bool update_certificate_links(LeafCertificateType certificate_type);
+    std::string get_verify_file(CaCertificateType certificate_type);
+    std::string get_verify_location(CaCertificateType certificate_type);
+    GetCertificateInfoResult get_ca_certificate_info(CaCertificateType certificate_type);
+    int get_leaf_expiry_days_count(LeafCertificateType certificate_type);
+    void garbage_collect();
+
+    /// @brief Same as 'EvseSecurity::register_expiry_watch', the callback is called without the lock of this client
+    /// held, from the thread of the call that received the notification. The watches are registered again when the
+    /// connection is re-established, the thresholds that were already crossed are then notified again
+    std::size_t register_expiry_watch(const std::vector<int>& threshold_days,
+                                      const std::function<void(const CertificateExpiry&)>& callback);
+    /// @brief Removes the watch with the @p watch_id returned by 'register_expiry_watch', its notifications that
+    /// were received but not processed yet are dropped
+    void unregister_expiry_watch(std::size_t watch_id);
+    /// @brief Receives the pending notifications of the daemon and calls the callbacks of the expiry watches
+    void process_notifications();
+
+    /// @brief The static helpers do not depend on the certificate stores and are run in this process
+    static bool verify_file_signature(const fs::path& path, const std::string& signing_certificate,
+                                      const std::string signature);
+    static std::vector<std::uint8_t> base64_decode_to_bytes(const std::string& base64_string);
+    static std::string base64_decode_to_string(const std::string& base64_string);
+    static std::string base64_encode_from_bytes(const std::vector<std::uint8_t>& bytes);
+    static std::string base64_encode_from_string(const std::string& string);
+
+    /// @brief Last generation of the daemon seen by this client
+    std::uint64_t get_generation();
+    /// @brief Count of the results served from the cache, without a request to the daemon
+    std::uint64_t get_cache_hits();
+
+private:
+    /// @brief Sends the request with the encoded @p args and decodes the response as @p Result
+    template <typename Result, typename... Args> Result call(daemon::Opcode opcode, const Args&... args);
+
+    /// @brief Returns the payload of the response, from the cache if possible
+    std::string transact(daemon::Opcode opcode, const std::string& payload);
+    bool exchange(const daemon::Message& request, daemon::Message& out_response);
+    void connect();
+    void disconnect();
+    /// @brief Processes the pushed generation updates and expiry notifications that were received since the last call
+    void process_updates();
+    void set_generation(std::uint64_t new_generation);
+    /// @brief Queues the expiry notification for its callback, false if it is invalid
+    bool receive_expiry(const daemon::Message& notification);
+    /// @brief Calls the callbacks of the queued expiry notifications, without the lock held
+    void dispatch_expiries();
+    /// @brief Registers the watch on the daemon, false if the connection failed
+    bool send_expiry_watch(std::size_t watch_id);
+
+    fs::path socket_path;
+
+    std::mutex mutex;
+    int fd{-1};
+    std::uint64_t generation{0};
+    std::uint64_t cache_hits{0};
+    std::map<std::pair<daemon::Opcode, std::string>, std::string> cache;
+
+    struct ExpiryWatch {
+        std::vector<int> threshold_days;
+        std::function<void(const CertificateExpiry&)> callback;
+    };
+    std::map<std::size_t, ExpiryWatch> expiry_watches; // Registered again on each connection
+    std::size_t next_expiry_watch_id{1};
+    std::vector<std::pair<std::size_t, CertificateExpiry>> received_expiries; // Not dispatched yet, by watch id
+};
+
+} // namespace evse_security
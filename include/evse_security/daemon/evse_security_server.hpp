@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <evse_security/daemon/protocol.hpp>
+#include <evse_security/evse_security.hpp>
+
+namespace evse_security {
+
+/// @brief Serves the API of one 'EvseSecurity' instance to the 'EvseSecurityClient's of the other processes over a
+/// Unix domain socket, so that the certificate stores are parsed and garbage collected once per system.
+///
+/// The requests are processed one after the other by the server thread. After each request that can modify the
+/// certificate stores the generation is incremented and pushed to all the clients, that drop their cached results.
+/// The stores are also checked every second for changes made outside the requests (by the garbage collection or by
+/// other processes), that increment the generation too. If the storage can not tell whether the stores changed
+/// without listing them, the generation is incremented on each check, so that no cached result is older than a
+/// second.
+///
+/// The socket is only accessible by the user of the server (mode 0600), or also by a configured group (mode 0660).
+/// The credentials of each connecting process are checked too: only the user of the server, root and the members of
+/// the configured group (by their primary group) are served.
+///
+/// The expiry watches of the clients are registered on the 'EvseSecurity' for the lifetime of their connection. Their
+/// callbacks queue the notifications and wake up the server thread, that sends them to the client.
+///
+/// The client sockets are non-blocking: requests are assembled and responses are sent from per client buffers, so
+/// that a client sending a partial request or not reading its responses only stalls itself
+class EvseSecurityServer {
+public:
+    /// @param socket_group group allowed to connect, besides the user of the server
+    EvseSecurityServer(EvseSecurity& security, const fs::path& socket_path,
+                       std::optional<gid_t> socket_group = std::nullopt);
+    ~EvseSecurityServer();
+
+    /// @brief Binds the socket (replacing a stale one) and starts serving the clients
+    /// @return false if the socket could not be created, or if something else than a socket exists at its path
+    bool start();
+    /// @brief Stops serving and disconnects all the clients
+    void stop();
+
+    std::uint64_t get_generation() const {
+        return generation;
+    }
+
+private:
+    struct Client {
+        int fd;
+        std::uint64_t id;   // Of the connection, the notifications are addressed by it as the fds are reused
+        std::string input;  // Received data, not a complete request yet
+        std::string output; // Responses and updates not sent yet
+        std::map<std::uint64_t, std::size_t> expiry_watches{}; // 'EvseSecurity' watch id by client watch id
+    };
+
+    /// @brief Expiry notifications queued by the watch callbacks, that run on the timer thread of the 'EvseSecurity'
+    /// and can still run after their watch was removed, so they share it instead of referring to the server
+    struct Notifications {
+        std::mutex mutex;
+        std::vector<std::pair<std::uint64_t, daemon::Message>> messages; // With the id of their client
+        int wake_fd{-1}; // Write end of the pipe waking up the server thread, -1 once stopped
+    };
+
+    void run();
+    /// @brief If the process connected on @p fd runs as the user of the server, as root or in the socket group
+    bool is_allowed_peer(int fd) const;
+    /// @brief Receives, processes the complete requests and sends, false if the client has to be disconnected
+    bool serve_client(Client& client, short events, std::vector<int>& out_closed_fds);
+    /// @brief Processes a request and queues its response, false if the client has to be disconnected
+    bool handle_request(Client& client, const daemon::Message& request);
+    /// @brief Decodes the request and encodes the result of the API call
+    bool dispatch(daemon::Opcode opcode, daemon::MessageReader& reader, daemon::MessageWriter& writer);
+    /// @brief Registers, replaces or removes an expiry watch of the client, false if the request is invalid
+    bool handle_expiry_watch(Client& client, daemon::Opcode opcode, daemon::MessageReader& reader);
+    /// @brief Removes all the expiry watches of the client
+    void unregister_expiry_watches(Client& client);
+    /// @brief Queues the pending expiry notifications to their clients
+    void deliver_notifications(std::vector<int>& out_failed_fds);
+    void push_generation(int except_fd, std::vector<int>& out_failed_fds);
+    /// @brief Reads the generation of the certificate stores, true if they changed since the last call or if the
+    /// storage can not tell
+    bool is_store_changed();
+
+    EvseSecurity& security;
+    fs::path socket_path;
+    std::optional<gid_t> socket_group;
+
+    int listen_fd{-1};
+    int wake_fds[2]{-1, -1}; // Pipe waking up the server thread on stop and on expiry notifications
+    std::atomic<bool> stopping{false};
+    std::vector<Client> clients;
+    std::uint64_t next_client_id{1};
+    std::shared_ptr<Notifications> notifications{std::make_shared<Notifications>()};
+    std::thread server_thread;
+
+    std::atomic<std::uint64_t> generation{1};
+    std::optional<std::uint64_t> store_generation; // Of the 'EvseSecurity' stores, at the last check
+};
+
+} // namespace evse_security
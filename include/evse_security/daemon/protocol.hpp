@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <evse_security/evse_types.hpp>
+
+/// Binary protocol between the 'EvseSecurityServer' and the 'EvseSecurityClient' over a Unix domain socket.
+/// Each message is a fixed header (payload size, opcode, generation) followed by the payload. Integers are in host
+/// byte order (the socket is local), strings and vectors are prefixed by their 32 bit size, optionals by a presence
+/// byte and enums are sent as their 32 bit underlying value
+namespace evse_security::daemon {
+
+constexpr std::uint32_t PROTOCOL_VERSION = 2;
+// Limit of a single message, a few certificate chains are far below it
+constexpr std::uint32_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+constexpr std::size_t MESSAGE_HEADER_SIZE = sizeof(std::uint32_t) + sizeof(std::uint16_t) + sizeof(std::uint64_t);
+
+/// @brief A request is answered with the same opcode, or with 'Error' if it could not be processed
+enum class Opcode : std::uint16_t {
+    Hello,            ///< Version handshake, the response contains the protocol version of the server
+    GenerationUpdate, ///< Pushed by the server to all the clients when the certificate stores were modified
+    Error,            ///< Response with the description of the failure
+    InstallCaCertificate,
+    DeleteCertificate,
+    VerifyCertificate,
+    UpdateLeafCertificate,
+    GetInstalledCertificates,
+    GetCountOfInstalledCertificates,
+    GetV2gOcspRequestData,
+    GetMoOcspRequestData,
+    UpdateOcspCache,
+    RetrieveOcspCache,
+    IsCaCertificateInstalled,
+    CertificateSigningRequestFailed,
+    GenerateCertificateSigningRequest,
+    GetLeafCertificateInfo,
+    GetAllValidCertificatesInfo,
+    UpdateCertificateLinks,
+    GetVerifyFile,
+    GetVerifyLocation,
+    GetCaCertificateInfo,
+    GetLeafExpiryDaysCount,
+    GarbageCollect,
+    InstallCrl,
+    GetCrlNextUpdate,
+    GetOcspVerdict,
+    GetOcspStaplingPayload,
+    RegisterExpiryWatch,   ///< Registers or replaces the expiry watch with the id chosen by the client
+    UnregisterExpiryWatch, ///< Removes the expiry watch with the id chosen by the client
+    ExpiryNotification,    ///< Pushed by the server to the client of an expiry watch when a threshold is crossed
+};
+
+/// @brief If the request can modify the certificate stores, the server increments its generation after it
+bool is_modifying(Opcode opcode);
+
+/// @brief If the response only depends on the request and the content of the certificate stores, and can be cached
+/// until the next generation update. The server also increments the generation when the stores change outside the
+/// requests. The results that also depend on the current time are never cached: the verification and the ones that
+/// only consider the valid roots (e.g. 'IsCaCertificateInstalled', 'GetVerifyFile', 'GetCaCertificateInfo', the MO
+/// OCSP request data) or the valid leafs (the leaf info, expiry and stapling payload, the V2G OCSP request data and
+/// the installed V2G chain)
+bool is_cacheable(Opcode opcode);
+
+struct Message {
+    Opcode opcode;
+    std::uint64_t generation; ///< Generation of the server when the message was sent, 0 for the requests
+    std::string payload;
+};
+
+/// @brief Sends the complete message, false if the connection failed
+/// @param wait if false, fails instead of waiting for space in the socket buffer
+bool send_message(int fd, const Message& message, bool wait = true);
+/// @brief Receives a complete message, false if the connection was closed or the message is invalid
+bool receive_message(int fd, Message& out_message);
+
+/// @brief Appends the encoded message to @p buffer, false if it is too large
+bool append_message(std::string& buffer, const Message& message);
+
+enum class ParseResult {
+    Complete,   ///< A message was taken from the buffer
+    Incomplete, ///< More data has to be received
+    Invalid,    ///< The connection has to be closed
+};
+
+/// @brief Takes the first message from the front of @p buffer, for readers that receive without blocking
+ParseResult parse_message(std::string& buffer, Message& out_message);
+
+class MessageWriter {
+public:
+    const std::string& get_data() const {
+        return data;
+    }
+
+    void write(bool value);
+    void write(std::int32_t value);
+    void write(std::uint32_t value);
+    void write(std::uint64_t value);
+    void write(const std::string& value);
+    void write(const fs::path& value);
+    void write(const std::chrono::system_clock::time_point& value);
+
+    void write(const CertificateHashData& value);
+    void write(const CertificateHashDataChain& value);
+    void write(const GetInstalledCertificatesResult& value);
+    void write(const OCSPRequestData& value);
+    void write(const OCSPRequestDataList& value);
+    void write(const CertificateOCSP& value);
+    void write(const CertificateInfo& value);
+    void write(const GetCertificateInfoResult& value);
+    void write(const GetCertificateFullInfoResult& value);
+    void write(const GetCertificateSignRequestResult& value);
+    void write(const OCSPVerdict& value);
+    void write(const OCSPStaplingPayload& value);
+    void write(const CertificateExpiry& value);
+
+    template <typename T> std::enable_if_t<std::is_enum_v<T>> write(T value) {
+        write(static_cast<std::uint32_t>(value));
+    }
+
+    template <typename T> void write(const std::optional<T>& value) {
+        write(value.has_value());
+
+        if (value.has_value()) {
+            write(value.value());
+        }
+    }
+
+    template <typename T> void write(const std::vector<T>& values) {
+        write(static_cast<std::uint32_t>(values.size()));
+
+        for (const auto& value : values) {
+            write(value);
+        }
+    }
+
+private:
+    void write_raw(const void* value, std::size_t size);
+
+    std::string data;
+};
+
+/// @brief Reads the values in the order they were written, all reads fail after the first invalid one
+class MessageReader {
+public:
+    explicit MessageReader(const std::string& data) : data(data) {
+    }
+
+    /// @brief If all the data was read without error
+    bool is_complete() const {
+        return valid && offset == data.size();
+    }
+
+    bool read(bool& value);
+    bool read(std::int32_t& value);
+    bool read(std::uint32_t& value);
+    bool read(std::uint64_t& value);
+    bool read(std::string& value);
+    bool read(fs::path& value);
+    bool read(std::chrono::system_clock::time_point& value);
+
+    bool read(CertificateHashData& value);
+    bool read(CertificateHashDataChain& value);
+    bool read(GetInstalledCertificatesResult& value);
+    bool read(OCSPRequestData& value);
+    bool read(OCSPRequestDataList& value);
+    bool read(CertificateOCSP& value);
+    bool read(CertificateInfo& value);
+    bool read(GetCertificateInfoResult& value);
+    bool read(GetCertificateFullInfoResult& value);
+    bool read(GetCertificateSignRequestResult& value);
+    bool read(OCSPVerdict& value);
+    bool read(OCSPStaplingPayload& value);
+    bool read(CertificateExpiry& value);
+
+    template <typename T> std::enable_if_t<std::is_enum_v<T>, bool> read(T& value) {
+        std::uint32_t raw;
+
+        if (!read(raw)) {
+            return false;
+        }
+
+        value = static_cast<T>(raw);
+        return true;
+    }
+
+    template <typename T> bool read(std::optional<T>& value) {
+        bool present;
+
+        if (!read(present)) {
+            return false;
+        }
+
+        if (!present) {
+            value.reset();
+            return true;
+        }
+
+        T content;
+        if (!read(content)) {
+            return false;
+        }
+
+        value = std::move(content);
+        return true;
+    }
+
+    template <typename T> bool read(std::vector<T>& values) {
+        std::uint32_t count;
+
+        // Each element takes at least a byte, do not reserve more than what was received
+        if (!read(count) || count > data.size() - offset) {
+            valid = false;
+            return false;
+        }
+
+        values.clear();
+        values.reserve(count);
+
+        for (std::uint32_t i = 0; i < count; i++) {
+            T value;
+
+            if (!read(value)) {
+                return false;
+            }
+
+            values.push_back(std::move(value));
+        }
+
+        return true;
+    }
+
+private:
+    bool read_raw(void* value, std::size_t size);
+
+    const std::string& data;
+    std::size_t offset{0};
+    bool valid{true};
+};
+
+} // namespace evse_security::daemon
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <evse_security/storage/certificate_storage.hpp>
+
+namespace evse_security {
+
+// Maximum count of cached directory snapshots, all are dropped when exceeded
+constexpr std::size_t MAX_DIRECTORY_SNAPSHOTS = 64;
+
+/// @brief Recursive listing of a directory at the time it was walked
+struct DirectorySnapshot {
+    /// @brief Regular files and symlinks to them, with paths relative to the directory
+    std::vector<std::pair<fs::path, StorageStatus>> files;
+    /// @brief Modification times of the directory ("") and of all its subdirectories
+    std::map<fs::path, std::int64_t> directories;
+};
+
+/// @brief Process-wide cache of directory snapshots, so that the directories of the store are walked once
+/// and not by each operation. A snapshot is dropped when inotify reports a change in one of its directories,
+/// or, if inotify is not available, when the modification time of one of its directories or the status of one of
+/// its files changed. Without inotify the files are stat'ed again on each use of a snapshot, so that in-place
+/// modifications by other processes are seen, only the directory walk is saved. Changes made through the
+/// 'PosixStorage' drop the snapshots containing them right away
+class DirectorySnapshotCache {
+public:
+    static DirectorySnapshotCache& instance();
+    ~DirectorySnapshotCache();
+
+    /// @brief Returns the snapshot of the directory, nullptr if missing or outdated
+    std::shared_ptr<const DirectorySnapshot> find(const fs::path& directory);
+    /// @brief Adds the snapshot of a walked directory, all the directory modification times must have
+    /// been read before the directory content
+    void insert(const fs::path& directory, const std::shared_ptr<const DirectorySnapshot>& snapshot);
+    /// @brief Drops the snapshots that contain the modified @p path
+    void invalidate(const fs::path& path);
+    void clear();
+
+    /// @brief Incremented each time a snapshot is dropped, for caches that depend on the directory content
+    std::uint64_t get_generation();
+    /// @brief The generation, if each of the directories has a snapshot watched by inotify. Then any change of their
+    /// content increments it, so that an unchanged generation proves them unchanged without walking them
+    std::optional<std::uint64_t> get_watched_generation(const std::vector<fs::path>& directories);
+    /// @brief If the new snapshots are watched by inotify, false if it is not available or disabled
+    bool is_watching();
+
+    /// @brief Enables (default) or disables the use of inotify, e.g. for network filesystems where the changes of
+    /// other hosts are not reported. Drops all the snapshots
+    void set_inotify_enabled(bool enabled);
+
+private:
+    DirectorySnapshotCache();
+
+    struct Entry {
+        std::shared_ptr<const DirectorySnapshot> snapshot;
+        std::vector<int> watches;
+        bool watched{false}; // If all the directories are watched by inotify
+    };
+
+    /// @brief Reads the pending inotify events and drops the changed snapshots
+    void process_events();
+    /// @brief If the modification times of the snapshot directories are unchanged
+    static bool is_unchanged(const fs::path& directory, const DirectorySnapshot& snapshot);
+    /// @brief If the modification times and sizes of the snapshot files are unchanged
+    static bool are_files_unchanged(const fs::path& directory, const DirectorySnapshot& snapshot);
+    void erase_internal(std::map<fs::path, Entry>::iterator it);
+
+    std::mutex mutex;
+    std::map<fs::path, Entry> entries; // By absolute normalized path
+    std::map<int, std::set<fs::path>> watch_owners; // Snapshots of each watched directory
+    std::uint64_t generation{0};
+    int inotify_fd{-1};
+    bool inotify_enabled{true};
+};
+
+} // namespace evse_security
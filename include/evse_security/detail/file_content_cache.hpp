@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace evse_security {
+
+// Default capacity of the process-wide file content cache, enough for a few hundred PEM files
+constexpr std::size_t DEFAULT_FILE_CONTENT_CACHE_CAPACITY = 4 * 1024 * 1024;
+
+/// @brief Identity of a file version, a file is considered unchanged while all fields match
+struct FileIdentity {
+    std::uintmax_t device;
+    std::uintmax_t inode;
+    std::int64_t modification_time;
+    std::uintmax_t size;
+
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode && modification_time == other.modification_time &&
+               size == other.size;
+    }
+};
+
+/// @brief Process-wide cache of file contents keyed by the file identity, so that reading a file that did not
+/// change costs a stat instead of a read. The least recently used entries are evicted once the total
+/// size exceeds the capacity. Since the key is the inode, all the paths to the same file share the entry
+class FileContentCache {
+public:
+    static FileContentCache& instance();
+
+    /// @brief Returns the cached content, nullptr if the file is not cached or changed
+    std::shared_ptr<const std::string> find(const FileIdentity& identity);
+    void insert(const FileIdentity& identity, const std::shared_ptr<const std::string>& data);
+    /// @brief Drops the entry of a file that is modified or removed
+    void erase(std::uintmax_t device, std::uintmax_t inode);
+    void clear();
+
+    /// @brief Sets the maximum total size of the cached contents, 0 disables the cache
+    void set_capacity(std::size_t capacity_bytes);
+    bool is_enabled();
+
+private:
+    using Key = std::pair<std::uintmax_t, std::uintmax_t>;
+
+    struct Entry {
+        FileIdentity identity;
+        std::shared_ptr<const std::string> data;
+        std::list<Key>::iterator usage;
+    };
+
+    void erase_internal(std::map<Key, Entry>::iterator it);
+    void evict();
+
+    std::mutex mutex;
+    std::map<Key, Entry> entries;
+    std::list<Key> usage; // Most recently used first
+    std::size_t size{0};
+    std::size_t capacity{DEFAULT_FILE_CONTENT_CACHE_CAPACITY};
+};
+
+} // namespace evse_security
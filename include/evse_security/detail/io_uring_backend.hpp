@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <evse_security/utils/evse_filesystem_types.hpp>
+
+/// @brief Batched file operations on top of the raw io_uring syscalls. Only compiled when
+/// LIBEVSE_SECURITY_USE_IO_URING is set, used by the filesystem_utils batch functions
+namespace evse_security::filesystem_utils::io_uring {
+
+/// @brief If the kernel supports io_uring with all the required operations. Can be false when
+/// io_uring is disabled or blocked (e.g. by a seccomp filter)
+bool is_available();
+
+/// @brief Reads all files, the open, stat, read and close operations are submitted in batches
+/// @return False if the ring failed, in that case the caller must fall back to blocking I/O
+bool read_files(const std::vector<fs::path>& file_paths, std::vector<std::optional<std::string>>& out_data);
+
+/// @brief Writes (truncates) all files
+/// @return False if the ring failed, in that case the caller must fall back to blocking I/O
+bool write_files(const std::vector<std::pair<fs::path, std::string>>& files, std::vector<bool>& out_written);
+
+/// @brief Unlinks all files
+/// @return False if the ring failed, in that case the caller must fall back to blocking I/O
+bool delete_files(const std::vector<fs::path>& file_paths, std::vector<bool>& out_deleted);
+
+} // namespace evse_security::filesystem_utils::io_uring
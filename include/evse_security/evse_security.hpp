@@ -4,12 +4,18 @@
 
 #include <everest/timer.hpp>
 
+#include <evse_security/certificate/embedded_trust_anchors.hpp>
 #include <evse_security/crypto/evse_crypto.hpp>
 #include <evse_security/evse_types.hpp>
+#include <evse_security/storage/certificate_storage.hpp>
 #include <evse_security/utils/evse_filesystem_types.hpp>
+#include <evse_security/utils/path_locks.hpp>
 
+#include <functional>
 #include <map>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifdef BUILD_TESTING_EVSE_SECURITY
 #include <gtest/gtest_prod.h>
@@ -17,6 +23,9 @@
 
 namespace evse_security {
 
+class X509CertificateBundle;
+class X509TrustIndex;
+
 struct LinkPaths {
     fs::path secc_leaf_cert_link;
     fs::path secc_leaf_key_link;
@@ -40,6 +49,9 @@ struct FilePaths {
     LinkPaths links;
 };
 
+// Interval of the checks of the expiry watches
+static constexpr std::chrono::hours EXPIRY_WATCH_INTERVAL{1};
+
 // Unchangeable security limit for certificate deletion, a min entry count will be always kept (newest)
 static constexpr std::size_t DEFAULT_MINIMUM_CERTIFICATE_ENTRIES = 10;
 // 50 MB default limit for filesystem usage
@@ -53,6 +65,16 @@ static std::chrono::seconds DEFAULT_CSR_EXPIRY(3600);
 // Garbage collect default time, 20 minutes
 static std::chrono::seconds DEFAULT_GARBAGE_COLLECT_TIME(20 * 60);
 
+// Journal of the pending CSR keys, one in each leaf key directory
+const fs::path MANAGED_CSR_JOURNAL_FILE = "managed_csr.journal";
+
+/// @brief Private key of a generated CSR that did not receive a certificate yet
+struct ManagedCsr {
+    std::chrono::time_point<std::chrono::steady_clock> timepoint; // Used for the expiry check
+    std::chrono::time_point<std::chrono::system_clock> created;   // Persisted, survives a reboot
+    std::string key_hash; // Public key hash, same as the 'get_key_hash' of the issued leaf
+};
+
 /// @brief This class holds filesystem paths to CA bundle file locations and directories for leaf certificates
 class EvseSecurity {
 
@@ -70,11 +92,16 @@ public:
     /// 'DEFAULT_CSR_EXPIRY'
     /// @param garbage_collect_time optional garbage collect time. How often we will delete expired CSRs and
     /// certificates. Defaults to 'DEFAULT_GARBAGE_COLLECT_TIME'
+    /// @param storage optional storage backend of the \p file_paths. Defaults to the filesystem ('PosixStorage')
+    /// @param embedded_trust_anchors optional read-only CA stores compiled into the binary (see
+    /// 'evse_security_embed_trust_anchors'), used instead of the configured bundle of their CA certificate type
     EvseSecurity(const FilePaths& file_paths, const std::optional<std::string>& private_key_password = std::nullopt,
                  const std::optional<std::uintmax_t>& max_fs_usage_bytes = std::nullopt,
                  const std::optional<std::uintmax_t>& max_fs_certificate_store_entries = std::nullopt,
                  const std::optional<std::chrono::seconds>& csr_expiry = std::nullopt,
-                 const std::optional<std::chrono::seconds>& garbage_collect_time = std::nullopt);
+                 const std::optional<std::chrono::seconds>& garbage_collect_time = std::nullopt,
+                 const std::shared_ptr<CertificateStorage>& storage = nullptr,
+                 const std::map<CaCertificateType, EmbeddedTrustAnchorSet>& embedded_trust_anchors = {});
 
     /// @brief Destructor
     ~EvseSecurity();
@@ -137,7 +164,8 @@ public:
     /// @return contains OCSP request data
     OCSPRequestDataList get_mo_ocsp_request_data(const std::string& certificate_chain);
 
-    /// @brief Updates the OCSP cache for the given \p certificate_hash_data with the given \p ocsp_response
+    /// @brief Updates the OCSP cache for the given \p certificate_hash_data with the given \p ocsp_response. A
+    /// response that can not be verified is not stored, the previously cached response is kept
     /// @param certificate_hash_data identifies the certificate for which the \p ocsp_response is specified
     /// @param ocsp_response the actual OCSP data
     void update_ocsp_cache(const CertificateHashData& certificate_hash_data, const std::string& ocsp_response);
@@ -148,6 +176,27 @@ public:
     /// @return the actual OCSP data or an empty value
     std::optional<fs::path> retrieve_ocsp_cache(const CertificateHashData& certificate_hash_data);
 
+    /// @brief Retrieves the verdict of the OCSP response cached for the given \p certificate_hash_data . The response
+    /// is verified once by \ref update_ocsp_cache (responder signature, certificate ID and validity window), this
+    /// function looks the verdict up in an index of the cache, without verifying or parsing it again
+    /// @param certificate_hash_data identifies the certificate of the OCSP response
+    /// @return the verdict, or an empty value if no response with a verdict is cached
+    std::optional<OCSPVerdict> get_ocsp_verdict(const CertificateHashData& certificate_hash_data);
+
+    /// @brief Installs the PEM revocation lists of \p crl for the CA bundle of \p certificate_type. Each list must be
+    /// signed by a certificate of the bundle, or by a sub-CA whose PEM certificate is supplied in \p crl and verifies
+    /// to the bundle (with the other supplied certificates as intermediates). A list replaces the installed list of the
+    /// same issuer unless that one is more recent. The revoked leafs and intermediates are rejected by
+    /// \ref verify_certificate
+    /// @param crl PEM formatted certificate revocation list or lists, optionally followed by the issuing sub-CAs
+    /// @param certificate_type specifies the CA certificate type
+    /// @return result of the operation
+    InstallCertificateResult install_crl(const std::string& crl, CaCertificateType certificate_type);
+
+    /// @brief Retrieves the earliest next update of the revocation lists installed for \p certificate_type
+    /// @return the next update time, or an empty value if no list with a next update is installed
+    std::optional<std::chrono::system_clock::time_point> get_crl_next_update(CaCertificateType certificate_type);
+
     /// @brief Indicates if a CA certificate for the given \p certificate_type is installed on the filesystem
     /// Supports both CA certificate bundles and directories
     /// @param certificate_type
@@ -216,7 +265,19 @@ public:
     GetCertificateFullInfoResult get_all_valid_certificates_info(LeafCertificateType certificate_type,
                                                                  EncodingFormat encoding, bool include_ocsp = false);
 
-    /// @brief Checks and updates the symlinks for the V2G leaf certificates and keys to the most recent valid one
+    /// @brief Retrieves the OCSP responses of the chain of the leaf selected by \ref get_leaf_certificate_info, ready
+    /// to be stapled for each certificate of a TLS 1.3 handshake. Only the responses with a good verdict that are
+    /// before their next update are included. The payload is kept and only rebuilt when a file of the leaf
+    /// directories, the CA bundles or the OCSP caches changed, a stapled response reached its next update or another
+    /// leaf can be selected
+    /// @param certificate_type type of the leaf certificate, CSMS or V2G
+    /// @return the payload, nullptr if no valid leaf with a key was found
+    std::shared_ptr<const OCSPStaplingPayload> get_ocsp_stapling_payload(LeafCertificateType certificate_type);
+
+    /// @brief Checks and updates the symlinks for the V2G leaf certificates and keys to the most recent valid one.
+    /// The links are also updated when a leaf is installed or deleted, and by the hourly timer of the expiry watches
+    /// (started when links are configured) once the selected leaf expires or another leaf becomes valid. A link is
+    /// replaced atomically, it is never missing while it changes
     /// @return true if one of the links was updated
     bool update_certificate_links(LeafCertificateType certificate_type);
 
@@ -237,17 +298,37 @@ public:
     /// @brief An extension of 'get_verify_file' with error handling included
     GetCertificateInfoResult get_ca_certificate_info(CaCertificateType certificate_type);
 
-    /// @brief Gets the expiry day count for the leaf certificate of the given \p certificate_type
+    /// @brief Gets the expiry day count for the leaf certificate of the given \p certificate_type. The expiry of the
+    /// selected leaf is kept, and only selected again when a file of the leaf directories changed, the leaf expired or
+    /// another leaf became valid
     /// @param certificate_type
     /// @return day count until the leaf certificate expires
     int get_leaf_expiry_days_count(LeafCertificateType certificate_type);
 
+    /// @brief Registers a watch of the leafs selected by \ref get_leaf_certificate_info and of the valid roots of all
+    /// CA types. The \p callback is called once for each threshold a certificate crosses, with the smallest threshold
+    /// if it crossed several since the previous check. The certificates are checked on registration and then every
+    /// 'EXPIRY_WATCH_INTERVAL', a renewed certificate is watched from its largest threshold again. The callback is
+    /// called without a lock held, from the registering thread or from the watch timer, and may call this instance
+    /// @param threshold_days the thresholds, in days left until the expiry, e.g. {30, 7, 1}
+    /// @return the id of the watch
+    std::size_t register_expiry_watch(const std::vector<int>& threshold_days,
+                                      const std::function<void(const CertificateExpiry&)>& callback);
+
+    /// @brief Removes the watch with the \p watch_id returned by \ref register_expiry_watch
+    void unregister_expiry_watch(std::size_t watch_id);
+
     /// @brief Collects and deletes unfulfilled CSR private keys. It also deletes the expired
     /// certificates. The caller must be sure the system clock is properly set for detecting expired
     /// certificates. A minimum of 'DEFAULT_MINIMUM_CERTIFICATE_ENTRIES' certificates to
     /// have a safeguard against a poorly set system clock
     void garbage_collect();
 
+    /// @brief Gets a value that changes whenever the certificate stores change, including the changes made by the
+    /// garbage collection or by other processes, for the caches of results derived from the stores
+    /// @return the generation, empty if the storage can not tell without listing the stores
+    std::optional<std::uint64_t> get_store_generation();
+
     /// @brief Verifies the file at the given \p path using the provided \p signing_certificate and \p signature
     /// @param path
     /// @param signing_certificate
@@ -284,38 +365,167 @@ private:
     GetCertificateInfoResult get_leaf_certificate_info_internal(LeafCertificateType certificate_type,
                                                                 EncodingFormat encoding, bool include_ocsp = false);
 
+    struct LeafSelection;
     /// @brief Retrieves information related to leaf certificates
     /// @param include_ocsp if OCSP information should be included
     /// @param include_root if the root certificate of the leaf should be included in the returned list
     /// @param include_all_valid if true, all valid leafs will be included, sorted in order, with the newest being
     /// first. If false, only the newest one will be returned
+    /// @param selection if set, receives the validity of the first returned leaf
     GetCertificateFullInfoResult get_full_leaf_certificate_info_internal(LeafCertificateType certificate_type,
                                                                          EncodingFormat encoding,
                                                                          bool include_ocsp = false,
                                                                          bool include_root = false,
-                                                                         bool include_all_valid = false);
+                                                                         bool include_all_valid = false,
+                                                                         LeafSelection* selection = nullptr);
+    /// @brief Gets the selection of the leaf of \p certificate_type, selected again when it is not valid anymore
+    /// @param links_changed if set, receives true if a new V2G selection changed the certificate links
+    const LeafSelection& get_leaf_selection(LeafCertificateType certificate_type, bool* links_changed = nullptr);
+    /// @brief Points the certificate links to the leaf of the V2G \p selection, if they do not already
+    /// @return true if one of the links was updated
+    bool apply_certificate_links(const LeafSelection& selection);
+
+    /// @brief Calls the expiry watches for the certificates that crossed one of their thresholds
+    void check_expiry_watches();
 
     GetCertificateInfoResult get_ca_certificate_info_internal(CaCertificateType certificate_type);
     std::optional<fs::path> retrieve_ocsp_cache_internal(const CertificateHashData& certificate_hash_data);
     bool is_ca_certificate_installed_internal(CaCertificateType certificate_type);
 
+    InstallCertificateResult install_crl_internal(const std::string& crl, CaCertificateType certificate_type);
+
+    /// @brief Loads the CA bundle of the type, from the embedded trust anchors if it has them
+    X509CertificateBundle load_ca_bundle(CaCertificateType certificate_type);
+    /// @brief Returns the trust index of the CA bundle of the type, rebuilt if one of its files changed
+    struct TrustIndexEntry;
+    TrustIndexEntry& get_trust_index_entry(CaCertificateType certificate_type);
+
+    /// @brief Path of the revocation lists of the type, next to the bundle file or inside the bundle directory
+    fs::path get_crl_path(CaCertificateType certificate_type);
+    struct RevocationIndex;
+    /// @brief Returns the revocation index of the type, reloaded if its revocation list file changed
+    const RevocationIndex& get_revocation_index(CaCertificateType certificate_type);
+    struct OCSPVerdictIndex;
+    /// @brief Returns the verdicts of the V2G OCSP cache, reloaded if one of its hash files changed
+    const OCSPVerdictIndex& get_ocsp_verdict_index();
+
     GetCertificateSignRequestResult
     generate_certificate_signing_request_internal(LeafCertificateType certificate_type,
                                                   const CertificateSigningRequestInfo& info);
 
-    /// @brief Determines if the total filesize of certificates is > than the max_filesystem_usage bytes
+    /// @brief Determines if the total filesize of certificates is > than the max_filesystem_usage bytes. Reads all the
+    /// store directories, to be called with all the path shards locked
     bool is_filesystem_full();
 
+    /// @brief Entry of @p cache for @p key, created if missing
+    template <typename Cache, typename Key> typename Cache::mapped_type& get_cache_entry(Cache& cache, Key key) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return cache[key];
+    }
+
+    /// @brief Restores the managed CSRs from the journals of the leaf key directories. If a directory does
+    /// not have a journal yet, its orphaned keys are added with the current time and a journal is created
+    void load_managed_csr_journals();
+    /// @brief Appends the addition (@p entry set) or removal of a managed CSR key to its directory journal, and
+    /// syncs the journal
+    /// @return false if the record could not be written
+    bool append_managed_csr_journal(const fs::path& key_path, const ManagedCsr* entry);
+    /// @brief Rewrites all journals with only the current managed CSRs
+    /// @param current content of the journals (none if missing), the journals with the same content are skipped
+    void compact_managed_csr_journals(const std::map<fs::path, std::optional<std::string>>* current = nullptr);
+
 private:
-    static std::mutex security_mutex;
+    // Storage of all the certificates, keys and related files, active while executing an entry point
+    std::shared_ptr<CertificateStorage> storage;
+
+    // Shards of the store directories, each entry point holds the shards it accesses. Shared with the other
+    // instances that use one of the store directories
+    PathLocks path_locks;
 
     // why not reusing the FilePaths here directly (storage duplication)
     std::map<CaCertificateType, fs::path> ca_bundle_path_map;
+    // Read-only CA stores that replace the bundles of their types
+    std::map<CaCertificateType, EmbeddedTrustAnchorSet> embedded_ca_bundles;
     DirectoryPaths directories;
     LinkPaths links;
 
-    // CSRs that were generated and require an expiry time
-    std::map<fs::path, std::chrono::time_point<std::chrono::steady_clock>> managed_csr;
+    /// @brief Validity of the self-signed roots of a CA bundle, the valid roots are only counted again once one of
+    /// them is activated or expires
+    struct RootSummary {
+        // Not before and not after of each root, in seconds since the epoch
+        std::vector<std::pair<std::int64_t, std::int64_t>> validity;
+        std::size_t valid_roots{0};
+        // Earliest activation or expiry after the last count
+        std::int64_t next_transition{0};
+
+        /// @brief Counts the roots valid at @p now
+        void update(std::int64_t now);
+    };
+
+    /// @brief Trust index and root summary of a CA bundle, with the status of the bundle files they were built from
+    struct TrustIndexEntry {
+        std::vector<StorageStatus> store_status;
+        std::shared_ptr<const X509TrustIndex> index;
+        RootSummary roots;
+    };
+    std::map<CaCertificateType, TrustIndexEntry> trust_indexes;
+
+    /// @brief Stapling payload of a leaf type, with the status of the files it was built from
+    struct StaplingPayloadEntry {
+        bool valid{false};
+        std::vector<StorageStatus> store_status;
+        // Next update of a stapled response or reselection of the leaf, in seconds since the epoch
+        std::int64_t rebuild_at{0};
+        std::shared_ptr<const OCSPStaplingPayload> payload;
+    };
+    std::map<LeafCertificateType, StaplingPayloadEntry> stapling_payloads;
+
+    /// @brief Validity of the leaf selected for a type, with the status of the files it was selected from
+    struct LeafSelection {
+        bool valid{false};
+        std::vector<StorageStatus> store_status;
+        // Change generation of the storage for the leaf directories, if it can tell, validates without a listing
+        std::optional<std::uint64_t> change_generation;
+        // Expiry of the selected leaf in seconds since the epoch, empty if no leaf was selected
+        std::optional<std::int64_t> not_after;
+        // Expiry of the selected leaf or activation of another leaf, after which the selection can change
+        std::int64_t reselect_at{0};
+        // Files of the selected leaf
+        std::optional<CertificateInfo> info;
+    };
+    std::map<LeafCertificateType, LeafSelection> leaf_selections;
+
+    // Targets of the V2G links (link, target or none) last applied, guarded by the V2G leaf shards
+    std::vector<std::pair<fs::path, std::optional<fs::path>>> applied_links;
+    bool links_applied{false};
+
+    /// @brief Revoked certificates of the revocation lists of a CA bundle, with the status of the list file
+    struct RevocationIndex {
+        bool valid{false};
+        StorageStatus file_status;
+        std::vector<CertificateRevocationList> crls;
+        // Keys of the revoked certificates, see 'to_revocation_key'
+        std::unordered_set<std::string> revoked;
+    };
+    std::map<CaCertificateType, RevocationIndex> revocation_indexes;
+
+    /// @brief Verdicts of the OCSP cache of the V2G certificates, with the status of the cache files
+    struct OCSPVerdictIndex {
+        bool valid{false};
+        std::vector<StorageStatus> store_status;
+        // Verdicts by the key of the certificate hash data, see 'to_ocsp_key'
+        std::unordered_map<std::string, OCSPVerdict> verdicts;
+    };
+    // Guarded by the V2G OCSP shards
+    OCSPVerdictIndex ocsp_verdict_index;
+
+    // Guards the structure of the caches above, their entries are guarded by the shards of their types
+    std::mutex cache_mutex;
+
+    // CSRs that were generated and require an expiry time, persisted in the key directory journals
+    std::map<fs::path, ManagedCsr> managed_csr;
+    // Guards 'managed_csr', used by the entry points of both leaf types
+    std::mutex managed_csr_mutex;
 
     // Maximum filesystem usage
     std::uintmax_t max_fs_usage_bytes;
@@ -329,10 +539,24 @@ private:
     // GC timer
     Everest::SteadyTimer garbage_collect_timer;
 
+    struct ExpiryWatch {
+        std::vector<int> threshold_days;
+        std::function<void(const CertificateExpiry&)> callback;
+        // Smallest threshold notified for each certificate, by type and expiry
+        std::map<std::pair<std::variant<LeafCertificateType, CaCertificateType>, std::int64_t>, int> notified;
+    };
+    std::map<std::size_t, ExpiryWatch> expiry_watches;
+    std::size_t next_expiry_watch_id{1};
+    bool expiry_watch_timer_started{false};
+    std::mutex expiry_watch_mutex;
+
     // FIXME(piet): map passwords to encrypted private key files
     // is there only one password for all private keys?
     std::optional<std::string> private_key_password; // used to decrypt encrypted private keys
 
+    // Expiry watch timer, last so that it is stopped before the members it checks are destroyed
+    Everest::SteadyTimer expiry_watch_timer;
+
 private:
 // Define here all tests that require internal function usage
 #ifdef BUILD_TESTING_EVSE_SECURITY
@@ -342,6 +566,7 @@ private:
     FRIEND_TEST(EvseSecurityTests, verify_expired_csr_deletion);
     FRIEND_TEST(EvseSecurityTests, verify_ocsp_garbage_collect);
     FRIEND_TEST(EvseSecurityTestsExpired, verify_expired_leaf_deletion);
+    FRIEND_TEST(EvseSecurityTests, verify_root_summary);
 #endif
 };
 
@@ -4,8 +4,10 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <optional>
 #include <string>
+#include <variant>
 #include <vector>
 
 #include <evse_security/utils/evse_filesystem_types.hpp>
@@ -17,6 +19,7 @@ const fs::path DER_EXTENSION = ".der";
 const fs::path KEY_EXTENSION = ".key";
 const fs::path CUSTOM_KEY_EXTENSION = ".tkey";
 const fs::path CERT_HASH_EXTENSION = ".hash";
+const fs::path CRL_EXTENSION = ".crl";
 
 enum class EncodingFormat {
     DER,
@@ -59,6 +62,7 @@ enum class CertificateValidationResult {
     InvalidLeafSignature,
     InvalidChain,
     Unknown,
+    Revoked,
 };
 
 enum class InstallCertificateResult {
@@ -92,6 +96,13 @@ enum class GetCertificateInfoStatus {
     PrivateKeyNotFound,
 };
 
+enum class OCSPCertificateStatus {
+    Good,
+    Revoked,
+    Unknown,
+    Invalid, ///< The response could not be verified, e.g. wrong signature, other certificate or out of its validity
+};
+
 enum class GetCertificateSignRequestStatus {
     Accepted,
     InvalidRequestedType, ///< Requested a CSR for non CSMS/V2G leafs
@@ -174,6 +185,11 @@ struct CertificateOCSP {
     std::optional<fs::path> ocsp_path; ///< Path to the file in which the certificate OCSP data is held
 };
 
+struct OCSPVerdict {
+    OCSPCertificateStatus status; ///< Status of the certificate in the verified OCSP response
+    std::optional<std::chrono::system_clock::time_point> next_update; ///< Time of the next response, if specified
+};
+
 struct CertificateInfo {
     fs::path key;                                ///< The path of the PEM or DER encoded private key
     std::optional<std::string> certificate_root; ///< The PEM of root certificate used by the leaf, has a value only
@@ -196,6 +212,20 @@ struct GetCertificateFullInfoResult {
     std::vector<CertificateInfo> info;
 };
 
+/// @brief OCSP responses to staple in a TLS 1.3 handshake, one per 'CertificateEntry' of the chain
+struct OCSPStaplingPayload {
+    fs::path certificate; ///< The path of the certificate chain, or single certificate, the responses are aligned with
+    std::vector<std::optional<std::string>> ocsp; ///< The DER response of each certificate, in the chain file order
+};
+
+/// @brief Certificate that crossed a threshold of an expiry watch
+struct CertificateExpiry {
+    std::variant<LeafCertificateType, CaCertificateType> certificate_type; ///< Type of the leaf, or of the root
+    std::chrono::system_clock::time_point not_after;                       ///< Expiry of the certificate
+    int days_left;      ///< Whole days left until the expiry
+    int threshold_days; ///< The smallest threshold of the watch that the certificate crossed
+};
+
 struct GetCertificateSignRequestResult {
     GetCertificateSignRequestStatus status;
     std::optional<std::string> csr;
@@ -213,6 +243,8 @@ std::string install_certificate_result_to_string(InstallCertificateResult e);
 std::string delete_certificate_result_to_string(DeleteCertificateResult e);
 std::string get_installed_certificates_status_to_string(GetInstalledCertificatesStatus e);
 std::string get_certificate_info_status_to_string(GetCertificateInfoStatus e);
+std::string ocsp_certificate_status_to_string(OCSPCertificateStatus e);
+OCSPCertificateStatus string_to_ocsp_certificate_status(const std::string& s);
 } // namespace conversions
 
 } // namespace evse_security
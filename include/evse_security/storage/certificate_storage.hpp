@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <evse_security/utils/evse_filesystem_types.hpp>
+
+namespace evse_security {
+
+enum class StorageEntryType {
+    None, // Does not exist
+    File,
+    Directory,
+};
+
+struct StorageStatus {
+    StorageEntryType type{StorageEntryType::None}; ///< Type of the entry, symlinks are followed
+    bool symlink{false};                           ///< If the entry itself is a symlink
+    std::uintmax_t size{0};                        ///< Size in bytes, only valid for files
+    std::int64_t modification_time{0};             ///< Last modification, nanoseconds since epoch
+    std::uintmax_t device{0};                      ///< Device of the file, 0 if not on a filesystem
+    std::uintmax_t inode{0};                       ///< Inode of the file, 0 if not on a filesystem
+
+    bool exists() const {
+        return type != StorageEntryType::None;
+    }
+};
+
+/// @brief Storage of the certificates, keys and related files. All the file operations of the library
+/// go through the storage that is active for the calling thread, see 'ScopedStorage'. The paths are
+/// the ones configured in the 'FilePaths' and keep their meaning for each implementation
+class CertificateStorage {
+public:
+    virtual ~CertificateStorage() = default;
+
+    /// @brief Status of the entry at @p path, with type 'None' if it does not exist
+    virtual StorageStatus stat(const fs::path& path) = 0;
+    /// @brief Lists the files (symlinks to files included) of a directory
+    /// @param recursive if the files of the subdirectories should be listed too
+    virtual bool list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) = 0;
+    /// @brief Lists the files of a directory with their status. By default each listed file is stat'ed,
+    /// implementations can override it to return the status known from the listing
+    virtual bool list_entries(const fs::path& directory, bool recursive,
+                              std::vector<std::pair<fs::path, StorageStatus>>& out_entries);
+
+    virtual bool read(const fs::path& path, std::string& out_data) = 0;
+    /// @brief Reads a file into a shared immutable buffer, that implementations can cache
+    /// @return the content, nullptr if the file can not be read
+    virtual std::shared_ptr<const std::string> read_shared(const fs::path& path);
+    /// @brief Writes a file, truncating it unless @p append is set. The parent directory must exist
+    virtual bool write(const fs::path& path, const std::string& data, bool append) = 0;
+    /// @brief Removes a file, a symlink (not its target) or an empty directory
+    virtual bool remove(const fs::path& path) = 0;
+    virtual bool create_directories(const fs::path& path) = 0;
+    virtual bool create_symlink(const fs::path& target, const fs::path& link) = 0;
+    virtual bool read_symlink(const fs::path& link, fs::path& out_target) = 0;
+    /// @brief Renames a file or directory, replacing an existing file at @p to
+    virtual bool rename(const fs::path& from, const fs::path& to) = 0;
+    /// @brief Makes the written content of a file durable. By default nothing is done, for the storages that
+    /// write through or are not persistent
+    virtual bool sync(const fs::path& path);
+    /// @brief Value that changes whenever the content of one of the @p directories (recursively) changes, so that
+    /// the callers can validate the results derived from them without listing the directories. By default empty,
+    /// for the storages that can not tell without listing them
+    virtual std::optional<std::uint64_t> get_change_generation(const std::vector<fs::path>& directories);
+
+    /// @brief Batch operations, one result per path. Implementations can override them
+    /// with a more efficient version, by default the single operations are used
+    virtual void read_files(const std::vector<fs::path>& paths, std::vector<std::optional<std::string>>& out_data);
+    virtual void write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                             std::vector<bool>& out_written);
+    virtual void remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed);
+
+    /// @brief Passes the file in chunks of @p buffer_size to @p func, stops if it returns true. By
+    /// default the file is read at once, implementations can override it to stream large files
+    virtual bool process_file(const fs::path& path, std::size_t buffer_size,
+                              const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func);
+};
+
+/// @brief Returns the storage active for the calling thread, a shared POSIX filesystem storage if none was set
+CertificateStorage& get_active_storage();
+
+/// @brief Activates a storage for the calling thread during its lifetime, and restores the previous one
+/// on destruction. Used by each of the EvseSecurity entry points, so that the certificate bundles and the
+/// filesystem utils that it uses operate on its storage
+class ScopedStorage {
+public:
+    explicit ScopedStorage(const std::shared_ptr<CertificateStorage>& storage);
+    ~ScopedStorage();
+
+    ScopedStorage(const ScopedStorage&) = delete;
+    ScopedStorage& operator=(const ScopedStorage&) = delete;
+
+private:
+    CertificateStorage* previous;
+};
+
+} // namespace evse_security
@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include <everest/timer.hpp>
+
+#include <evse_security/storage/certificate_storage.hpp>
+
+namespace evse_security {
+
+/// @brief Largest delay between the retries of a failed delayed write
+static constexpr std::chrono::milliseconds MAX_FLUSH_RETRY_DELAY{60000};
+
+/// @brief Statistics of the writes that reached the backing storage, to estimate the flash wear
+struct StorageWriteStatistics {
+    std::uintmax_t bytes_written{0};    ///< Total bytes written to the backing storage
+    std::uintmax_t writes{0};           ///< Writes that reached the backing storage
+    std::uintmax_t skipped_writes{0};   ///< Writes skipped since the content did not change
+    std::uintmax_t coalesced_writes{0}; ///< Writes merged with a pending write of the same file
+    std::uintmax_t failed_writes{0};    ///< Delayed writes that failed, they stay pending and are retried
+};
+
+/// @brief Storage decorator that reduces the writes to a flash backed storage. Writes with unchanged content
+/// are skipped, and with a non-zero @p coalesce_window a file write is delayed for up to the window, so that
+/// repeated writes of the same file are merged in a single one. The pending writes are visible to all the
+/// operations on the same path, they are written once the window elapsed, before a rename, a symlink creation,
+/// a sync of the file or a streamed read, on 'flush' and on destruction. A delayed write that fails stays pending
+/// and is retried with a backoff, from the window doubled up to 'MAX_FLUSH_RETRY_DELAY'. A pending write is
+/// reported with its own modification time, so that a rewrite of the same size is seen as a change. Paths are
+/// matched lexically, a pending write is not visible through a symlink to it
+class CoalescingStorage : public CertificateStorage {
+public:
+    explicit CoalescingStorage(const std::shared_ptr<CertificateStorage>& backend,
+                               std::chrono::milliseconds coalesce_window = std::chrono::milliseconds(0));
+    ~CoalescingStorage() override;
+
+    CoalescingStorage(const CoalescingStorage&) = delete;
+    CoalescingStorage& operator=(const CoalescingStorage&) = delete;
+
+    StorageStatus stat(const fs::path& path) override;
+    bool list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) override;
+
+    bool read(const fs::path& path, std::string& out_data) override;
+    bool write(const fs::path& path, const std::string& data, bool append) override;
+    bool remove(const fs::path& path) override;
+    bool create_directories(const fs::path& path) override;
+    bool create_symlink(const fs::path& target, const fs::path& link) override;
+    bool read_symlink(const fs::path& link, fs::path& out_target) override;
+    bool rename(const fs::path& from, const fs::path& to) override;
+    bool sync(const fs::path& path) override;
+
+    void read_files(const std::vector<fs::path>& paths, std::vector<std::optional<std::string>>& out_data) override;
+
+    bool process_file(const fs::path& path, std::size_t buffer_size,
+                      const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) override;
+
+    /// @brief Writes all the pending writes to the backing storage, the failed ones stay pending
+    /// @return false if any of the writes failed
+    bool flush();
+
+    StorageWriteStatistics get_statistics();
+
+private:
+    bool flush_internal();
+    /// @brief Starts the flush timer if it is not running, also retries the writes that failed
+    void schedule_flush();
+    /// @brief Flushes after @p delay, and again with a backoff while writes fail
+    void start_flush_timer(std::chrono::milliseconds delay);
+    /// @brief Writes to the backing storage, with accounting
+    bool write_backend(const fs::path& path, const std::string& data, bool append);
+
+    std::shared_ptr<CertificateStorage> backend;
+    std::chrono::milliseconds coalesce_window;
+
+    std::mutex mutex;
+    struct PendingWrite {
+        std::string data;
+        std::int64_t modification_time; // Nanoseconds since epoch, distinct for each write
+    };
+    /// @brief Content of the delayed writes, by normalized path
+    std::map<fs::path, PendingWrite> pending;
+    std::int64_t last_modification_time{0};
+
+    /// @brief Modification time of a new pending write, later than all previous ones
+    std::int64_t next_modification_time();
+    StorageWriteStatistics statistics;
+
+    bool flush_scheduled{false};
+    // Delay of the last retry of a failed flush, zero if the last flush succeeded
+    std::chrono::milliseconds flush_retry_delay{0};
+    // Set on destruction, the flush is not scheduled again
+    bool stopping{false};
+    Everest::SteadyTimer flush_timer;
+};
+
+} // namespace evse_security
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <map>
+#include <mutex>
+
+#include <evse_security/storage/certificate_storage.hpp>
+
+namespace evse_security {
+
+/// @brief Storage that keeps everything in memory, for systems without a usable filesystem and
+/// for tests and benchmarks without I/O. Paths are compared lexically (after normalization),
+/// a relative and an absolute path to the same file are two different entries
+class InMemoryStorage : public CertificateStorage {
+public:
+    StorageStatus stat(const fs::path& path) override;
+    bool list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) override;
+
+    bool read(const fs::path& path, std::string& out_data) override;
+    bool write(const fs::path& path, const std::string& data, bool append) override;
+    bool remove(const fs::path& path) override;
+    bool create_directories(const fs::path& path) override;
+    bool create_symlink(const fs::path& target, const fs::path& link) override;
+    bool read_symlink(const fs::path& link, fs::path& out_target) override;
+    bool rename(const fs::path& from, const fs::path& to) override;
+
+protected:
+    struct Node {
+        enum class Type {
+            File,
+            Directory,
+            Symlink,
+        };
+
+        Type type;
+        std::string data;    // File content or symlink target
+        std::int64_t modification_time;
+    };
+
+    std::mutex mutex;
+    /// @brief All entries, ordered so that the content of a directory follows it
+    std::map<fs::path, Node> nodes;
+
+private:
+    /// @brief Resolves the symlinks of all the components of @p path
+    /// @param follow_last if a symlink as the last component is resolved too
+    /// @return the resolved path, or nullopt for a symlink loop
+    std::optional<fs::path> resolve(const fs::path& path, bool follow_last) const;
+    /// @brief Returns the node at the resolved path, nullptr if missing
+    Node* find(const fs::path& resolved);
+    /// @brief Checks that the parent of a new entry is an existing directory
+    bool parent_exists(const fs::path& resolved);
+    /// @brief Updates the modification time of the entry and of its parent directory
+    void touch(const fs::path& resolved);
+    std::int64_t next_modification_time();
+
+    std::int64_t last_modification_time{0};
+};
+
+} // namespace evse_security
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <evse_security/storage/in_memory_storage.hpp>
+
+namespace evse_security {
+
+/// @brief Storage that keeps all the store objects in a single append-only log file instead of one file per
+/// certificate, key, hash or OCSP response. Each modification is appended as a checksummed record and synced
+/// before it is applied, the log is replayed in memory when opened. A record that was not completely written
+/// before a power loss is discarded together with everything after it. The log is compacted, rewritten with only
+/// the current content, once it grew to 'compaction_factor' times its size after the last compaction
+class LogFileStorage : public InMemoryStorage {
+public:
+    /// @brief Opens the log, creating it if missing
+    /// @param log_file path of the log on the filesystem
+    /// @param compaction_min_size the log is never compacted below this size
+    /// @param compaction_factor growth of the log since the last compaction that triggers a compaction
+    /// @throws std::runtime_error if the log can not be opened or is not a log file
+    explicit LogFileStorage(const fs::path& log_file, std::uintmax_t compaction_min_size = 64 * 1024,
+                            std::uintmax_t compaction_factor = 2);
+    ~LogFileStorage() override;
+
+    LogFileStorage(const LogFileStorage&) = delete;
+    LogFileStorage& operator=(const LogFileStorage&) = delete;
+
+    bool write(const fs::path& path, const std::string& data, bool append) override;
+    bool remove(const fs::path& path) override;
+    bool create_directories(const fs::path& path) override;
+    bool create_symlink(const fs::path& target, const fs::path& link) override;
+    bool rename(const fs::path& from, const fs::path& to) override;
+
+    /// @brief Rewrites the log with only the current content
+    bool compact();
+
+    /// @brief Exports a file or directory of the store to the filesystem, for consumers that can only
+    /// read PEM files (e.g. a TLS server). Symlinks are exported as copies of their targets
+    /// @param path file or directory in the store
+    /// @param destination filesystem path, that the path is exported as
+    bool export_to_filesystem(const fs::path& path, const fs::path& destination);
+
+    /// @brief Current size of the log file in bytes
+    std::uintmax_t get_log_size();
+
+private:
+    /// @brief Replays the log into memory, discarding an incomplete or corrupted tail
+    void replay();
+    /// @brief Appends a record to the log and syncs it. Called before the modification is applied in memory, so
+    /// that a modification that could not be logged does not take effect
+    bool append_record(const std::string& payload);
+    /// @brief Compacts the log if it grew too much since the last compaction
+    void compact_if_grown();
+    /// @brief Writes the current content as a new log and replaces the existing one
+    bool compact_internal();
+
+    fs::path log_file;
+    int log_fd{-1};
+
+    std::uintmax_t compaction_min_size;
+    std::uintmax_t compaction_factor;
+
+    std::uintmax_t log_size{0};
+    std::uintmax_t compacted_size{0};
+    /// @brief Set if a record could not be completely appended, the log is rewritten from the content in
+    /// memory before the next record
+    bool log_outdated{false};
+
+    /// @brief Serializes the modifications with their records
+    std::mutex log_mutex;
+};
+
+} // namespace evse_security
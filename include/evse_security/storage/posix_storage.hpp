@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <evse_security/storage/certificate_storage.hpp>
+
+namespace evse_security {
+
+/// @brief Storage on the filesystem, the default. When built with LIBEVSE_SECURITY_USE_IO_URING the
+/// batch operations are submitted through io_uring if it is available at runtime. The read files are
+/// kept in a process-wide cache keyed by (device, inode, modification time, size), a file that did
+/// not change is not read again. The directory listings are kept in the process-wide
+/// 'DirectorySnapshotCache', a directory is only walked again after it changed
+class PosixStorage : public CertificateStorage {
+public:
+    /// @brief Sets the maximum total size of the process-wide read cache, 0 disables it. Defaults
+    /// to 'DEFAULT_FILE_CONTENT_CACHE_CAPACITY'
+    static void set_read_cache_capacity(std::size_t capacity_bytes);
+
+    StorageStatus stat(const fs::path& path) override;
+    bool list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) override;
+    bool list_entries(const fs::path& directory, bool recursive,
+                      std::vector<std::pair<fs::path, StorageStatus>>& out_entries) override;
+
+    bool read(const fs::path& path, std::string& out_data) override;
+    std::shared_ptr<const std::string> read_shared(const fs::path& path) override;
+    bool write(const fs::path& path, const std::string& data, bool append) override;
+    bool remove(const fs::path& path) override;
+    bool create_directories(const fs::path& path) override;
+    bool create_symlink(const fs::path& target, const fs::path& link) override;
+    bool read_symlink(const fs::path& link, fs::path& out_target) override;
+    bool rename(const fs::path& from, const fs::path& to) override;
+    bool sync(const fs::path& path) override;
+    /// @brief The generation of the directory snapshots, if all the directories are watched by inotify
+    std::optional<std::uint64_t> get_change_generation(const std::vector<fs::path>& directories) override;
+
+    void read_files(const std::vector<fs::path>& paths, std::vector<std::optional<std::string>>& out_data) override;
+    void write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                     std::vector<bool>& out_written) override;
+    void remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed) override;
+
+    bool process_file(const fs::path& path, std::size_t buffer_size,
+                      const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) override;
+};
+
+} // namespace evse_security
@@ -3,15 +3,34 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include <evse_security/evse_types.hpp>
+#include <evse_security/storage/certificate_storage.hpp>
 #include <evse_security/utils/evse_filesystem_types.hpp>
 
 struct CertificateHashData;
 
+/// @brief File utilities of the library. All of them operate on the certificate storage that
+/// is active for the calling thread, the filesystem by default (see 'ScopedStorage')
 namespace evse_security::filesystem_utils {
 
 bool is_subdirectory(const fs::path& base, const fs::path& subdir);
 
+bool exists(const fs::path& path);
+/// @brief Regular file or symlink to a regular file
+bool is_regular_file(const fs::path& path);
+bool is_directory(const fs::path& path);
+/// @brief Lists the regular files (symlinks to files included) of a directory
+bool list_files(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files);
+/// @brief Lists the regular files of a directory with their status, without a stat per file if the storage caches it
+bool list_file_entries(const fs::path& directory, bool recursive,
+                       std::vector<std::pair<fs::path, StorageStatus>>& out_entries);
+
 /// @brief Should be used to ensure file exists, not for directories
 bool create_file_if_nonexistent(const fs::path& file_path);
 /// @brief Ensure a file exists (if there's an extension), or a directory if no extension is found
@@ -19,8 +38,21 @@ bool create_file_or_dir_if_nonexistent(const fs::path& file_path);
 bool delete_file(const fs::path& file_path);
 
 bool read_from_file(const fs::path& file_path, std::string& out_data);
+/// @brief Reads the file into a shared immutable buffer, the storage can return a cached one for an unchanged file
+/// @return the content, nullptr if the file could not be read
+std::shared_ptr<const std::string> read_shared_from_file(const fs::path& file_path);
 bool write_to_file(const fs::path& file_path, const std::string& data, std::ios::openmode mode);
 
+/// @brief Batch versions of the functions above for operations on many files. On the filesystem storage
+/// built with LIBEVSE_SECURITY_USE_IO_URING the operations are submitted together through io_uring, falling
+/// back to the blocking functions if io_uring is not available at runtime. The outputs have one entry
+/// per file, in the same order as the inputs
+/// @return True if the operation succeeded for all files
+bool read_from_files(const std::vector<fs::path>& file_paths, std::vector<std::optional<std::string>>& out_data);
+/// @brief Writes all files, truncating existing ones
+bool write_to_files(const std::vector<std::pair<fs::path, std::string>>& files, std::vector<bool>& out_written);
+bool delete_files(const std::vector<fs::path>& file_paths, std::vector<bool>& out_deleted);
+
 /// @brief Process the file in chunks with the provided function. If the process function
 /// returns false, this function will also immediately  return
 /// @return True if the file was properly opened false otherwise
@@ -37,4 +69,13 @@ bool read_hash_from_file(const fs::path& file_path, CertificateHashData& out_has
 /// @return True if we could write, false otherwise
 bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash);
 
+/// @brief Attempts to write a certificate hash followed by the verdict of its OCSP response, as stored in the
+/// OCSP cache. Readers of the hash alone ignore the verdict
+/// @return True if we could write, false otherwise
+bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash, const OCSPVerdict& verdict);
+
+/// @brief Attempts to read the OCSP verdict of a hash file written with a verdict
+/// @return True if we could read, false otherwise (e.g. a hash file of a previous version without verdict)
+bool read_ocsp_verdict_from_file(const fs::path& file_path, OCSPVerdict& out_verdict);
+
 } // namespace evse_security::filesystem_utils
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <atomic>
+
+#include <everest/logging.hpp>
+
+// Minimum level of the log statements of the library that are compiled, the others are removed. Same order as the
+// severities of the logging library: 0 verbose, 1 debug, 2 info, 3 warning, 4 error, 5 critical
+#ifndef LIBEVSE_SECURITY_MIN_LOG_LEVEL
+#define LIBEVSE_SECURITY_MIN_LOG_LEVEL 0
+#endif
+
+namespace evse_security {
+
+enum class LogLevel {
+    Verbose,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Critical,
+};
+
+/// @brief Sets the minimum level of the log statements of the library that are formatted and passed to the logging
+/// library, for all instances. The default (Verbose) leaves the filtering to the logging library
+void set_log_level(LogLevel level);
+LogLevel get_log_level();
+
+namespace detail {
+
+extern std::atomic<int> log_level;
+
+constexpr bool is_log_level_compiled(LogLevel level) {
+    return static_cast<int>(level) >= LIBEVSE_SECURITY_MIN_LOG_LEVEL;
+}
+
+inline bool is_log_level_enabled(LogLevel level) {
+    return is_log_level_compiled(level) && static_cast<int>(level) >= log_level.load(std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+} // namespace evse_security
+
+// Same usage as the EVLOG macros. The stream operands (e.g. debug strings) are only evaluated if the level is enabled
+#define EVSE_LOG(level, severity)                                                                                      \
+    if (!::evse_security::detail::is_log_level_enabled(::evse_security::LogLevel::level)) {                            \
+    } else                                                                                                             \
+        EVLOG_##severity
+
+#define EVSE_LOG_verbose EVSE_LOG(Verbose, verbose)
+#define EVSE_LOG_debug EVSE_LOG(Debug, debug)
+#define EVSE_LOG_info EVSE_LOG(Info, info)
+#define EVSE_LOG_warning EVSE_LOG(Warning, warning)
+#define EVSE_LOG_error EVSE_LOG(Error, error)
+#define EVSE_LOG_critical EVSE_LOG(Critical, critical)
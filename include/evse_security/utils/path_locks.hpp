@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+#include <evse_security/utils/evse_filesystem_types.hpp>
+
+namespace evse_security {
+
+/// @brief Set of shards of a 'PathLocks', the shard at index i is selected by the bit (1 << i)
+using PathShards = std::uint32_t;
+
+static constexpr PathShards ALL_PATH_SHARDS = ~PathShards{0};
+
+/// @brief Lock of a set of store directories, grouped in shards that can be locked separately. The mutex of each
+/// directory is shared process-wide by all the 'PathLocks' that contain it, so that the users of a common directory
+/// exclude each other while the users of disjoint directories do not contend. Directories are matched by their
+/// absolute normalized path. A directory also excludes the users of its ancestors and of its nested directories: the
+/// ancestors of a locked directory are locked shared, so that siblings do not contend. The mutexes are always locked
+/// in the same (path) order, two sets with several common directories can not deadlock. Satisfies Lockable for all
+/// the shards, for use with std::lock_guard
+class PathLocks {
+public:
+    /// @param shards the directories of each shard, a directory can be part of several shards, empty paths are
+    /// ignored
+    explicit PathLocks(const std::vector<std::vector<fs::path>>& shards);
+
+    PathLocks(const PathLocks&) = delete;
+    PathLocks& operator=(const PathLocks&) = delete;
+
+    void lock(PathShards shards = ALL_PATH_SHARDS);
+    bool try_lock(PathShards shards = ALL_PATH_SHARDS);
+    void unlock(PathShards shards = ALL_PATH_SHARDS);
+
+private:
+    struct Entry {
+        std::shared_ptr<std::shared_mutex> mutex;
+        // Shards that contain the directory, locked exclusively
+        PathShards shards{0};
+        // Shards that contain a directory nested in it, locked shared
+        PathShards nested_shards{0};
+    };
+
+    static void unlock(const Entry& entry, PathShards shards);
+
+    // Ordered by path, the ancestors before their nested directories
+    std::vector<Entry> entries;
+};
+
+/// @brief Holds some shards of a 'PathLocks' for its lifetime
+class PathShardGuard {
+public:
+    PathShardGuard(PathLocks& locks, PathShards shards) : locks(locks), shards(shards) {
+        locks.lock(shards);
+    }
+
+    ~PathShardGuard() {
+        locks.unlock(shards);
+    }
+
+    PathShardGuard(const PathShardGuard&) = delete;
+    PathShardGuard& operator=(const PathShardGuard&) = delete;
+
+private:
+    PathLocks& locks;
+    PathShards shards;
+};
+
+} // namespace evse_security
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/certificate/shared_certificate_cache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security {
+
+static constexpr std::uint32_t SEGMENT_MAGIC = 0x43535345; // "ESSC"
+static constexpr std::uint32_t SEGMENT_VERSION = 1;
+static constexpr std::uint64_t BUCKET_COUNT = 1024;
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Shared segment requires lock-free 64 bit atomics");
+
+/// @brief Start of the segment, followed by the buckets and the entries
+struct SegmentHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t size; // Size of the whole segment
+    std::atomic<std::uint64_t> generation;
+    std::atomic<std::uint64_t> used; // End offset of the entries
+};
+
+/// @brief Version of a file, followed by its certificates as (u32 length, DER) aligned to 8 bytes
+struct SegmentEntry {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::int64_t modification_time;
+    std::uint64_t size;
+    std::uint64_t next; // Offset of the previous entry of the bucket, 0 if none
+    std::uint32_t certificate_count;
+    std::uint32_t reserved;
+};
+
+static constexpr std::uint64_t align(std::uint64_t value) {
+    return (value + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+static constexpr std::uint64_t BUCKETS_OFFSET = align(sizeof(SegmentHeader));
+static constexpr std::uint64_t ENTRIES_OFFSET = BUCKETS_OFFSET + BUCKET_COUNT * sizeof(std::uint64_t);
+
+static std::uint64_t get_bucket(const StorageStatus& status) {
+    std::uint64_t hash = status.inode * 0x9e3779b97f4a7c15ULL;
+    hash ^= status.device + 0x7f4a7c159e3779b9ULL + (hash << 6) + (hash >> 2);
+    hash ^= static_cast<std::uint64_t>(status.modification_time) + (hash << 6) + (hash >> 2);
+
+    return hash % BUCKET_COUNT;
+}
+
+static bool matches(const SegmentEntry& entry, const StorageStatus& status) {
+    return entry.device == status.device && entry.inode == status.inode &&
+           entry.modification_time == status.modification_time && entry.size == status.size;
+}
+
+/// @brief Only a regular file owned by this user and not writable by others is trusted, another user could
+/// otherwise publish forged certificates or hold the lock
+static bool is_trusted_file(int fd, const fs::path& path) {
+    struct stat file_stat;
+
+    if (::fstat(fd, &file_stat) != 0) {
+        EVLOG_error << "Could not stat shared certificate cache file: " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    if (!S_ISREG(file_stat.st_mode) || file_stat.st_uid != ::geteuid() ||
+        (file_stat.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+        EVLOG_error << "Shared certificate cache file not owned by this user or writable by others: " << path;
+        return false;
+    }
+
+    return true;
+}
+
+SharedCertificateCache& SharedCertificateCache::instance() {
+    static SharedCertificateCache cache;
+    return cache;
+}
+
+SharedCertificateCache::~SharedCertificateCache() {
+    close();
+}
+
+bool SharedCertificateCache::open(const fs::path& segment_path, std::size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (segment != nullptr) {
+        EVLOG_warning << "Shared certificate cache already open: " << this->segment_path;
+        return false;
+    }
+
+    if (size <= ENTRIES_OFFSET + sizeof(SegmentEntry)) {
+        EVLOG_error << "Shared certificate cache size too small: " << size;
+        return false;
+    }
+
+    this->segment_path = segment_path;
+    this->requested_size = size;
+
+    const fs::path lock_path = segment_path.string() + ".lock";
+    lock_fd = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+
+    if (lock_fd < 0) {
+        EVLOG_error << "Could not open shared certificate cache lock: " << segment_path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    if (false == is_trusted_file(lock_fd, lock_path)) {
+        ::close(lock_fd);
+        lock_fd = -1;
+        return false;
+    }
+
+    if (try_become_writer()) {
+        return true;
+    }
+
+    // Another process is the writer, its segment is used read-only
+    return map_segment(false, 0);
+}
+
+void SharedCertificateCache::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    unmap_segment();
+
+    if (lock_fd >= 0) {
+        // Closing the descriptor releases the lock, another process can become the writer
+        ::close(lock_fd);
+        lock_fd = -1;
+    }
+
+    writer = false;
+}
+
+bool SharedCertificateCache::is_open() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segment != nullptr;
+}
+
+bool SharedCertificateCache::is_writer() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writer;
+}
+
+std::uint64_t SharedCertificateCache::get_generation() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (segment == nullptr) {
+        return 0;
+    }
+
+    return reinterpret_cast<SegmentHeader*>(segment)->generation.load(std::memory_order_acquire);
+}
+
+bool SharedCertificateCache::map_segment(bool writable, std::size_t size) {
+    unmap_segment();
+
+    segment_fd =
+        ::open(segment_path.c_str(), (writable ? (O_RDWR | O_CREAT) : O_RDONLY) | O_NOFOLLOW | O_CLOEXEC, 0600);
+
+    if (segment_fd < 0) {
+        // The writer did not create it yet
+        EVSE_LOG_debug << "Could not open shared certificate cache: " << segment_path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    struct stat segment_stat;
+    if (false == is_trusted_file(segment_fd, segment_path) || ::fstat(segment_fd, &segment_stat) != 0) {
+        unmap_segment();
+        return false;
+    }
+
+    std::size_t mapped_size = static_cast<std::size_t>(segment_stat.st_size);
+    bool initialize = false;
+
+    if (writable) {
+        // Never shrunk, the readers could still access the end of it
+        if (mapped_size < size) {
+            if (::ftruncate(segment_fd, static_cast<off_t>(size)) != 0) {
+                EVLOG_error << "Could not resize shared certificate cache: " << std::strerror(errno);
+                unmap_segment();
+                return false;
+            }
+
+            mapped_size = size;
+        }
+    } else if (mapped_size < ENTRIES_OFFSET) {
+        unmap_segment();
+        return false;
+    }
+
+    void* mapped = ::mmap(nullptr, mapped_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                          segment_fd, 0);
+
+    if (mapped == MAP_FAILED) {
+        EVLOG_error << "Could not map shared certificate cache: " << std::strerror(errno);
+        unmap_segment();
+        return false;
+    }
+
+    segment = static_cast<std::uint8_t*>(mapped);
+    segment_size = mapped_size;
+
+    auto* header = reinterpret_cast<SegmentHeader*>(segment);
+    const bool valid = header->magic == SEGMENT_MAGIC && header->version == SEGMENT_VERSION &&
+                       header->size <= segment_size && header->size > ENTRIES_OFFSET;
+
+    if (writable) {
+        // An odd generation is left by a writer that exited while writing
+        initialize = !valid || header->size != segment_size ||
+                     (header->generation.load(std::memory_order_relaxed) & 1) != 0;
+    } else if (!valid) {
+        // Not initialized yet by the writer
+        unmap_segment();
+        return false;
+    }
+
+    if (initialize) {
+        const std::uint64_t generation = valid ? header->generation.load(std::memory_order_relaxed) : 0;
+
+        // Odd while the layout changes, readers of a previous segment drop their lookups
+        header->generation.store(generation | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        header->magic = SEGMENT_MAGIC;
+        header->version = SEGMENT_VERSION;
+        header->size = segment_size;
+        header->used.store(ENTRIES_OFFSET, std::memory_order_relaxed);
+        std::memset(segment + BUCKETS_OFFSET, 0, BUCKET_COUNT * sizeof(std::uint64_t));
+
+        std::atomic_thread_fence(std::memory_order_release);
+        header->generation.store((generation | 1) + 1, std::memory_order_release);
+    }
+
+    return true;
+}
+
+void SharedCertificateCache::unmap_segment() {
+    if (segment != nullptr) {
+        ::munmap(segment, segment_size);
+        segment = nullptr;
+        segment_size = 0;
+    }
+
+    if (segment_fd >= 0) {
+        ::close(segment_fd);
+        segment_fd = -1;
+    }
+}
+
+bool SharedCertificateCache::try_become_writer() {
+    if (writer) {
+        return true;
+    }
+
+    if (lock_fd < 0 || ::flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        return false;
+    }
+
+    if (false == map_segment(true, requested_size)) {
+        ::flock(lock_fd, LOCK_UN);
+        return false;
+    }
+
+    EVSE_LOG_debug << "Shared certificate cache writer: " << segment_path;
+
+    writer = true;
+    return true;
+}
+
+bool SharedCertificateCache::find_internal(const StorageStatus& status, std::vector<std::string>* out_der) {
+    const auto* header = reinterpret_cast<const SegmentHeader*>(segment);
+    const std::uint64_t generation = header->generation.load(std::memory_order_acquire);
+
+    if (generation & 1) {
+        return false;
+    }
+
+    // Everything read from the segment is bounds checked, it can change while it is read
+    const std::uint64_t used = std::min<std::uint64_t>(header->used.load(std::memory_order_acquire), segment_size);
+    const auto* buckets = reinterpret_cast<const std::atomic<std::uint64_t>*>(segment + BUCKETS_OFFSET);
+
+    std::uint64_t offset = buckets[get_bucket(status)].load(std::memory_order_acquire);
+    bool found = false;
+
+    // The entries only link to older ones, at lower offsets
+    while (offset >= ENTRIES_OFFSET && offset + sizeof(SegmentEntry) <= used) {
+        SegmentEntry entry;
+        std::memcpy(&entry, segment + offset, sizeof(SegmentEntry));
+
+        if (matches(entry, status)) {
+            std::uint64_t position = offset + sizeof(SegmentEntry);
+            found = true;
+
+            if (out_der != nullptr) {
+                out_der->clear();
+
+                for (std::uint32_t i = 0; i < entry.certificate_count && found; i++) {
+                    std::uint32_t length;
+
+                    if (position + sizeof(length) > used) {
+                        found = false;
+                        break;
+                    }
+
+                    std::memcpy(&length, segment + position, sizeof(length));
+                    position += sizeof(length);
+
+                    if (position + length > used) {
+                        found = false;
+                        break;
+                    }
+
+                    out_der->emplace_back(reinterpret_cast<const char*>(segment + position), length);
+                    position = align(position + length);
+                }
+            }
+
+            break;
+        }
+
+        if (entry.next >= offset) {
+            break;
+        }
+
+        offset = entry.next;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return found && header->generation.load(std::memory_order_relaxed) == generation;
+}
+
+bool SharedCertificateCache::find(const StorageStatus& status, std::vector<std::string>& out_der) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (segment == nullptr) {
+        return false;
+    }
+
+    // Resized by a new writer, mapped again
+    if (!writer && reinterpret_cast<const SegmentHeader*>(segment)->size != segment_size) {
+        if (false == map_segment(false, 0)) {
+            return false;
+        }
+    }
+
+    return find_internal(status, &out_der);
+}
+
+bool SharedCertificateCache::insert(const StorageStatus& status, const std::vector<std::string>& der) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (lock_fd < 0 || status.inode == 0) {
+        return false;
+    }
+
+    // The previous writer might have exited
+    if (false == try_become_writer()) {
+        if (segment == nullptr) {
+            map_segment(false, 0);
+        }
+
+        return false;
+    }
+
+    if (find_internal(status, nullptr)) {
+        return true;
+    }
+
+    std::uint64_t required = sizeof(SegmentEntry);
+    for (const auto& certificate : der) {
+        required = align(required + sizeof(std::uint32_t) + certificate.size());
+    }
+
+    if (ENTRIES_OFFSET + required > segment_size) {
+        return false;
+    }
+
+    auto* header = reinterpret_cast<SegmentHeader*>(segment);
+    auto* buckets = reinterpret_cast<std::atomic<std::uint64_t>*>(segment + BUCKETS_OFFSET);
+    const std::uint64_t generation = header->generation.load(std::memory_order_relaxed);
+
+    header->generation.store(generation + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::uint64_t offset = header->used.load(std::memory_order_relaxed);
+
+    if (offset + required > segment_size) {
+        // Full, dropped at once, the entries of the current files are published again when parsed
+        std::memset(segment + BUCKETS_OFFSET, 0, BUCKET_COUNT * sizeof(std::uint64_t));
+        offset = ENTRIES_OFFSET;
+    }
+
+    const std::uint64_t bucket = get_bucket(status);
+
+    SegmentEntry entry{};
+    entry.device = status.device;
+    entry.inode = status.inode;
+    entry.modification_time = status.modification_time;
+    entry.size = status.size;
+    entry.next = buckets[bucket].load(std::memory_order_relaxed);
+    entry.certificate_count = static_cast<std::uint32_t>(der.size());
+
+    std::memcpy(segment + offset, &entry, sizeof(entry));
+    std::uint64_t position = offset + sizeof(entry);
+
+    for (const auto& certificate : der) {
+        const auto length = static_cast<std::uint32_t>(certificate.size());
+
+        std::memcpy(segment + position, &length, sizeof(length));
+        std::memcpy(segment + position + sizeof(length), certificate.data(), certificate.size());
+        position = align(position + sizeof(length) + certificate.size());
+    }
+
+    buckets[bucket].store(offset, std::memory_order_relaxed);
+    header->used.store(offset + required, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    header->generation.store(generation + 2, std::memory_order_release);
+
+    return true;
+}
+
+} // namespace evse_security
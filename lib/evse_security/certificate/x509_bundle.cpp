@@ -1,11 +1,12 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/certificate/shared_certificate_cache.hpp>
 #include <evse_security/certificate/x509_bundle.hpp>
 
 #include <algorithm>
 #include <fstream>
 
-#include <everest/logging.hpp>
+#include <evse_security/utils/evse_logging.hpp>
 #include <evse_security/crypto/evse_crypto.hpp>
 #include <evse_security/utils/evse_filesystem.hpp>
 
@@ -41,6 +42,19 @@ X509CertificateBundle::X509CertificateBundle(const std::string& certificate, con
     add_certificates(certificate, encoding, std::nullopt);
 }
 
+X509CertificateBundle::X509CertificateBundle(const EmbeddedTrustAnchorSet& anchors, const fs::path& path) :
+    path(path), source(X509CertificateSource::EMBEDDED), hierarchy_invalidated(true) {
+    auto& list = certificates[fs::path()];
+
+    for (const auto& anchor : anchors) {
+        const std::string der(reinterpret_cast<const char*>(anchor.der), anchor.der_size);
+
+        for (auto& x509 : CryptoSupplier::load_certificates(der, EncodingFormat::DER)) {
+            list.emplace_back(std::move(x509));
+        }
+    }
+}
+
 X509CertificateBundle::X509CertificateBundle(const fs::path& path, const EncodingFormat encoding) :
     hierarchy_invalidated(true) {
     this->path = path;
@@ -48,28 +62,103 @@ X509CertificateBundle::X509CertificateBundle(const fs::path& path, const Encodin
     // Attempt creation
     filesystem_utils::create_file_or_dir_if_nonexistent(path);
 
-    if (fs::is_directory(path)) {
+    if (filesystem_utils::is_directory(path)) {
         source = X509CertificateSource::DIRECTORY;
 
-        // Iterate directory
-        for (const auto& entry : fs::recursive_directory_iterator(path)) {
-            if (is_certificate_file(entry)) {
-                std::string certificate;
-                if (filesystem_utils::read_from_file(entry.path(), certificate))
-                    add_certificates(certificate, encoding, entry.path());
+        // Iterate directory, the files are read together
+        std::vector<fs::path> directory_files;
+        filesystem_utils::list_files(path, true, directory_files);
+
+        std::vector<fs::path> certificate_files;
+        std::vector<StorageStatus> certificate_statuses;
+
+        for (const auto& file : directory_files) {
+            StorageStatus status;
+
+            if (is_certificate_extension(file) && !add_shared_certificates(file, status)) {
+                certificate_files.push_back(file);
+                certificate_statuses.push_back(status);
+            }
+        }
+
+        std::vector<std::optional<std::string>> certificates_data;
+        filesystem_utils::read_from_files(certificate_files, certificates_data);
+
+        for (std::size_t i = 0; i < certificate_files.size(); i++) {
+            if (certificates_data[i].has_value()) {
+                add_certificates(certificates_data[i].value(), encoding, certificate_files[i]);
+                publish_shared_certificates(certificate_files[i], certificate_statuses[i]);
             }
         }
     } else if (is_certificate_file(path)) {
         source = X509CertificateSource::FILE;
 
-        std::string certificate;
-        if (filesystem_utils::read_from_file(path, certificate))
-            add_certificates(certificate, encoding, path);
+        StorageStatus status;
+
+        if (!add_shared_certificates(path, status)) {
+            if (const auto certificate = filesystem_utils::read_shared_from_file(path)) {
+                add_certificates(*certificate, encoding, path);
+                publish_shared_certificates(path, status);
+            }
+        }
     } else {
         throw CertificateLoadException("Failed to create certificate info from path: " + path.string());
     }
 }
 
+bool X509CertificateBundle::add_shared_certificates(const fs::path& file, StorageStatus& out_status) {
+    auto& shared_cache = SharedCertificateCache::instance();
+
+    if (!shared_cache.is_open()) {
+        return false;
+    }
+
+    out_status = get_active_storage().stat(file);
+    std::vector<std::string> certificates_der;
+
+    // Only files on a filesystem have an identity that other processes can look up
+    if (out_status.inode == 0 || !shared_cache.find(out_status, certificates_der)) {
+        return false;
+    }
+
+    auto& list = certificates[file];
+
+    for (const auto& der : certificates_der) {
+        for (auto& x509 : CryptoSupplier::load_certificates(der, EncodingFormat::DER)) {
+            list.emplace_back(std::move(x509), file);
+        }
+    }
+
+    return true;
+}
+
+void X509CertificateBundle::publish_shared_certificates(const fs::path& file, const StorageStatus& status) {
+    // Not looked up, the cache is closed or the file is not on a filesystem
+    if (status.inode == 0) {
+        return;
+    }
+
+    // Not published if the file was modified since the lookup, its content could be newer than the identity
+    const StorageStatus current = get_active_storage().stat(file);
+
+    if (current.device != status.device || current.inode != status.inode ||
+        current.modification_time != status.modification_time || current.size != status.size) {
+        return;
+    }
+
+    std::vector<std::string> certificates_der;
+
+    for (const auto& certificate : certificates[file]) {
+        certificates_der.push_back(CryptoSupplier::x509_to_der(certificate.get()));
+    }
+
+    SharedCertificateCache::instance().insert(current, certificates_der);
+}
+
+bool X509CertificateBundle::is_certificate_file(const fs::path& file) {
+    return is_certificate_extension(file) && filesystem_utils::is_regular_file(file);
+}
+
 std::vector<X509Wrapper> X509CertificateBundle::split() {
     std::vector<X509Wrapper> full_certificates;
 
@@ -264,6 +353,11 @@ bool X509CertificateBundle::export_certificates() {
         return false;
     }
 
+    if (source == X509CertificateSource::EMBEDDED) {
+        EVLOG_error << "Export for embedded trust anchors is invalid, the store is read-only!";
+        return false;
+    }
+
     // Add/delete certifs
     if (!sync_to_certificate_store()) {
         EVLOG_error << "Sync to certificate store failed!";
@@ -271,7 +365,7 @@ bool X509CertificateBundle::export_certificates() {
     }
 
     if (source == X509CertificateSource::DIRECTORY) {
-        bool exported_all = true;
+        std::vector<std::pair<fs::path, std::string>> files;
 
         // Write updated certificates
         for (auto& chains : certificates) {
@@ -280,12 +374,11 @@ bool X509CertificateBundle::export_certificates() {
                 continue;
 
             // Each chain is a single file
-            if (!filesystem_utils::write_to_file(chains.first, to_export_string(chains.first), std::ios::trunc)) {
-                exported_all = false;
-            }
+            files.emplace_back(chains.first, to_export_string(chains.first));
         }
 
-        return exported_all;
+        std::vector<bool> written;
+        return filesystem_utils::write_to_files(files, written);
     } else if (source == X509CertificateSource::FILE) {
         // We're using a single file, no need to check for deleted certificates
         return filesystem_utils::write_to_file(path, to_export_string(), std::ios::trunc);
@@ -295,8 +388,8 @@ bool X509CertificateBundle::export_certificates() {
 }
 
 bool X509CertificateBundle::sync_to_certificate_store() {
-    if (source == X509CertificateSource::STRING) {
-        EVLOG_error << "Sync for string is invalid!";
+    if (source == X509CertificateSource::STRING || source == X509CertificateSource::EMBEDDED) {
+        EVLOG_error << "Sync for string or embedded trust anchors is invalid!";
         return false;
     }
 
@@ -358,7 +451,7 @@ void X509CertificateBundle::invalidate_hierarchy() {
 
 X509CertificateHierarchy& X509CertificateBundle::get_certificate_hierarchy() {
     if (hierarchy_invalidated) {
-        EVLOG_info << "Building new certificate hierarchy!";
+        EVSE_LOG_debug << "Building new certificate hierarchy!";
         hierarchy_invalidated = false;
 
         auto certificates = split();
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/certificate/x509_trust_index.hpp>
+
+#include <algorithm>
+
+namespace evse_security {
+
+X509TrustIndex::X509TrustIndex(const std::vector<X509Wrapper>& trusted_certificates) {
+    for (const auto& certificate : trusted_certificates) {
+        key_identifiers[certificate.get_subject_hash()].push_back(certificate.get_key_identifier());
+        count++;
+    }
+}
+
+bool X509TrustIndex::is_key_identifier_match(const std::string& authority_key_identifier,
+                                             const std::string& key_identifier) {
+    // Only a mismatch of two present identifiers excludes the issuer
+    return authority_key_identifier.empty() || key_identifier.empty() || authority_key_identifier == key_identifier;
+}
+
+bool X509TrustIndex::is_anchored(const X509Wrapper& certificate) const {
+    const auto matches = [](const std::vector<std::string>& identifiers, const std::string& key_identifier) {
+        return std::any_of(identifiers.begin(), identifiers.end(), [&key_identifier](const std::string& identifier) {
+            return is_key_identifier_match(key_identifier, identifier);
+        });
+    };
+
+    const auto issuers = key_identifiers.find(certificate.get_issuer_hash());
+    if (issuers != key_identifiers.end() && matches(issuers->second, certificate.get_authority_key_identifier())) {
+        return true;
+    }
+
+    // The certificate itself is in the store
+    const auto same = key_identifiers.find(certificate.get_subject_hash());
+    return same != key_identifiers.end() && matches(same->second, certificate.get_key_identifier());
+}
+
+CertificateValidationResult X509TrustIndex::precheck(const std::vector<X509Wrapper>& chain) const {
+    if (chain.empty()) {
+        return CertificateValidationResult::Unknown;
+    }
+
+    const X509Wrapper& leaf = chain.at(0);
+
+    // Same as the verification, that allows future certificates but checks the expiry of the leaf
+    if (leaf.is_expired()) {
+        return CertificateValidationResult::Expired;
+    }
+
+    struct Candidate {
+        const X509Wrapper* certificate;
+        std::string subject_hash;
+        std::string key_identifier;
+    };
+
+    // The received roots are ignored by the verification
+    std::vector<Candidate> intermediates;
+    for (std::size_t i = 1; i < chain.size(); i++) {
+        if (!chain[i].is_selfsigned()) {
+            intermediates.push_back({&chain[i], chain[i].get_subject_hash(), chain[i].get_key_identifier()});
+        }
+    }
+
+    // Every path from the leaf through the intermediates, like the chain building of OpenSSL
+    std::vector<const X509Wrapper*> pending{&leaf};
+    std::vector<bool> visited(intermediates.size(), false);
+
+    while (!pending.empty()) {
+        const X509Wrapper* certificate = pending.back();
+        pending.pop_back();
+
+        if (is_anchored(*certificate)) {
+            return CertificateValidationResult::Valid;
+        }
+
+        const std::string issuer_hash = certificate->get_issuer_hash();
+        const std::string authority_key_identifier = certificate->get_authority_key_identifier();
+
+        for (std::size_t i = 0; i < intermediates.size(); i++) {
+            if (!visited[i] && intermediates[i].subject_hash == issuer_hash &&
+                is_key_identifier_match(authority_key_identifier, intermediates[i].key_identifier)) {
+                visited[i] = true;
+                pending.push_back(intermediates[i].certificate);
+            }
+        }
+    }
+
+    return CertificateValidationResult::IssuerNotFound;
+}
+
+} // namespace evse_security
@@ -3,7 +3,6 @@
 #include <evse_security/certificate/x509_wrapper.hpp>
 
 #include <cctype>
-#include <fstream>
 #include <iostream>
 #include <regex>
 
@@ -14,14 +13,14 @@
 namespace evse_security {
 
 X509Wrapper::X509Wrapper(const fs::path& file, const EncodingFormat encoding) {
-    if (fs::is_regular_file(file) == false) {
+    const auto certificate =
+        filesystem_utils::is_regular_file(file) ? filesystem_utils::read_shared_from_file(file) : nullptr;
+
+    if (certificate == nullptr) {
         throw CertificateLoadException("X509Wrapper can only load from files!");
     }
 
-    fsstd::ifstream read(file, std::ios::binary);
-    std::string certificate((std::istreambuf_iterator<char>(read)), std::istreambuf_iterator<char>());
-
-    auto loaded = CryptoSupplier::load_certificates(certificate, encoding);
+    auto loaded = CryptoSupplier::load_certificates(*certificate, encoding);
     if (loaded.size() != 1) {
         std::string error = "X509Wrapper can only load a single certificate! Loaded: ";
         error += std::to_string(loaded.size());
@@ -52,7 +51,7 @@ X509Wrapper::X509Wrapper(X509Handle_ptr&& x509) : x509(std::move(x509)) {
 }
 
 X509Wrapper::X509Wrapper(X509Handle_ptr&& x509, const fs::path& file) : x509(std::move(x509)), file(file) {
-    if (fs::is_regular_file(file) == false) {
+    if (filesystem_utils::is_regular_file(file) == false) {
         throw CertificateLoadException("X509Wrapper can only load from files!");
     }
 
@@ -117,7 +116,7 @@ std::optional<fs::path> X509Wrapper::get_file() const {
 }
 
 void X509Wrapper::set_file(fs::path& path) {
-    if (fs::is_directory(path))
+    if (filesystem_utils::is_directory(path))
         throw std::logic_error("update_file must only be used for files, not directories!");
 
     file = path;
@@ -139,6 +138,22 @@ std::string X509Wrapper::get_issuer_name_hash() const {
     return CryptoSupplier::x509_get_issuer_name_hash(get());
 }
 
+std::string X509Wrapper::get_subject_hash() const {
+    return CryptoSupplier::x509_get_subject_hash(get());
+}
+
+std::string X509Wrapper::get_issuer_hash() const {
+    return CryptoSupplier::x509_get_issuer_hash(get());
+}
+
+std::string X509Wrapper::get_key_identifier() const {
+    return CryptoSupplier::x509_get_key_identifier(get());
+}
+
+std::string X509Wrapper::get_authority_key_identifier() const {
+    return CryptoSupplier::x509_get_authority_key_identifier(get());
+}
+
 std::string X509Wrapper::get_serial_number() const {
     return CryptoSupplier::x509_get_serial_number(get());
 }
@@ -34,6 +34,10 @@ std::string AbstractCryptoSupplier::x509_to_string(X509Handle* handle) {
     default_crypto_supplier_usage_error() return {};
 }
 
+std::string AbstractCryptoSupplier::x509_to_der(X509Handle* handle) {
+    default_crypto_supplier_usage_error() return {};
+}
+
 std::string AbstractCryptoSupplier::x509_get_responder_url(X509Handle* handle) {
     default_crypto_supplier_usage_error() return {};
 }
@@ -54,6 +58,22 @@ std::string AbstractCryptoSupplier::x509_get_common_name(X509Handle* handle) {
     default_crypto_supplier_usage_error() return {};
 }
 
+std::string AbstractCryptoSupplier::x509_get_subject_hash(X509Handle* handle) {
+    default_crypto_supplier_usage_error() return {};
+}
+
+std::string AbstractCryptoSupplier::x509_get_issuer_hash(X509Handle* handle) {
+    default_crypto_supplier_usage_error() return {};
+}
+
+std::string AbstractCryptoSupplier::x509_get_key_identifier(X509Handle* handle) {
+    default_crypto_supplier_usage_error() return {};
+}
+
+std::string AbstractCryptoSupplier::x509_get_authority_key_identifier(X509Handle* handle) {
+    default_crypto_supplier_usage_error() return {};
+}
+
 bool AbstractCryptoSupplier::x509_get_validity(X509Handle* handle, std::int64_t& out_valid_in,
                                                std::int64_t& out_valid_to) {
     default_crypto_supplier_usage_error() return false;
@@ -96,6 +116,24 @@ CertificateSignRequestResult AbstractCryptoSupplier::x509_generate_csr(const Cer
     default_crypto_supplier_usage_error() return CertificateSignRequestResult::Unknown;
 }
 
+std::string AbstractCryptoSupplier::x509_get_csr_key_hash(const std::string& csr) {
+    default_crypto_supplier_usage_error() return {};
+}
+
+bool AbstractCryptoSupplier::x509_crl_load(const std::string& data, std::vector<CertificateRevocationList>& out_crls) {
+    default_crypto_supplier_usage_error() return false;
+}
+
+bool AbstractCryptoSupplier::x509_crl_verify(const CertificateRevocationList& crl, X509Handle* issuer) {
+    default_crypto_supplier_usage_error() return false;
+}
+
+OCSPCertificateStatus AbstractCryptoSupplier::x509_verify_ocsp_response(const std::string& response,
+                                                                        X509Handle* certificate, X509Handle* issuer,
+                                                                        std::optional<std::int64_t>& out_next_update) {
+    default_crypto_supplier_usage_error() return OCSPCertificateStatus::Invalid;
+}
+
 bool AbstractCryptoSupplier::digest_file_sha256(const fs::path& path, std::vector<std::uint8_t>& out_digest) {
     default_crypto_supplier_usage_error() return false;
 }
@@ -2,11 +2,13 @@
 // Copyright Pionix GmbH and Contributors to EVerest
 #include <evse_security/crypto/openssl/openssl_crypto_supplier.hpp>
 
-#include <everest/logging.hpp>
+#include <evse_security/utils/evse_logging.hpp>
 
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <map>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <vector>
@@ -14,6 +16,7 @@
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/ocsp.h>
 #include <openssl/opensslv.h>
 #include <openssl/pem.h>
 #include <openssl/sha.h>
@@ -70,10 +73,18 @@ bool OpenSSLSupplier::supports_tpm_key_creation() {
     return provider.supports_provider_tpm();
 }
 
+/// @brief Writes the content of a memory BIO to a file, through the active certificate storage
+static bool write_bio_to_file(BIO* bio, const fs::path& file_path) {
+    BUF_MEM* mem = NULL;
+    BIO_get_mem_ptr(bio, &mem);
+
+    return filesystem_utils::write_to_file(file_path, std::string(mem->data, mem->length), std::ios::out);
+}
+
 static bool export_key_internal(const KeyGenerationInfo& key_info, const EVP_PKEY_ptr& evp_key) {
     // write private key to file
     if (key_info.private_key_file.has_value()) {
-        BIO_ptr key_bio(BIO_new_file(key_info.private_key_file.value().c_str(), "w"));
+        BIO_ptr key_bio(BIO_new(BIO_s_mem()));
 
         if (!key_bio) {
             EVLOG_error << "Failed to create private key file!";
@@ -88,21 +99,22 @@ static bool export_key_internal(const KeyGenerationInfo& key_info, const EVP_PKE
             success = PEM_write_bio_PrivateKey(key_bio.get(), evp_key.get(), NULL, NULL, 0, NULL, NULL);
         }
 
-        if (false == success) {
+        if (false == success || false == write_bio_to_file(key_bio.get(), key_info.private_key_file.value())) {
             EVLOG_error << "Failed to write private key!";
             return false;
         }
     }
 
     if (key_info.public_key_file.has_value()) {
-        BIO_ptr key_bio(BIO_new_file(key_info.public_key_file.value().c_str(), "w"));
+        BIO_ptr key_bio(BIO_new(BIO_s_mem()));
 
         if (!key_bio) {
             EVLOG_error << "Failed to create private key file!";
             return false;
         }
 
-        if (false == PEM_write_bio_PUBKEY(key_bio.get(), evp_key.get())) {
+        if (false == PEM_write_bio_PUBKEY(key_bio.get(), evp_key.get()) ||
+            false == write_bio_to_file(key_bio.get(), key_info.public_key_file.value())) {
             EVLOG_error << "Failed to write pubkey!";
             return false;
         }
@@ -127,7 +139,7 @@ static bool s_generate_key(const KeyGenerationInfo& key_info, KeyHandle_ptr& out
 
     // note when using tpm2 some key_types may not be supported.
 
-    EVLOG_info << "Key parameters";
+    EVSE_LOG_info << "Key parameters";
     switch (key_info.key_type) {
     case CryptoKeyType::RSA_TPM20:
         bits = 2048;
@@ -159,18 +171,18 @@ static bool s_generate_key(const KeyGenerationInfo& key_info, KeyHandle_ptr& out
 
     if (bEC) {
         params[0] = OSSL_PARAM_construct_utf8_string("group", group, group_sz);
-        EVLOG_info << "Key parameters: EC";
+        EVSE_LOG_info << "Key parameters: EC";
         ctx = EVP_PKEY_CTX_ptr(EVP_PKEY_CTX_new_from_name(nullptr, kt_ec, nullptr));
     } else {
         params[0] = OSSL_PARAM_construct_uint("bits", &bits);
-        EVLOG_info << "Key parameters: RSA";
+        EVSE_LOG_info << "Key parameters: RSA";
         ctx = EVP_PKEY_CTX_ptr(EVP_PKEY_CTX_new_from_name(nullptr, kt_rsa, nullptr));
     }
 
     params[1] = OSSL_PARAM_construct_end();
 
     if (bResult) {
-        EVLOG_info << "Key parameters done";
+        EVSE_LOG_info << "Key parameters done";
         if (nullptr == ctx.get()) {
             EVLOG_error << "create key context failed!";
             ERR_print_errors_fp(stderr);
@@ -179,7 +191,7 @@ static bool s_generate_key(const KeyGenerationInfo& key_info, KeyHandle_ptr& out
     }
 
     if (bResult) {
-        EVLOG_info << "Keygen init";
+        EVSE_LOG_info << "Keygen init";
         if (EVP_PKEY_keygen_init(ctx.get()) <= 0 || EVP_PKEY_CTX_set_params(ctx.get(), params) <= 0) {
             EVLOG_error << "Keygen init failed";
             ERR_print_errors_fp(stderr);
@@ -190,7 +202,7 @@ static bool s_generate_key(const KeyGenerationInfo& key_info, KeyHandle_ptr& out
     EVP_PKEY* pkey = nullptr;
 
     if (bResult) {
-        EVLOG_info << "Key generate";
+        EVSE_LOG_info << "Key generate";
         if (EVP_PKEY_generate(ctx.get(), &pkey) <= 0) {
             EVLOG_error << "Failed to generate tpm2 key!";
             ERR_print_errors_fp(stderr);
@@ -201,7 +213,7 @@ static bool s_generate_key(const KeyGenerationInfo& key_info, KeyHandle_ptr& out
     auto evp_key = EVP_PKEY_ptr(pkey);
 
     if (bResult) {
-        EVLOG_info << "Key export";
+        EVSE_LOG_info << "Key export";
         // Export keys too
         bResult = export_key_internal(key_info, evp_key);
         EVP_PKEY* raw_key_handle = evp_key.release();
@@ -290,6 +302,23 @@ std::string OpenSSLSupplier::x509_to_string(X509Handle* handle) {
     return {};
 }
 
+std::string OpenSSLSupplier::x509_to_der(X509Handle* handle) {
+    if (X509* x509 = get(handle)) {
+        const int length = i2d_X509(x509, nullptr);
+
+        if (length > 0) {
+            std::string der(static_cast<std::size_t>(length), '\0');
+            unsigned char* out = reinterpret_cast<unsigned char*>(der.data());
+
+            if (i2d_X509(x509, &out) == length) {
+                return der;
+            }
+        }
+    }
+
+    return {};
+}
+
 std::string OpenSSLSupplier::x509_get_common_name(X509Handle* handle) {
     X509* x509 = get(handle);
 
@@ -316,35 +345,84 @@ std::string OpenSSLSupplier::x509_get_common_name(X509Handle* handle) {
     return common_name;
 }
 
-std::string OpenSSLSupplier::x509_get_issuer_name_hash(X509Handle* handle) {
+static std::string to_hex(const unsigned char* data, int length) {
+    std::stringstream ss;
+    for (int i = 0; i < length; i++) {
+        ss << std::setw(2) << std::setfill('0') << std::hex << (int)data[i];
+    }
+    return ss.str();
+}
+
+static std::string to_name_hash(unsigned long hash) {
+    std::stringstream ss;
+    ss << std::setw(8) << std::setfill('0') << std::hex << hash;
+    return ss.str();
+}
+
+std::string OpenSSLSupplier::x509_get_subject_hash(X509Handle* handle) {
     X509* x509 = get(handle);
 
     if (x509 == nullptr)
         return {};
 
-    unsigned char md[SHA256_DIGEST_LENGTH];
-    X509_NAME* name = X509_get_issuer_name(x509);
-    X509_NAME_digest(name, EVP_sha256(), md, NULL);
+    return to_name_hash(X509_subject_name_hash(x509));
+}
 
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::setw(2) << std::setfill('0') << std::hex << (int)md[i];
+std::string OpenSSLSupplier::x509_get_issuer_hash(X509Handle* handle) {
+    X509* x509 = get(handle);
+
+    if (x509 == nullptr)
+        return {};
+
+    return to_name_hash(X509_issuer_name_hash(x509));
+}
+
+std::string OpenSSLSupplier::x509_get_key_identifier(X509Handle* handle) {
+    X509* x509 = get(handle);
+
+    if (x509 == nullptr)
+        return {};
+
+    const ASN1_OCTET_STRING* key_id = X509_get0_subject_key_id(x509);
+    if (key_id == nullptr) {
+        return {};
     }
-    return ss.str();
+
+    return to_hex(ASN1_STRING_get0_data(key_id), ASN1_STRING_length(key_id));
 }
 
-std::string OpenSSLSupplier::x509_get_serial_number(X509Handle* handle) {
+std::string OpenSSLSupplier::x509_get_authority_key_identifier(X509Handle* handle) {
     X509* x509 = get(handle);
 
     if (x509 == nullptr)
         return {};
 
-    ASN1_INTEGER* serial_asn1 = X509_get_serialNumber(x509);
-    if (serial_asn1 == nullptr) {
-        ERR_print_errors_fp(stderr);
+    const ASN1_OCTET_STRING* key_id = X509_get0_authority_key_id(x509);
+    if (key_id == nullptr) {
         return {};
     }
 
+    return to_hex(ASN1_STRING_get0_data(key_id), ASN1_STRING_length(key_id));
+}
+
+std::string OpenSSLSupplier::x509_get_issuer_name_hash(X509Handle* handle) {
+    X509* x509 = get(handle);
+
+    if (x509 == nullptr)
+        return {};
+
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    X509_NAME* name = X509_get_issuer_name(x509);
+    X509_NAME_digest(name, EVP_sha256(), md, NULL);
+
+    std::stringstream ss;
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        ss << std::setw(2) << std::setfill('0') << std::hex << (int)md[i];
+    }
+    return ss.str();
+}
+
+static std::string to_serial_number(const ASN1_INTEGER* serial_asn1) {
     BIGNUM* bn_serial = ASN1_INTEGER_to_BN(serial_asn1, NULL);
 
     if (bn_serial == nullptr) {
@@ -371,6 +449,21 @@ std::string OpenSSLSupplier::x509_get_serial_number(X509Handle* handle) {
     return serial;
 }
 
+std::string OpenSSLSupplier::x509_get_serial_number(X509Handle* handle) {
+    X509* x509 = get(handle);
+
+    if (x509 == nullptr)
+        return {};
+
+    ASN1_INTEGER* serial_asn1 = X509_get_serialNumber(x509);
+    if (serial_asn1 == nullptr) {
+        ERR_print_errors_fp(stderr);
+        return {};
+    }
+
+    return to_serial_number(serial_asn1);
+}
+
 std::string OpenSSLSupplier::x509_get_key_hash(X509Handle* handle) {
     X509* x509 = get(handle);
 
@@ -457,7 +550,7 @@ bool OpenSSLSupplier::x509_is_child(X509Handle* child, X509Handle* parent) {
         int ec = X509_STORE_CTX_get_error(ctx.get());
         const char* error = X509_verify_cert_error_string(ec);
 
-        EVLOG_debug << "Certificate issued by error: " << ((error != nullptr) ? error : "UNKNOWN");
+        EVSE_LOG_debug << "Certificate issued by error: " << ((error != nullptr) ? error : "UNKNOWN");
         return false;
     }
 
@@ -569,7 +662,7 @@ KeyValidationResult OpenSSLSupplier::x509_check_private_key(X509Handle* handle,
     } else {
         provider.set_global_mode(OpenSSLProvider::mode_t::default_provider);
     }
-    EVLOG_debug << "Is Custom Key: " << custom_key;
+    EVSE_LOG_debug << "Is Custom Key: " << custom_key;
 
     BIO_ptr bio(BIO_new_mem_buf(private_key.c_str(), -1));
     // Passing password string since if NULL is provided, the password CB will be called
@@ -635,31 +728,14 @@ bool OpenSSLSupplier::x509_verify_signature(X509Handle* handle, const std::vecto
         EVLOG_error << "Failure to verify: " << result;
         return false;
     } else {
-        EVLOG_debug << "Successful verification";
+        EVSE_LOG_debug << "Successful verification";
         return true;
     }
 }
 
-CertificateSignRequestResult OpenSSLSupplier::x509_generate_csr(const CertificateSigningRequestInfo& csr_info,
-                                                                std::string& out_csr) {
-
-    KeyHandle_ptr gen_key;
-    EVP_PKEY_CTX_ptr ctx;
-    OpenSSLProvider provider;
-
-    if (csr_info.key_info.generate_on_custom) {
-        provider.set_global_mode(OpenSSLProvider::mode_t::custom_provider);
-    } else {
-        provider.set_global_mode(OpenSSLProvider::mode_t::default_provider);
-    }
-
-    if (false == s_generate_key(csr_info.key_info, gen_key, ctx)) {
-        return CertificateSignRequestResult::KeyGenerationError;
-    }
-
-    EVP_PKEY* key = get(gen_key.get());
-
-    // X509 CSR request
+/// @brief Builds the key independent part of a CSR, that is the version, the subject and the extensions
+static CertificateSignRequestResult build_csr_template(const CertificateSigningRequestInfo& csr_info,
+                                                       X509_REQ_ptr& out_template) {
     X509_REQ_ptr x509_req_ptr(X509_REQ_new());
 
     if (nullptr == x509_req_ptr.get()) {
@@ -679,14 +755,6 @@ CertificateSignRequestResult OpenSSLSupplier::x509_generate_csr(const Certificat
         return CertificateSignRequestResult::VersioningError;
     }
 
-    // set public key of x509 req
-    if (false == X509_REQ_set_pubkey(x509_req_ptr.get(), key)) {
-        EVLOG_error << "Failed to set csr pubkey!";
-        ERR_print_errors_fp(stderr);
-
-        return CertificateSignRequestResult::PubkeyError;
-    }
-
     X509_NAME* x509Name = X509_REQ_get_subject_name(x509_req_ptr.get());
 
     // set subject of x509 req
@@ -733,6 +801,129 @@ CertificateSignRequestResult OpenSSLSupplier::x509_generate_csr(const Certificat
         return CertificateSignRequestResult::ExtensionsError;
     }
 
+    out_template = std::move(x509_req_ptr);
+    return CertificateSignRequestResult::Valid;
+}
+
+// Templates kept, one per leaf type when each type renews with the same subject
+static constexpr std::size_t MAX_CSR_TEMPLATES = 4;
+
+/// @brief Returns a fresh copy of the prepared CSR for the provided info. The templates are cached by the
+/// subject and the subject alternative names, since they rarely change between renewals of the same leaf. The least
+/// recently used template is replaced, so that distinct subjects (e.g. a serial per CN) do not grow the cache
+static CertificateSignRequestResult get_csr_from_template(const CertificateSigningRequestInfo& csr_info,
+                                                          X509_REQ_ptr& out_request) {
+    static std::mutex templates_mutex;
+    // Ordered from the least to the most recently used
+    static std::vector<std::pair<std::string, X509_REQ_ptr>> templates;
+
+    // Zero separated, since none of the components can contain a zero
+    std::string template_key = std::to_string(csr_info.n_version);
+
+    for (const std::string& component : {csr_info.country, csr_info.organization, csr_info.commonName}) {
+        template_key += '\0' + component;
+    }
+
+    // Differentiate between a missing and an empty alternative name
+    for (const auto& alt_name : {csr_info.dns_name, csr_info.ip_address}) {
+        template_key += '\0';
+        template_key += alt_name.has_value() ? ("+" + alt_name.value()) : "-";
+    }
+
+    std::lock_guard<std::mutex> guard(templates_mutex);
+
+    auto found = std::find_if(templates.begin(), templates.end(),
+                              [&template_key](const auto& entry) { return entry.first == template_key; });
+
+    if (found == templates.end()) {
+        X509_REQ_ptr new_template;
+        CertificateSignRequestResult result = build_csr_template(csr_info, new_template);
+
+        if (result != CertificateSignRequestResult::Valid) {
+            return result;
+        }
+
+        if (templates.size() >= MAX_CSR_TEMPLATES) {
+            templates.erase(templates.begin());
+        }
+
+        templates.emplace_back(std::move(template_key), std::move(new_template));
+    } else {
+        std::rotate(found, std::next(found), templates.end());
+    }
+
+    // The template can't be duplicated as a whole since it does not have a public key
+    // yet, so we only copy over the prepared parts
+    X509_REQ* csr_template = templates.back().second.get();
+    X509_REQ_ptr x509_req_ptr(X509_REQ_new());
+
+    if (nullptr == x509_req_ptr.get()) {
+        EVLOG_error << "Failed to create CSR request!";
+        ERR_print_errors_fp(stderr);
+
+        return CertificateSignRequestResult::Unknown;
+    }
+
+    if (false == X509_REQ_set_version(x509_req_ptr.get(), X509_REQ_get_version(csr_template))) {
+        EVLOG_error << "Failed to set csr version!";
+        ERR_print_errors_fp(stderr);
+
+        return CertificateSignRequestResult::VersioningError;
+    }
+
+    bool copied = X509_REQ_set_subject_name(x509_req_ptr.get(), X509_REQ_get_subject_name(csr_template));
+
+    // Extensions are stored as a single pre-encoded attribute
+    for (int i = 0; copied && i < X509_REQ_get_attr_count(csr_template); i++) {
+        copied = X509_REQ_add1_attr(x509_req_ptr.get(), X509_REQ_get_attr(csr_template, i));
+    }
+
+    if (false == copied) {
+        EVLOG_error << "Failed to copy csr template!";
+        ERR_print_errors_fp(stderr);
+
+        return CertificateSignRequestResult::ExtensionsError;
+    }
+
+    out_request = std::move(x509_req_ptr);
+    return CertificateSignRequestResult::Valid;
+}
+
+CertificateSignRequestResult OpenSSLSupplier::x509_generate_csr(const CertificateSigningRequestInfo& csr_info,
+                                                                std::string& out_csr) {
+
+    KeyHandle_ptr gen_key;
+    EVP_PKEY_CTX_ptr ctx;
+    OpenSSLProvider provider;
+
+    if (csr_info.key_info.generate_on_custom) {
+        provider.set_global_mode(OpenSSLProvider::mode_t::custom_provider);
+    } else {
+        provider.set_global_mode(OpenSSLProvider::mode_t::default_provider);
+    }
+
+    if (false == s_generate_key(csr_info.key_info, gen_key, ctx)) {
+        return CertificateSignRequestResult::KeyGenerationError;
+    }
+
+    EVP_PKEY* key = get(gen_key.get());
+
+    // X509 CSR request, the subject and extensions are already prepared
+    X509_REQ_ptr x509_req_ptr;
+    CertificateSignRequestResult template_result = get_csr_from_template(csr_info, x509_req_ptr);
+
+    if (template_result != CertificateSignRequestResult::Valid) {
+        return template_result;
+    }
+
+    // set public key of x509 req
+    if (false == X509_REQ_set_pubkey(x509_req_ptr.get(), key)) {
+        EVLOG_error << "Failed to set csr pubkey!";
+        ERR_print_errors_fp(stderr);
+
+        return CertificateSignRequestResult::PubkeyError;
+    }
+
     // sign the certificate with the private key
     bool x509_signed = X509_REQ_sign(x509_req_ptr.get(), key, EVP_sha256());
 
@@ -755,6 +946,257 @@ CertificateSignRequestResult OpenSSLSupplier::x509_generate_csr(const Certificat
     return CertificateSignRequestResult::Valid;
 }
 
+std::string OpenSSLSupplier::x509_get_csr_key_hash(const std::string& csr) {
+    BIO_ptr bio(BIO_new_mem_buf(csr.c_str(), static_cast<int>(csr.size())));
+
+    if (!bio) {
+        return {};
+    }
+
+    X509_REQ_ptr x509_req_ptr(PEM_read_bio_X509_REQ(bio.get(), nullptr, nullptr, nullptr));
+
+    if (!x509_req_ptr) {
+        EVLOG_error << "Failed to read csr!";
+        return {};
+    }
+
+    // Same digest as 'X509_pubkey_digest' so that it matches 'x509_get_key_hash' of the issued certificate
+    const unsigned char* pubkey_data = nullptr;
+    int pubkey_length = 0;
+
+    if (false == X509_PUBKEY_get0_param(nullptr, &pubkey_data, &pubkey_length, nullptr,
+                                        X509_REQ_get_X509_PUBKEY(x509_req_ptr.get()))) {
+        return {};
+    }
+
+    unsigned char tmphash[SHA256_DIGEST_LENGTH];
+    SHA256(pubkey_data, pubkey_length, tmphash);
+    std::stringstream ss;
+    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        ss << std::setw(2) << std::setfill('0') << std::hex << (int)tmphash[i];
+    }
+
+    return ss.str();
+}
+
+static std::int64_t to_epoch_seconds(const ASN1_TIME* time) {
+    int day, sec;
+    ASN1_TIME_diff(&day, &sec, nullptr, time);
+
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    return now.count() + std::chrono::duration_cast<std::chrono::seconds>(days_to_seconds(day)).count() + sec;
+}
+
+bool OpenSSLSupplier::x509_crl_load(const std::string& data, std::vector<CertificateRevocationList>& out_crls) {
+    BIO_ptr bio(BIO_new_mem_buf(data.data(), static_cast<int>(data.size())));
+
+    if (!bio) {
+        return false;
+    }
+
+    STACK_OF(X509_INFO)* all_infos = PEM_X509_INFO_read_bio(bio.get(), nullptr, nullptr, nullptr);
+
+    if (all_infos == nullptr) {
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+
+    std::vector<CertificateRevocationList> crls;
+    bool valid = true;
+
+    for (int i = 0; i < sk_X509_INFO_num(all_infos); i++) {
+        X509_INFO* xi = sk_X509_INFO_value(all_infos, i);
+
+        if (xi == nullptr || xi->crl == nullptr) {
+            continue;
+        }
+
+        X509_CRL* x509_crl = xi->crl;
+        CertificateRevocationList crl;
+
+        unsigned char md[SHA256_DIGEST_LENGTH];
+        if (!X509_NAME_digest(X509_CRL_get_issuer(x509_crl), EVP_sha256(), md, NULL)) {
+            valid = false;
+            break;
+        }
+
+        std::stringstream ss;
+        for (int j = 0; j < SHA256_DIGEST_LENGTH; j++) {
+            ss << std::setw(2) << std::setfill('0') << std::hex << (int)md[j];
+        }
+        crl.issuer_name_hash = ss.str();
+
+        crl.last_update = to_epoch_seconds(X509_CRL_get0_lastUpdate(x509_crl));
+        if (const ASN1_TIME* next_update = X509_CRL_get0_nextUpdate(x509_crl)) {
+            crl.next_update = to_epoch_seconds(next_update);
+        }
+
+        STACK_OF(X509_REVOKED)* revoked = X509_CRL_get_REVOKED(x509_crl);
+        for (int j = 0; j < sk_X509_REVOKED_num(revoked); j++) {
+            crl.revoked_serial_numbers.push_back(
+                to_serial_number(X509_REVOKED_get0_serialNumber(sk_X509_REVOKED_value(revoked, j))));
+        }
+
+        BIO_ptr bio_write(BIO_new(BIO_s_mem()));
+        if (!bio_write || PEM_write_bio_X509_CRL(bio_write.get(), x509_crl) != 1) {
+            valid = false;
+            break;
+        }
+
+        BUF_MEM* mem = NULL;
+        BIO_get_mem_ptr(bio_write.get(), &mem);
+        crl.pem = std::string(mem->data, mem->length);
+
+        crls.push_back(std::move(crl));
+    }
+
+    sk_X509_INFO_pop_free(all_infos, X509_INFO_free);
+
+    if (!valid || crls.empty()) {
+        ERR_clear_error();
+        return false;
+    }
+
+    out_crls = std::move(crls);
+    return true;
+}
+
+bool OpenSSLSupplier::x509_crl_verify(const CertificateRevocationList& crl, X509Handle* issuer) {
+    X509* x509 = get(issuer);
+
+    if (x509 == nullptr) {
+        return false;
+    }
+
+    OpenSSLProvider provider;
+    provider.set_global_mode(OpenSSLProvider::mode_t::default_provider);
+
+    BIO_ptr bio(BIO_new_mem_buf(crl.pem.data(), static_cast<int>(crl.pem.size())));
+
+    if (!bio) {
+        return false;
+    }
+
+    X509_CRL_ptr x509_crl(PEM_read_bio_X509_CRL(bio.get(), nullptr, nullptr, nullptr));
+
+    if (!x509_crl) {
+        ERR_print_errors_fp(stderr);
+        return false;
+    }
+
+    if (X509_NAME_cmp(X509_CRL_get_issuer(x509_crl.get()), X509_get_subject_name(x509)) != 0) {
+        return false;
+    }
+
+    EVP_PKEY* public_key = X509_get0_pubkey(x509);
+
+    if (public_key == nullptr || X509_CRL_verify(x509_crl.get(), public_key) != 1) {
+        ERR_clear_error();
+        return false;
+    }
+
+    return true;
+}
+
+// Accepted clock difference to the responder when checking the validity window
+constexpr long OCSP_VALIDITY_LEEWAY_SECONDS = 300;
+
+OCSPCertificateStatus OpenSSLSupplier::x509_verify_ocsp_response(const std::string& response,
+                                                                 X509Handle* certificate, X509Handle* issuer,
+                                                                 std::optional<std::int64_t>& out_next_update) {
+    X509* x509 = get(certificate);
+    X509* x509_issuer = get(issuer);
+
+    if (x509 == nullptr || x509_issuer == nullptr) {
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    OpenSSLProvider provider;
+    provider.set_global_mode(OpenSSLProvider::mode_t::default_provider);
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(response.data());
+    OCSP_RESPONSE_ptr ocsp_response(d2i_OCSP_RESPONSE(nullptr, &data, static_cast<long>(response.size())));
+
+    if (!ocsp_response || OCSP_response_status(ocsp_response.get()) != OCSP_RESPONSE_STATUS_SUCCESSFUL) {
+        ERR_clear_error();
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    OCSP_BASICRESP_ptr basic_response(OCSP_response_get1_basic(ocsp_response.get()));
+
+    if (!basic_response) {
+        ERR_clear_error();
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    // The responder is the issuer or a delegated responder issued by it, the issuer can be a sub-CA
+    X509_STORE_ptr store(X509_STORE_new());
+    X509_STORE_add_cert(store.get(), x509_issuer);
+    X509_STORE_set_flags(store.get(), X509_V_FLAG_PARTIAL_CHAIN);
+
+    X509_STACK_UNSAFE_ptr issuer_stack(sk_X509_new_null());
+    sk_X509_push(issuer_stack.get(), x509_issuer);
+
+    if (OCSP_basic_verify(basic_response.get(), issuer_stack.get(), store.get(), 0) != 1) {
+        EVSE_LOG_debug << "OCSP response signature could not be verified";
+        ERR_clear_error();
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    // Search the response of the certificate, with the digest used by the responder
+    OCSP_SINGLERESP* single = nullptr;
+
+    for (int i = 0; i < OCSP_resp_count(basic_response.get()) && single == nullptr; i++) {
+        OCSP_SINGLERESP* candidate = OCSP_resp_get0(basic_response.get(), i);
+
+        ASN1_OBJECT* digest_object = nullptr;
+        OCSP_id_get0_info(nullptr, &digest_object, nullptr, nullptr,
+                          const_cast<OCSP_CERTID*>(OCSP_SINGLERESP_get0_id(candidate)));
+
+        const EVP_MD* digest = (digest_object != nullptr) ? EVP_get_digestbyobj(digest_object) : nullptr;
+
+        if (digest != nullptr) {
+            OCSP_CERTID_ptr certificate_id(OCSP_cert_to_id(digest, x509, x509_issuer));
+
+            if (certificate_id && OCSP_id_cmp(certificate_id.get(), OCSP_SINGLERESP_get0_id(candidate)) == 0) {
+                single = candidate;
+            }
+        }
+    }
+
+    if (single == nullptr) {
+        EVSE_LOG_debug << "OCSP response does not contain the certificate";
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    int reason;
+    ASN1_GENERALIZEDTIME* revocation_time = nullptr;
+    ASN1_GENERALIZEDTIME* this_update = nullptr;
+    ASN1_GENERALIZEDTIME* next_update = nullptr;
+    const int status = OCSP_single_get0_status(single, &reason, &revocation_time, &this_update, &next_update);
+
+    if (OCSP_check_validity(this_update, next_update, OCSP_VALIDITY_LEEWAY_SECONDS, -1) != 1) {
+        EVSE_LOG_debug << "OCSP response is out of its validity window";
+        ERR_clear_error();
+        return OCSPCertificateStatus::Invalid;
+    }
+
+    out_next_update.reset();
+    if (next_update != nullptr) {
+        out_next_update = to_epoch_seconds(next_update);
+    }
+
+    switch (status) {
+    case V_OCSP_CERTSTATUS_GOOD:
+        return OCSPCertificateStatus::Good;
+    case V_OCSP_CERTSTATUS_REVOKED:
+        return OCSPCertificateStatus::Revoked;
+    default:
+        return OCSPCertificateStatus::Unknown;
+    }
+}
+
 bool OpenSSLSupplier::digest_file_sha256(const fs::path& path, std::vector<std::uint8_t>& out_digest) {
     EVP_MD_CTX_ptr md_context_ptr(EVP_MD_CTX_create());
     if (!md_context_ptr.get()) {
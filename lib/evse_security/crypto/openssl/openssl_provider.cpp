@@ -3,6 +3,9 @@
 
 #include <evse_security/crypto/openssl/openssl_provider.hpp>
 #include <evse_security/evse_types.hpp>
+#include <evse_security/utils/evse_filesystem.hpp>
+
+#include <sstream>
 
 #include <openssl/opensslv.h>
 
@@ -12,7 +15,7 @@
 #include <openssl/evp.h>
 #include <openssl/provider.h>
 
-#include <everest/logging.hpp>
+#include <evse_security/utils/evse_logging.hpp>
 #else
 // dummy structures for non-OpenSSL 3
 struct ossl_provider_st {};
@@ -32,11 +35,12 @@ bool is_custom_private_key_string(const std::string& private_key_pem) {
 }
 
 bool is_custom_private_key_file(const fs::path& private_key_file_pem) {
-    if (fs::is_regular_file(private_key_file_pem)) {
-        std::ifstream key_file(private_key_file_pem);
+    std::string key_data;
+
+    if (filesystem_utils::read_from_file(private_key_file_pem, key_data)) {
+        std::istringstream key_file(key_data);
         std::string line;
         std::getline(key_file, line);
-        key_file.close();
 
         // Search for the standard header
         return is_custom_private_key_string(line);
@@ -76,7 +80,7 @@ static bool s_load_and_test_provider(OSSL_PROVIDER*& provider, OSSL_LIB_CTX* lib
     bool result = true;
 #ifdef DEBUG
     const char* modestr = (libctx == nullptr) ? "global" : "TLS";
-    EVLOG_info << "Loading " << modestr << " provider: " << provider_name;
+    EVSE_LOG_info << "Loading " << modestr << " provider: " << provider_name;
 #endif
     if ((provider = OSSL_PROVIDER_load(libctx, provider_name)) == nullptr) {
         EVLOG_error << "Unable to load OSSL_PROVIDER: " << provider_name;
@@ -84,7 +88,7 @@ static bool s_load_and_test_provider(OSSL_PROVIDER*& provider, OSSL_LIB_CTX* lib
         result = false;
     } else {
 #ifdef DEBUG
-        EVLOG_info << "Testing " << modestr << " provider: " << provider_name;
+        EVSE_LOG_info << "Testing " << modestr << " provider: " << provider_name;
 #endif
         if (OSSL_PROVIDER_self_test(provider) == 0) {
             EVLOG_error << "Self-test failed: OSSL_PROVIDER: " << provider_name;
@@ -164,7 +168,7 @@ bool OpenSSLProvider::load(OSSL_PROVIDER*& default_p, OSSL_PROVIDER*& custom_p,
 bool OpenSSLProvider::set_propstr(OSSL_LIB_CTX* libctx, mode_t mode) {
     const char* propstr = propquery(mode);
 #ifdef DEBUG
-    EVLOG_info << "Setting " << ((libctx == nullptr) ? "global" : "tls") << " propquery: " << propstr;
+    EVSE_LOG_info << "Setting " << ((libctx == nullptr) ? "global" : "tls") << " propquery: " << propstr;
 #endif
     const bool result = EVP_set_default_properties(libctx, propstr) == 1;
     if (!result) {
@@ -0,0 +1,495 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/daemon/evse_security_client.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <evse_security/evse_security.hpp>
+
+namespace evse_security {
+
+using daemon::Message;
+using daemon::MessageReader;
+using daemon::MessageWriter;
+using daemon::Opcode;
+
+EvseSecurityClient::EvseSecurityClient(const fs::path& socket_path) : socket_path(socket_path) {
+}
+
+EvseSecurityClient::~EvseSecurityClient() {
+    disconnect();
+}
+
+void EvseSecurityClient::connect() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.string().size() >= sizeof(address.sun_path)) {
+        throw DaemonConnectionException("Socket path too long: " + socket_path.string());
+    }
+
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::string error = std::strerror(errno);
+        disconnect();
+        throw DaemonConnectionException("Could not connect to: " + socket_path.string() + ": " + error);
+    }
+
+    MessageWriter writer;
+    writer.write(daemon::PROTOCOL_VERSION);
+
+    Message response;
+    if (!exchange({Opcode::Hello, 0, writer.get_data()}, response) || response.opcode != Opcode::Hello) {
+        disconnect();
+        throw DaemonConnectionException("Handshake failed with: " + socket_path.string());
+    }
+
+    // Updates may have been missed while disconnected
+    cache.clear();
+    set_generation(response.generation);
+
+    // The watches of the previous connection were removed by the daemon
+    for (const auto& [watch_id, watch] : expiry_watches) {
+        if (!send_expiry_watch(watch_id)) {
+            disconnect();
+            throw DaemonConnectionException("Could not register the expiry watches with: " + socket_path.string());
+        }
+    }
+}
+
+void EvseSecurityClient::disconnect() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void EvseSecurityClient::set_generation(std::uint64_t new_generation) {
+    if (new_generation != generation) {
+        generation = new_generation;
+        cache.clear();
+    }
+}
+
+void EvseSecurityClient::process_updates() {
+    char header[daemon::MESSAGE_HEADER_SIZE];
+
+    while (fd >= 0) {
+        const ssize_t available = ::recv(fd, header, sizeof(header), MSG_PEEK | MSG_DONTWAIT);
+
+        if (available < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        Message update;
+
+        // Only updates and notifications are received between two calls, they are complete once their header is
+        // available
+        if (available <= 0 || !daemon::receive_message(fd, update)) {
+            disconnect();
+            return;
+        }
+
+        if (update.opcode == Opcode::GenerationUpdate) {
+            set_generation(update.generation);
+        } else if (update.opcode != Opcode::ExpiryNotification || !receive_expiry(update)) {
+            disconnect();
+            return;
+        }
+    }
+}
+
+bool EvseSecurityClient::receive_expiry(const Message& notification) {
+    std::uint64_t watch_id;
+    CertificateExpiry expiry;
+    MessageReader reader(notification.payload);
+
+    if (!reader.read(watch_id) || !reader.read(expiry) || !reader.is_complete()) {
+        return false;
+    }
+
+    received_expiries.emplace_back(watch_id, expiry);
+    return true;
+}
+
+void EvseSecurityClient::dispatch_expiries() {
+    std::vector<std::pair<std::function<void(const CertificateExpiry&)>, CertificateExpiry>> pending;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto& [watch_id, expiry] : received_expiries) {
+            // Dropped if the watch was removed since
+            if (const auto watch = expiry_watches.find(watch_id); watch != expiry_watches.end()) {
+                pending.emplace_back(watch->second.callback, expiry);
+            }
+        }
+
+        received_expiries.clear();
+    }
+
+    // The callbacks may call this client
+    for (const auto& [callback, expiry] : pending) {
+        callback(expiry);
+    }
+}
+
+bool EvseSecurityClient::send_expiry_watch(std::size_t watch_id) {
+    MessageWriter writer;
+    writer.write(static_cast<std::uint64_t>(watch_id));
+    writer.write(expiry_watches.at(watch_id).threshold_days);
+
+    Message response;
+    if (!exchange({Opcode::RegisterExpiryWatch, 0, writer.get_data()}, response)) {
+        return false;
+    }
+
+    if (response.opcode == Opcode::Error) {
+        std::string error;
+        MessageReader reader(response.payload);
+        reader.read(error);
+
+        throw std::runtime_error("Daemon request failed: " + error);
+    }
+
+    if (response.opcode != Opcode::RegisterExpiryWatch) {
+        return false;
+    }
+
+    set_generation(response.generation);
+    return true;
+}
+
+bool EvseSecurityClient::exchange(const Message& request, Message& out_response) {
+    if (!daemon::send_message(fd, request)) {
+        return false;
+    }
+
+    for (;;) {
+        if (!daemon::receive_message(fd, out_response)) {
+            return false;
+        }
+
+        if (out_response.opcode == Opcode::GenerationUpdate) {
+            set_generation(out_response.generation);
+        } else if (out_response.opcode == Opcode::ExpiryNotification) {
+            if (!receive_expiry(out_response)) {
+                return false;
+            }
+        } else {
+            return true;
+        }
+    }
+}
+
+std::string EvseSecurityClient::transact(Opcode opcode, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    process_updates();
+
+    const bool cacheable = daemon::is_cacheable(opcode);
+    const auto key = std::make_pair(opcode, payload);
+
+    if (cacheable && fd >= 0) {
+        const auto it = cache.find(key);
+
+        if (it != cache.end()) {
+            cache_hits++;
+            return it->second;
+        }
+    }
+
+    Message response;
+    bool exchanged = false;
+
+    // A request that failed on a stale connection (e.g. daemon restart) is sent again, unless it may have been
+    // processed and would modify the stores twice
+    for (int attempt = 0; attempt < 2 && !exchanged; attempt++) {
+        const bool reconnected = (fd < 0);
+
+        if (reconnected) {
+            connect();
+        }
+
+        exchanged = exchange({opcode, 0, payload}, response);
+
+        if (!exchanged) {
+            disconnect();
+
+            if (reconnected || daemon::is_modifying(opcode)) {
+                break;
+            }
+        }
+    }
+
+    if (!exchanged) {
+        throw DaemonConnectionException("Lost connection to: " + socket_path.string());
+    }
+
+    if (response.opcode == Opcode::Error) {
+        std::string error;
+        MessageReader reader(response.payload);
+        reader.read(error);
+
+        throw std::runtime_error("Daemon request failed: " + error);
+    }
+
+    if (response.opcode != opcode) {
+        disconnect();
+        throw DaemonConnectionException("Unexpected response from: " + socket_path.string());
+    }
+
+    set_generation(response.generation);
+
+    if (cacheable) {
+        cache[key] = response.payload;
+    }
+
+    return std::move(response.payload);
+}
+
+template <typename Result, typename... Args> Result EvseSecurityClient::call(Opcode opcode, const Args&... args) {
+    MessageWriter writer;
+    (writer.write(args), ...);
+
+    const std::string payload = transact(opcode, writer.get_data());
+    dispatch_expiries();
+
+    if constexpr (!std::is_void_v<Result>) {
+        Result result;
+        MessageReader reader(payload);
+
+        if (!reader.read(result) || !reader.is_complete()) {
+            throw DaemonConnectionException("Invalid response from: " + socket_path.string());
+        }
+
+        return result;
+    }
+}
+
+InstallCertificateResult EvseSecurityClient::install_ca_certificate(const std::string& certificate,
+                                                                    CaCertificateType certificate_type) {
+    return call<InstallCertificateResult>(Opcode::InstallCaCertificate, certificate, certificate_type);
+}
+
+DeleteCertificateResult EvseSecurityClient::delete_certificate(const CertificateHashData& certificate_hash_data) {
+    return call<DeleteCertificateResult>(Opcode::DeleteCertificate, certificate_hash_data);
+}
+
+CertificateValidationResult EvseSecurityClient::verify_certificate(const std::string& certificate_chain,
+                                                                   const LeafCertificateType certificate_type) {
+    return call<CertificateValidationResult>(Opcode::VerifyCertificate, certificate_chain, certificate_type);
+}
+
+InstallCertificateResult EvseSecurityClient::update_leaf_certificate(const std::string& certificate_chain,
+                                                                     LeafCertificateType certificate_type) {
+    return call<InstallCertificateResult>(Opcode::UpdateLeafCertificate, certificate_chain, certificate_type);
+}
+
+GetInstalledCertificatesResult EvseSecurityClient::get_installed_certificate(CertificateType certificate_type) {
+    return get_installed_certificates({certificate_type});
+}
+
+GetInstalledCertificatesResult
+EvseSecurityClient::get_installed_certificates(const std::vector<CertificateType>& certificate_types) {
+    return call<GetInstalledCertificatesResult>(Opcode::GetInstalledCertificates, certificate_types);
+}
+
+int EvseSecurityClient::get_count_of_installed_certificates(const std::vector<CertificateType>& certificate_types) {
+    return call<std::int32_t>(Opcode::GetCountOfInstalledCertificates, certificate_types);
+}
+
+OCSPRequestDataList EvseSecurityClient::get_v2g_ocsp_request_data() {
+    return call<OCSPRequestDataList>(Opcode::GetV2gOcspRequestData);
+}
+
+OCSPRequestDataList EvseSecurityClient::get_mo_ocsp_request_data(const std::string& certificate_chain) {
+    return call<OCSPRequestDataList>(Opcode::GetMoOcspRequestData, certificate_chain);
+}
+
+void EvseSecurityClient::update_ocsp_cache(const CertificateHashData& certificate_hash_data,
+                                           const std::string& ocsp_response) {
+    call<void>(Opcode::UpdateOcspCache, certificate_hash_data, ocsp_response);
+}
+
+std::optional<fs::path> EvseSecurityClient::retrieve_ocsp_cache(const CertificateHashData& certificate_hash_data) {
+    return call<std::optional<fs::path>>(Opcode::RetrieveOcspCache, certificate_hash_data);
+}
+
+std::optional<OCSPVerdict> EvseSecurityClient::get_ocsp_verdict(const CertificateHashData& certificate_hash_data) {
+    return call<std::optional<OCSPVerdict>>(Opcode::GetOcspVerdict, certificate_hash_data);
+}
+
+InstallCertificateResult EvseSecurityClient::install_crl(const std::string& crl, CaCertificateType certificate_type) {
+    return call<InstallCertificateResult>(Opcode::InstallCrl, crl, certificate_type);
+}
+
+std::optional<std::chrono::system_clock::time_point>
+EvseSecurityClient::get_crl_next_update(CaCertificateType certificate_type) {
+    return call<std::optional<std::chrono::system_clock::time_point>>(Opcode::GetCrlNextUpdate, certificate_type);
+}
+
+bool EvseSecurityClient::is_ca_certificate_installed(CaCertificateType certificate_type) {
+    return call<bool>(Opcode::IsCaCertificateInstalled, certificate_type);
+}
+
+void EvseSecurityClient::certificate_signing_request_failed(const std::string& csr,
+                                                            LeafCertificateType certificate_type) {
+    call<void>(Opcode::CertificateSigningRequestFailed, csr, certificate_type);
+}
+
+GetCertificateSignRequestResult EvseSecurityClient::generate_certificate_signing_request(
+    LeafCertificateType certificate_type, const std::string& country, const std::string& organization,
+    const std::string& common, bool use_custom_provider) {
+    return call<GetCertificateSignRequestResult>(Opcode::GenerateCertificateSigningRequest, certificate_type,
+                                                 country, organization, common, use_custom_provider);
+}
+
+GetCertificateSignRequestResult EvseSecurityClient::generate_certificate_signing_request(
+    LeafCertificateType certificate_type, const std::string& country, const std::string& organization,
+    const std::string& common) {
+    return generate_certificate_signing_request(certificate_type, country, organization, common, false);
+}
+
+GetCertificateInfoResult EvseSecurityClient::get_leaf_certificate_info(LeafCertificateType certificate_type,
+                                                                       EncodingFormat encoding, bool include_ocsp) {
+    return call<GetCertificateInfoResult>(Opcode::GetLeafCertificateInfo, certificate_type, encoding, include_ocsp);
+}
+
+GetCertificateFullInfoResult EvseSecurityClient::get_all_valid_certificates_info(LeafCertificateType certificate_type,
+                                                                                 EncodingFormat encoding,
+                                                                                 bool include_ocsp) {
+    return call<GetCertificateFullInfoResult>(Opcode::GetAllValidCertificatesInfo, certificate_type, encoding,
+                                              include_ocsp);
+}
+
+std::shared_ptr<const OCSPStaplingPayload>
+EvseSecurityClient::get_ocsp_stapling_payload(LeafCertificateType certificate_type) {
+    auto payload = call<std::optional<OCSPStaplingPayload>>(Opcode::GetOcspStaplingPayload, certificate_type);
+
+    if (!payload.has_value()) {
+        return nullptr;
+    }
+
+    return std::make_shared<const OCSPStaplingPayload>(std::move(payload.value()));
+}
+
+bool EvseSecurityClient::update_certificate_links(LeafCertificateType certificate_type) {
+    return call<bool>(Opcode::UpdateCertificateLinks, certificate_type);
+}
+
+std::string EvseSecurityClient::get_verify_file(CaCertificateType certificate_type) {
+    return call<std::string>(Opcode::GetVerifyFile, certificate_type);
+}
+
+std::string EvseSecurityClient::get_verify_location(CaCertificateType certificate_type) {
+    return call<std::string>(Opcode::GetVerifyLocation, certificate_type);
+}
+
+GetCertificateInfoResult EvseSecurityClient::get_ca_certificate_info(CaCertificateType certificate_type) {
+    return call<GetCertificateInfoResult>(Opcode::GetCaCertificateInfo, certificate_type);
+}
+
+int EvseSecurityClient::get_leaf_expiry_days_count(LeafCertificateType certificate_type) {
+    return call<std::int32_t>(Opcode::GetLeafExpiryDaysCount, certificate_type);
+}
+
+void EvseSecurityClient::garbage_collect() {
+    call<void>(Opcode::GarbageCollect);
+}
+
+std::size_t EvseSecurityClient::register_expiry_watch(const std::vector<int>& threshold_days,
+                                                     const std::function<void(const CertificateExpiry&)>& callback) {
+    std::size_t watch_id;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        process_updates();
+
+        watch_id = next_expiry_watch_id++;
+        expiry_watches[watch_id] = {threshold_days, callback};
+
+        try {
+            // A new connection registers all the watches, including this one
+            if (fd < 0 || !send_expiry_watch(watch_id)) {
+                disconnect();
+                connect();
+            }
+        } catch (...) {
+            expiry_watches.erase(watch_id);
+            throw;
+        }
+    }
+
+    // The certificates that already crossed a threshold are notified right after the response
+    process_notifications();
+    return watch_id;
+}
+
+void EvseSecurityClient::unregister_expiry_watch(std::size_t watch_id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (expiry_watches.erase(watch_id) == 0) {
+            return;
+        }
+    }
+
+    try {
+        call<void>(Opcode::UnregisterExpiryWatch, static_cast<std::uint64_t>(watch_id));
+    } catch (const DaemonConnectionException&) {
+        // The daemon removed the watches of the lost connection, and they are not registered again
+    }
+}
+
+void EvseSecurityClient::process_notifications() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        process_updates();
+    }
+
+    dispatch_expiries();
+}
+
+bool EvseSecurityClient::verify_file_signature(const fs::path& path, const std::string& signing_certificate,
+                                               const std::string signature) {
+    return EvseSecurity::verify_file_signature(path, signing_certificate, signature);
+}
+
+std::vector<std::uint8_t> EvseSecurityClient::base64_decode_to_bytes(const std::string& base64_string) {
+    return EvseSecurity::base64_decode_to_bytes(base64_string);
+}
+
+std::string EvseSecurityClient::base64_decode_to_string(const std::string& base64_string) {
+    return EvseSecurity::base64_decode_to_string(base64_string);
+}
+
+std::string EvseSecurityClient::base64_encode_from_bytes(const std::vector<std::uint8_t>& bytes) {
+    return EvseSecurity::base64_encode_from_bytes(bytes);
+}
+
+std::string EvseSecurityClient::base64_encode_from_string(const std::string& string) {
+    return EvseSecurity::base64_encode_from_string(string);
+}
+
+std::uint64_t EvseSecurityClient::get_generation() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    process_updates();
+    return generation;
+}
+
+std::uint64_t EvseSecurityClient::get_cache_hits() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return cache_hits;
+}
+
+} // namespace evse_security
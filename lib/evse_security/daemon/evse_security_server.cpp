@@ -0,0 +1,583 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/daemon/evse_security_server.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <tuple>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security {
+
+using daemon::Message;
+using daemon::MessageReader;
+using daemon::MessageWriter;
+using daemon::Opcode;
+
+namespace {
+
+// Received per client and poll, so that a client sending continuously does not starve the others
+constexpr std::size_t RECEIVE_SIZE = 64 * 1024;
+// Unsent data of a client, over it the client is disconnected
+constexpr std::size_t MAX_OUTPUT_SIZE = 2 * daemon::MAX_MESSAGE_SIZE;
+// Interval of the checks for the changes of the stores made outside the requests
+constexpr std::chrono::milliseconds STORE_CHECK_INTERVAL{1000};
+
+/// @brief Appends the message to the unsent data, false if the client has to be disconnected
+bool queue(std::string& output, const Message& message) {
+    return output.size() < MAX_OUTPUT_SIZE && daemon::append_message(output, message);
+}
+
+/// @brief Sends as much of the unsent data as the socket accepts, false if the connection failed
+bool flush(int fd, std::string& output) {
+    std::size_t offset = 0;
+
+    while (offset < output.size()) {
+        const ssize_t sent = ::send(fd, output.data() + offset, output.size() - offset, MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+
+            break;
+        }
+
+        offset += sent;
+    }
+
+    output.erase(0, offset);
+    return true;
+}
+
+/// @brief Reads the arguments of the API call, calls it and writes its result
+template <typename... Args, typename Function>
+bool handle(MessageReader& reader, MessageWriter& writer, Function function) {
+    std::tuple<Args...> args;
+
+    const bool decoded = std::apply([&reader](auto&... arg) { return (reader.read(arg) && ...); }, args);
+    if (!decoded || !reader.is_complete()) {
+        return false;
+    }
+
+    if constexpr (std::is_void_v<decltype(std::apply(function, args))>) {
+        std::apply(function, args);
+    } else {
+        writer.write(std::apply(function, args));
+    }
+
+    return true;
+}
+
+} // namespace
+
+EvseSecurityServer::EvseSecurityServer(EvseSecurity& security, const fs::path& socket_path,
+                                       std::optional<gid_t> socket_group) :
+    security(security), socket_path(socket_path), socket_group(socket_group) {
+}
+
+EvseSecurityServer::~EvseSecurityServer() {
+    stop();
+}
+
+bool EvseSecurityServer::start() {
+    if (server_thread.joinable()) {
+        return true;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.string().size() >= sizeof(address.sun_path)) {
+        EVLOG_error << "Socket path too long: " << socket_path;
+        return false;
+    }
+
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // A socket left over by a previous instance is replaced, anything else at the path is kept
+    struct stat existing;
+    if (::lstat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            EVLOG_error << "Not a socket, not replacing: " << socket_path;
+            return false;
+        }
+
+        if (::unlink(socket_path.c_str()) != 0) {
+            EVLOG_error << "Could not remove the stale socket: " << socket_path << ": " << std::strerror(errno);
+            return false;
+        }
+    }
+
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        EVLOG_error << "Could not create socket: " << std::strerror(errno);
+        return false;
+    }
+
+    // The permissions are set before listening, no process can connect with the ones from the umask
+    const mode_t mode = socket_group.has_value() ? 0660 : 0600;
+
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        (socket_group.has_value() && ::chown(socket_path.c_str(), -1, socket_group.value()) != 0) ||
+        ::chmod(socket_path.c_str(), mode) != 0 || ::listen(listen_fd, SOMAXCONN) != 0 ||
+        ::pipe2(wake_fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        EVLOG_error << "Could not listen on: " << socket_path << ": " << std::strerror(errno);
+        stop();
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(notifications->mutex);
+        notifications->wake_fd = wake_fds[1];
+    }
+
+    stopping = false;
+    server_thread = std::thread(&EvseSecurityServer::run, this);
+
+    EVSE_LOG_info << "Serving EvseSecurity on: " << socket_path;
+    return true;
+}
+
+void EvseSecurityServer::stop() {
+    if (server_thread.joinable()) {
+        stopping = true;
+        const char wake = 0;
+        [[maybe_unused]] const auto written = ::write(wake_fds[1], &wake, sizeof(wake));
+        server_thread.join();
+    }
+
+    // The callbacks still running no longer queue nor write to the pipe
+    {
+        std::lock_guard<std::mutex> lock(notifications->mutex);
+        notifications->wake_fd = -1;
+        notifications->messages.clear();
+    }
+
+    for (auto& client : clients) {
+        unregister_expiry_watches(client);
+        ::close(client.fd);
+    }
+    clients.clear();
+
+    for (int& fd : wake_fds) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        ::unlink(socket_path.c_str());
+        listen_fd = -1;
+    }
+}
+
+void EvseSecurityServer::run() {
+    std::vector<pollfd> poll_fds;
+
+    is_store_changed();
+    auto next_store_check = std::chrono::steady_clock::now() + STORE_CHECK_INTERVAL;
+
+    for (;;) {
+        poll_fds.clear();
+        poll_fds.push_back({wake_fds[0], POLLIN, 0});
+        poll_fds.push_back({listen_fd, POLLIN, 0});
+
+        for (const auto& client : clients) {
+            // No request is read until the previous responses are sent
+            poll_fds.push_back({client.fd, static_cast<short>(client.output.empty() ? POLLIN : POLLOUT), 0});
+        }
+
+        const auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next_store_check -
+                                                                                   std::chrono::steady_clock::now());
+
+        if (::poll(poll_fds.data(), poll_fds.size(), std::max<int>(0, timeout.count())) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            EVLOG_error << "Server poll failed: " << std::strerror(errno);
+            return;
+        }
+
+        if (poll_fds[0].revents != 0) {
+            char buffer[64];
+            while (::read(wake_fds[0], buffer, sizeof(buffer)) > 0) {
+            }
+
+            if (stopping) {
+                return;
+            }
+        }
+
+        std::vector<int> closed_fds;
+
+        deliver_notifications(closed_fds);
+
+        if (std::chrono::steady_clock::now() >= next_store_check) {
+            if (is_store_changed()) {
+                generation++;
+                push_generation(-1, closed_fds);
+            }
+
+            next_store_check = std::chrono::steady_clock::now() + STORE_CHECK_INTERVAL;
+        }
+
+        for (std::size_t i = 2; i < poll_fds.size(); i++) {
+            auto& client = clients[i - 2];
+
+            if (poll_fds[i].revents == 0 ||
+                std::find(closed_fds.begin(), closed_fds.end(), client.fd) != closed_fds.end()) {
+                continue;
+            }
+
+            if (!serve_client(client, poll_fds[i].revents, closed_fds)) {
+                closed_fds.push_back(client.fd);
+            }
+        }
+
+        for (const int fd : closed_fds) {
+            const auto closed =
+                std::find_if(clients.begin(), clients.end(), [fd](const Client& client) { return client.fd == fd; });
+
+            if (closed != clients.end()) {
+                unregister_expiry_watches(*closed);
+                clients.erase(closed);
+            }
+
+            ::close(fd);
+        }
+
+        if (poll_fds[1].revents & POLLIN) {
+            const int client_fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+            if (client_fd >= 0 && !is_allowed_peer(client_fd)) {
+                EVLOG_warning << "Rejected a client not allowed to use the security daemon";
+                ::close(client_fd);
+            } else if (client_fd >= 0) {
+                clients.push_back({client_fd, next_client_id++, {}, {}});
+            }
+        }
+    }
+}
+
+bool EvseSecurityServer::is_allowed_peer(int fd) const {
+    ucred credentials{};
+    socklen_t size = sizeof(credentials);
+
+    if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0) {
+        return false;
+    }
+
+    return credentials.uid == 0 || credentials.uid == ::geteuid() ||
+           (socket_group.has_value() && credentials.gid == socket_group.value());
+}
+
+bool EvseSecurityServer::serve_client(Client& client, short events, std::vector<int>& out_closed_fds) {
+    if ((events & (POLLIN | POLLOUT)) == 0) {
+        // Error or hang up
+        return false;
+    }
+
+    if (events & POLLIN) {
+        char buffer[RECEIVE_SIZE];
+        const ssize_t received = ::recv(client.fd, buffer, sizeof(buffer), 0);
+
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            return false;
+        }
+
+        if (received > 0) {
+            client.input.append(buffer, received);
+        }
+
+        Message request;
+        daemon::ParseResult result;
+
+        while ((result = daemon::parse_message(client.input, request)) == daemon::ParseResult::Complete) {
+            if (!handle_request(client, request)) {
+                return false;
+            }
+
+            if (daemon::is_modifying(request.opcode)) {
+                push_generation(client.fd, out_closed_fds);
+            }
+
+            // The certificates that already crossed a threshold are notified right after the response
+            if (request.opcode == Opcode::RegisterExpiryWatch) {
+                deliver_notifications(out_closed_fds);
+            }
+        }
+
+        if (result == daemon::ParseResult::Invalid) {
+            return false;
+        }
+    }
+
+    return flush(client.fd, client.output);
+}
+
+bool EvseSecurityServer::handle_request(Client& client, const Message& request) {
+    Message response{request.opcode, 0, {}};
+    MessageReader reader(request.payload);
+    MessageWriter writer;
+
+    try {
+        if (request.opcode == Opcode::Hello) {
+            std::uint32_t version;
+
+            if (!reader.read(version) || version != daemon::PROTOCOL_VERSION) {
+                response.opcode = Opcode::Error;
+                writer.write(std::string("Unsupported protocol version"));
+            } else {
+                writer.write(daemon::PROTOCOL_VERSION);
+            }
+        } else if (request.opcode == Opcode::RegisterExpiryWatch || request.opcode == Opcode::UnregisterExpiryWatch) {
+            if (!handle_expiry_watch(client, request.opcode, reader)) {
+                response.opcode = Opcode::Error;
+                writer.write(std::string("Invalid request"));
+            }
+        } else if (!dispatch(request.opcode, reader, writer)) {
+            response.opcode = Opcode::Error;
+            writer = MessageWriter();
+            writer.write(std::string("Invalid request"));
+        }
+    } catch (const std::exception& e) {
+        // Thrown by the API, e.g. on invalid arguments
+        response.opcode = Opcode::Error;
+        writer = MessageWriter();
+        writer.write(std::string(e.what()));
+    }
+
+    // The caller receives the new generation with its response, the others by the push. The changes of the request
+    // are not reported again by the next check
+    if (daemon::is_modifying(request.opcode)) {
+        generation++;
+        is_store_changed();
+    }
+
+    response.generation = generation;
+    response.payload = writer.get_data();
+
+    return queue(client.output, response);
+}
+
+void EvseSecurityServer::push_generation(int except_fd, std::vector<int>& out_failed_fds) {
+    const Message update{Opcode::GenerationUpdate, generation, {}};
+
+    for (auto& client : clients) {
+        if (client.fd == except_fd ||
+            std::find(out_failed_fds.begin(), out_failed_fds.end(), client.fd) != out_failed_fds.end()) {
+            continue;
+        }
+
+        // Sent once the client can receive, a client that does not read its socket is disconnected once its
+        // buffer is full, it reconnects
+        if (!queue(client.output, update)) {
+            out_failed_fds.push_back(client.fd);
+        }
+    }
+}
+
+bool EvseSecurityServer::handle_expiry_watch(Client& client, Opcode opcode, MessageReader& reader) {
+    std::uint64_t client_watch_id;
+    std::vector<std::int32_t> threshold_days;
+
+    if (!reader.read(client_watch_id) || (opcode == Opcode::RegisterExpiryWatch && !reader.read(threshold_days)) ||
+        !reader.is_complete()) {
+        return false;
+    }
+
+    // A watch registered again, e.g. after a lost response, replaces the previous one
+    if (const auto existing = client.expiry_watches.find(client_watch_id); existing != client.expiry_watches.end()) {
+        security.unregister_expiry_watch(existing->second);
+        client.expiry_watches.erase(existing);
+    }
+
+    if (opcode == Opcode::UnregisterExpiryWatch) {
+        return true;
+    }
+
+    client.expiry_watches[client_watch_id] = security.register_expiry_watch(
+        std::vector<int>(threshold_days.begin(), threshold_days.end()),
+        [notifications = this->notifications, client_id = client.id, client_watch_id](const CertificateExpiry& expiry) {
+            MessageWriter writer;
+            writer.write(client_watch_id);
+            writer.write(expiry);
+
+            std::lock_guard<std::mutex> lock(notifications->mutex);
+            if (notifications->wake_fd < 0) {
+                return;
+            }
+
+            notifications->messages.push_back({client_id, Message{Opcode::ExpiryNotification, 0, writer.get_data()}});
+
+            // Non-blocking, a full pipe wakes up the server already
+            const char wake = 0;
+            [[maybe_unused]] const auto written = ::write(notifications->wake_fd, &wake, sizeof(wake));
+        });
+
+    return true;
+}
+
+void EvseSecurityServer::unregister_expiry_watches(Client& client) {
+    for (const auto& [client_watch_id, watch_id] : client.expiry_watches) {
+        security.unregister_expiry_watch(watch_id);
+    }
+
+    client.expiry_watches.clear();
+}
+
+void EvseSecurityServer::deliver_notifications(std::vector<int>& out_failed_fds) {
+    std::vector<std::pair<std::uint64_t, Message>> messages;
+
+    {
+        std::lock_guard<std::mutex> lock(notifications->mutex);
+        messages.swap(notifications->messages);
+    }
+
+    for (auto& [client_id, message] : messages) {
+        const auto client = std::find_if(clients.begin(), clients.end(),
+                                         [id = client_id](const Client& client) { return client.id == id; });
+
+        // Disconnected since the notification was queued
+        if (client == clients.end() ||
+            std::find(out_failed_fds.begin(), out_failed_fds.end(), client->fd) != out_failed_fds.end()) {
+            continue;
+        }
+
+        message.generation = generation;
+
+        if (!queue(client->output, message)) {
+            out_failed_fds.push_back(client->fd);
+        }
+    }
+}
+
+bool EvseSecurityServer::is_store_changed() {
+    const auto current = security.get_store_generation();
+    const bool changed = !current.has_value() || current != store_generation;
+
+    store_generation = current;
+    return changed;
+}
+
+bool EvseSecurityServer::dispatch(Opcode opcode, MessageReader& reader, MessageWriter& writer) {
+    switch (opcode) {
+    case Opcode::InstallCaCertificate:
+        return handle<std::string, CaCertificateType>(reader, writer, [this](const auto& certificate, auto type) {
+            return security.install_ca_certificate(certificate, type);
+        });
+    case Opcode::DeleteCertificate:
+        return handle<CertificateHashData>(
+            reader, writer, [this](const auto& hash_data) { return security.delete_certificate(hash_data); });
+    case Opcode::VerifyCertificate:
+        return handle<std::string, LeafCertificateType>(reader, writer, [this](const auto& chain, auto type) {
+            return security.verify_certificate(chain, type);
+        });
+    case Opcode::UpdateLeafCertificate:
+        return handle<std::string, LeafCertificateType>(reader, writer, [this](const auto& chain, auto type) {
+            return security.update_leaf_certificate(chain, type);
+        });
+    case Opcode::GetInstalledCertificates:
+        return handle<std::vector<CertificateType>>(
+            reader, writer, [this](const auto& types) { return security.get_installed_certificates(types); });
+    case Opcode::GetCountOfInstalledCertificates:
+        return handle<std::vector<CertificateType>>(reader, writer, [this](const auto& types) {
+            return static_cast<std::int32_t>(security.get_count_of_installed_certificates(types));
+        });
+    case Opcode::GetV2gOcspRequestData:
+        return handle<>(reader, writer, [this]() { return security.get_v2g_ocsp_request_data(); });
+    case Opcode::GetMoOcspRequestData:
+        return handle<std::string>(reader, writer,
+                                   [this](const auto& chain) { return security.get_mo_ocsp_request_data(chain); });
+    case Opcode::UpdateOcspCache:
+        return handle<CertificateHashData, std::string>(
+            reader, writer,
+            [this](const auto& hash_data, const auto& response) { security.update_ocsp_cache(hash_data, response); });
+    case Opcode::RetrieveOcspCache:
+        return handle<CertificateHashData>(
+            reader, writer, [this](const auto& hash_data) { return security.retrieve_ocsp_cache(hash_data); });
+    case Opcode::IsCaCertificateInstalled:
+        return handle<CaCertificateType>(reader, writer,
+                                         [this](auto type) { return security.is_ca_certificate_installed(type); });
+    case Opcode::CertificateSigningRequestFailed:
+        return handle<std::string, LeafCertificateType>(reader, writer, [this](const auto& csr, auto type) {
+            security.certificate_signing_request_failed(csr, type);
+        });
+    case Opcode::GenerateCertificateSigningRequest:
+        return handle<LeafCertificateType, std::string, std::string, std::string, bool>(
+            reader, writer,
+            [this](auto type, const auto& country, const auto& organization, const auto& common,
+                   bool use_custom_provider) {
+                return security.generate_certificate_signing_request(type, country, organization, common,
+                                                                     use_custom_provider);
+            });
+    case Opcode::GetLeafCertificateInfo:
+        return handle<LeafCertificateType, EncodingFormat, bool>(
+            reader, writer, [this](auto type, auto encoding, bool include_ocsp) {
+                return security.get_leaf_certificate_info(type, encoding, include_ocsp);
+            });
+    case Opcode::GetAllValidCertificatesInfo:
+        return handle<LeafCertificateType, EncodingFormat, bool>(
+            reader, writer, [this](auto type, auto encoding, bool include_ocsp) {
+                return security.get_all_valid_certificates_info(type, encoding, include_ocsp);
+            });
+    case Opcode::UpdateCertificateLinks:
+        return handle<LeafCertificateType>(reader, writer,
+                                           [this](auto type) { return security.update_certificate_links(type); });
+    case Opcode::GetVerifyFile:
+        return handle<CaCertificateType>(reader, writer, [this](auto type) { return security.get_verify_file(type); });
+    case Opcode::GetVerifyLocation:
+        return handle<CaCertificateType>(reader, writer,
+                                         [this](auto type) { return security.get_verify_location(type); });
+    case Opcode::GetCaCertificateInfo:
+        return handle<CaCertificateType>(reader, writer,
+                                         [this](auto type) { return security.get_ca_certificate_info(type); });
+    case Opcode::GetLeafExpiryDaysCount:
+        return handle<LeafCertificateType>(reader, writer, [this](auto type) {
+            return static_cast<std::int32_t>(security.get_leaf_expiry_days_count(type));
+        });
+    case Opcode::GarbageCollect:
+        return handle<>(reader, writer, [this]() { security.garbage_collect(); });
+    case Opcode::InstallCrl:
+        return handle<std::string, CaCertificateType>(
+            reader, writer, [this](const auto& crl, auto type) { return security.install_crl(crl, type); });
+    case Opcode::GetCrlNextUpdate:
+        return handle<CaCertificateType>(reader, writer,
+                                         [this](auto type) { return security.get_crl_next_update(type); });
+    case Opcode::GetOcspStaplingPayload:
+        return handle<LeafCertificateType>(reader, writer, [this](auto type) {
+            std::optional<OCSPStaplingPayload> payload;
+            if (const auto shared_payload = security.get_ocsp_stapling_payload(type)) {
+                payload = *shared_payload;
+            }
+            return payload;
+        });
+    case Opcode::GetOcspVerdict:
+        return handle<CertificateHashData>(
+            reader, writer, [this](const auto& certificate_hash_data) {
+                return security.get_ocsp_verdict(certificate_hash_data);
+            });
+    default:
+        return false;
+    }
+}
+
+} // namespace evse_security
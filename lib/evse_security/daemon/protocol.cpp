@@ -0,0 +1,443 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/daemon/protocol.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace evse_security::daemon {
+
+bool is_modifying(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::InstallCaCertificate:
+    case Opcode::DeleteCertificate:
+    case Opcode::UpdateLeafCertificate:
+    case Opcode::UpdateOcspCache:
+    case Opcode::CertificateSigningRequestFailed:
+    case Opcode::GenerateCertificateSigningRequest:
+    case Opcode::UpdateCertificateLinks:
+    case Opcode::GarbageCollect:
+    case Opcode::InstallCrl:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool is_cacheable(Opcode opcode) {
+    switch (opcode) {
+    case Opcode::GetCountOfInstalledCertificates:
+    case Opcode::RetrieveOcspCache:
+    case Opcode::GetVerifyLocation:
+    case Opcode::GetCrlNextUpdate:
+    case Opcode::GetOcspVerdict:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool send_all(int fd, const char* data, std::size_t size, int flags) {
+    while (size > 0) {
+        // No SIGPIPE if the peer is gone
+        const ssize_t sent = ::send(fd, data, size, flags | MSG_NOSIGNAL);
+
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += sent;
+        size -= sent;
+    }
+
+    return true;
+}
+
+static bool receive_all(int fd, char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t received = ::recv(fd, data, size, 0);
+
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (received <= 0) {
+            return false;
+        }
+
+        data += received;
+        size -= received;
+    }
+
+    return true;
+}
+
+/// @brief Decodes the header, false if the payload size is over the limit
+static bool decode_header(const char* header, Message& out_message, std::uint32_t& out_size) {
+    std::uint16_t opcode;
+    std::memcpy(&out_size, header, sizeof(out_size));
+    std::memcpy(&opcode, header + sizeof(out_size), sizeof(opcode));
+    std::memcpy(&out_message.generation, header + sizeof(out_size) + sizeof(opcode), sizeof(out_message.generation));
+
+    out_message.opcode = static_cast<Opcode>(opcode);
+    return out_size <= MAX_MESSAGE_SIZE;
+}
+
+bool append_message(std::string& buffer, const Message& message) {
+    if (message.payload.size() > MAX_MESSAGE_SIZE) {
+        return false;
+    }
+
+    const auto size = static_cast<std::uint32_t>(message.payload.size());
+    const auto opcode = static_cast<std::uint16_t>(message.opcode);
+
+    buffer.reserve(buffer.size() + MESSAGE_HEADER_SIZE + message.payload.size());
+    buffer.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    buffer.append(reinterpret_cast<const char*>(&opcode), sizeof(opcode));
+    buffer.append(reinterpret_cast<const char*>(&message.generation), sizeof(message.generation));
+    buffer.append(message.payload);
+
+    return true;
+}
+
+ParseResult parse_message(std::string& buffer, Message& out_message) {
+    if (buffer.size() < MESSAGE_HEADER_SIZE) {
+        return ParseResult::Incomplete;
+    }
+
+    std::uint32_t size;
+    if (!decode_header(buffer.data(), out_message, size)) {
+        return ParseResult::Invalid;
+    }
+
+    if (buffer.size() - MESSAGE_HEADER_SIZE < size) {
+        return ParseResult::Incomplete;
+    }
+
+    out_message.payload.assign(buffer, MESSAGE_HEADER_SIZE, size);
+    buffer.erase(0, MESSAGE_HEADER_SIZE + size);
+
+    return ParseResult::Complete;
+}
+
+bool send_message(int fd, const Message& message, bool wait) {
+    // Header and payload in one write, so that the pushed updates are never interleaved with a partial message
+    std::string buffer;
+
+    if (!append_message(buffer, message)) {
+        return false;
+    }
+
+    return send_all(fd, buffer.data(), buffer.size(), wait ? 0 : MSG_DONTWAIT);
+}
+
+bool receive_message(int fd, Message& out_message) {
+    char header[MESSAGE_HEADER_SIZE];
+
+    if (!receive_all(fd, header, sizeof(header))) {
+        return false;
+    }
+
+    std::uint32_t size;
+    if (!decode_header(header, out_message, size)) {
+        return false;
+    }
+
+    out_message.payload.resize(size);
+
+    return receive_all(fd, out_message.payload.data(), size);
+}
+
+void MessageWriter::write_raw(const void* value, std::size_t size) {
+    data.append(static_cast<const char*>(value), size);
+}
+
+void MessageWriter::write(bool value) {
+    const std::uint8_t raw = value ? 1 : 0;
+    write_raw(&raw, sizeof(raw));
+}
+
+void MessageWriter::write(std::int32_t value) {
+    write_raw(&value, sizeof(value));
+}
+
+void MessageWriter::write(std::uint32_t value) {
+    write_raw(&value, sizeof(value));
+}
+
+void MessageWriter::write(std::uint64_t value) {
+    write_raw(&value, sizeof(value));
+}
+
+void MessageWriter::write(const std::string& value) {
+    write(static_cast<std::uint32_t>(value.size()));
+    write_raw(value.data(), value.size());
+}
+
+void MessageWriter::write(const fs::path& value) {
+    write(value.string());
+}
+
+void MessageWriter::write(const std::chrono::system_clock::time_point& value) {
+    // Seconds since epoch
+    write(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(value.time_since_epoch()).count()));
+}
+
+void MessageWriter::write(const CertificateHashData& value) {
+    write(value.hash_algorithm);
+    write(value.issuer_name_hash);
+    write(value.issuer_key_hash);
+    write(value.serial_number);
+}
+
+void MessageWriter::write(const CertificateHashDataChain& value) {
+    write(value.certificate_type);
+    write(value.certificate_hash_data);
+    write(value.child_certificate_hash_data);
+}
+
+void MessageWriter::write(const GetInstalledCertificatesResult& value) {
+    write(value.status);
+    write(value.certificate_hash_data_chain);
+}
+
+void MessageWriter::write(const OCSPRequestData& value) {
+    write(value.certificate_hash_data);
+    write(value.responder_url);
+}
+
+void MessageWriter::write(const OCSPRequestDataList& value) {
+    write(value.ocsp_request_data_list);
+}
+
+void MessageWriter::write(const CertificateOCSP& value) {
+    write(value.hash);
+    write(value.ocsp_path);
+}
+
+void MessageWriter::write(const CertificateInfo& value) {
+    write(value.key);
+    write(value.certificate_root);
+    write(value.certificate);
+    write(value.certificate_single);
+    write(static_cast<std::int32_t>(value.certificate_count));
+    write(value.password);
+    write(value.ocsp);
+}
+
+void MessageWriter::write(const CertificateExpiry& value) {
+    // The variant as a leaf flag and the enum of the alternative
+    const auto* leaf_type = std::get_if<LeafCertificateType>(&value.certificate_type);
+    write(leaf_type != nullptr);
+
+    if (leaf_type != nullptr) {
+        write(*leaf_type);
+    } else {
+        write(std::get<CaCertificateType>(value.certificate_type));
+    }
+
+    write(value.not_after);
+    write(static_cast<std::int32_t>(value.days_left));
+    write(static_cast<std::int32_t>(value.threshold_days));
+}
+
+void MessageWriter::write(const GetCertificateInfoResult& value) {
+    write(value.status);
+    write(value.info);
+}
+
+void MessageWriter::write(const GetCertificateFullInfoResult& value) {
+    write(value.status);
+    write(value.info);
+}
+
+void MessageWriter::write(const GetCertificateSignRequestResult& value) {
+    write(value.status);
+    write(value.csr);
+}
+
+void MessageWriter::write(const OCSPVerdict& value) {
+    write(value.status);
+    write(value.next_update);
+}
+
+void MessageWriter::write(const OCSPStaplingPayload& value) {
+    write(value.certificate);
+    write(value.ocsp);
+}
+
+bool MessageReader::read_raw(void* value, std::size_t size) {
+    if (!valid || size > data.size() - offset) {
+        valid = false;
+        return false;
+    }
+
+    std::memcpy(value, data.data() + offset, size);
+    offset += size;
+
+    return true;
+}
+
+bool MessageReader::read(bool& value) {
+    std::uint8_t raw;
+
+    if (!read_raw(&raw, sizeof(raw))) {
+        return false;
+    }
+
+    value = (raw != 0);
+    return true;
+}
+
+bool MessageReader::read(std::int32_t& value) {
+    return read_raw(&value, sizeof(value));
+}
+
+bool MessageReader::read(std::uint32_t& value) {
+    return read_raw(&value, sizeof(value));
+}
+
+bool MessageReader::read(std::uint64_t& value) {
+    return read_raw(&value, sizeof(value));
+}
+
+bool MessageReader::read(std::string& value) {
+    std::uint32_t size;
+
+    if (!read(size) || size > data.size() - offset) {
+        valid = false;
+        return false;
+    }
+
+    value.assign(data, offset, size);
+    offset += size;
+
+    return true;
+}
+
+bool MessageReader::read(fs::path& value) {
+    std::string path;
+
+    if (!read(path)) {
+        return false;
+    }
+
+    value = path;
+    return true;
+}
+
+bool MessageReader::read(std::chrono::system_clock::time_point& value) {
+    std::uint64_t seconds;
+
+    if (!read(seconds)) {
+        return false;
+    }
+
+    value = std::chrono::system_clock::time_point(std::chrono::seconds(seconds));
+    return true;
+}
+
+bool MessageReader::read(CertificateHashData& value) {
+    return read(value.hash_algorithm) && read(value.issuer_name_hash) && read(value.issuer_key_hash) &&
+           read(value.serial_number);
+}
+
+bool MessageReader::read(CertificateHashDataChain& value) {
+    return read(value.certificate_type) && read(value.certificate_hash_data) &&
+           read(value.child_certificate_hash_data);
+}
+
+bool MessageReader::read(GetInstalledCertificatesResult& value) {
+    return read(value.status) && read(value.certificate_hash_data_chain);
+}
+
+bool MessageReader::read(OCSPRequestData& value) {
+    return read(value.certificate_hash_data) && read(value.responder_url);
+}
+
+bool MessageReader::read(OCSPRequestDataList& value) {
+    return read(value.ocsp_request_data_list);
+}
+
+bool MessageReader::read(CertificateOCSP& value) {
+    return read(value.hash) && read(value.ocsp_path);
+}
+
+bool MessageReader::read(CertificateInfo& value) {
+    std::int32_t certificate_count;
+
+    if (!(read(value.key) && read(value.certificate_root) && read(value.certificate) &&
+          read(value.certificate_single) && read(certificate_count) && read(value.password) && read(value.ocsp))) {
+        return false;
+    }
+
+    value.certificate_count = certificate_count;
+    return true;
+}
+
+bool MessageReader::read(GetCertificateInfoResult& value) {
+    return read(value.status) && read(value.info);
+}
+
+bool MessageReader::read(GetCertificateFullInfoResult& value) {
+    return read(value.status) && read(value.info);
+}
+
+bool MessageReader::read(GetCertificateSignRequestResult& value) {
+    return read(value.status) && read(value.csr);
+}
+
+bool MessageReader::read(OCSPVerdict& value) {
+    return read(value.status) && read(value.next_update);
+}
+
+bool MessageReader::read(OCSPStaplingPayload& value) {
+    return read(value.certificate) && read(value.ocsp);
+}
+
+bool MessageReader::read(CertificateExpiry& value) {
+    bool is_leaf;
+
+    if (!read(is_leaf)) {
+        return false;
+    }
+
+    if (is_leaf) {
+        LeafCertificateType leaf_type;
+
+        if (!read(leaf_type)) {
+            return false;
+        }
+
+        value.certificate_type = leaf_type;
+    } else {
+        CaCertificateType ca_type;
+
+        if (!read(ca_type)) {
+            return false;
+        }
+
+        value.certificate_type = ca_type;
+    }
+
+    std::int32_t days_left;
+    std::int32_t threshold_days;
+
+    if (!read(value.not_after) || !read(days_left) || !read(threshold_days)) {
+        return false;
+    }
+
+    value.days_left = days_left;
+    value.threshold_days = threshold_days;
+    return true;
+}
+
+} // namespace evse_security::daemon
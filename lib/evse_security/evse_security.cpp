@@ -1,30 +1,65 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright Pionix GmbH and Contributors to EVerest
 
-#include <everest/logging.hpp>
+#include <evse_security/utils/evse_logging.hpp>
 
 #include <evse_security/evse_security.hpp>
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <set>
+#include <sstream>
 #include <stdio.h>
 
 #include <cert_rehash/c_rehash.hpp>
 
 #include <evse_security/certificate/x509_bundle.hpp>
 #include <evse_security/certificate/x509_hierarchy.hpp>
+#include <evse_security/certificate/x509_trust_index.hpp>
 #include <evse_security/certificate/x509_wrapper.hpp>
+#include <evse_security/storage/posix_storage.hpp>
 #include <evse_security/utils/evse_filesystem.hpp>
 
 namespace evse_security {
 
+static bool is_same_status(const StorageStatus& a, const StorageStatus& b) {
+    return a.type == b.type && a.size == b.size && a.modification_time == b.modification_time &&
+           a.device == b.device && a.inode == b.inode;
+}
+
+static void append_store_status(const fs::path& location, std::vector<StorageStatus>& out_status) {
+    out_status.push_back(get_active_storage().stat(location));
+
+    if (out_status.back().type == StorageEntryType::Directory) {
+        std::vector<std::pair<fs::path, StorageStatus>> entries;
+        filesystem_utils::list_file_entries(location, true, entries);
+
+        for (const auto& [file, file_status] : entries) {
+            out_status.push_back(file_status);
+        }
+    }
+}
+
+static bool is_same_store_status(const std::vector<StorageStatus>& a, const std::vector<StorageStatus>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), is_same_status);
+}
+
+static std::string to_revocation_key(const std::string& issuer_name_hash, const std::string& serial_number) {
+    return issuer_name_hash + ":" + serial_number;
+}
+
+static std::string to_ocsp_key(const CertificateHashData& hash_data) {
+    return std::to_string(static_cast<int>(hash_data.hash_algorithm)) + ":" + hash_data.issuer_name_hash + ":" +
+           hash_data.issuer_key_hash + ":" + hash_data.serial_number;
+}
+
 static InstallCertificateResult to_install_certificate_result(CertificateValidationResult error) {
     switch (error) {
     case CertificateValidationResult::Valid:
-        EVLOG_info << "Certificate accepted";
+        EVSE_LOG_info << "Certificate accepted";
         return InstallCertificateResult::Accepted;
     case CertificateValidationResult::Expired:
         EVLOG_warning << "Certificate has expired";
@@ -41,6 +76,9 @@ static InstallCertificateResult to_install_certificate_result(CertificateValidat
     case CertificateValidationResult::IssuerNotFound:
         EVLOG_warning << "Issuer not found";
         return InstallCertificateResult::NoRootCertificateInstalled;
+    case CertificateValidationResult::Revoked:
+        EVLOG_warning << "Certificate revoked";
+        return InstallCertificateResult::InvalidCertificateChain;
     default:
         return InstallCertificateResult::InvalidFormat;
     }
@@ -81,7 +119,7 @@ static CertificateType get_certificate_type(const CaCertificateType ca_certifica
 }
 
 static bool is_keyfile(const fs::path& file_path) {
-    if (fs::is_regular_file(file_path)) {
+    if (filesystem_utils::is_regular_file(file_path)) {
         if (file_path.has_extension()) {
             auto extension = file_path.extension();
             if (extension == KEY_EXTENSION || extension == CUSTOM_KEY_EXTENSION) {
@@ -103,41 +141,38 @@ static fs::path get_private_key_path_of_certificate(const X509Wrapper& certifica
             fs::path potential_keyfile = certificate.get_file().value();
             potential_keyfile.replace_extension(extension);
 
-            if (fs::exists(potential_keyfile)) {
+            if (filesystem_utils::exists(potential_keyfile)) {
                 try {
-                    std::string private_key;
-
-                    if (filesystem_utils::read_from_file(potential_keyfile, private_key)) {
+                    if (const auto private_key = filesystem_utils::read_shared_from_file(potential_keyfile)) {
                         if (KeyValidationResult::Valid ==
-                            CryptoSupplier::x509_check_private_key(certificate.get(), private_key, password)) {
-                            EVLOG_debug << "Key found for certificate at path: " << potential_keyfile;
+                            CryptoSupplier::x509_check_private_key(certificate.get(), *private_key, password)) {
+                            EVSE_LOG_debug << "Key found for certificate at path: " << potential_keyfile;
                             return potential_keyfile;
                         }
                     }
                 } catch (const std::exception& e) {
-                    EVLOG_debug << "Could not load or verify private key at: " << potential_keyfile << ": " << e.what();
+                    EVSE_LOG_debug << "Could not load or verify private key at: " << potential_keyfile << ": "
+                                   << e.what();
                 }
             }
         }
     }
 
-    for (const auto& entry : fs::recursive_directory_iterator(key_path_directory)) {
-        if (fs::is_regular_file(entry)) {
-            auto key_file_path = entry.path();
-            if (is_keyfile(key_file_path)) {
-                try {
-                    std::string private_key;
+    std::vector<fs::path> key_directory_files;
+    filesystem_utils::list_files(key_path_directory, true, key_directory_files);
 
-                    if (filesystem_utils::read_from_file(key_file_path, private_key)) {
-                        if (KeyValidationResult::Valid ==
-                            CryptoSupplier::x509_check_private_key(certificate.get(), private_key, password)) {
-                            EVLOG_debug << "Key found for certificate at path: " << key_file_path;
-                            return key_file_path;
-                        }
+    for (const auto& key_file_path : key_directory_files) {
+        if (is_keyfile(key_file_path)) {
+            try {
+                if (const auto private_key = filesystem_utils::read_shared_from_file(key_file_path)) {
+                    if (KeyValidationResult::Valid ==
+                        CryptoSupplier::x509_check_private_key(certificate.get(), *private_key, password)) {
+                        EVSE_LOG_debug << "Key found for certificate at path: " << key_file_path;
+                        return key_file_path;
                     }
-                } catch (const std::exception& e) {
-                    EVLOG_debug << "Could not load or verify private key at: " << key_file_path << ": " << e.what();
                 }
+            } catch (const std::exception& e) {
+                EVSE_LOG_debug << "Could not load or verify private key at: " << key_file_path << ": " << e.what();
             }
         }
     }
@@ -165,7 +200,7 @@ static std::set<fs::path> get_certificate_path_of_key(const fs::path& key, const
     fs::path cert_filename = key;
     cert_filename.replace_extension(PEM_EXTENSION);
 
-    if (fs::exists(cert_filename)) {
+    if (filesystem_utils::exists(cert_filename)) {
         try {
             std::set<fs::path> bundles;
             X509CertificateBundle certificate_bundles(cert_filename, EncodingFormat::PEM);
@@ -187,7 +222,8 @@ static std::set<fs::path> get_certificate_path_of_key(const fs::path& key, const
                 return bundles;
             }
         } catch (const CertificateLoadException& e) {
-            EVLOG_debug << "Could not load certificate bundle at: " << certificate_path_directory << ": " << e.what();
+            EVSE_LOG_debug << "Could not load certificate bundle at: " << certificate_path_directory << ": "
+                           << e.what();
         }
     }
 
@@ -211,7 +247,7 @@ static std::set<fs::path> get_certificate_path_of_key(const fs::path& key, const
             return bundles;
         }
     } catch (const CertificateLoadException& e) {
-        EVLOG_debug << "Could not load certificate bundle at: " << certificate_path_directory << ": " << e.what();
+        EVSE_LOG_debug << "Could not load certificate bundle at: " << certificate_path_directory << ": " << e.what();
     }
 
     std::string error = "Could not find certificate for given private key: ";
@@ -223,18 +259,141 @@ static std::set<fs::path> get_certificate_path_of_key(const fs::path& key, const
 }
 
 // Declared here to avoid requirement of X509Wrapper include in header
-static OCSPRequestDataList get_ocsp_request_data_internal(fs::path& root_path, std::vector<X509Wrapper>& leaf_chain);
+static OCSPRequestDataList get_ocsp_request_data_internal(X509CertificateBundle& root_bundle,
+                                                          std::vector<X509Wrapper>& leaf_chain);
+
+/// @brief Returns the journal of the leaf key directory that contains the provided key
+static fs::path get_managed_csr_journal_path(const DirectoryPaths& directories, const fs::path& key_path) {
+    for (const auto& key_directory : {directories.csms_leaf_key_directory, directories.secc_leaf_key_directory}) {
+        const auto journal_path = (key_directory / MANAGED_CSR_JOURNAL_FILE).lexically_normal();
+        const auto relative = key_path.lexically_normal().lexically_relative(journal_path.parent_path());
+
+        if (!relative.empty() && *relative.begin() != "..") {
+            return journal_path;
+        }
+    }
+
+    return (key_path.parent_path() / MANAGED_CSR_JOURNAL_FILE).lexically_normal();
+}
+
+/// @brief Builds a journal line, 'add <created> <key hash> <path>' for an entry or 'del <path>' for a removal
+static std::string get_managed_csr_record(const fs::path& key_path, const ManagedCsr* entry) {
+    std::stringstream record;
+
+    if (entry != nullptr) {
+        record << "add "
+               << std::chrono::duration_cast<std::chrono::seconds>(entry->created.time_since_epoch()).count() << " "
+               << (entry->key_hash.empty() ? "-" : entry->key_hash) << " " << key_path.string() << "\n";
+    } else {
+        record << "del " << key_path.string() << "\n";
+    }
+
+    return record.str();
+}
+
+/// @brief Returns the target of the symlink, empty if it is not a symlink
+static fs::path read_symlink_target(const fs::path& link) {
+    fs::path target;
+    get_active_storage().read_symlink(link, target);
+    return target;
+}
+
+// Lock shards of the store, one per certificate domain, at their index in 'get_store_shards'. An entry point locks
+// the shards of the directories it accesses, the operations of disjoint domains (e.g. an ISO 15118 handshake and an
+// OCPP TLS connection) run in parallel
+static constexpr PathShards V2G_CA_SHARD = 1 << 0;
+static constexpr PathShards MO_CA_SHARD = 1 << 1;
+static constexpr PathShards CSMS_CA_SHARD = 1 << 2;
+static constexpr PathShards MF_CA_SHARD = 1 << 3;
+static constexpr PathShards SECC_LEAF_SHARD = 1 << 4;
+static constexpr PathShards CSMS_LEAF_SHARD = 1 << 5;
+
+static constexpr PathShards CA_SHARDS = V2G_CA_SHARD | MO_CA_SHARD | CSMS_CA_SHARD | MF_CA_SHARD;
+// The V2G OCSP cache is kept with the V2G roots and the SECC leafs
+static constexpr PathShards V2G_OCSP_SHARDS = V2G_CA_SHARD | SECC_LEAF_SHARD;
+
+/// @brief Directory of the CA bundle at @p location, with its OCSP cache and revocation list: the bundle directory
+/// itself, or the directory of a bundle file (also if it does not exist yet, it is created as a file)
+static fs::path get_bundle_directory(CertificateStorage& storage, const fs::path& location) {
+    return storage.stat(location).type == StorageEntryType::Directory ? location : location.parent_path();
+}
+
+/// @brief Directories of each lock shard: the directories of the bundles (with their OCSP caches and revocation
+/// lists), the leaf directories and the directories of the links
+static std::vector<std::vector<fs::path>> get_store_shards(const FilePaths& file_paths, CertificateStorage& storage) {
+    return {
+        {get_bundle_directory(storage, file_paths.v2g_ca_bundle)},
+        {get_bundle_directory(storage, file_paths.mo_ca_bundle)},
+        {get_bundle_directory(storage, file_paths.csms_ca_bundle)},
+        {get_bundle_directory(storage, file_paths.mf_ca_bundle)},
+        {file_paths.directories.secc_leaf_cert_directory, file_paths.directories.secc_leaf_key_directory,
+         file_paths.links.secc_leaf_cert_link.parent_path(), file_paths.links.secc_leaf_key_link.parent_path(),
+         file_paths.links.cpo_cert_chain_link.parent_path()},
+        {file_paths.directories.csms_leaf_cert_directory, file_paths.directories.csms_leaf_key_directory},
+    };
+}
+
+static PathShards get_ca_shard(CaCertificateType certificate_type) {
+    switch (certificate_type) {
+    case CaCertificateType::V2G:
+        return V2G_CA_SHARD;
+    case CaCertificateType::MO:
+        return MO_CA_SHARD;
+    case CaCertificateType::CSMS:
+        return CSMS_CA_SHARD;
+    case CaCertificateType::MF:
+        return MF_CA_SHARD;
+    default:
+        return CA_SHARDS;
+    }
+}
+
+/// @brief Shards of the leafs of @p certificate_type and of the CA bundle they are verified against
+static PathShards get_leaf_shards(LeafCertificateType certificate_type) {
+    switch (certificate_type) {
+    case LeafCertificateType::CSMS:
+        return CSMS_LEAF_SHARD | CSMS_CA_SHARD;
+    case LeafCertificateType::V2G:
+        return SECC_LEAF_SHARD | V2G_CA_SHARD;
+    case LeafCertificateType::MF:
+        return MF_CA_SHARD;
+    case LeafCertificateType::MO:
+        return MO_CA_SHARD;
+    default:
+        return ALL_PATH_SHARDS;
+    }
+}
+
+static PathShards get_installed_shards(const std::vector<CertificateType>& certificate_types) {
+    PathShards shards = 0;
+
+    for (const auto& ca_certificate_type : get_ca_certificate_types(certificate_types)) {
+        shards |= get_ca_shard(ca_certificate_type);
+    }
+
+    if (std::find(certificate_types.begin(), certificate_types.end(), CertificateType::V2GCertificateChain) !=
+        certificate_types.end()) {
+        shards |= get_leaf_shards(LeafCertificateType::V2G);
+    }
 
-std::mutex EvseSecurity::security_mutex;
+    return shards;
+}
 
 EvseSecurity::EvseSecurity(const FilePaths& file_paths, const std::optional<std::string>& private_key_password,
                            const std::optional<std::uintmax_t>& max_fs_usage_bytes,
                            const std::optional<std::uintmax_t>& max_fs_certificate_store_entries,
                            const std::optional<std::chrono::seconds>& csr_expiry,
-                           const std::optional<std::chrono::seconds>& garbage_collect_time) :
+                           const std::optional<std::chrono::seconds>& garbage_collect_time,
+                           const std::shared_ptr<CertificateStorage>& storage,
+                           const std::map<CaCertificateType, EmbeddedTrustAnchorSet>& embedded_trust_anchors) :
+    storage(storage ? storage : std::make_shared<PosixStorage>()),
+    path_locks(get_store_shards(file_paths, *this->storage)),
+    embedded_ca_bundles(embedded_trust_anchors),
     private_key_password(private_key_password) {
     static_assert(sizeof(std::uint8_t) == 1, "uint8_t not equal to 1 byte!");
 
+    ScopedStorage scoped_storage(this->storage);
+
     std::vector<fs::path> dirs = {
         file_paths.directories.csms_leaf_cert_directory,
         file_paths.directories.csms_leaf_key_directory,
@@ -243,13 +402,13 @@ EvseSecurity::EvseSecurity(const FilePaths& file_paths, const std::optional<std:
     };
 
     for (const auto& path : dirs) {
-        if (!fs::exists(path)) {
+        if (!filesystem_utils::exists(path)) {
             EVLOG_warning << "Could not find configured leaf directory at: " << path.string()
                           << " creating default dir!";
-            if (!fs::create_directories(path)) {
+            if (!get_active_storage().create_directories(path)) {
                 EVLOG_error << "Could not create default dir for path: " << path.string();
             }
-        } else if (!fs::is_directory(path)) {
+        } else if (!filesystem_utils::is_directory(path)) {
             throw std::runtime_error(path.string() + " is not a directory.");
         }
     }
@@ -260,7 +419,12 @@ EvseSecurity::EvseSecurity(const FilePaths& file_paths, const std::optional<std:
     this->ca_bundle_path_map[CaCertificateType::V2G] = file_paths.v2g_ca_bundle;
 
     for (const auto& pair : this->ca_bundle_path_map) {
-        if (!fs::exists(pair.second)) {
+        // Embedded stores do not use their bundle
+        if (embedded_ca_bundles.find(pair.first) != embedded_ca_bundles.end()) {
+            continue;
+        }
+
+        if (!filesystem_utils::exists(pair.second)) {
             EVLOG_warning << "Could not find configured " << conversions::ca_certificate_type_to_string(pair.first)
                           << " bundle file at: " + pair.second.string() << ", creating default!";
             if (!filesystem_utils::create_file_if_nonexistent(pair.second)) {
@@ -288,8 +452,22 @@ EvseSecurity::EvseSecurity(const FilePaths& file_paths, const std::optional<std:
     this->csr_expiry = csr_expiry.value_or(DEFAULT_CSR_EXPIRY);
     this->garbage_collect_time = garbage_collect_time.value_or(DEFAULT_GARBAGE_COLLECT_TIME);
 
+    // Restore the pending CSRs, their expiry continues from the time they were generated. Under the path locks,
+    // another instance of the process can use the same key directories
+    {
+        PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
+        load_managed_csr_journals();
+    }
+
     // Start GC timer
     garbage_collect_timer.interval([this]() { this->garbage_collect(); }, this->garbage_collect_time);
+
+    // The links follow the expiry and activation of the leafs, checked with the expiry watches
+    if (!links.secc_leaf_cert_link.empty() || !links.secc_leaf_key_link.empty() ||
+        !links.cpo_cert_chain_link.empty()) {
+        expiry_watch_timer_started = true;
+        expiry_watch_timer.interval([this]() { this->check_expiry_watches(); }, EXPIRY_WATCH_INTERVAL);
+    }
 }
 
 EvseSecurity::~EvseSecurity() {
@@ -297,9 +475,18 @@ EvseSecurity::~EvseSecurity() {
 
 InstallCertificateResult EvseSecurity::install_ca_certificate(const std::string& certificate,
                                                               CaCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    ScopedStorage scoped_storage(storage);
+
+    EVSE_LOG_info << "Installing ca certificate: " << conversions::ca_certificate_type_to_string(certificate_type);
+
+    if (embedded_ca_bundles.find(certificate_type) != embedded_ca_bundles.end()) {
+        EVLOG_error << "Rejected install of CA certificate in read-only embedded store: "
+                    << conversions::ca_certificate_type_to_string(certificate_type);
+        return InstallCertificateResult::WriteError;
+    }
 
-    EVLOG_info << "Installing ca certificate: " << conversions::ca_certificate_type_to_string(certificate_type);
+    // The usage is counted over all the store directories, and must not change before the certificate is written
+    PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
 
     if (is_filesystem_full()) {
         EVLOG_error << "Filesystem full, can't install new CA certificate!";
@@ -316,7 +503,7 @@ InstallCertificateResult EvseSecurity::install_ca_certificate(const std::string&
         // Load existing
         const auto ca_bundle_path = this->ca_bundle_path_map.at(certificate_type);
 
-        if (!fs::is_directory(ca_bundle_path)) {
+        if (!filesystem_utils::is_directory(ca_bundle_path)) {
             // Ensure file exists
             filesystem_utils::create_file_if_nonexistent(ca_bundle_path);
         }
@@ -360,9 +547,10 @@ InstallCertificateResult EvseSecurity::install_ca_certificate(const std::string&
 }
 
 DeleteCertificateResult EvseSecurity::delete_certificate(const CertificateHashData& certificate_hash_data) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
+    ScopedStorage scoped_storage(storage);
 
-    EVLOG_info << "Delete CA certificate: " << certificate_hash_data.serial_number;
+    EVSE_LOG_info << "Delete CA certificate: " << certificate_hash_data.serial_number;
 
     auto response = DeleteCertificateResult::NotFound;
 
@@ -373,7 +561,7 @@ DeleteCertificateResult EvseSecurity::delete_certificate(const CertificateHashDa
     // whole hierarchies
     for (auto const& [certificate_type, ca_bundle_path] : ca_bundle_path_map) {
         try {
-            X509CertificateBundle ca_bundle(ca_bundle_path, EncodingFormat::PEM);
+            X509CertificateBundle ca_bundle = load_ca_bundle(certificate_type);
 
             if (ca_bundle.delete_certificate(certificate_hash_data, true)) {
                 found_certificate = true;
@@ -402,14 +590,14 @@ DeleteCertificateResult EvseSecurity::delete_certificate(const CertificateHashDa
                 load = CaCertificateType::CSMS;
 
             // Also load the roots since we need to build the hierarchy for correct certificate hashes
-            X509CertificateBundle root_bundle(ca_bundle_path_map[load], EncodingFormat::PEM);
+            X509CertificateBundle root_bundle = load_ca_bundle(load);
             X509CertificateBundle leaf_bundle(leaf_certificate_path, EncodingFormat::PEM);
 
             X509CertificateHierarchy hierarchy =
                 std::move(X509CertificateHierarchy::build_hierarchy(root_bundle.split(), leaf_bundle.split()));
 
-            EVLOG_debug << "Delete hierarchy:(" << leaf_certificate_path.string() << ")\n"
-                        << hierarchy.to_debug_string();
+            EVSE_LOG_debug << "Delete hierarchy:(" << leaf_certificate_path.string() << ")\n"
+                           << hierarchy.to_debug_string();
 
             try {
                 X509Wrapper to_delete =
@@ -440,6 +628,10 @@ DeleteCertificateResult EvseSecurity::delete_certificate(const CertificateHashDa
     if (!found_certificate) {
         return DeleteCertificateResult::NotFound;
     }
+
+    // The links follow the deletion of the selected leaf
+    get_leaf_selection(LeafCertificateType::V2G);
+
     if (failed_to_write) {
         // at least one certificate could not be deleted from the bundle
         return DeleteCertificateResult::Failed;
@@ -449,14 +641,17 @@ DeleteCertificateResult EvseSecurity::delete_certificate(const CertificateHashDa
 
 InstallCertificateResult EvseSecurity::update_leaf_certificate(const std::string& certificate_chain,
                                                                LeafCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    ScopedStorage scoped_storage(storage);
+
+    // The usage is counted over all the store directories, and must not change before the leaf is written
+    PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
 
     if (is_filesystem_full()) {
         EVLOG_error << "Filesystem full, can't install new CA certificate!";
         return InstallCertificateResult::CertificateStoreMaxLengthExceeded;
     }
 
-    EVLOG_info << "Updating leaf certificate: " << conversions::leaf_certificate_type_to_string(certificate_type);
+    EVSE_LOG_info << "Updating leaf certificate: " << conversions::leaf_certificate_type_to_string(certificate_type);
 
     fs::path cert_path;
     fs::path key_path;
@@ -491,12 +686,35 @@ InstallCertificateResult EvseSecurity::update_leaf_certificate(const std::string
         // Check if a private key belongs to the provided certificate
         fs::path private_key_path;
 
-        try {
-            private_key_path =
-                get_private_key_path_of_certificate(leaf_certificate, key_path, this->private_key_password);
-        } catch (const NoPrivateKeyException& e) {
-            EVLOG_warning << "Provided certificate does not belong to any private key";
-            return InstallCertificateResult::WriteError;
+        // Usually the certificate is the response to one of our CSRs, check that key first
+        const auto leaf_key_hash = leaf_certificate.get_key_hash();
+
+        std::unique_lock<std::mutex> csr_lock(managed_csr_mutex);
+        for (const auto& [managed_key_path, entry] : managed_csr) {
+            if (entry.key_hash != leaf_key_hash ||
+                (key_path / managed_key_path.filename()).lexically_normal() != managed_key_path.lexically_normal()) {
+                continue;
+            }
+
+            std::string private_key;
+
+            if (filesystem_utils::read_from_file(managed_key_path, private_key) &&
+                KeyValidationResult::Valid == CryptoSupplier::x509_check_private_key(
+                                                  leaf_certificate.get(), private_key, this->private_key_password)) {
+                private_key_path = managed_key_path;
+                break;
+            }
+        }
+        csr_lock.unlock();
+
+        if (private_key_path.empty()) {
+            try {
+                private_key_path =
+                    get_private_key_path_of_certificate(leaf_certificate, key_path, this->private_key_password);
+            } catch (const NoPrivateKeyException& e) {
+                EVLOG_warning << "Provided certificate does not belong to any private key";
+                return InstallCertificateResult::WriteError;
+            }
         }
 
         // Write certificate to file
@@ -510,9 +728,11 @@ InstallCertificateResult EvseSecurity::update_leaf_certificate(const std::string
 
             // Remove from managed certificate keys, the CSR is fulfilled, no need to delete the key
             // since it is not orphaned any more
+            std::lock_guard<std::mutex> lock(managed_csr_mutex);
             auto it = managed_csr.find(private_key_path);
             if (it != managed_csr.end()) {
                 managed_csr.erase(it);
+                append_managed_csr_journal(private_key_path, nullptr);
             }
 
             // Do not presume that we received back a chain certificate that requires writing
@@ -536,6 +756,11 @@ InstallCertificateResult EvseSecurity::update_leaf_certificate(const std::string
             // TODO(ioan): properly rename key path here for fast retrieval
             // @see 'get_private_key_path_of_certificate' and 'get_certificate_path_of_key'
 
+            // The links follow the new selection
+            if (certificate_type == LeafCertificateType::V2G) {
+                get_leaf_selection(certificate_type);
+            }
+
             return InstallCertificateResult::Accepted;
         } else {
             return InstallCertificateResult::WriteError;
@@ -555,7 +780,8 @@ GetInstalledCertificatesResult EvseSecurity::get_installed_certificate(Certifica
 
 GetInstalledCertificatesResult
 EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& certificate_types) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_installed_shards(certificate_types));
+    ScopedStorage scoped_storage(storage);
 
     GetInstalledCertificatesResult result;
     std::vector<CertificateHashDataChain> certificate_chains;
@@ -563,13 +789,12 @@ EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& cer
 
     // retrieve ca certificates and chains
     for (const auto& ca_certificate_type : ca_certificate_types) {
-        auto ca_bundle_path = this->ca_bundle_path_map.at(ca_certificate_type);
         try {
-            X509CertificateBundle ca_bundle(ca_bundle_path, EncodingFormat::PEM);
+            X509CertificateBundle ca_bundle = load_ca_bundle(ca_certificate_type);
             X509CertificateHierarchy& hierarchy = ca_bundle.get_certificate_hierarchy();
 
-            EVLOG_debug << "Hierarchy:(" << conversions::ca_certificate_type_to_string(ca_certificate_type) << ")\n"
-                        << hierarchy.to_debug_string();
+            EVSE_LOG_debug << "Hierarchy:(" << conversions::ca_certificate_type_to_string(ca_certificate_type) << ")\n"
+                           << hierarchy.to_debug_string();
 
             // Iterate the hierarchy and add all the certificates to their respective locations
             for (auto& root : hierarchy.get_hierarchy()) {
@@ -590,7 +815,8 @@ EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& cer
                 certificate_chains.push_back(certificate_hash_data_chain);
             }
         } catch (const CertificateLoadException& e) {
-            EVLOG_warning << "Could not load CA bundle file at: " << ca_bundle_path << " error: " << e.what();
+            EVLOG_warning << "Could not load CA bundle file at: " << this->ca_bundle_path_map.at(ca_certificate_type)
+                          << " error: " << e.what();
         }
     }
 
@@ -614,8 +840,7 @@ EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& cer
                 X509CertificateBundle leaf_bundle(certificate_path, EncodingFormat::PEM);
 
                 // V2G chain
-                const auto ca_bundle_path = this->ca_bundle_path_map.at(CaCertificateType::V2G);
-                X509CertificateBundle ca_bundle(ca_bundle_path, EncodingFormat::PEM);
+                X509CertificateBundle ca_bundle = load_ca_bundle(CaCertificateType::V2G);
 
                 // Merge the bundles
                 for (auto& certif : leaf_bundle.split()) {
@@ -624,7 +849,7 @@ EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& cer
 
                 // Create the certificate hierarchy
                 X509CertificateHierarchy& hierarchy = ca_bundle.get_certificate_hierarchy();
-                EVLOG_debug << "Hierarchy:(V2GCertificateChain)\n" << hierarchy.to_debug_string();
+                EVSE_LOG_debug << "Hierarchy:(V2GCertificateChain)\n" << hierarchy.to_debug_string();
 
                 for (auto& root : hierarchy.get_hierarchy()) {
                     CertificateHashDataChain certificate_hash_data_chain;
@@ -672,16 +897,23 @@ EvseSecurity::get_installed_certificates(const std::vector<CertificateType>& cer
 }
 
 int EvseSecurity::get_count_of_installed_certificates(const std::vector<CertificateType>& certificate_types) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_installed_shards(certificate_types));
+    ScopedStorage scoped_storage(storage);
 
     int count = 0;
 
     std::set<fs::path> directories;
     const auto ca_certificate_types = get_ca_certificate_types(certificate_types);
 
-    // Collect unique directories
+    // Collect unique directories, the embedded stores are counted directly
     for (const auto& ca_certificate_type : ca_certificate_types) {
-        directories.emplace(this->ca_bundle_path_map.at(ca_certificate_type));
+        const auto embedded = embedded_ca_bundles.find(ca_certificate_type);
+
+        if (embedded != embedded_ca_bundles.end()) {
+            count += static_cast<int>(embedded->second.count);
+        } else {
+            directories.emplace(this->ca_bundle_path_map.at(ca_certificate_type));
+        }
     }
 
     for (const auto& unique_dir : directories) {
@@ -711,7 +943,8 @@ int EvseSecurity::get_count_of_installed_certificates(const std::vector<Certific
 }
 
 OCSPRequestDataList EvseSecurity::get_v2g_ocsp_request_data() {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, V2G_OCSP_SHARDS);
+    ScopedStorage scoped_storage(storage);
 
     try {
         const auto secc_key_pair =
@@ -736,7 +969,8 @@ OCSPRequestDataList EvseSecurity::get_v2g_ocsp_request_data() {
         }
 
         if (!chain.empty()) {
-            return get_ocsp_request_data_internal(this->ca_bundle_path_map.at(CaCertificateType::V2G), chain);
+            X509CertificateBundle root_bundle = load_ca_bundle(CaCertificateType::V2G);
+            return get_ocsp_request_data_internal(root_bundle, chain);
         }
     } catch (const CertificateLoadException& e) {
         EVLOG_error << "Could not get v2g ocsp cache, certificate load failure: " << e.what();
@@ -746,14 +980,16 @@ OCSPRequestDataList EvseSecurity::get_v2g_ocsp_request_data() {
 }
 
 OCSPRequestDataList EvseSecurity::get_mo_ocsp_request_data(const std::string& certificate_chain) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, MO_CA_SHARD);
+    ScopedStorage scoped_storage(storage);
 
     try {
         std::vector<X509Wrapper> chain =
             std::move(X509CertificateBundle(certificate_chain, EncodingFormat::PEM).split());
 
         // Find the MO root
-        return get_ocsp_request_data_internal(this->ca_bundle_path_map.at(CaCertificateType::MO), chain);
+        X509CertificateBundle root_bundle = load_ca_bundle(CaCertificateType::MO);
+        return get_ocsp_request_data_internal(root_bundle, chain);
     } catch (const CertificateLoadException& e) {
         EVLOG_error << "Could not get mo ocsp cache, certificate load failure: " << e.what();
     }
@@ -761,12 +997,13 @@ OCSPRequestDataList EvseSecurity::get_mo_ocsp_request_data(const std::string& ce
     return OCSPRequestDataList();
 }
 
-OCSPRequestDataList get_ocsp_request_data_internal(fs::path& root_path, std::vector<X509Wrapper>& leaf_chain) {
+OCSPRequestDataList get_ocsp_request_data_internal(X509CertificateBundle& root_bundle,
+                                                   std::vector<X509Wrapper>& leaf_chain) {
     OCSPRequestDataList response;
     std::vector<OCSPRequestData> ocsp_request_data_list;
 
     try {
-        std::vector<X509Wrapper> full_hierarchy = X509CertificateBundle(root_path, EncodingFormat::PEM).split();
+        std::vector<X509Wrapper> full_hierarchy = root_bundle.split();
 
         // Build the full hierarchy
         auto hierarchy = std::move(X509CertificateHierarchy::build_hierarchy(full_hierarchy, leaf_chain));
@@ -821,18 +1058,46 @@ OCSPRequestDataList get_ocsp_request_data_internal(fs::path& root_path, std::vec
     return response;
 }
 
+/// @brief Verifies the OCSP response of the certificate of the hierarchy with the hash data, against its issuer
+static OCSPVerdict verify_ocsp_response(X509CertificateHierarchy& hierarchy,
+                                        const CertificateHashData& certificate_hash_data,
+                                        const std::string& ocsp_response) {
+    OCSPVerdict verdict{OCSPCertificateStatus::Invalid, std::nullopt};
+
+    hierarchy.for_each([&](const X509Node& node) {
+        if (!(node.hash == certificate_hash_data)) {
+            return true;
+        }
+
+        // A root answers for itself
+        const X509Wrapper& issuer = node.state.is_selfsigned ? node.certificate : node.issuer;
+
+        std::optional<std::int64_t> next_update;
+        verdict.status =
+            CryptoSupplier::x509_verify_ocsp_response(ocsp_response, node.certificate.get(), issuer.get(), next_update);
+
+        if (next_update.has_value()) {
+            verdict.next_update = std::chrono::system_clock::time_point(std::chrono::seconds(next_update.value()));
+        }
+
+        return false;
+    });
+
+    return verdict;
+}
+
 void EvseSecurity::update_ocsp_cache(const CertificateHashData& certificate_hash_data,
                                      const std::string& ocsp_response) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, V2G_OCSP_SHARDS);
+    ScopedStorage scoped_storage(storage);
 
-    EVLOG_info << "Updating OCSP cache";
+    EVSE_LOG_info << "Updating OCSP cache";
 
     // TODO(ioan): shouldn't we also do this for the MO?
-    const auto ca_bundle_path = this->ca_bundle_path_map.at(CaCertificateType::V2G);
     auto leaf_cert_dir = this->directories.secc_leaf_cert_directory; // V2G leafs
 
     try {
-        X509CertificateBundle ca_bundle(ca_bundle_path, EncodingFormat::PEM);
+        X509CertificateBundle ca_bundle = load_ca_bundle(CaCertificateType::V2G);
         X509CertificateBundle leaf_bundle(leaf_cert_dir, EncodingFormat::PEM);
 
         auto certificate_hierarchy =
@@ -843,34 +1108,44 @@ void EvseSecurity::update_ocsp_cache(const CertificateHashData& certificate_hash
             // Find the certificates, can me multiple if we have SUBcas in multiple bundles
             std::vector<X509Wrapper> certs = certificate_hierarchy.find_certificates_multi(certificate_hash_data);
 
+            // The response is verified once, the verdict is stored with its hash
+            const OCSPVerdict verdict =
+                verify_ocsp_response(certificate_hierarchy, certificate_hash_data, ocsp_response);
+
+            // Never served, the previous response (if any) is kept
+            if (verdict.status == OCSPCertificateStatus::Invalid) {
+                EVLOG_warning << "OCSP response could not be verified, not stored";
+                return;
+            }
+
             for (auto& cert : certs) {
-                EVLOG_debug << "Writing OCSP Response to filesystem";
+                EVSE_LOG_debug << "Writing OCSP Response to filesystem";
                 if (cert.get_file().has_value()) {
                     const auto ocsp_path = cert.get_file().value().parent_path() / "ocsp";
 
-                    if (false == fs::exists(ocsp_path)) {
+                    if (false == filesystem_utils::exists(ocsp_path)) {
                         filesystem_utils::create_file_or_dir_if_nonexistent(ocsp_path);
                     } else {
                         // Iterate existing hashes
-                        for (const auto& hash_entry : fs::directory_iterator(ocsp_path)) {
-                            if (hash_entry.is_regular_file()) {
-                                CertificateHashData read_hash;
+                        std::vector<fs::path> hash_entries;
+                        filesystem_utils::list_files(ocsp_path, false, hash_entries);
 
-                                if (filesystem_utils::read_hash_from_file(hash_entry.path(), read_hash) &&
-                                    read_hash == certificate_hash_data) {
-                                    EVLOG_debug << "OCSP certificate hash already found, over-writing!";
+                        for (const auto& hash_entry : hash_entries) {
+                            CertificateHashData read_hash;
 
-                                    // Over-write the data file and return
-                                    fs::path ocsp_path = hash_entry.path();
-                                    ocsp_path.replace_extension(DER_EXTENSION);
+                            if (filesystem_utils::read_hash_from_file(hash_entry, read_hash) &&
+                                read_hash == certificate_hash_data) {
+                                EVSE_LOG_debug << "OCSP certificate hash already found, over-writing!";
 
-                                    // Discard previous content
-                                    std::ofstream fs(ocsp_path.c_str(), std::ios::trunc);
-                                    fs << ocsp_response;
-                                    fs.close();
+                                // Over-write the data file and return
+                                fs::path ocsp_path = hash_entry;
+                                ocsp_path.replace_extension(DER_EXTENSION);
 
-                                    return;
-                                }
+                                // Discard previous content
+                                filesystem_utils::write_to_file(ocsp_path, ocsp_response, std::ios::trunc);
+                                filesystem_utils::write_hash_to_file(hash_entry, certificate_hash_data, verdict);
+
+                                return;
                             }
                         }
                     }
@@ -882,19 +1157,16 @@ void EvseSecurity::update_ocsp_cache(const CertificateHashData& certificate_hash
                     const auto hash_file_path = (ocsp_path / name) += CERT_HASH_EXTENSION;
 
                     // Write out OCSP data
-                    try {
-                        std::ofstream fs(ocsp_file_path.c_str());
-                        fs << ocsp_response;
-                        fs.close();
-                    } catch (const std::exception& e) {
+                    if (false == filesystem_utils::write_to_file(ocsp_file_path, ocsp_response, std::ios::out)) {
                         EVLOG_error << "Could not write OCSP certificate data!";
                     }
 
-                    if (false == filesystem_utils::write_hash_to_file(hash_file_path, certificate_hash_data)) {
+                    if (false ==
+                        filesystem_utils::write_hash_to_file(hash_file_path, certificate_hash_data, verdict)) {
                         EVLOG_error << "Could not write OCSP certificate hash!";
                     }
 
-                    EVLOG_debug << "OCSP certificate hash not found, written at path: " << ocsp_file_path;
+                    EVSE_LOG_debug << "OCSP certificate hash not found, written at path: " << ocsp_file_path;
                 } else {
                     EVLOG_error << "Could not find OCSP cache patch directory!";
                 }
@@ -907,87 +1179,321 @@ void EvseSecurity::update_ocsp_cache(const CertificateHashData& certificate_hash
     }
 }
 
+std::optional<OCSPVerdict> EvseSecurity::get_ocsp_verdict(const CertificateHashData& certificate_hash_data) {
+    PathShardGuard guard(this->path_locks, V2G_OCSP_SHARDS);
+    ScopedStorage scoped_storage(storage);
+
+    // Only the status of the OCSP cache files is read, the certificates are neither loaded nor verified
+    const OCSPVerdictIndex& index = get_ocsp_verdict_index();
+    const auto verdict = index.verdicts.find(to_ocsp_key(certificate_hash_data));
+
+    if (verdict == index.verdicts.end()) {
+        return std::nullopt;
+    }
+
+    return verdict->second;
+}
+
+const EvseSecurity::OCSPVerdictIndex& EvseSecurity::get_ocsp_verdict_index() {
+    auto& storage = get_active_storage();
+
+    // The cache next to the bundle file, or the caches inside the directories
+    std::vector<fs::path> locations;
+
+    for (const auto& location : {ca_bundle_path_map.at(CaCertificateType::V2G), directories.secc_leaf_cert_directory}) {
+        const StorageStatus status = storage.stat(location);
+
+        if (status.type == StorageEntryType::File) {
+            locations.push_back(location.parent_path() / "ocsp");
+        } else if (status.type == StorageEntryType::Directory) {
+            locations.push_back(location);
+        }
+    }
+
+    std::vector<StorageStatus> store_status;
+    for (const auto& location : locations) {
+        append_store_status(location, store_status);
+    }
+
+    OCSPVerdictIndex& index = ocsp_verdict_index;
+    if (index.valid && is_same_store_status(store_status, index.store_status)) {
+        return index;
+    }
+
+    index.verdicts.clear();
+
+    for (const auto& location : locations) {
+        std::vector<std::pair<fs::path, StorageStatus>> entries;
+        filesystem_utils::list_file_entries(location, true, entries);
+
+        for (const auto& [file, file_status] : entries) {
+            if (file.parent_path().filename() != "ocsp" || file.extension() != CERT_HASH_EXTENSION) {
+                continue;
+            }
+
+            CertificateHashData read_hash;
+            OCSPVerdict verdict;
+
+            if (filesystem_utils::read_hash_from_file(file, read_hash) &&
+                filesystem_utils::read_ocsp_verdict_from_file(file, verdict)) {
+                index.verdicts.emplace(to_ocsp_key(read_hash), verdict);
+            }
+        }
+    }
+
+    index.valid = true;
+    index.store_status = std::move(store_status);
+
+    return index;
+}
+
 std::optional<fs::path> EvseSecurity::retrieve_ocsp_cache(const CertificateHashData& certificate_hash_data) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, V2G_OCSP_SHARDS);
+    ScopedStorage scoped_storage(storage);
 
     return retrieve_ocsp_cache_internal(certificate_hash_data);
 }
 
+/// @brief Hash files of the OCSP cache directories, with the hash data they hold, in listing order
+using OCSPCacheListings = std::map<fs::path, std::vector<std::pair<fs::path, CertificateHashData>>>;
+
+/// @brief Path of the cached OCSP response of the certificate of the @p hierarchy with the hash data, from the OCSP
+/// cache next to the certificate file. Each cache directory is listed and read once into @p listings
+static std::optional<fs::path> find_ocsp_cache(X509CertificateHierarchy& hierarchy,
+                                               const CertificateHashData& certificate_hash_data,
+                                               OCSPCacheListings& listings) {
+    try {
+        // Find the certificate
+        X509Wrapper cert = hierarchy.find_certificate(certificate_hash_data);
+
+        EVSE_LOG_debug << "Reading OCSP Response from filesystem";
+
+        if (cert.get_file().has_value()) {
+            const auto ocsp_path = cert.get_file().value().parent_path() / "ocsp";
+            auto listing = listings.find(ocsp_path);
+
+            if (listing == listings.end()) {
+                listing = listings.emplace(ocsp_path, OCSPCacheListings::mapped_type{}).first;
+
+                std::vector<fs::path> ocsp_entries;
+                filesystem_utils::list_files(ocsp_path, false, ocsp_entries);
+
+                for (const auto& ocsp_entry : ocsp_entries) {
+                    CertificateHashData read_hash;
+
+                    if (filesystem_utils::read_hash_from_file(ocsp_entry, read_hash)) {
+                        listing->second.emplace_back(ocsp_entry, std::move(read_hash));
+                    }
+                }
+            }
+
+            // Search through the OCSP directory and see if we can find any related certificate hash data
+            for (const auto& [ocsp_entry, read_hash] : listing->second) {
+                if (read_hash == certificate_hash_data) {
+                    fs::path replaced_ext = ocsp_entry;
+                    replaced_ext.replace_extension(DER_EXTENSION);
+
+                    // Return the data file's path
+                    return std::make_optional<fs::path>(replaced_ext);
+                }
+            }
+        }
+    } catch (const NoCertificateFound& e) {
+        EVLOG_error << "Could not find any certificate for ocsp cache retrieve: " << e.what();
+    } catch (const std::filesystem::filesystem_error& e) {
+        EVLOG_error << "Could not iterate over ocsp cache: " << e.what();
+    }
+
+    return std::nullopt;
+}
+
 std::optional<fs::path> EvseSecurity::retrieve_ocsp_cache_internal(const CertificateHashData& certificate_hash_data) {
     // TODO(ioan): shouldn't we also do this for the MO?
-    const auto ca_bundle_path = this->ca_bundle_path_map.at(CaCertificateType::V2G);
     const auto leaf_path = this->directories.secc_leaf_key_directory;
 
     try {
-        X509CertificateBundle ca_bundle(ca_bundle_path, EncodingFormat::PEM);
+        X509CertificateBundle ca_bundle = load_ca_bundle(CaCertificateType::V2G);
         X509CertificateBundle leaf_bundle(leaf_path, EncodingFormat::PEM);
 
         auto certificate_hierarchy =
             std::move(X509CertificateHierarchy::build_hierarchy(ca_bundle.split(), leaf_bundle.split()));
 
-        try {
-            // Find the certificate
-            X509Wrapper cert = certificate_hierarchy.find_certificate(certificate_hash_data);
+        OCSPCacheListings listings;
+        return find_ocsp_cache(certificate_hierarchy, certificate_hash_data, listings);
+    } catch (const CertificateLoadException& e) {
+        EVLOG_error << "Could not retrieve ocsp cache, certificate load failure: " << e.what();
+    }
 
-            EVLOG_debug << "Reading OCSP Response from filesystem";
+    return std::nullopt;
+}
 
-            if (cert.get_file().has_value()) {
-                const auto ocsp_path = cert.get_file().value().parent_path() / "ocsp";
+InstallCertificateResult EvseSecurity::install_crl(const std::string& crl, CaCertificateType certificate_type) {
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
-                // Search through the OCSP directory and see if we can find any related certificate hash data
-                for (const auto& ocsp_entry : fs::directory_iterator(ocsp_path)) {
-                    if (ocsp_entry.is_regular_file()) {
-                        CertificateHashData read_hash;
+    return install_crl_internal(crl, certificate_type);
+}
 
-                        if (filesystem_utils::read_hash_from_file(ocsp_entry.path(), read_hash) &&
-                            (read_hash == certificate_hash_data)) {
-                            fs::path replaced_ext = ocsp_entry.path();
-                            replaced_ext.replace_extension(DER_EXTENSION);
+InstallCertificateResult EvseSecurity::install_crl_internal(const std::string& crl,
+                                                           CaCertificateType certificate_type) {
+    EVSE_LOG_info << "Installing revocation list: " << conversions::ca_certificate_type_to_string(certificate_type);
 
-                            // Return the data file's path
-                            return std::make_optional<fs::path>(replaced_ext);
-                        }
-                    }
-                }
+    std::vector<CertificateRevocationList> new_crls;
+    if (false == CryptoSupplier::x509_crl_load(crl, new_crls)) {
+        EVLOG_error << "Could not parse revocation list";
+        return InstallCertificateResult::InvalidFormat;
+    }
+
+    if (false == is_ca_certificate_installed_internal(certificate_type)) {
+        return InstallCertificateResult::NoRootCertificateInstalled;
+    }
+
+    try {
+        X509CertificateBundle ca_bundle = load_ca_bundle(certificate_type);
+        std::vector<X509Wrapper> ca_certificates = ca_bundle.split();
+
+        std::vector<X509Handle*> trusted_parent_certificates;
+        for (const auto& ca : ca_certificates) {
+            trusted_parent_certificates.push_back(ca.get());
+        }
+
+        // The sub-CAs supplied with the lists, e.g. the issuer of the leafs, can sign them once verified to the bundle
+        const std::vector<X509Handle_ptr> supplied_certificates =
+            CryptoSupplier::load_certificates(crl, EncodingFormat::PEM);
+
+        std::vector<X509Handle*> untrusted_subcas;
+        for (const auto& certificate : supplied_certificates) {
+            untrusted_subcas.push_back(certificate.get());
+        }
+
+        std::vector<X509Handle*> issuers = trusted_parent_certificates;
+        for (const auto& certificate : supplied_certificates) {
+            if (CryptoSupplier::x509_verify_certificate_chain(certificate.get(), trusted_parent_certificates,
+                                                              untrusted_subcas, true, std::nullopt,
+                                                              std::nullopt) == CertificateValidationResult::Valid) {
+                issuers.push_back(certificate.get());
+            } else {
+                EVLOG_warning << "Ignored certificate supplied with the revocation list, not issued by the CA bundle";
+            }
+        }
+
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+        for (const auto& new_crl : new_crls) {
+            const bool signed_by_ca = std::any_of(issuers.begin(), issuers.end(), [&new_crl](X509Handle* issuer) {
+                return CryptoSupplier::x509_crl_verify(new_crl, issuer);
+            });
+
+            if (!signed_by_ca) {
+                EVLOG_warning << "Revocation list not signed by a certificate of the CA bundle or a supplied sub-CA";
+                return InstallCertificateResult::InvalidSignature;
+            }
+
+            if (new_crl.next_update.has_value() && new_crl.next_update.value() < now) {
+                EVLOG_warning << "Revocation list has expired";
+                return InstallCertificateResult::Expired;
             }
-        } catch (const NoCertificateFound& e) {
-            EVLOG_error << "Could not find any certificate for ocsp cache retrieve: " << e.what();
-        } catch (const std::filesystem::filesystem_error& e) {
-            EVLOG_error << "Could not iterate over ocsp cache: " << e.what();
         }
     } catch (const CertificateLoadException& e) {
-        EVLOG_error << "Could not retrieve ocsp cache, certificate load failure: " << e.what();
+        EVLOG_error << "Certificate load error: " << e.what();
+        return InstallCertificateResult::NoRootCertificateInstalled;
     }
 
-    return std::nullopt;
+    // One list per issuer, a received list does not replace a more recent one
+    std::vector<CertificateRevocationList> crls = get_revocation_index(certificate_type).crls;
+
+    for (auto& new_crl : new_crls) {
+        const auto installed =
+            std::find_if(crls.begin(), crls.end(), [&new_crl](const CertificateRevocationList& installed_crl) {
+                return installed_crl.issuer_name_hash == new_crl.issuer_name_hash;
+            });
+
+        if (installed == crls.end()) {
+            crls.push_back(std::move(new_crl));
+        } else if (installed->last_update <= new_crl.last_update) {
+            *installed = std::move(new_crl);
+        } else {
+            EVSE_LOG_info << "Kept the more recent installed revocation list of the same issuer";
+        }
+    }
+
+    std::string data;
+    for (const auto& installed_crl : crls) {
+        data += installed_crl.pem;
+    }
+
+    get_cache_entry(revocation_indexes, certificate_type).valid = false;
+
+    if (false == filesystem_utils::write_to_file(get_crl_path(certificate_type), data, std::ios::out)) {
+        EVLOG_error << "Could not write revocation list";
+        return InstallCertificateResult::WriteError;
+    }
+
+    return InstallCertificateResult::Accepted;
+}
+
+std::optional<std::chrono::system_clock::time_point>
+EvseSecurity::get_crl_next_update(CaCertificateType certificate_type) {
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
+
+    std::optional<std::int64_t> next_update;
+
+    for (const auto& crl : get_revocation_index(certificate_type).crls) {
+        if (crl.next_update.has_value() && (!next_update.has_value() || crl.next_update < next_update)) {
+            next_update = crl.next_update;
+        }
+    }
+
+    if (!next_update.has_value()) {
+        return std::nullopt;
+    }
+
+    return std::chrono::system_clock::time_point(std::chrono::seconds(next_update.value()));
 }
 
 bool EvseSecurity::is_ca_certificate_installed(CaCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
     return is_ca_certificate_installed_internal(certificate_type);
 }
 
 bool EvseSecurity::is_ca_certificate_installed_internal(CaCertificateType certificate_type) {
+    const auto embedded = embedded_ca_bundles.find(certificate_type);
+
+    if (embedded != embedded_ca_bundles.end()) {
+        // The roots are known to be self-signed, the validity is checked without decoding them
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+        return std::any_of(embedded->second.begin(), embedded->second.end(),
+                           [now](const EmbeddedTrustAnchor& anchor) {
+                               return anchor.not_before <= now && now <= anchor.not_after;
+                           });
+    }
+
     try {
-        X509CertificateBundle bundle(this->ca_bundle_path_map.at(certificate_type), EncodingFormat::PEM);
+        // The summary is rebuilt with the trust index when the bundle changed
+        RootSummary& roots = get_trust_index_entry(certificate_type).roots;
 
-        // Search for a valid self-signed root
-        auto& hierarchy = bundle.get_certificate_hierarchy();
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
 
-        // Get all roots and search for a valid self-signed
-        for (auto& root : hierarchy.get_hierarchy()) {
-            if (root.certificate.is_selfsigned() && root.certificate.is_valid()) {
-                return true;
-            }
+        if (now >= roots.next_transition) {
+            roots.update(now);
         }
+
+        return roots.valid_roots > 0;
     } catch (const CertificateLoadException& e) {
         EVLOG_error << "Could not load ca certificate type:"
                     << conversions::ca_certificate_type_to_string(certificate_type);
         return false;
     }
-
-    return false;
 }
 
 void EvseSecurity::certificate_signing_request_failed(const std::string& csr, LeafCertificateType certificate_type) {
@@ -999,30 +1505,61 @@ EvseSecurity::generate_certificate_signing_request_internal(LeafCertificateType
                                                             const CertificateSigningRequestInfo& info) {
     GetCertificateSignRequestResult result{};
 
-    EVLOG_info << "Generating CSR for leaf: " << conversions::leaf_certificate_type_to_string(certificate_type);
+    EVSE_LOG_info << "Generating CSR for leaf: " << conversions::leaf_certificate_type_to_string(certificate_type);
+
+    // Add the key to the managed CRS that we will delete if we can't find a certificate pair within the time.
+    // Recorded before the key is written, so that a key is never left without its journal record. A failed
+    // generation records the removal again
+    ManagedCsr entry;
+    entry.timepoint = std::chrono::steady_clock::now();
+    entry.created = std::chrono::system_clock::now();
+
+    if (info.key_info.private_key_file.has_value() &&
+        false == append_managed_csr_journal(info.key_info.private_key_file.value(), &entry)) {
+        EVLOG_error << "CSR leaf generation error: could not record the key in the managed CSR journal";
+        result.status = GetCertificateSignRequestStatus::GenerationError;
+        return result;
+    }
 
     std::string csr;
     CertificateSignRequestResult csr_result = CryptoSupplier::x509_generate_csr(info, csr);
 
     if (csr_result == CertificateSignRequestResult::Valid) {
-        result.status = GetCertificateSignRequestStatus::Accepted;
-        result.csr = std::move(csr);
+        if (info.key_info.private_key_file.has_value()) {
+            const auto& key_path = info.key_info.private_key_file.value();
 
-        EVLOG_debug << "Generated CSR end. CSR: " << csr;
+            // The key hash only speeds up the matching of the certificate, the key is managed without it
+            entry.key_hash = CryptoSupplier::x509_get_csr_key_hash(csr);
+            append_managed_csr_journal(key_path, &entry);
 
-        // Add the key to the managed CRS that we will delete if we can't find a certificate pair within the time
-        if (info.key_info.private_key_file.has_value()) {
-            managed_csr.emplace(info.key_info.private_key_file.value(), std::chrono::steady_clock::now());
+            std::lock_guard<std::mutex> lock(managed_csr_mutex);
+            managed_csr[key_path] = std::move(entry);
         }
+
+        result.status = GetCertificateSignRequestStatus::Accepted;
+        result.csr = std::move(csr);
+
+        EVSE_LOG_debug << "Generated CSR end. CSR: " << result.csr.value();
     } else {
         EVLOG_error << "CSR leaf generation error: "
                     << conversions::get_certificate_sign_request_result_to_string(csr_result);
 
-        if (csr_result == CertificateSignRequestResult::KeyGenerationError) {
-            result.status = GetCertificateSignRequestStatus::KeyGenError;
-        } else {
-            result.status = GetCertificateSignRequestStatus::GenerationError;
-        }
+        // The key of a failed CSR is not managed, a key that was already written is of no use without its CSR
+        if (info.key_info.private_key_file.has_value()) {
+            const auto& key_path = info.key_info.private_key_file.value();
+
+            if (filesystem_utils::exists(key_path) && !filesystem_utils::delete_file(key_path)) {
+                EVLOG_warning << "Could not delete the key of the failed CSR: " << key_path;
+            }
+
+            append_managed_csr_journal(key_path, nullptr);
+        }
+
+        if (csr_result == CertificateSignRequestResult::KeyGenerationError) {
+            result.status = GetCertificateSignRequestStatus::KeyGenError;
+        } else {
+            result.status = GetCertificateSignRequestStatus::GenerationError;
+        }
     }
 
     return result;
@@ -1033,7 +1570,8 @@ GetCertificateSignRequestResult EvseSecurity::generate_certificate_signing_reque
                                                                                    const std::string& organization,
                                                                                    const std::string& common,
                                                                                    bool use_custom_provider) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
     // Make a difference between normal and tpm keys for identification
     const auto file_name = conversions::leaf_certificate_type_to_filename(certificate_type) +
@@ -1091,7 +1629,8 @@ GetCertificateSignRequestResult EvseSecurity::generate_certificate_signing_reque
 
 GetCertificateFullInfoResult EvseSecurity::get_all_valid_certificates_info(LeafCertificateType certificate_type,
                                                                            EncodingFormat encoding, bool include_ocsp) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type) | (include_ocsp ? V2G_OCSP_SHARDS : 0));
+    ScopedStorage scoped_storage(storage);
 
     GetCertificateFullInfoResult result =
         get_full_leaf_certificate_info_internal(certificate_type, encoding, include_ocsp, true, true);
@@ -1132,7 +1671,8 @@ GetCertificateFullInfoResult EvseSecurity::get_all_valid_certificates_info(LeafC
 
 GetCertificateInfoResult EvseSecurity::get_leaf_certificate_info(LeafCertificateType certificate_type,
                                                                  EncodingFormat encoding, bool include_ocsp) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type) | (include_ocsp ? V2G_OCSP_SHARDS : 0));
+    ScopedStorage scoped_storage(storage);
 
     return get_leaf_certificate_info_internal(certificate_type, encoding, include_ocsp);
 }
@@ -1154,12 +1694,20 @@ GetCertificateInfoResult EvseSecurity::get_leaf_certificate_info_internal(LeafCe
 GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_internal(LeafCertificateType certificate_type,
                                                                                    EncodingFormat encoding,
                                                                                    bool include_ocsp, bool include_root,
-                                                                                   bool include_all_valid) {
-    EVLOG_info << "Requesting leaf certificate info: "
-               << conversions::leaf_certificate_type_to_string(certificate_type);
+                                                                                   bool include_all_valid,
+                                                                                   LeafSelection* selection) {
+    EVSE_LOG_debug << "Requesting leaf certificate info: "
+                   << conversions::leaf_certificate_type_to_string(certificate_type);
 
     GetCertificateFullInfoResult result;
 
+    // Selected again on the next request, unless a leaf was loaded
+    if (selection != nullptr) {
+        selection->not_after.reset();
+        selection->reselect_at = 0;
+        selection->info.reset();
+    }
+
     fs::path key_dir;
     fs::path cert_dir;
     CaCertificateType root_type;
@@ -1178,12 +1726,27 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
         return result;
     }
 
-    fs::path root_dir = ca_bundle_path_map[root_type];
 
     // choose appropriate cert (valid_from / valid_to)
     try {
         auto leaf_certificates = X509CertificateBundle(cert_dir, EncodingFormat::PEM);
 
+        // The validity of the wrappers is relative to their load
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+        if (selection != nullptr) {
+            // A leaf that becomes valid can be selected instead
+            selection->reselect_at = std::numeric_limits<std::int64_t>::max();
+            leaf_certificates.for_each_chain([&](const fs::path&, const std::vector<X509Wrapper>& chain) {
+                if (not chain.empty() && chain.at(0).get_valid_in() > 0) {
+                    selection->reselect_at = std::min(selection->reselect_at, now + chain.at(0).get_valid_in());
+                }
+                return true;
+            });
+        }
+
         if (leaf_certificates.empty()) {
             EVLOG_warning << "Could not find any key pair";
             result.status = GetCertificateInfoStatus::NotFound;
@@ -1220,11 +1783,11 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
                         valid_leafs.emplace_back(std::move(key_pair));
 
                         // We found, break
-                        EVLOG_info << "Found valid leaf: [" << chain.at(0).get_file().value() << "]";
+                        EVSE_LOG_debug << "Found valid leaf: [" << chain.at(0).get_file().value() << "]";
 
                         // Collect all if we don't include valid only
                         if (include_all_valid == false) {
-                            EVLOG_info << "Not requiring all valid leafs, returning";
+                            EVSE_LOG_debug << "Not requiring all valid leafs, returning";
                             return false;
                         }
                     } catch (const NoPrivateKeyException& e) {
@@ -1254,6 +1817,49 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
             return result;
         }
 
+        // One hierarchy of the roots and all the leafs, for the roots and the OCSP data of every valid leaf
+        std::optional<X509CertificateHierarchy> hierarchy;
+
+        if (include_ocsp || include_root) {
+            X509CertificateBundle root_bundle = load_ca_bundle(root_type);
+
+            hierarchy.emplace(
+                X509CertificateHierarchy::build_hierarchy(root_bundle.split(), leaf_certificates.split()));
+            EVSE_LOG_debug << "Hierarchy for root/OCSP data: \n" << hierarchy->to_debug_string();
+        }
+
+        // The OCSP cache is searched in the V2G hierarchy of the SECC key directory, see 'retrieve_ocsp_cache', that
+        // is the same hierarchy when the SECC keys are stored with the certificates
+        std::optional<X509CertificateHierarchy> v2g_hierarchy;
+        X509CertificateHierarchy* ocsp_hierarchy = nullptr;
+        OCSPCacheListings ocsp_listings;
+
+        if (include_ocsp) {
+            if (root_type == CaCertificateType::V2G &&
+                cert_dir.lexically_normal() == this->directories.secc_leaf_key_directory.lexically_normal()) {
+                ocsp_hierarchy = &hierarchy.value();
+            } else {
+                try {
+                    X509CertificateBundle ca_bundle = load_ca_bundle(CaCertificateType::V2G);
+                    X509CertificateBundle leaf_bundle(this->directories.secc_leaf_key_directory, EncodingFormat::PEM);
+
+                    ocsp_hierarchy =
+                        &v2g_hierarchy.emplace(X509CertificateHierarchy::build_hierarchy(ca_bundle.split(),
+                                                                                         leaf_bundle.split()));
+                } catch (const CertificateLoadException& e) {
+                    EVLOG_error << "Could not retrieve ocsp cache, certificate load failure: " << e.what();
+                }
+            }
+        }
+
+        auto find_ocsp = [&](const CertificateHashData& hash) -> std::optional<fs::path> {
+            if (ocsp_hierarchy == nullptr) {
+                return std::nullopt;
+            }
+
+            return find_ocsp_cache(*ocsp_hierarchy, hash, ocsp_listings);
+        };
+
         for (const auto& valid_leaf : valid_leafs) {
             // Key path doesn't change
             fs::path key_file = valid_leaf.certificate_key;
@@ -1263,15 +1869,13 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
             std::optional<fs::path> certificate_file;
             std::optional<fs::path> chain_file;
 
-            X509CertificateBundle leaf_directory(cert_dir, EncodingFormat::PEM);
-
             const std::vector<X509Wrapper>* leaf_fullchain = nullptr;
             const std::vector<X509Wrapper>* leaf_single = nullptr;
             int chain_len = 1; // Defaults to 1, single certificate
 
             // We are searching for both the full leaf bundle, containing the leaf and the cso1/2 and the single leaf
             // without the cso1/2
-            leaf_directory.for_each_chain(
+            leaf_certificates.for_each_chain(
                 [&](const std::filesystem::path& path, const std::vector<X509Wrapper>& chain) {
                     // If we contain the latest valid, we found our generated bundle
                     bool leaf_found = (std::find(chain.begin(), chain.end(), certificate) != chain.end());
@@ -1305,36 +1909,30 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
 
             if (leaf_fullchain != nullptr) {
                 chain_file = leaf_fullchain->at(0).get_file();
-                EVLOG_debug << "Leaf fullchain: [" << chain_file.value_or("INVALID") << "]";
+                EVSE_LOG_debug << "Leaf fullchain: [" << chain_file.value_or("INVALID") << "]";
             } else {
-                EVLOG_debug << conversions::leaf_certificate_type_to_string(certificate_type)
-                            << " leaf requires full bundle, but full bundle not found at path: " << cert_dir;
+                EVSE_LOG_debug << conversions::leaf_certificate_type_to_string(certificate_type)
+                               << " leaf requires full bundle, but full bundle not found at path: " << cert_dir;
             }
 
             if (leaf_single != nullptr) {
                 certificate_file = leaf_single->at(0).get_file();
-                EVLOG_debug << "Leaf single: [" << certificate_file.value_or("INVALID") << "]";
+                EVSE_LOG_debug << "Leaf single: [" << certificate_file.value_or("INVALID") << "]";
             } else {
-                EVLOG_debug << conversions::leaf_certificate_type_to_string(certificate_type)
-                            << " single leaf not found at path: " << cert_dir;
+                EVSE_LOG_debug << conversions::leaf_certificate_type_to_string(certificate_type)
+                               << " single leaf not found at path: " << cert_dir;
             }
 
             // Both require the hierarchy build
-            if (include_ocsp || include_root) {
-                X509CertificateBundle root_bundle(root_dir, EncodingFormat::PEM); // Required for hierarchy
-
-                // The hierarchy is required for both roots and the OCSP cache
-                auto hierarchy = X509CertificateHierarchy::build_hierarchy(root_bundle.split(), leaf_directory.split());
-                EVLOG_debug << "Hierarchy for root/OCSP data: \n" << hierarchy.to_debug_string();
-
+            if (hierarchy.has_value()) {
                 // Include OCSP data if possible
                 if (include_ocsp) {
                     // Search for OCSP data for each certificate
                     if (leaf_fullchain != nullptr) {
                         for (const auto& chain_certif : *leaf_fullchain) {
                             try {
-                                CertificateHashData hash = hierarchy.get_certificate_hash(chain_certif);
-                                std::optional<fs::path> data = retrieve_ocsp_cache_internal(hash);
+                                CertificateHashData hash = hierarchy->get_certificate_hash(chain_certif);
+                                std::optional<fs::path> data = find_ocsp(hash);
 
                                 certificate_ocsp.push_back({hash, data});
                             } catch (const NoCertificateFound& e) {
@@ -1344,8 +1942,8 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
                         }
                     } else {
                         try {
-                            CertificateHashData hash = hierarchy.get_certificate_hash(leaf_single->at(0));
-                            certificate_ocsp.push_back({hash, retrieve_ocsp_cache_internal(hash)});
+                            CertificateHashData hash = hierarchy->get_certificate_hash(leaf_single->at(0));
+                            certificate_ocsp.push_back({hash, find_ocsp(hash)});
                         } catch (const NoCertificateFound& e) {
                         }
                     }
@@ -1356,7 +1954,7 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
                     // Search for the root of any of the leafs
                     // present either in the chain or single
                     try {
-                        X509Wrapper leafs_root_cert = hierarchy.find_certificate_root(
+                        X509Wrapper leafs_root_cert = hierarchy->find_certificate_root(
                             leaf_fullchain != nullptr ? leaf_fullchain->at(0) : leaf_single->at(0));
 
                         // Append the root
@@ -1385,6 +1983,12 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
                 info.certificate_root = leafs_root.value();
             }
 
+            if (selection != nullptr && result.info.empty()) {
+                selection->not_after = now + certificate.get_valid_to();
+                selection->reselect_at = std::min(selection->reselect_at, selection->not_after.value() + 1);
+                selection->info = info;
+            }
+
             // Add it to the returned result list
             result.info.push_back(info);
             result.status = GetCertificateInfoStatus::Accepted;
@@ -1401,104 +2005,264 @@ GetCertificateFullInfoResult EvseSecurity::get_full_leaf_certificate_info_intern
     return result;
 }
 
-bool EvseSecurity::update_certificate_links(LeafCertificateType certificate_type) {
-    bool changed = false;
+const EvseSecurity::LeafSelection& EvseSecurity::get_leaf_selection(LeafCertificateType certificate_type,
+                                                                    bool* links_changed) {
+    std::set<fs::path> locations;
 
-    if (certificate_type != LeafCertificateType::V2G) {
-        throw std::runtime_error("Link updating only supported for V2G certificates");
+    if (certificate_type == LeafCertificateType::CSMS) {
+        locations.insert({directories.csms_leaf_cert_directory, directories.csms_leaf_key_directory});
+    } else if (certificate_type == LeafCertificateType::V2G) {
+        locations.insert({directories.secc_leaf_cert_directory, directories.secc_leaf_key_directory});
     }
 
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
 
-    fs::path cert_link_path = this->links.secc_leaf_cert_link;
-    fs::path key_link_path = this->links.secc_leaf_key_link;
-    fs::path chain_link_path = this->links.cpo_cert_chain_link;
+    // Read before the listing, a change made during it changes the generation of the next call
+    const auto change_generation = get_active_storage().get_change_generation({locations.begin(), locations.end()});
 
-    // Get the most recent valid certificate (internal since we already locked mutex)
-    const auto key_pair = this->get_leaf_certificate_info_internal(certificate_type, EncodingFormat::PEM);
-    if ((key_pair.status == GetCertificateInfoStatus::Accepted) && key_pair.info.has_value()) {
+    LeafSelection& cached = get_cache_entry(leaf_selections, certificate_type);
+    const bool selectable = cached.valid && now < cached.reselect_at;
 
-        // Create or update symlinks to SECC leaf cert
-        if (!cert_link_path.empty()) {
-            std::optional<fs::path> cert_path = key_pair.info.value().certificate_single;
+    if (selectable && change_generation.has_value() && cached.change_generation == change_generation) {
+        return cached;
+    }
 
-            if (cert_path.has_value()) {
-                if (fs::is_symlink(cert_link_path)) {
-                    if (fs::read_symlink(cert_link_path) != cert_path.value()) {
-                        fs::remove(cert_link_path);
-                        changed = true;
-                    }
-                }
-                if (!fs::exists(cert_link_path)) {
-                    EVLOG_debug << "SECC cert link: " << cert_link_path << " -> " << cert_path.value();
-                    fs::create_symlink(cert_path.value(), cert_link_path);
-                    changed = true;
-                }
-            }
+    std::vector<StorageStatus> store_status;
+    for (const auto& location : locations) {
+        append_store_status(location, store_status);
+    }
+
+    if (selectable && is_same_store_status(store_status, cached.store_status)) {
+        cached.change_generation = change_generation;
+        return cached;
+    }
+
+    LeafSelection selection;
+    get_full_leaf_certificate_info_internal(certificate_type, EncodingFormat::PEM, false, false, false, &selection);
+
+    selection.valid = true;
+    selection.store_status = std::move(store_status);
+    selection.change_generation = change_generation;
+
+    cached = std::move(selection);
+
+    // The links follow the changes of the selection, instead of being checked on each request
+    if (certificate_type == LeafCertificateType::V2G) {
+        const bool changed = apply_certificate_links(cached);
+        if (links_changed != nullptr) {
+            *links_changed = changed;
         }
+    }
 
-        // Create or update symlinks to SECC leaf key
-        if (!key_link_path.empty()) {
-            fs::path key_path = key_pair.info.value().key;
-            if (fs::is_symlink(key_link_path)) {
-                if (fs::read_symlink(key_link_path) != key_path) {
-                    fs::remove(key_link_path);
-                    changed = true;
-                }
-            }
-            if (!fs::exists(key_link_path)) {
-                EVLOG_debug << "SECC key link: " << key_link_path << " -> " << key_path;
-                fs::create_symlink(key_path, key_link_path);
-                changed = true;
-            }
+    return cached;
+}
+
+std::shared_ptr<const OCSPStaplingPayload>
+EvseSecurity::get_ocsp_stapling_payload(LeafCertificateType certificate_type) {
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type) | V2G_OCSP_SHARDS);
+    ScopedStorage scoped_storage(storage);
+
+    CaCertificateType root_type;
+    std::set<fs::path> locations;
+
+    if (certificate_type == LeafCertificateType::CSMS) {
+        locations.insert({directories.csms_leaf_cert_directory, directories.csms_leaf_key_directory});
+        root_type = CaCertificateType::CSMS;
+    } else if (certificate_type == LeafCertificateType::V2G) {
+        locations.insert({directories.secc_leaf_cert_directory, directories.secc_leaf_key_directory});
+        root_type = CaCertificateType::V2G;
+    } else {
+        EVLOG_warning << "Rejected attempt to retrieve non CSMS/V2G stapling payload";
+        return nullptr;
+    }
+
+    // Same locations as the OCSP cache, that is kept for the V2G certificates
+    locations.insert(directories.secc_leaf_key_directory);
+
+    for (const auto ca_type : {root_type, CaCertificateType::V2G}) {
+        const fs::path& ca_location = ca_bundle_path_map.at(ca_type);
+        locations.insert(ca_location);
+
+        if (get_active_storage().stat(ca_location).type != StorageEntryType::Directory) {
+            locations.insert(ca_location.parent_path() / "ocsp");
         }
+    }
+
+    std::vector<StorageStatus> store_status;
+    for (const auto& location : locations) {
+        append_store_status(location, store_status);
+    }
+
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+
+    StaplingPayloadEntry& cached = get_cache_entry(stapling_payloads, certificate_type);
+    if (cached.valid && now < cached.rebuild_at && is_same_store_status(store_status, cached.store_status)) {
+        return cached.payload;
+    }
+
+    // The selection gives the instant at which another leaf can be selected
+    LeafSelection selection;
+    const auto result =
+        get_full_leaf_certificate_info_internal(certificate_type, EncodingFormat::PEM, true, false, false, &selection);
+    std::int64_t rebuild_at = selection.reselect_at;
+
+    std::shared_ptr<OCSPStaplingPayload> payload;
+
+    if (result.status == GetCertificateInfoStatus::Accepted && !result.info.empty()) {
+        const CertificateInfo& info = result.info.at(0);
+
+        payload = std::make_shared<OCSPStaplingPayload>();
+        payload->certificate = info.certificate.value_or(info.certificate_single.value_or(fs::path()));
 
-        // Create or update symlinks to CPO chain
-        if (key_pair.info.value().certificate.has_value()) {
-            fs::path chain_path = key_pair.info.value().certificate.value();
-            if (!chain_link_path.empty()) {
-                if (fs::is_symlink(chain_link_path)) {
-                    if (fs::read_symlink(chain_link_path) != chain_path) {
-                        fs::remove(chain_link_path);
-                        changed = true;
+        for (const auto& certificate_ocsp : info.ocsp) {
+            std::optional<std::string> response;
+
+            // Only the responses with a good verdict are stapled, until their next update
+            if (certificate_ocsp.ocsp_path.has_value()) {
+                fs::path hash_file = certificate_ocsp.ocsp_path.value();
+                hash_file.replace_extension(CERT_HASH_EXTENSION);
+
+                OCSPVerdict verdict;
+                std::string data;
+
+                if (filesystem_utils::read_ocsp_verdict_from_file(hash_file, verdict) &&
+                    verdict.status == OCSPCertificateStatus::Good) {
+                    const std::int64_t next_update =
+                        verdict.next_update.has_value()
+                            ? std::chrono::duration_cast<std::chrono::seconds>(
+                                  verdict.next_update->time_since_epoch())
+                                  .count()
+                            : std::numeric_limits<std::int64_t>::max();
+
+                    if (next_update > now &&
+                        filesystem_utils::read_from_file(certificate_ocsp.ocsp_path.value(), data)) {
+                        response = std::move(data);
+                        rebuild_at = std::min(rebuild_at, next_update);
                     }
                 }
-                if (!fs::exists(chain_link_path)) {
-                    EVLOG_debug << "CPO cert chain link: " << chain_link_path << " -> " << chain_path;
-                    fs::create_symlink(chain_path, chain_link_path);
-                    changed = true;
-                }
             }
+
+            payload->ocsp.emplace_back(std::move(response));
         }
-    } else {
-        // Remove existing symlinks if no valid certificate is found
-        if (!cert_link_path.empty() && fs::is_symlink(cert_link_path)) {
-            fs::remove(cert_link_path);
-            changed = true;
-        }
-        if (!key_link_path.empty() && fs::is_symlink(key_link_path)) {
-            fs::remove(key_link_path);
-            changed = true;
+    }
+
+    cached = {true, std::move(store_status), rebuild_at, payload};
+    return payload;
+}
+
+bool EvseSecurity::update_certificate_links(LeafCertificateType certificate_type) {
+    if (certificate_type != LeafCertificateType::V2G) {
+        throw std::runtime_error("Link updating only supported for V2G certificates");
+    }
+
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type));
+    ScopedStorage scoped_storage(storage);
+
+    // Applied by a new selection, otherwise only compared with the applied links
+    bool changed = false;
+    const LeafSelection& selection = get_leaf_selection(certificate_type, &changed);
+
+    return apply_certificate_links(selection) || changed;
+}
+
+/// @brief Points the symlink at @p link to @p target, through a temporary link renamed over it so that a reader
+/// always finds either the previous or the new target
+static bool replace_symlink(const fs::path& target, const fs::path& link) {
+    auto& storage = get_active_storage();
+    const fs::path temporary_link = link.parent_path() / ("." + link.filename().string() + ".tmp");
+
+    // Left by an interrupted update
+    storage.remove(temporary_link);
+
+    if (storage.create_symlink(target, temporary_link) && storage.rename(temporary_link, link)) {
+        return true;
+    }
+
+    storage.remove(temporary_link);
+    return false;
+}
+
+bool EvseSecurity::apply_certificate_links(const LeafSelection& selection) {
+    const std::optional<CertificateInfo>& info = selection.info;
+
+    std::vector<std::pair<fs::path, std::optional<fs::path>>> targets;
+    const std::pair<fs::path, std::optional<fs::path>> all_links[] = {
+        {this->links.secc_leaf_cert_link, info.has_value() ? info->certificate_single : std::nullopt},
+        {this->links.secc_leaf_key_link, info.has_value() ? std::optional<fs::path>(info->key) : std::nullopt},
+        {this->links.cpo_cert_chain_link, info.has_value() ? info->certificate : std::nullopt}};
+
+    for (const auto& link : all_links) {
+        if (!link.first.empty()) {
+            targets.push_back(link);
         }
-        if (!chain_link_path.empty() && fs::is_symlink(chain_link_path)) {
-            fs::remove(chain_link_path);
+    }
+
+    // Unchanged selection, the links are not accessed
+    if (links_applied && targets == applied_links) {
+        return false;
+    }
+
+    auto& storage = get_active_storage();
+    bool changed = false;
+    bool applied = true;
+
+    for (const auto& [link_path, target] : targets) {
+        if (target.has_value()) {
+            if (read_symlink_target(link_path) == target.value()) {
+                continue;
+            }
+
+            const StorageStatus status = storage.stat(link_path);
+            if (status.exists() && !status.symlink) {
+                EVLOG_warning << "Not replacing the file at the link path: " << link_path;
+                continue;
+            }
+
+            EVSE_LOG_debug << "SECC link: " << link_path << " -> " << target.value();
+
+            if (replace_symlink(target.value(), link_path)) {
+                changed = true;
+            } else {
+                EVLOG_error << "Could not update the link: " << link_path;
+                applied = false;
+            }
+        } else if (storage.stat(link_path).symlink) {
+            // Remove the links of a leaf that is no longer selected
+            storage.remove(link_path);
             changed = true;
         }
     }
 
+    // A failed link is retried with the next request
+    applied_links = std::move(targets);
+    links_applied = applied;
+
     return changed;
 }
 
 GetCertificateInfoResult EvseSecurity::get_ca_certificate_info_internal(CaCertificateType certificate_type) {
     GetCertificateInfoResult result{};
 
+    if (embedded_ca_bundles.find(certificate_type) != embedded_ca_bundles.end()) {
+        EVLOG_error << "No certificate file for the embedded store: "
+                    << conversions::ca_certificate_type_to_string(certificate_type);
+
+        result.status = GetCertificateInfoStatus::NotFound;
+        return result;
+    }
+
     try {
         // Support bundle files, in case the certificates contain
         // multiple entries (should be 3) as per the specification
         X509CertificateBundle verify_file(this->ca_bundle_path_map.at(certificate_type), EncodingFormat::PEM);
 
-        EVLOG_info << "Requesting certificate file: [" << conversions::ca_certificate_type_to_string(certificate_type)
-                   << "] file:" << verify_file.get_path();
+        EVSE_LOG_debug << "Requesting certificate file: ["
+                       << conversions::ca_certificate_type_to_string(certificate_type)
+                       << "] file:" << verify_file.get_path();
 
         // If we are using a directory, search for the first valid root file
         if (verify_file.is_using_directory()) {
@@ -1538,13 +2302,15 @@ GetCertificateInfoResult EvseSecurity::get_ca_certificate_info_internal(CaCertif
 }
 
 GetCertificateInfoResult EvseSecurity::get_ca_certificate_info(CaCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
     return get_ca_certificate_info_internal(certificate_type);
 }
 
 std::string EvseSecurity::get_verify_file(CaCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
     auto result = get_ca_certificate_info_internal(certificate_type);
 
@@ -1559,7 +2325,14 @@ std::string EvseSecurity::get_verify_file(CaCertificateType certificate_type) {
 
 std::string EvseSecurity::get_verify_location(CaCertificateType certificate_type) {
 
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_ca_shard(certificate_type));
+    ScopedStorage scoped_storage(storage);
+
+    if (embedded_ca_bundles.find(certificate_type) != embedded_ca_bundles.end()) {
+        EVLOG_error << "No certificate location for the embedded store: "
+                    << conversions::ca_certificate_type_to_string(certificate_type);
+        return {};
+    }
 
     try {
         // Support bundle files, in case the certificates contain
@@ -1568,8 +2341,9 @@ std::string EvseSecurity::get_verify_location(CaCertificateType certificate_type
 
         const auto location_path = verify_location.get_path();
 
-        EVLOG_info << "Requesting certificate location: ["
-                   << conversions::ca_certificate_type_to_string(certificate_type) << "] location:" << location_path;
+        EVSE_LOG_debug << "Requesting certificate location: ["
+                       << conversions::ca_certificate_type_to_string(certificate_type)
+                       << "] location:" << location_path;
 
         if (!verify_location.empty() &&
             (!verify_location.is_using_directory() || hash_dir(location_path.c_str()) == 0)) {
@@ -1588,44 +2362,156 @@ std::string EvseSecurity::get_verify_location(CaCertificateType certificate_type
 }
 
 int EvseSecurity::get_leaf_expiry_days_count(LeafCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type));
+    ScopedStorage scoped_storage(storage);
 
-    EVLOG_info << "Requesting certificate expiry: " << conversions::leaf_certificate_type_to_string(certificate_type);
+    EVSE_LOG_debug << "Requesting certificate expiry: "
+                   << conversions::leaf_certificate_type_to_string(certificate_type);
 
-    // Internal since we already locked mutex
-    const auto key_pair = this->get_leaf_certificate_info_internal(certificate_type, EncodingFormat::PEM, false);
-    if (key_pair.status == GetCertificateInfoStatus::Accepted) {
-        try {
-            fs::path certificate_path;
+    const LeafSelection& selection = get_leaf_selection(certificate_type);
+    if (selection.not_after.has_value()) {
+        const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
 
-            if (key_pair.info.has_value()) {
-                if (key_pair.info.value().certificate.has_value()) {
-                    certificate_path = key_pair.info.value().certificate.value();
-                } else {
-                    certificate_path = key_pair.info.value().certificate_single.value();
+        return std::chrono::duration_cast<days_to_seconds>(std::chrono::seconds(selection.not_after.value() - now))
+            .count();
+    }
+
+    return 0;
+}
+
+std::size_t EvseSecurity::register_expiry_watch(const std::vector<int>& threshold_days,
+                                                const std::function<void(const CertificateExpiry&)>& callback) {
+    std::size_t watch_id = 0;
+    bool start_timer = false;
+
+    {
+        std::lock_guard<std::mutex> lock(expiry_watch_mutex);
+
+        watch_id = next_expiry_watch_id++;
+        expiry_watches[watch_id] = {threshold_days, callback, {}};
+
+        start_timer = !expiry_watch_timer_started;
+        expiry_watch_timer_started = true;
+    }
+
+    // Started once, outside of the lock that the timer callback takes
+    if (start_timer) {
+        expiry_watch_timer.interval([this]() { this->check_expiry_watches(); }, EXPIRY_WATCH_INTERVAL);
+    }
+
+    check_expiry_watches();
+    return watch_id;
+}
+
+void EvseSecurity::unregister_expiry_watch(std::size_t watch_id) {
+    std::lock_guard<std::mutex> lock(expiry_watch_mutex);
+    expiry_watches.erase(watch_id);
+}
+
+void EvseSecurity::check_expiry_watches() {
+    using ExpiryKey = std::pair<std::variant<LeafCertificateType, CaCertificateType>, std::int64_t>;
+    std::vector<ExpiryKey> expiries;
+
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+
+    // Selected again once the leaf expired or another became valid, which also updates the certificate links
+    for (const auto leaf_type : {LeafCertificateType::CSMS, LeafCertificateType::V2G}) {
+        PathShardGuard guard(this->path_locks, get_leaf_shards(leaf_type));
+        ScopedStorage scoped_storage(storage);
+
+        const LeafSelection& selection = get_leaf_selection(leaf_type);
+        if (selection.not_after.has_value()) {
+            expiries.emplace_back(leaf_type, selection.not_after.value());
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(expiry_watch_mutex);
+        if (expiry_watches.empty()) {
+            return;
+        }
+    }
+
+    for (const auto ca_type :
+         {CaCertificateType::V2G, CaCertificateType::MO, CaCertificateType::CSMS, CaCertificateType::MF}) {
+        PathShardGuard guard(this->path_locks, get_ca_shard(ca_type));
+        ScopedStorage scoped_storage(storage);
+
+        const auto embedded = embedded_ca_bundles.find(ca_type);
+        if (embedded != embedded_ca_bundles.end()) {
+            for (const auto& anchor : embedded->second) {
+                if (anchor.not_before <= now && now <= anchor.not_after) {
+                    expiries.emplace_back(ca_type, anchor.not_after);
                 }
             }
+            continue;
+        }
 
-            if (certificate_path.empty() == false) {
-                // In case it is a bundle, we know the leaf is always the first
-                X509CertificateBundle cert(certificate_path, EncodingFormat::PEM);
-
-                int64_t seconds = cert.split().at(0).get_valid_to();
-                return std::chrono::duration_cast<days_to_seconds>(std::chrono::seconds(seconds)).count();
+        try {
+            for (const auto& [not_before, not_after] : get_trust_index_entry(ca_type).roots.validity) {
+                if (not_before <= now && now <= not_after) {
+                    expiries.emplace_back(ca_type, not_after);
+                }
             }
         } catch (const CertificateLoadException& e) {
-            EVLOG_error << "Could not obtain leaf expiry certificate: " << e.what();
+            // Not installed, nothing to watch
         }
     }
 
-    return 0;
+    std::vector<std::pair<std::function<void(const CertificateExpiry&)>, CertificateExpiry>> events;
+
+    {
+        std::lock_guard<std::mutex> lock(expiry_watch_mutex);
+
+        for (auto& [watch_id, watch] : expiry_watches) {
+            std::map<ExpiryKey, int> notified;
+
+            for (const auto& expiry : expiries) {
+                const auto& [certificate_type, not_after] = expiry;
+                const int days_left = static_cast<int>(
+                    std::chrono::duration_cast<days_to_seconds>(std::chrono::seconds(not_after - now)).count());
+
+                // Smallest threshold crossed, that was not notified yet for this certificate
+                std::optional<int> crossed;
+                for (const int threshold : watch.threshold_days) {
+                    if (days_left <= threshold && (!crossed.has_value() || threshold < crossed.value())) {
+                        crossed = threshold;
+                    }
+                }
+
+                const auto previous = watch.notified.find(expiry);
+                if (previous != watch.notified.end()) {
+                    notified[expiry] = previous->second;
+                }
+
+                if (crossed.has_value() && (previous == watch.notified.end() || crossed.value() < previous->second)) {
+                    notified[expiry] = crossed.value();
+                    events.emplace_back(watch.callback,
+                                        CertificateExpiry{certificate_type,
+                                                          std::chrono::system_clock::time_point(
+                                                              std::chrono::seconds(not_after)),
+                                                          days_left, crossed.value()});
+                }
+            }
+
+            // Renewed and removed certificates are forgotten
+            watch.notified = std::move(notified);
+        }
+    }
+
+    for (const auto& [callback, event] : events) {
+        callback(event);
+    }
 }
 
 bool EvseSecurity::verify_file_signature(const fs::path& path, const std::string& signing_certificate,
                                          const std::string signature) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
-
-    EVLOG_info << "Verifying file signature for " << path.string();
+    // Static, does not access a store
+    EVSE_LOG_info << "Verifying file signature for " << path.string();
 
     std::vector<std::uint8_t> sha256_digest;
 
@@ -1645,7 +2531,7 @@ bool EvseSecurity::verify_file_signature(const fs::path& path, const std::string
         X509Wrapper x509_signing_cerificate(signing_certificate, EncodingFormat::PEM);
 
         if (CryptoSupplier::x509_verify_signature(x509_signing_cerificate.get(), signature_decoded, sha256_digest)) {
-            EVLOG_debug << "Signature successful verification";
+            EVSE_LOG_debug << "Signature successful verification";
             return true;
         } else {
             EVLOG_error << "Failure to verify signature";
@@ -1701,14 +2587,15 @@ std::string EvseSecurity::base64_encode_from_string(const std::string& string) {
 
 CertificateValidationResult EvseSecurity::verify_certificate(const std::string& certificate_chain,
                                                              LeafCertificateType certificate_type) {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    PathShardGuard guard(this->path_locks, get_leaf_shards(certificate_type) & CA_SHARDS);
+    ScopedStorage scoped_storage(storage);
 
     return verify_certificate_internal(certificate_chain, certificate_type);
 }
 
 CertificateValidationResult EvseSecurity::verify_certificate_internal(const std::string& certificate_chain,
                                                                       LeafCertificateType certificate_type) {
-    EVLOG_info << "Verifying leaf certificate: " << conversions::leaf_certificate_type_to_string(certificate_type);
+    EVSE_LOG_debug << "Verifying leaf certificate: " << conversions::leaf_certificate_type_to_string(certificate_type);
 
     CaCertificateType ca_certificate_type;
 
@@ -1737,6 +2624,43 @@ CertificateValidationResult EvseSecurity::verify_certificate_internal(const std:
             return CertificateValidationResult::Unknown;
         }
 
+        // Most invalid chains (expired, other PKI) are rejected by the index of the CA bundle alone
+        const CertificateValidationResult precheck =
+            get_trust_index_entry(ca_certificate_type).index->precheck(_certificate_chain);
+
+        if (precheck != CertificateValidationResult::Valid) {
+            EVSE_LOG_info << "Certificate chain rejected by the trust index of: "
+                          << conversions::ca_certificate_type_to_string(ca_certificate_type);
+            return precheck;
+        }
+
+        // The revoked leafs and intermediates are looked up by issuer and serial, the lists are not passed to OpenSSL
+        const RevocationIndex& revocation_index = get_revocation_index(ca_certificate_type);
+
+        if (!revocation_index.revoked.empty()) {
+            const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                                 std::chrono::system_clock::now().time_since_epoch())
+                                 .count();
+
+            // A stale list still revokes its certificates
+            for (const auto& crl : revocation_index.crls) {
+                if (crl.next_update.has_value() && crl.next_update.value() < now) {
+                    EVLOG_warning << "Revocation list of: "
+                                  << conversions::ca_certificate_type_to_string(ca_certificate_type)
+                                  << " is past its next update";
+                }
+            }
+
+            for (const auto& cert : _certificate_chain) {
+                if (!cert.is_selfsigned() &&
+                    revocation_index.revoked.count(to_revocation_key(cert.get_issuer_name_hash(),
+                                                                     cert.get_serial_number())) != 0) {
+                    EVLOG_warning << "Revoked certificate in chain: " << cert.get_common_name();
+                    return CertificateValidationResult::Revoked;
+                }
+            }
+        }
+
         // The leaf is to be verified
         const auto leaf_certificate = _certificate_chain.at(0);
 
@@ -1761,33 +2685,26 @@ CertificateValidationResult EvseSecurity::verify_certificate_internal(const std:
         // Build the trusted parent certificates from our internal store
         std::vector<X509Handle*> trusted_parent_certificates;
 
-        fs::path root_store = this->ca_bundle_path_map.at(ca_certificate_type);
         CertificateValidationResult validated{};
 
-        if (fs::is_directory(root_store)) {
-            // In case of a directory load the certificates manually and add them
-            // to the parent certificates
-            X509CertificateBundle roots(root_store, EncodingFormat::PEM);
-
-            // We use a root chain instead of relying on OpenSSL since that requires to have
-            // the name of the certificates in the format "hash.0", hash being the subject hash
-            // or to have symlinks in the mentioned format to the certificates in the directory
-            std::vector<X509Wrapper> root_chain{roots.split()};
+        // Load the certificates manually and add them to the parent certificates, for both
+        // directories and bundle files, since OpenSSL would read them outside of our storage
+        X509CertificateBundle roots = load_ca_bundle(ca_certificate_type);
 
-            for (size_t i = 0; i < root_chain.size(); i++) {
-                trusted_parent_certificates.emplace_back(root_chain[i].get());
-            }
+        // We use a root chain instead of relying on OpenSSL since that requires to have
+        // the name of the certificates in the format "hash.0", hash being the subject hash
+        // or to have symlinks in the mentioned format to the certificates in the directory
+        std::vector<X509Wrapper> root_chain{roots.split()};
 
-            // The root_chain stores the X509Handler pointers, if this goes out of scope then
-            // parent_certificates will point to nothing.
-            validated =
-                CryptoSupplier::x509_verify_certificate_chain(leaf_certificate.get(), trusted_parent_certificates,
-                                                              untrusted_subcas, true, std::nullopt, std::nullopt);
-        } else {
-            validated = CryptoSupplier::x509_verify_certificate_chain(
-                leaf_certificate.get(), trusted_parent_certificates, untrusted_subcas, true, std::nullopt, root_store);
+        for (size_t i = 0; i < root_chain.size(); i++) {
+            trusted_parent_certificates.emplace_back(root_chain[i].get());
         }
 
+        // The root_chain stores the X509Handler pointers, if this goes out of scope then
+        // parent_certificates will point to nothing.
+        validated = CryptoSupplier::x509_verify_certificate_chain(leaf_certificate.get(), trusted_parent_certificates,
+                                                                  untrusted_subcas, true, std::nullopt, std::nullopt);
+
         return validated;
     } catch (const CertificateLoadException& e) {
         EVLOG_warning << "Could not validate certificate chain because of invalid format";
@@ -1795,17 +2712,44 @@ CertificateValidationResult EvseSecurity::verify_certificate_internal(const std:
     }
 }
 
+std::optional<std::uint64_t> EvseSecurity::get_store_generation() {
+    PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
+    ScopedStorage scoped_storage(storage);
+
+    std::set<fs::path> locations = {directories.secc_leaf_cert_directory, directories.secc_leaf_key_directory,
+                                    directories.csms_leaf_cert_directory, directories.csms_leaf_key_directory};
+
+    for (const auto& [certificate_type, location] : ca_bundle_path_map) {
+        if (embedded_ca_bundles.find(certificate_type) == embedded_ca_bundles.end()) {
+            locations.insert(get_bundle_directory(get_active_storage(), location));
+        }
+    }
+
+    return get_active_storage().get_change_generation({locations.begin(), locations.end()});
+}
+
 void EvseSecurity::garbage_collect() {
-    std::lock_guard<std::mutex> guard(EvseSecurity::security_mutex);
+    ScopedStorage scoped_storage(storage);
 
-    // Only garbage collect if we are full
-    if (is_filesystem_full() == false) {
-        EVLOG_debug << "Garbage collect postponed, filesystem is not full";
-        return;
+    {
+        PathShardGuard guard(this->path_locks, ALL_PATH_SHARDS);
+
+        // Only garbage collect if we are full
+        if (is_filesystem_full() == false) {
+            EVSE_LOG_debug << "Garbage collect postponed, filesystem is not full";
+            return;
+        }
     }
 
-    EVLOG_info << "Starting garbage collect!";
+    EVSE_LOG_info << "Starting garbage collect!";
+
+    std::size_t managed_csr_count = 0;
+    {
+        std::lock_guard<std::mutex> lock(managed_csr_mutex);
+        managed_csr_count = managed_csr.size();
+    }
 
+    // Each domain is collected with its shards only, the operations of the other domains are not blocked
     std::vector<std::tuple<fs::path, fs::path, CaCertificateType>> leaf_paths;
 
     leaf_paths.push_back(std::make_tuple(this->directories.csms_leaf_cert_directory,
@@ -1813,17 +2757,21 @@ void EvseSecurity::garbage_collect() {
     leaf_paths.push_back(std::make_tuple(this->directories.secc_leaf_cert_directory,
                                          this->directories.secc_leaf_key_directory, CaCertificateType::V2G));
 
-    // Delete certificates first, give the option to cleanup the dangling keys afterwards
-    std::set<fs::path> invalid_certificate_files;
-
-    // Private keys that are linked to the skipped certificates and that will not be deleted regardless
-    std::set<fs::path> protected_private_keys;
-
     // Order by latest valid, and keep newest with a safety limit
     for (auto const& [cert_dir, key_dir, ca_type] : leaf_paths) {
+        PathShardGuard guard(this->path_locks,
+                             get_leaf_shards(ca_type == CaCertificateType::V2G ? LeafCertificateType::V2G
+                                                                                : LeafCertificateType::CSMS));
+
+        // Delete certificates first, give the option to cleanup the dangling keys afterwards
+        std::set<fs::path> invalid_certificate_files;
+
+        // Private keys that are linked to the skipped certificates and that will not be deleted regardless
+        std::set<fs::path> protected_private_keys;
+
         // Root bundle required for hash of OCSP cache
         try {
-            X509CertificateBundle root_bundle(ca_bundle_path_map[ca_type], EncodingFormat::PEM);
+            X509CertificateBundle root_bundle = load_ca_bundle(ca_type);
             X509CertificateBundle expired_certs(cert_dir, EncodingFormat::PEM);
 
             // Only handle if we have more than the minimum certificates entry
@@ -1868,22 +2816,20 @@ void EvseSecurity::garbage_collect() {
                                     if (chain[0].get_file().has_value()) {
                                         const auto ocsp_path = chain[0].get_file().value().parent_path() / "ocsp";
 
-                                        if (fs::exists(ocsp_path)) {
-                                            for (const auto& hash_entry : fs::directory_iterator(ocsp_path)) {
-                                                if (hash_entry.is_regular_file() == false) {
-                                                    continue;
-                                                }
+                                        std::vector<fs::path> hash_entries;
+
+                                        if (filesystem_utils::list_files(ocsp_path, false, hash_entries)) {
+                                            for (const auto& hash_entry : hash_entries) {
                                                 // Attempt hash read
                                                 CertificateHashData read_hash;
 
-                                                if (filesystem_utils::read_hash_from_file(hash_entry.path(),
-                                                                                          read_hash) &&
+                                                if (filesystem_utils::read_hash_from_file(hash_entry, read_hash) &&
                                                     read_hash == ocsp_hash) {
 
-                                                    auto oscp_data_path = hash_entry.path();
+                                                    auto oscp_data_path = hash_entry;
                                                     oscp_data_path.replace_extension(DER_EXTENSION);
 
-                                                    invalid_certificate_files.emplace(hash_entry.path());
+                                                    invalid_certificate_files.emplace(hash_entry);
                                                     invalid_certificate_files.emplace(oscp_data_path);
                                                 }
                                             }
@@ -1900,6 +2846,7 @@ void EvseSecurity::garbage_collect() {
                                 protected_private_keys.emplace(key_file);
 
                                 // Erase all protected keys from the managed CRSs
+                                std::lock_guard<std::mutex> lock(managed_csr_mutex);
                                 auto it = managed_csr.find(key_file);
                                 if (it != managed_csr.end()) {
                                     managed_csr.erase(it);
@@ -1923,94 +2870,71 @@ void EvseSecurity::garbage_collect() {
         } catch (const CertificateLoadException& e) {
             EVLOG_warning << "Could not load bundle from file: " << e.what();
         }
-    } // End leaf for iteration
 
-    for (const auto& expired_certificate_file : invalid_certificate_files) {
-        if (filesystem_utils::delete_file(expired_certificate_file))
-            EVLOG_info << "Deleted expired certificate file: " << expired_certificate_file;
-        else
-            EVLOG_warning << "Error deleting expired certificate file: " << expired_certificate_file;
-    }
+        const std::vector<fs::path> expired_certificate_files(invalid_certificate_files.begin(),
+                                                              invalid_certificate_files.end());
+        std::vector<bool> deleted;
+        filesystem_utils::delete_files(expired_certificate_files, deleted);
 
-    // In case of a reset, the managed CSRs can be lost. In that case add them back to the list
-    // to give the change of a CSR to be fulfilled. Eventually the GC will delete those CSRs
-    // at a further invocation after the GC timer will elapse a few times. This behavior
-    // was added so that if we have a reset and the CSMS sends us a CSR response while we were
-    // down it should still be processed when we boot up and NOT delete the CSRs
-    for (auto const& [cert_dir, keys_dir, ca_type] : leaf_paths) {
-        fs::path cert_path = cert_dir;
-        fs::path key_path = keys_dir;
+        for (std::size_t i = 0; i < expired_certificate_files.size(); i++) {
+            if (deleted[i])
+                EVSE_LOG_info << "Deleted expired certificate file: " << expired_certificate_files[i];
+            else
+                EVLOG_warning << "Error deleting expired certificate file: " << expired_certificate_files[i];
+        }
+    } // End leaf for iteration
 
-        for (const auto& key_entry : fs::recursive_directory_iterator(key_path)) {
-            auto key_file_path = key_entry.path();
+    {
+        // The keys and journals are kept in the key directories
+        PathShardGuard csr_guard(this->path_locks, SECC_LEAF_SHARD | CSMS_LEAF_SHARD);
+        std::lock_guard<std::mutex> csr_lock(managed_csr_mutex);
 
-            // Skip protected keys
-            if (protected_private_keys.find(key_file_path) != protected_private_keys.end()) {
-                continue;
-            }
+        // Delete all managed private keys of a CSR that we did not had a response to
+        auto now_timepoint = std::chrono::steady_clock::now();
 
-            if (is_keyfile(key_file_path)) {
-                bool error = false;
+        // The update_leaf_certificate function is responsible for removing responded CSRs from this managed list
+        for (auto it = managed_csr.begin(); it != managed_csr.end();) {
+            std::chrono::seconds elapsed =
+                std::chrono::duration_cast<std::chrono::seconds>(now_timepoint - it->second.timepoint);
 
-                try {
-                    // Check if we have found any matching certificate
-                    get_certificate_path_of_key(key_file_path, keys_dir, this->private_key_password);
-                } catch (const NoCertificateValidException& e) {
-                    // If we did not found, add to the potential delete list
-                    EVLOG_debug << "Could not find matching certificate for key: " << key_file_path
-                                << " adding to potential deletes";
-                    error = true;
-                } catch (const NoPrivateKeyException& e) {
-                    EVLOG_debug << "Could not load private key: " << key_file_path << " adding to potential deletes";
-                    error = true;
-                }
+            if (elapsed > csr_expiry) {
+                EVSE_LOG_debug << "Found expired csr key, deleting: " << it->first;
+                filesystem_utils::delete_file(it->first);
 
-                if (error) {
-                    // Give a chance to be fulfilled by the CSMS
-                    if (managed_csr.find(key_file_path) == managed_csr.end()) {
-                        managed_csr.emplace(key_file_path, std::chrono::steady_clock::now());
-                    }
-                }
+                it = managed_csr.erase(it);
+            } else {
+                ++it;
             }
         }
-    }
-
-    // Delete all managed private keys of a CSR that we did not had a response to
-    auto now_timepoint = std::chrono::steady_clock::now();
-
-    // The update_leaf_certificate function is responsible for removing responded CSRs from this managed list
-    for (auto it = managed_csr.begin(); it != managed_csr.end();) {
-        std::chrono::seconds elapsed = std::chrono::duration_cast<std::chrono::seconds>(now_timepoint - it->second);
 
-        if (elapsed > csr_expiry) {
-            EVLOG_debug << "Found expired csr key, deleting: " << it->first;
-            filesystem_utils::delete_file(it->first);
-
-            it = managed_csr.erase(it);
-        } else {
-            ++it;
+        // Drop the removed entries from the journals
+        if (managed_csr.size() != managed_csr_count) {
+            compact_managed_csr_journals();
         }
     }
 
-    std::set<fs::path> invalid_ocsp_files;
-
     // Delete all non-owned OCSP data
     for (const auto& leaf_certificate_path :
          {directories.secc_leaf_cert_directory, directories.csms_leaf_cert_directory}) {
-        try {
-            bool secc = (leaf_certificate_path == directories.secc_leaf_cert_directory);
-            bool csms = (leaf_certificate_path == directories.csms_leaf_cert_directory) ||
-                        (directories.csms_leaf_cert_directory == directories.secc_leaf_cert_directory);
+        bool secc = (leaf_certificate_path == directories.secc_leaf_cert_directory);
+        bool csms = (leaf_certificate_path == directories.csms_leaf_cert_directory) ||
+                    (directories.csms_leaf_cert_directory == directories.secc_leaf_cert_directory);
 
-            CaCertificateType load;
+        CaCertificateType load;
 
-            if (secc)
-                load = CaCertificateType::V2G;
-            else if (csms)
-                load = CaCertificateType::CSMS;
+        if (secc)
+            load = CaCertificateType::V2G;
+        else if (csms)
+            load = CaCertificateType::CSMS;
+
+        PathShardGuard guard(this->path_locks,
+                             get_leaf_shards(secc ? LeafCertificateType::V2G : LeafCertificateType::CSMS));
 
+        std::set<fs::path> invalid_ocsp_files;
+
+        try {
             // Also load the roots since we need to build the hierarchy for correct certificate hashes
-            X509CertificateBundle root_bundle(ca_bundle_path_map[load], EncodingFormat::PEM);
+            X509CertificateBundle root_bundle = load_ca_bundle(load);
             X509CertificateBundle leaf_bundle(leaf_certificate_path, EncodingFormat::PEM);
 
             fs::path leaf_ocsp;
@@ -2033,22 +2957,20 @@ void EvseSecurity::garbage_collect() {
 
             // Iterate all hashes folders and see if any are missing
             for (auto& ocsp_dir : {leaf_ocsp, root_ocsp}) {
-                if (fs::exists(ocsp_dir)) {
-                    for (auto& ocsp_entry : fs::directory_iterator(ocsp_dir)) {
-                        if (ocsp_entry.is_regular_file() == false) {
-                            continue;
-                        }
+                std::vector<fs::path> ocsp_entries;
 
+                if (filesystem_utils::list_files(ocsp_dir, false, ocsp_entries)) {
+                    for (auto& ocsp_entry : ocsp_entries) {
                         // Attempt hash read
                         CertificateHashData read_hash;
 
-                        if (filesystem_utils::read_hash_from_file(ocsp_entry.path(), read_hash)) {
+                        if (filesystem_utils::read_hash_from_file(ocsp_entry, read_hash)) {
                             // If we can't find the has, it means it was deleted somehow, add to delete list
                             if (hierarchy.contains_certificate_hash(read_hash) == false) {
-                                auto oscp_data_path = ocsp_entry.path();
+                                auto oscp_data_path = ocsp_entry;
                                 oscp_data_path.replace_extension(DER_EXTENSION);
 
-                                invalid_ocsp_files.emplace(ocsp_entry.path());
+                                invalid_ocsp_files.emplace(ocsp_entry);
                                 invalid_ocsp_files.emplace(oscp_data_path);
                             }
                         }
@@ -2058,54 +2980,310 @@ void EvseSecurity::garbage_collect() {
         } catch (const CertificateLoadException& e) {
             EVLOG_warning << "Could not load ca bundle from file: " << leaf_certificate_path;
         }
+
+        const std::vector<fs::path> invalid_ocsp_paths(invalid_ocsp_files.begin(), invalid_ocsp_files.end());
+        std::vector<bool> deleted;
+        filesystem_utils::delete_files(invalid_ocsp_paths, deleted);
+
+        for (std::size_t i = 0; i < invalid_ocsp_paths.size(); i++) {
+            if (deleted[i])
+                EVSE_LOG_info << "Deleted invalid ocsp file: " << invalid_ocsp_paths[i];
+            else
+                EVLOG_warning << "Error deleting invalid ocsp file: " << invalid_ocsp_paths[i];
+        }
+    }
+}
+
+void EvseSecurity::load_managed_csr_journals() {
+    const auto system_now = std::chrono::system_clock::now();
+    const auto steady_now = std::chrono::steady_clock::now();
+
+    // Key directories can be shared between the leaf types
+    std::map<fs::path, fs::path> journals;
+    for (const auto& key_directory : {directories.csms_leaf_key_directory, directories.secc_leaf_key_directory}) {
+        journals.emplace((key_directory / MANAGED_CSR_JOURNAL_FILE).lexically_normal(), key_directory);
+    }
+
+    // Content of the journals as read, to skip their compaction if nothing changed
+    std::map<fs::path, std::optional<std::string>> loaded_journals;
+
+    for (auto const& [journal_path, key_directory] : journals) {
+        std::string journal;
+
+        if (filesystem_utils::exists(journal_path) && filesystem_utils::read_from_file(journal_path, journal)) {
+            loaded_journals[journal_path] = journal;
+
+            std::istringstream records(journal);
+            std::string record;
+
+            while (std::getline(records, record)) {
+                std::istringstream fields(record);
+                std::string operation;
+                fields >> operation;
+
+                if (operation == "add") {
+                    std::int64_t created;
+                    std::string key_hash;
+                    std::string key_file;
+
+                    // Skip records that were not completely written
+                    if (!(fields >> created >> key_hash) || !std::getline(fields >> std::ws, key_file)) {
+                        continue;
+                    }
+
+                    ManagedCsr entry;
+                    entry.created = std::chrono::system_clock::time_point(std::chrono::seconds(created));
+                    entry.key_hash = (key_hash == "-") ? std::string() : key_hash;
+
+                    // Continue from the already elapsed time, a clock that was set back counts as no elapsed time
+                    const auto elapsed = std::max(system_now - entry.created, std::chrono::system_clock::duration(0));
+                    entry.timepoint =
+                        steady_now - std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed);
+
+                    managed_csr[key_file] = std::move(entry);
+                } else if (operation == "del") {
+                    std::string key_file;
+
+                    if (std::getline(fields >> std::ws, key_file)) {
+                        managed_csr.erase(key_file);
+                    }
+                }
+            }
+        } else {
+            // No journal yet, give the keys that do not have a certificate the chance to be fulfilled
+            // by the CSMS, they will be deleted by the GC after the CSR expiry
+            EVSE_LOG_info << "No managed CSR journal found at: " << journal_path << ", scanning keys";
+
+            std::vector<fs::path> key_files;
+            filesystem_utils::list_files(key_directory, true, key_files);
+
+            for (const auto& key_file_path : key_files) {
+                if (is_keyfile(key_file_path) == false) {
+                    continue;
+                }
+
+                bool error = false;
+
+                try {
+                    // Check if we have found any matching certificate
+                    get_certificate_path_of_key(key_file_path, key_directory, this->private_key_password);
+                } catch (const NoCertificateValidException& e) {
+                    EVSE_LOG_debug << "Could not find matching certificate for key: " << key_file_path
+                                   << " adding to potential deletes";
+                    error = true;
+                } catch (const NoPrivateKeyException& e) {
+                    EVSE_LOG_debug << "Could not load private key: " << key_file_path << " adding to potential deletes";
+                    error = true;
+                }
+
+                if (error && managed_csr.find(key_file_path) == managed_csr.end()) {
+                    ManagedCsr entry;
+                    entry.timepoint = steady_now;
+                    entry.created = system_now;
+
+                    managed_csr.emplace(key_file_path, std::move(entry));
+                }
+            }
+        }
     }
 
-    for (const auto& invalid_ocsp : invalid_ocsp_files) {
-        if (filesystem_utils::delete_file(invalid_ocsp))
-            EVLOG_info << "Deleted invalid ocsp file: " << invalid_ocsp;
-        else
-            EVLOG_warning << "Error deleting invalid ocsp file: " << invalid_ocsp;
+    // Keys can be removed while we are not running, or were never written for a failed CSR
+    for (auto it = managed_csr.begin(); it != managed_csr.end();) {
+        if (filesystem_utils::exists(it->first)) {
+            ++it;
+        } else {
+            it = managed_csr.erase(it);
+        }
     }
+
+    // Only the journals that changed are written, not on each start
+    compact_managed_csr_journals(&loaded_journals);
 }
 
-bool EvseSecurity::is_filesystem_full() {
-    std::set<fs::path> unique_paths;
+bool EvseSecurity::append_managed_csr_journal(const fs::path& key_path, const ManagedCsr* entry) {
+    const auto journal_path = get_managed_csr_journal_path(this->directories, key_path);
 
-    // Collect all bundles
-    for (auto const& [certificate_type, ca_bundle_path] : ca_bundle_path_map) {
-        if (fs::is_regular_file(ca_bundle_path)) {
-            unique_paths.emplace(ca_bundle_path);
-        } else if (fs::is_directory(ca_bundle_path)) {
-            for (const auto& entry : fs::recursive_directory_iterator(ca_bundle_path)) {
-                if (fs::is_regular_file(entry)) {
-                    unique_paths.emplace(entry);
+    const std::string record = get_managed_csr_record(key_path, entry);
+
+    if (false == filesystem_utils::write_to_file(journal_path, record, std::ios::app) ||
+        false == get_active_storage().sync(journal_path)) {
+        EVLOG_warning << "Could not write managed CSR journal: " << journal_path;
+        return false;
+    }
+
+    return true;
+}
+
+void EvseSecurity::compact_managed_csr_journals(const std::map<fs::path, std::optional<std::string>>* current) {
+    std::map<fs::path, std::string> journals;
+
+    // Always rewrite the journals of the key directories, even if they end up empty
+    for (const auto& key_directory : {directories.csms_leaf_key_directory, directories.secc_leaf_key_directory}) {
+        journals[(key_directory / MANAGED_CSR_JOURNAL_FILE).lexically_normal()];
+    }
+
+    for (auto const& [key_path, entry] : managed_csr) {
+        const auto journal_path = get_managed_csr_journal_path(this->directories, key_path);
+        journals[journal_path] += get_managed_csr_record(key_path, &entry);
+    }
+
+    for (auto const& [journal_path, records] : journals) {
+        if (current != nullptr) {
+            const auto found = current->find(journal_path);
+
+            if (found != current->end() && found->second.has_value() && found->second.value() == records) {
+                continue;
+            }
+        }
+
+        // Replace the journal in one step, so that a power loss leaves either the old or the new one
+        fs::path compacted_path = journal_path;
+        compacted_path += ".tmp";
+
+        if (false == filesystem_utils::write_to_file(compacted_path, records, std::ios::out)) {
+            EVLOG_warning << "Could not write managed CSR journal: " << compacted_path;
+            continue;
+        }
+
+        if (false == get_active_storage().rename(compacted_path, journal_path)) {
+            EVLOG_warning << "Could not replace managed CSR journal: " << journal_path;
+        }
+    }
+}
+
+X509CertificateBundle EvseSecurity::load_ca_bundle(CaCertificateType certificate_type) {
+    const auto embedded = embedded_ca_bundles.find(certificate_type);
+
+    if (embedded != embedded_ca_bundles.end()) {
+        return X509CertificateBundle(embedded->second, ca_bundle_path_map.at(certificate_type));
+    }
+
+    return X509CertificateBundle(ca_bundle_path_map.at(certificate_type), EncodingFormat::PEM);
+}
+
+void EvseSecurity::RootSummary::update(std::int64_t now) {
+    valid_roots = 0;
+    next_transition = std::numeric_limits<std::int64_t>::max();
+
+    for (const auto& [not_before, not_after] : validity) {
+        if (now < not_before) {
+            next_transition = std::min(next_transition, not_before);
+        } else if (now <= not_after) {
+            valid_roots++;
+            next_transition = std::min(next_transition, not_after + 1);
+        }
+    }
+}
+
+EvseSecurity::TrustIndexEntry& EvseSecurity::get_trust_index_entry(CaCertificateType certificate_type) {
+    std::vector<StorageStatus> store_status;
+
+    // The embedded trust anchors never change, their status stays empty
+    if (embedded_ca_bundles.find(certificate_type) == embedded_ca_bundles.end()) {
+        append_store_status(ca_bundle_path_map.at(certificate_type), store_status);
+    }
+
+    TrustIndexEntry& entry = get_cache_entry(trust_indexes, certificate_type);
+    if (entry.index != nullptr && is_same_store_status(store_status, entry.store_status)) {
+        return entry;
+    }
+
+    X509CertificateBundle bundle = load_ca_bundle(certificate_type);
+    const std::vector<X509Wrapper> certificates = bundle.split();
+
+    // The validity of the wrappers is relative to their load
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+
+    RootSummary roots;
+    for (const auto& certificate : certificates) {
+        if (certificate.is_selfsigned()) {
+            roots.validity.emplace_back(now + certificate.get_valid_in(), now + certificate.get_valid_to());
+        }
+    }
+    roots.update(now);
+
+    entry = {std::move(store_status), std::make_shared<const X509TrustIndex>(certificates), std::move(roots)};
+    return entry;
+}
+
+fs::path EvseSecurity::get_crl_path(CaCertificateType certificate_type) {
+    const fs::path& location = ca_bundle_path_map.at(certificate_type);
+    const fs::path file_name = conversions::ca_certificate_type_to_string(certificate_type) + "_REVOCATION_LIST";
+
+    // The directory bundles only load the certificate extensions
+    return get_bundle_directory(get_active_storage(), location) / file_name.string().append(CRL_EXTENSION.string());
+}
+
+const EvseSecurity::RevocationIndex& EvseSecurity::get_revocation_index(CaCertificateType certificate_type) {
+    const fs::path crl_path = get_crl_path(certificate_type);
+    const StorageStatus file_status = get_active_storage().stat(crl_path);
+
+    RevocationIndex& cached = get_cache_entry(revocation_indexes, certificate_type);
+    if (cached.valid && is_same_status(cached.file_status, file_status)) {
+        return cached;
+    }
+
+    RevocationIndex index;
+    index.valid = true;
+    index.file_status = file_status;
+
+    std::string data;
+    if (file_status.type == StorageEntryType::File && filesystem_utils::read_from_file(crl_path, data) &&
+        !data.empty()) {
+        if (CryptoSupplier::x509_crl_load(data, index.crls)) {
+            for (const auto& crl : index.crls) {
+                for (const auto& serial_number : crl.revoked_serial_numbers) {
+                    index.revoked.insert(to_revocation_key(crl.issuer_name_hash, serial_number));
                 }
             }
+        } else {
+            EVLOG_error << "Could not load revocation list: " << crl_path;
         }
     }
 
-    // Collect all key/leafs
-    std::vector<fs::path> key_pairs;
-
-    key_pairs.push_back(directories.csms_leaf_cert_directory);
-    key_pairs.push_back(directories.csms_leaf_key_directory);
-    key_pairs.push_back(directories.secc_leaf_cert_directory);
-    key_pairs.push_back(directories.secc_leaf_key_directory);
-
-    for (auto const& directory : key_pairs) {
-        if (fs::is_regular_file(directory)) {
-            unique_paths.emplace(directory);
-        } else if (fs::is_directory(directory)) {
-            for (const auto& entry : fs::recursive_directory_iterator(directory)) {
-                if (fs::is_regular_file(entry)) {
-                    unique_paths.emplace(entry);
+    return cached = std::move(index);
+}
+
+bool EvseSecurity::is_filesystem_full() {
+    // Sizes by path, the listings return them so that no file has to be stat'ed again
+    std::map<fs::path, uintmax_t> unique_paths;
+    auto& storage = get_active_storage();
+
+    const auto collect = [&](const fs::path& path, bool skip_csr_journal) {
+        const StorageStatus status = storage.stat(path);
+
+        if (status.type == StorageEntryType::File) {
+            unique_paths.emplace(path, status.size);
+        } else if (status.type == StorageEntryType::Directory) {
+            std::vector<std::pair<fs::path, StorageStatus>> entries;
+            filesystem_utils::list_file_entries(path, true, entries);
+
+            for (const auto& [file, file_status] : entries) {
+                // The managed CSR journal is not part of the certificate store
+                if (skip_csr_journal == false || file.filename() != MANAGED_CSR_JOURNAL_FILE) {
+                    unique_paths.emplace(file, file_status.size);
                 }
             }
         }
+    };
+
+    // Collect all bundles, the embedded stores do not use the filesystem
+    for (auto const& [certificate_type, ca_bundle_path] : ca_bundle_path_map) {
+        if (embedded_ca_bundles.find(certificate_type) == embedded_ca_bundles.end()) {
+            collect(ca_bundle_path, false);
+        }
     }
 
+    // Collect all key/leafs
+    collect(directories.csms_leaf_cert_directory, true);
+    collect(directories.csms_leaf_key_directory, true);
+    collect(directories.secc_leaf_cert_directory, true);
+    collect(directories.secc_leaf_key_directory, true);
+
     uintmax_t total_entries = unique_paths.size();
-    EVLOG_debug << "Total entries used: " << total_entries;
+    EVSE_LOG_debug << "Total entries used: " << total_entries;
 
     if (total_entries > max_fs_certificate_store_entries) {
         EVLOG_warning << "Exceeded maximum entries: " << max_fs_certificate_store_entries << " with :" << total_entries
@@ -2114,11 +3292,11 @@ bool EvseSecurity::is_filesystem_full() {
     }
 
     uintmax_t total_size_bytes = 0;
-    for (const auto& path : unique_paths) {
-        total_size_bytes = fs::file_size(path);
+    for (const auto& [path, size] : unique_paths) {
+        total_size_bytes += size;
     }
 
-    EVLOG_debug << "Total bytes used: " << total_size_bytes;
+    EVSE_LOG_debug << "Total bytes used: " << total_size_bytes;
     if (total_size_bytes >= max_fs_usage_bytes) {
         EVLOG_warning << "Exceeded maximum byte size: " << total_size_bytes;
         return true;
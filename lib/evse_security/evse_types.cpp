@@ -170,6 +170,34 @@ std::string get_key_pair_status_to_string(GetCertificateInfoStatus e) {
     }
 };
 
+std::string ocsp_certificate_status_to_string(OCSPCertificateStatus e) {
+    switch (e) {
+    case OCSPCertificateStatus::Good:
+        return "Good";
+    case OCSPCertificateStatus::Revoked:
+        return "Revoked";
+    case OCSPCertificateStatus::Unknown:
+        return "Unknown";
+    case OCSPCertificateStatus::Invalid:
+        return "Invalid";
+    default:
+        throw std::out_of_range("Could not convert OCSPCertificateStatus to string");
+    }
+};
+
+OCSPCertificateStatus string_to_ocsp_certificate_status(const std::string& s) {
+    if (s == "Good")
+        return OCSPCertificateStatus::Good;
+    else if (s == "Revoked")
+        return OCSPCertificateStatus::Revoked;
+    else if (s == "Unknown")
+        return OCSPCertificateStatus::Unknown;
+    else if (s == "Invalid")
+        return OCSPCertificateStatus::Invalid;
+
+    throw std::out_of_range("Could not convert string to OCSPCertificateStatus");
+}
+
 } // namespace conversions
 
 } // namespace evse_security
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/storage/certificate_storage.hpp>
+#include <evse_security/storage/posix_storage.hpp>
+
+#include <algorithm>
+
+namespace evse_security {
+
+bool CertificateStorage::list_entries(const fs::path& directory, bool recursive,
+                                      std::vector<std::pair<fs::path, StorageStatus>>& out_entries) {
+    std::vector<fs::path> files;
+    out_entries.clear();
+
+    if (false == list(directory, recursive, files)) {
+        return false;
+    }
+
+    out_entries.reserve(files.size());
+
+    for (auto& file : files) {
+        StorageStatus status = stat(file);
+        out_entries.emplace_back(std::move(file), status);
+    }
+
+    return true;
+}
+
+bool CertificateStorage::sync(const fs::path& path) {
+    return true;
+}
+
+std::optional<std::uint64_t> CertificateStorage::get_change_generation(const std::vector<fs::path>& directories) {
+    return std::nullopt;
+}
+
+std::shared_ptr<const std::string> CertificateStorage::read_shared(const fs::path& path) {
+    std::string data;
+
+    if (false == read(path, data)) {
+        return nullptr;
+    }
+
+    return std::make_shared<const std::string>(std::move(data));
+}
+
+void CertificateStorage::read_files(const std::vector<fs::path>& paths,
+                                    std::vector<std::optional<std::string>>& out_data) {
+    out_data.clear();
+    out_data.reserve(paths.size());
+
+    for (const auto& path : paths) {
+        std::string data;
+
+        if (read(path, data)) {
+            out_data.emplace_back(std::move(data));
+        } else {
+            out_data.emplace_back(std::nullopt);
+        }
+    }
+}
+
+void CertificateStorage::write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                                     std::vector<bool>& out_written) {
+    out_written.clear();
+    out_written.reserve(files.size());
+
+    for (const auto& [path, data] : files) {
+        out_written.push_back(write(path, data, false));
+    }
+}
+
+void CertificateStorage::remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed) {
+    out_removed.clear();
+    out_removed.reserve(paths.size());
+
+    for (const auto& path : paths) {
+        out_removed.push_back(stat(path).type == StorageEntryType::File && remove(path));
+    }
+}
+
+bool CertificateStorage::process_file(
+    const fs::path& path, std::size_t buffer_size,
+    const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) {
+    std::string data;
+
+    if (false == read(path, data) || buffer_size == 0) {
+        return false;
+    }
+
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(data.data());
+    std::size_t offset = 0;
+
+    // Same chunking as a streamed read, full chunks first and the remaining bytes as last chunk
+    while (data.size() - offset >= buffer_size) {
+        if (func(bytes + offset, buffer_size, false)) {
+            return true;
+        }
+
+        offset += buffer_size;
+    }
+
+    func(bytes + offset, data.size() - offset, true);
+    return true;
+}
+
+static PosixStorage& get_default_storage() {
+    static PosixStorage default_storage;
+    return default_storage;
+}
+
+// Storage of the EvseSecurity instance that is executing on this thread
+static thread_local CertificateStorage* active_storage = nullptr;
+
+CertificateStorage& get_active_storage() {
+    if (active_storage != nullptr) {
+        return *active_storage;
+    }
+
+    return get_default_storage();
+}
+
+ScopedStorage::ScopedStorage(const std::shared_ptr<CertificateStorage>& storage) : previous(active_storage) {
+    active_storage = storage.get();
+}
+
+ScopedStorage::~ScopedStorage() {
+    active_storage = previous;
+}
+
+} // namespace evse_security
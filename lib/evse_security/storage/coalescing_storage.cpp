@@ -0,0 +1,338 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/storage/coalescing_storage.hpp>
+
+#include <algorithm>
+#include <set>
+
+#include <everest/logging.hpp>
+
+namespace evse_security {
+
+/// @brief Normalizes the path, "dir/" and "dir" refer to the same entry
+static fs::path normalize(const fs::path& path) {
+    fs::path normalized = path.lexically_normal();
+
+    if (!normalized.empty() && !normalized.has_filename()) {
+        normalized = normalized.parent_path();
+    }
+
+    if (normalized == ".") {
+        normalized.clear();
+    }
+
+    return normalized;
+}
+
+/// @brief If @p path is inside (and not equal to) @p directory
+static bool is_within(const fs::path& directory, const fs::path& path) {
+    const auto [directory_end, path_it] = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+    return directory_end == directory.end() && path_it != path.end();
+}
+
+CoalescingStorage::CoalescingStorage(const std::shared_ptr<CertificateStorage>& backend,
+                                     std::chrono::milliseconds coalesce_window) :
+    backend(backend), coalesce_window(coalesce_window) {
+}
+
+CoalescingStorage::~CoalescingStorage() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    // Not under the lock, a running flush must be able to complete
+    flush_timer.stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    flush_internal();
+}
+
+bool CoalescingStorage::write_backend(const fs::path& path, const std::string& data, bool append) {
+    if (false == backend->write(path, data, append)) {
+        return false;
+    }
+
+    statistics.bytes_written += data.size();
+    statistics.writes++;
+
+    return true;
+}
+
+std::int64_t CoalescingStorage::next_modification_time() {
+    const std::int64_t now =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    last_modification_time = std::max(now, last_modification_time + 1);
+    return last_modification_time;
+}
+
+bool CoalescingStorage::flush_internal() {
+    bool flushed_all = true;
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (write_backend(it->first, it->second.data, false)) {
+            it = pending.erase(it);
+        } else {
+            // Kept, the caller already got a successful write
+            EVLOG_error << "Could not write delayed file, retrying later: " << it->first;
+            statistics.failed_writes++;
+            flushed_all = false;
+            ++it;
+        }
+    }
+
+    return flushed_all;
+}
+
+bool CoalescingStorage::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return flush_internal();
+}
+
+StorageWriteStatistics CoalescingStorage::get_statistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+StorageStatus CoalescingStorage::stat(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    StorageStatus status = backend->stat(path);
+    const auto it = pending.find(normalize(path));
+
+    if (it != pending.end()) {
+        status.type = StorageEntryType::File;
+        status.size = it->second.data.size();
+        status.modification_time = it->second.modification_time;
+    }
+
+    return status;
+}
+
+bool CoalescingStorage::list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (false == backend->list(directory, recursive, out_files)) {
+        return false;
+    }
+
+    if (pending.empty()) {
+        return true;
+    }
+
+    // Add the files that were not written yet
+    std::set<fs::path> listed;
+    for (const auto& file : out_files) {
+        listed.insert(normalize(file));
+    }
+
+    const fs::path normalized_directory = normalize(directory);
+
+    for (const auto& [path, write] : pending) {
+        const bool contained =
+            recursive ? is_within(normalized_directory, path) : (path.parent_path() == normalized_directory);
+
+        if (contained && listed.find(path) == listed.end()) {
+            out_files.push_back(directory / path.lexically_relative(normalized_directory));
+        }
+    }
+
+    return true;
+}
+
+bool CoalescingStorage::read(const fs::path& path, std::string& out_data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = pending.find(normalize(path));
+
+    if (it != pending.end()) {
+        out_data = it->second.data;
+        return true;
+    }
+
+    return backend->read(path, out_data);
+}
+
+bool CoalescingStorage::write(const fs::path& path, const std::string& data, bool append) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const fs::path normalized = normalize(path);
+    const auto it = pending.find(normalized);
+
+    if (append) {
+        // Merged with the pending content, else appended right away, no need to read the whole file
+        if (it != pending.end()) {
+            it->second.data += data;
+            it->second.modification_time = next_modification_time();
+            statistics.coalesced_writes++;
+            schedule_flush();
+            return true;
+        }
+
+        return write_backend(path, data, true);
+    }
+
+    // Skip the write if the content did not change
+    std::string current;
+    bool exists;
+
+    if (it != pending.end()) {
+        current = it->second.data;
+        exists = true;
+    } else {
+        exists = backend->read(path, current);
+    }
+
+    if (exists && current == data) {
+        statistics.skipped_writes++;
+        return true;
+    }
+
+    if (coalesce_window.count() == 0) {
+        return write_backend(path, data, false);
+    }
+
+    if (it != pending.end()) {
+        it->second = {data, next_modification_time()};
+        statistics.coalesced_writes++;
+        schedule_flush();
+        return true;
+    }
+
+    // Report a missing directory right away, as the write would fail later
+    const fs::path parent = normalized.parent_path();
+    if (parent.empty() == false && backend->stat(parent).type != StorageEntryType::Directory) {
+        return false;
+    }
+
+    pending.emplace(normalized, PendingWrite{data, next_modification_time()});
+    schedule_flush();
+
+    return true;
+}
+
+void CoalescingStorage::schedule_flush() {
+    if (flush_scheduled) {
+        return;
+    }
+
+    flush_scheduled = true;
+    start_flush_timer(coalesce_window);
+}
+
+void CoalescingStorage::start_flush_timer(std::chrono::milliseconds delay) {
+    flush_timer.timeout(
+        [this]() {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (flush_internal() || stopping) {
+                flush_retry_delay = std::chrono::milliseconds(0);
+                flush_scheduled = false;
+                return;
+            }
+
+            // The failed writes stay pending, retried even if no other write schedules a flush
+            flush_retry_delay = std::min(std::max(flush_retry_delay * 2, coalesce_window), MAX_FLUSH_RETRY_DELAY);
+            start_flush_timer(flush_retry_delay);
+        },
+        delay);
+}
+
+bool CoalescingStorage::remove(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // A file that was never written only has to be dropped
+    if (pending.erase(normalize(path)) != 0 && backend->stat(path).exists() == false) {
+        return true;
+    }
+
+    return backend->remove(path);
+}
+
+bool CoalescingStorage::create_directories(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return backend->create_directories(path);
+}
+
+bool CoalescingStorage::create_symlink(const fs::path& target, const fs::path& link) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // The link target must be readable through the backing storage
+    flush_internal();
+    return backend->create_symlink(target, link);
+}
+
+bool CoalescingStorage::read_symlink(const fs::path& link, fs::path& out_target) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return backend->read_symlink(link, out_target);
+}
+
+bool CoalescingStorage::rename(const fs::path& from, const fs::path& to) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    flush_internal();
+    return backend->rename(from, to);
+}
+
+bool CoalescingStorage::sync(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = pending.find(normalize(path));
+
+    if (it != pending.end()) {
+        if (false == write_backend(it->first, it->second.data, false)) {
+            return false;
+        }
+
+        pending.erase(it);
+    }
+
+    return backend->sync(path);
+}
+
+void CoalescingStorage::read_files(const std::vector<fs::path>& paths,
+                                   std::vector<std::optional<std::string>>& out_data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (pending.empty()) {
+        backend->read_files(paths, out_data);
+        return;
+    }
+
+    // Only the files without a pending write are read in a batch from the backing storage
+    std::vector<fs::path> backend_paths;
+    std::vector<std::size_t> backend_indices;
+
+    out_data.assign(paths.size(), std::nullopt);
+
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        const auto it = pending.find(normalize(paths[i]));
+
+        if (it != pending.end()) {
+            out_data[i] = it->second.data;
+        } else {
+            backend_paths.push_back(paths[i]);
+            backend_indices.push_back(i);
+        }
+    }
+
+    std::vector<std::optional<std::string>> backend_data;
+    backend->read_files(backend_paths, backend_data);
+
+    for (std::size_t i = 0; i < backend_indices.size(); i++) {
+        out_data[backend_indices[i]] = std::move(backend_data[i]);
+    }
+}
+
+bool CoalescingStorage::process_file(
+    const fs::path& path, std::size_t buffer_size,
+    const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    flush_internal();
+    return backend->process_file(path, buffer_size, func);
+}
+
+} // namespace evse_security
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/detail/directory_snapshot_cache.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security {
+
+#ifdef __linux__
+// Changes of the directory entries, and in-place modifications of the files
+static constexpr std::uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                            IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+/// @brief Absolute normalized path, "dir/" and "dir" refer to the same directory
+static fs::path get_key(const fs::path& path) {
+    fs::path key = fs::absolute(path).lexically_normal();
+
+    if (!key.has_filename() && key.has_parent_path() && key != key.root_path()) {
+        key = key.parent_path();
+    }
+
+    return key;
+}
+
+/// @brief If @p path is @p directory or inside it
+static bool is_within_or_equal(const fs::path& directory, const fs::path& path) {
+    const auto [directory_end, path_it] = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+    return directory_end == directory.end();
+}
+
+static std::optional<std::int64_t> get_modification_time(const fs::path& path) {
+    struct stat file_stat;
+
+    if (::stat(path.c_str(), &file_stat) != 0) {
+        return std::nullopt;
+    }
+
+    return static_cast<std::int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+}
+
+DirectorySnapshotCache& DirectorySnapshotCache::instance() {
+    static DirectorySnapshotCache cache;
+    return cache;
+}
+
+DirectorySnapshotCache::DirectorySnapshotCache() {
+#ifdef __linux__
+    inotify_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (inotify_fd < 0) {
+        EVSE_LOG_debug << "inotify not available, directory snapshots are checked by modification time";
+    }
+#endif
+}
+
+DirectorySnapshotCache::~DirectorySnapshotCache() {
+    if (inotify_fd >= 0) {
+        ::close(inotify_fd);
+    }
+}
+
+bool DirectorySnapshotCache::is_unchanged(const fs::path& directory, const DirectorySnapshot& snapshot) {
+    for (const auto& [relative, modification_time] : snapshot.directories) {
+        const auto current = get_modification_time(relative.empty() ? directory : directory / relative);
+
+        if (current.has_value() == false || current.value() != modification_time) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DirectorySnapshotCache::are_files_unchanged(const fs::path& directory, const DirectorySnapshot& snapshot) {
+    for (const auto& [relative, status] : snapshot.files) {
+        struct stat file_stat;
+
+        if (::stat((directory / relative).c_str(), &file_stat) != 0 ||
+            static_cast<std::uintmax_t>(file_stat.st_size) != status.size ||
+            static_cast<std::int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec !=
+                status.modification_time) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void DirectorySnapshotCache::erase_internal(std::map<fs::path, Entry>::iterator it) {
+#ifdef __linux__
+    for (const int watch : it->second.watches) {
+        const auto owners = watch_owners.find(watch);
+
+        if (owners != watch_owners.end()) {
+            owners->second.erase(it->first);
+
+            // The watch is shared by the snapshots of the same directory
+            if (owners->second.empty()) {
+                ::inotify_rm_watch(inotify_fd, watch);
+                watch_owners.erase(owners);
+            }
+        }
+    }
+#endif
+
+    entries.erase(it);
+    generation++;
+}
+
+void DirectorySnapshotCache::process_events() {
+#ifdef __linux__
+    if (inotify_fd < 0) {
+        return;
+    }
+
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    std::set<fs::path> changed;
+    bool overflow = false;
+
+    for (;;) {
+        const ssize_t length = ::read(inotify_fd, buffer.data(), buffer.size());
+
+        if (length <= 0) {
+            // EAGAIN, no more events
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+
+            const auto owners = watch_owners.find(event->wd);
+            if (owners != watch_owners.end()) {
+                changed.insert(owners->second.begin(), owners->second.end());
+            }
+        }
+    }
+
+    if (overflow) {
+        // Events were lost, nothing can be trusted
+        while (entries.empty() == false) {
+            erase_internal(entries.begin());
+        }
+
+        return;
+    }
+
+    for (const auto& key : changed) {
+        const auto it = entries.find(key);
+
+        if (it != entries.end()) {
+            erase_internal(it);
+        }
+    }
+#endif
+}
+
+std::shared_ptr<const DirectorySnapshot> DirectorySnapshotCache::find(const fs::path& directory) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    process_events();
+
+    const auto it = entries.find(get_key(directory));
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    if (it->second.watched == false && (is_unchanged(it->first, *it->second.snapshot) == false ||
+                                         are_files_unchanged(it->first, *it->second.snapshot) == false)) {
+        erase_internal(it);
+        return nullptr;
+    }
+
+    return it->second.snapshot;
+}
+
+void DirectorySnapshotCache::insert(const fs::path& directory,
+                                    const std::shared_ptr<const DirectorySnapshot>& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const fs::path key = get_key(directory);
+    const auto existing = entries.find(key);
+
+    if (existing != entries.end()) {
+        erase_internal(existing);
+    }
+
+    if (entries.size() >= MAX_DIRECTORY_SNAPSHOTS) {
+        while (entries.empty() == false) {
+            erase_internal(entries.begin());
+        }
+    }
+
+    Entry& entry = entries[key];
+    entry.snapshot = snapshot;
+
+#ifdef __linux__
+    if (inotify_fd >= 0 && inotify_enabled) {
+        entry.watched = true;
+
+        for (const auto& [relative, modification_time] : snapshot->directories) {
+            const fs::path watched_directory = relative.empty() ? key : key / relative;
+            const int watch = ::inotify_add_watch(inotify_fd, watched_directory.c_str(), WATCH_MASK);
+
+            if (watch < 0) {
+                // E.g. the watch limit was reached, check by modification time instead
+                EVSE_LOG_debug << "Could not watch directory: " << watched_directory << ": " << std::strerror(errno);
+                entry.watched = false;
+                continue;
+            }
+
+            entry.watches.push_back(watch);
+            watch_owners[watch].insert(key);
+        }
+    }
+#endif
+
+    // Changes made after the walk and before the watches were added
+    if (is_unchanged(key, *snapshot) == false) {
+        erase_internal(entries.find(key));
+    }
+}
+
+void DirectorySnapshotCache::invalidate(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const fs::path key = get_key(path);
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        // A changed directory also changes the content of the snapshots inside it (e.g. on rename)
+        if (is_within_or_equal(it->first, key) || is_within_or_equal(key, it->first)) {
+            const auto next = std::next(it);
+            erase_internal(it);
+            it = next;
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DirectorySnapshotCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    while (entries.empty() == false) {
+        erase_internal(entries.begin());
+    }
+}
+
+void DirectorySnapshotCache::set_inotify_enabled(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    inotify_enabled = enabled;
+
+    while (entries.empty() == false) {
+        erase_internal(entries.begin());
+    }
+}
+
+std::uint64_t DirectorySnapshotCache::get_generation() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    process_events();
+    return generation;
+}
+
+bool DirectorySnapshotCache::is_watching() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return inotify_fd >= 0 && inotify_enabled;
+}
+
+std::optional<std::uint64_t> DirectorySnapshotCache::get_watched_generation(const std::vector<fs::path>& directories) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    process_events();
+
+    for (const auto& directory : directories) {
+        const auto it = entries.find(get_key(directory));
+
+        if (it == entries.end() || it->second.watched == false) {
+            return std::nullopt;
+        }
+    }
+
+    return generation;
+}
+
+} // namespace evse_security
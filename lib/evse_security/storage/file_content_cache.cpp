@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/detail/file_content_cache.hpp>
+
+namespace evse_security {
+
+FileContentCache& FileContentCache::instance() {
+    static FileContentCache cache;
+    return cache;
+}
+
+std::shared_ptr<const std::string> FileContentCache::find(const FileIdentity& identity) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = entries.find(Key(identity.device, identity.inode));
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    if (!(it->second.identity == identity)) {
+        // Modified since it was cached
+        erase_internal(it);
+        return nullptr;
+    }
+
+    usage.splice(usage.begin(), usage, it->second.usage);
+    return it->second.data;
+}
+
+void FileContentCache::insert(const FileIdentity& identity, const std::shared_ptr<const std::string>& data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (data == nullptr || data->size() > capacity) {
+        return;
+    }
+
+    const Key key(identity.device, identity.inode);
+    const auto it = entries.find(key);
+
+    if (it != entries.end()) {
+        erase_internal(it);
+    }
+
+    usage.push_front(key);
+    entries.emplace(key, Entry{identity, data, usage.begin()});
+    size += data->size();
+
+    evict();
+}
+
+void FileContentCache::erase(std::uintmax_t device, std::uintmax_t inode) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = entries.find(Key(device, inode));
+    if (it != entries.end()) {
+        erase_internal(it);
+    }
+}
+
+void FileContentCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entries.clear();
+    usage.clear();
+    size = 0;
+}
+
+void FileContentCache::set_capacity(std::size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    capacity = capacity_bytes;
+    evict();
+}
+
+bool FileContentCache::is_enabled() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return capacity != 0;
+}
+
+void FileContentCache::erase_internal(std::map<Key, Entry>::iterator it) {
+    size -= it->second.data->size();
+    usage.erase(it->second.usage);
+    entries.erase(it);
+}
+
+void FileContentCache::evict() {
+    while (size > capacity && usage.empty() == false) {
+        erase_internal(entries.find(usage.back()));
+    }
+}
+
+} // namespace evse_security
@@ -0,0 +1,395 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/storage/in_memory_storage.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace evse_security {
+
+// Same limit as the Linux kernel
+static constexpr int MAX_SYMLINK_FOLLOWS = 40;
+
+/// @brief Normalizes the path, "dir/" and "dir" refer to the same entry
+static fs::path normalize(const fs::path& path) {
+    fs::path normalized = path.lexically_normal();
+
+    if (!normalized.empty() && !normalized.has_filename()) {
+        normalized = normalized.parent_path();
+    }
+
+    if (normalized == ".") {
+        normalized.clear();
+    }
+
+    return normalized;
+}
+
+/// @brief The current directory ("") and the filesystem root always exist
+static bool is_root(const fs::path& path) {
+    return path.empty() || (path.has_root_path() && path == path.root_path());
+}
+
+/// @brief If @p path is inside (and not equal to) @p directory
+static bool is_within(const fs::path& directory, const fs::path& path) {
+    const auto [directory_end, path_it] = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+    return directory_end == directory.end() && path_it != path.end();
+}
+
+static std::ptrdiff_t depth(const fs::path& path) {
+    return std::distance(path.begin(), path.end());
+}
+
+std::optional<fs::path> InMemoryStorage::resolve(const fs::path& path, bool follow_last) const {
+    const fs::path normalized = normalize(path);
+    std::vector<fs::path> components(normalized.begin(), normalized.end());
+    int follows = 0;
+
+    fs::path current;
+    std::size_t i = 0;
+
+    while (i < components.size()) {
+        fs::path next = current / components[i];
+        const bool last = (i + 1 == components.size());
+
+        const auto it = nodes.find(next);
+        if (it != nodes.end() && it->second.type == Node::Type::Symlink && (!last || follow_last)) {
+            if (++follows > MAX_SYMLINK_FOLLOWS) {
+                return std::nullopt;
+            }
+
+            // Relative targets are relative to the directory of the link
+            const fs::path target = it->second.data;
+            const fs::path resolved_target = normalize(target.is_absolute() ? target : current / target);
+
+            // Restart with the link replaced by its target
+            std::vector<fs::path> restarted(resolved_target.begin(), resolved_target.end());
+            restarted.insert(restarted.end(), components.begin() + i + 1, components.end());
+
+            components = std::move(restarted);
+            current.clear();
+            i = 0;
+            continue;
+        }
+
+        current = std::move(next);
+        i++;
+    }
+
+    return normalize(current);
+}
+
+InMemoryStorage::Node* InMemoryStorage::find(const fs::path& resolved) {
+    const auto it = nodes.find(resolved);
+    return (it != nodes.end()) ? &it->second : nullptr;
+}
+
+bool InMemoryStorage::parent_exists(const fs::path& resolved) {
+    const fs::path parent = resolved.parent_path();
+
+    if (is_root(parent)) {
+        return true;
+    }
+
+    const Node* node = find(parent);
+    return (node != nullptr && node->type == Node::Type::Directory);
+}
+
+std::int64_t InMemoryStorage::next_modification_time() {
+    const std::int64_t now =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    // Strictly increasing, so that each change can be detected
+    last_modification_time = std::max(now, last_modification_time + 1);
+    return last_modification_time;
+}
+
+void InMemoryStorage::touch(const fs::path& resolved) {
+    const std::int64_t modification_time = next_modification_time();
+
+    if (Node* node = find(resolved)) {
+        node->modification_time = modification_time;
+    }
+
+    if (Node* parent = find(resolved.parent_path())) {
+        parent->modification_time = modification_time;
+    }
+}
+
+StorageStatus InMemoryStorage::stat(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    StorageStatus status;
+
+    const auto entry = resolve(path, false);
+    if (entry.has_value()) {
+        const Node* node = find(entry.value());
+        status.symlink = (node != nullptr && node->type == Node::Type::Symlink);
+    }
+
+    const auto resolved = resolve(path, true);
+    if (resolved.has_value() == false) {
+        return status;
+    }
+
+    if (is_root(resolved.value())) {
+        status.type = StorageEntryType::Directory;
+    } else if (const Node* node = find(resolved.value())) {
+        if (node->type == Node::Type::File) {
+            status.type = StorageEntryType::File;
+            status.size = node->data.size();
+        } else if (node->type == Node::Type::Directory) {
+            status.type = StorageEntryType::Directory;
+        }
+
+        status.modification_time = node->modification_time;
+    }
+
+    return status;
+}
+
+bool InMemoryStorage::list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out_files.clear();
+
+    const auto resolved = resolve(directory, true);
+    if (resolved.has_value() == false) {
+        return false;
+    }
+
+    const fs::path& resolved_directory = resolved.value();
+
+    if (is_root(resolved_directory) == false) {
+        const Node* node = find(resolved_directory);
+
+        if (node == nullptr || node->type != Node::Type::Directory) {
+            return false;
+        }
+    }
+
+    const auto directory_depth = depth(resolved_directory);
+
+    // The map is ordered by path components, the content of a directory is a contiguous range after it
+    for (auto it = nodes.upper_bound(resolved_directory); it != nodes.end(); ++it) {
+        if (is_within(resolved_directory, it->first) == false) {
+            break;
+        }
+
+        if (recursive == false && depth(it->first) != directory_depth + 1) {
+            continue;
+        }
+
+        bool is_file = (it->second.type == Node::Type::File);
+
+        if (it->second.type == Node::Type::Symlink) {
+            const auto target = resolve(it->first, true);
+            const Node* target_node = target.has_value() ? find(target.value()) : nullptr;
+            is_file = (target_node != nullptr && target_node->type == Node::Type::File);
+        }
+
+        if (is_file) {
+            // Keep the spelling of the requested directory, as a directory iteration does
+            const fs::path relative =
+                resolved_directory.empty() ? it->first : it->first.lexically_relative(resolved_directory);
+            out_files.push_back(directory / relative);
+        }
+    }
+
+    return true;
+}
+
+bool InMemoryStorage::read(const fs::path& path, std::string& out_data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved = resolve(path, true);
+    const Node* node = resolved.has_value() ? find(resolved.value()) : nullptr;
+
+    if (node == nullptr || node->type != Node::Type::File) {
+        return false;
+    }
+
+    out_data = node->data;
+    return true;
+}
+
+bool InMemoryStorage::write(const fs::path& path, const std::string& data, bool append) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved = resolve(path, true);
+    if (resolved.has_value() == false || is_root(resolved.value())) {
+        return false;
+    }
+
+    Node* node = find(resolved.value());
+
+    if (node == nullptr) {
+        if (parent_exists(resolved.value()) == false) {
+            return false;
+        }
+
+        node = &nodes[resolved.value()];
+        node->type = Node::Type::File;
+    } else if (node->type != Node::Type::File) {
+        return false;
+    }
+
+    if (append) {
+        node->data += data;
+    } else {
+        node->data = data;
+    }
+
+    touch(resolved.value());
+    return true;
+}
+
+bool InMemoryStorage::remove(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved = resolve(path, false);
+    if (resolved.has_value() == false) {
+        return false;
+    }
+
+    const auto it = nodes.find(resolved.value());
+    if (it == nodes.end()) {
+        return false;
+    }
+
+    // Only empty directories can be removed
+    if (it->second.type == Node::Type::Directory) {
+        const auto next = std::next(it);
+
+        if (next != nodes.end() && is_within(it->first, next->first)) {
+            return false;
+        }
+    }
+
+    nodes.erase(it);
+    touch(resolved.value());
+
+    return true;
+}
+
+bool InMemoryStorage::create_directories(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    fs::path current;
+
+    for (const auto& component : normalize(path)) {
+        current /= component;
+
+        const auto resolved = resolve(current, true);
+        if (resolved.has_value() == false) {
+            return false;
+        }
+
+        if (is_root(resolved.value())) {
+            continue;
+        }
+
+        const Node* node = find(resolved.value());
+
+        if (node == nullptr) {
+            nodes[resolved.value()].type = Node::Type::Directory;
+            touch(resolved.value());
+        } else if (node->type != Node::Type::Directory) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool InMemoryStorage::create_symlink(const fs::path& target, const fs::path& link) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved = resolve(link, false);
+    if (resolved.has_value() == false || is_root(resolved.value())) {
+        return false;
+    }
+
+    if (find(resolved.value()) != nullptr || parent_exists(resolved.value()) == false) {
+        return false;
+    }
+
+    Node& node = nodes[resolved.value()];
+    node.type = Node::Type::Symlink;
+    node.data = target.string();
+
+    touch(resolved.value());
+    return true;
+}
+
+bool InMemoryStorage::read_symlink(const fs::path& link, fs::path& out_target) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved = resolve(link, false);
+    const Node* node = resolved.has_value() ? find(resolved.value()) : nullptr;
+
+    if (node == nullptr || node->type != Node::Type::Symlink) {
+        return false;
+    }
+
+    out_target = node->data;
+    return true;
+}
+
+bool InMemoryStorage::rename(const fs::path& from, const fs::path& to) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto resolved_from = resolve(from, false);
+    const auto resolved_to = resolve(to, false);
+
+    if (resolved_from.has_value() == false || resolved_to.has_value() == false) {
+        return false;
+    }
+
+    const fs::path& source = resolved_from.value();
+    const fs::path& destination = resolved_to.value();
+
+    const Node* source_node = find(source);
+    if (source_node == nullptr || is_root(destination) || parent_exists(destination) == false) {
+        return false;
+    }
+
+    if (source == destination) {
+        return true;
+    }
+
+    const bool source_is_directory = (source_node->type == Node::Type::Directory);
+
+    // A directory can not be moved inside itself
+    if (source_is_directory && is_within(source, destination)) {
+        return false;
+    }
+
+    if (const Node* destination_node = find(destination)) {
+        // Only files and symlinks are replaced
+        if (destination_node->type == Node::Type::Directory || source_is_directory) {
+            return false;
+        }
+
+        nodes.erase(destination);
+    }
+
+    // Move the entry and, for a directory, all its content
+    std::vector<std::pair<fs::path, Node>> moved;
+
+    for (auto it = nodes.find(source); it != nodes.end() && (it->first == source || is_within(source, it->first));) {
+        moved.emplace_back(destination / it->first.lexically_relative(source), std::move(it->second));
+        it = nodes.erase(it);
+    }
+
+    for (auto& [path, node] : moved) {
+        nodes[normalize(path)] = std::move(node);
+    }
+
+    touch(source);
+    touch(destination);
+
+    return true;
+}
+
+} // namespace evse_security
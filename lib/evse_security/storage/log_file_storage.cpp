@@ -0,0 +1,507 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/storage/log_file_storage.hpp>
+#include <evse_security/storage/posix_storage.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security {
+
+// Identifies the log and its format version, written once at the start of the file
+static constexpr char LOG_HEADER[] = {'E', 'V', 'S', 'E', 'L', 'O', 'G', '1'};
+static constexpr std::size_t LOG_HEADER_SIZE = sizeof(LOG_HEADER);
+
+// Each record is prefixed by its payload size and the CRC32 of the payload
+static constexpr std::size_t RECORD_PREFIX_SIZE = 8;
+
+enum class RecordType : std::uint8_t {
+    Write = 1,
+    Append = 2,
+    Remove = 3,
+    CreateDirectories = 4,
+    CreateSymlink = 5,
+    Rename = 6,
+};
+
+static std::uint32_t crc32(const std::string& data) {
+    static const auto table = []() {
+        std::array<std::uint32_t, 256> table{};
+
+        for (std::uint32_t i = 0; i < table.size(); i++) {
+            std::uint32_t value = i;
+
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+            }
+
+            table[i] = value;
+        }
+
+        return table;
+    }();
+
+    std::uint32_t crc = 0xFFFFFFFFu;
+
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<std::uint8_t>(c)) & 0xFFu] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void put_u32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFFu));
+    }
+}
+
+static bool get_u32(const std::string& in, std::size_t& offset, std::uint32_t& out_value) {
+    if (in.size() - offset < 4) {
+        return false;
+    }
+
+    out_value = 0;
+    for (int i = 0; i < 4; i++) {
+        out_value |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(in[offset + i])) << (8 * i);
+    }
+
+    offset += 4;
+    return true;
+}
+
+static void put_string(std::string& out, const std::string& value) {
+    put_u32(out, static_cast<std::uint32_t>(value.size()));
+    out += value;
+}
+
+static bool get_string(const std::string& in, std::size_t& offset, std::string& out_value) {
+    std::uint32_t size;
+
+    if (false == get_u32(in, offset, size) || in.size() - offset < size) {
+        return false;
+    }
+
+    out_value = in.substr(offset, size);
+    offset += size;
+    return true;
+}
+
+static std::string make_payload(RecordType type, const std::string& first, const std::string& second = {}) {
+    std::string payload;
+
+    payload.push_back(static_cast<char>(type));
+    put_string(payload, first);
+    put_string(payload, second);
+
+    return payload;
+}
+
+static std::string make_record(const std::string& payload) {
+    std::string record;
+
+    record.reserve(RECORD_PREFIX_SIZE + payload.size());
+    put_u32(record, static_cast<std::uint32_t>(payload.size()));
+    put_u32(record, crc32(payload));
+    record += payload;
+
+    return record;
+}
+
+static bool write_all(int fd, const std::string& data) {
+    std::size_t written = 0;
+
+    while (written < data.size()) {
+        const ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        written += static_cast<std::size_t>(result);
+    }
+
+    return true;
+}
+
+static bool read_all(int fd, std::string& out_data) {
+    std::array<char, 16 * 1024> buffer;
+    out_data.clear();
+
+    for (;;) {
+        const ssize_t result = ::read(fd, buffer.data(), buffer.size());
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        if (result == 0) {
+            return true;
+        }
+
+        out_data.append(buffer.data(), static_cast<std::size_t>(result));
+    }
+}
+
+/// @brief Syncs the directory, so that a created or renamed log entry is persisted
+static void sync_directory(const fs::path& directory) {
+    const fs::path path = directory.empty() ? fs::path(".") : directory;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+LogFileStorage::LogFileStorage(const fs::path& log_file, std::uintmax_t compaction_min_size,
+                               std::uintmax_t compaction_factor) :
+    log_file(log_file), compaction_min_size(compaction_min_size), compaction_factor(compaction_factor) {
+    log_fd = ::open(log_file.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+    if (log_fd < 0) {
+        throw std::runtime_error("Could not open storage log: " + log_file.string() + ": " + std::strerror(errno));
+    }
+
+    try {
+        replay();
+    } catch (...) {
+        ::close(log_fd);
+        throw;
+    }
+
+    compacted_size = log_size;
+}
+
+LogFileStorage::~LogFileStorage() {
+    if (log_fd >= 0) {
+        ::close(log_fd);
+    }
+}
+
+void LogFileStorage::replay() {
+    std::string log;
+
+    if (false == read_all(log_fd, log)) {
+        throw std::runtime_error("Could not read storage log: " + log_file.string());
+    }
+
+    if (log.empty()) {
+        // New log
+        if (false == write_all(log_fd, std::string(LOG_HEADER, LOG_HEADER_SIZE)) || ::fsync(log_fd) != 0) {
+            throw std::runtime_error("Could not initialize storage log: " + log_file.string());
+        }
+
+        sync_directory(log_file.parent_path());
+        log_size = LOG_HEADER_SIZE;
+        return;
+    }
+
+    if (log.size() < LOG_HEADER_SIZE || log.compare(0, LOG_HEADER_SIZE, LOG_HEADER, LOG_HEADER_SIZE) != 0) {
+        throw std::runtime_error("Not a storage log: " + log_file.string());
+    }
+
+    std::size_t offset = LOG_HEADER_SIZE;
+    std::size_t records = 0;
+
+    while (offset < log.size()) {
+        std::size_t record_offset = offset;
+        std::uint32_t payload_size;
+        std::uint32_t checksum;
+
+        if (false == get_u32(log, record_offset, payload_size) || false == get_u32(log, record_offset, checksum) ||
+            log.size() - record_offset < payload_size) {
+            break;
+        }
+
+        const std::string payload = log.substr(record_offset, payload_size);
+
+        if (payload.empty() || crc32(payload) != checksum) {
+            break;
+        }
+
+        std::size_t payload_offset = 1;
+        std::string first;
+        std::string second;
+
+        if (false == get_string(payload, payload_offset, first) ||
+            false == get_string(payload, payload_offset, second)) {
+            break;
+        }
+
+        // The records are logged before they are applied, a modification that failed fails again on the same
+        // content
+        switch (static_cast<RecordType>(payload[0])) {
+        case RecordType::Write:
+            InMemoryStorage::write(first, second, false);
+            break;
+        case RecordType::Append:
+            InMemoryStorage::write(first, second, true);
+            break;
+        case RecordType::Remove:
+            InMemoryStorage::remove(first);
+            break;
+        case RecordType::CreateDirectories:
+            InMemoryStorage::create_directories(first);
+            break;
+        case RecordType::CreateSymlink:
+            InMemoryStorage::create_symlink(second, first);
+            break;
+        case RecordType::Rename:
+            InMemoryStorage::rename(first, second);
+            break;
+        default:
+            EVLOG_warning << "Unknown record type in storage log: " << static_cast<int>(payload[0]);
+            break;
+        }
+
+        offset = record_offset + payload_size;
+        records++;
+    }
+
+    if (offset < log.size()) {
+        // Interrupted while writing the last record, drop it so that new records are not appended after it
+        EVLOG_warning << "Discarding " << (log.size() - offset) << " incomplete bytes at the end of storage log: "
+                      << log_file;
+
+        if (::ftruncate(log_fd, static_cast<off_t>(offset)) != 0 || ::fsync(log_fd) != 0) {
+            throw std::runtime_error("Could not truncate storage log: " + log_file.string());
+        }
+    }
+
+    EVSE_LOG_debug << "Replayed " << records << " records from storage log: " << log_file;
+    log_size = offset;
+}
+
+bool LogFileStorage::append_record(const std::string& payload) {
+    // A previous record was only partially written, new records can not follow it
+    if (log_outdated && false == compact_internal()) {
+        return false;
+    }
+
+    const std::string record = make_record(payload);
+
+    if (false == write_all(log_fd, record) || ::fdatasync(log_fd) != 0) {
+        EVLOG_error << "Could not append to storage log: " << log_file << ": " << std::strerror(errno);
+
+        // The modification is not applied, the log is rewritten from the content in memory before the next one
+        log_outdated = true;
+        return false;
+    }
+
+    log_size += record.size();
+    return true;
+}
+
+void LogFileStorage::compact_if_grown() {
+    if (log_size >= compaction_min_size && log_size >= compacted_size * compaction_factor) {
+        // Not an error for the applied modification, its record is already persisted
+        compact_internal();
+    }
+}
+
+bool LogFileStorage::compact_internal() {
+    std::string log(LOG_HEADER, LOG_HEADER_SIZE);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // The map is ordered, the directories are recreated before their content
+        for (const auto& [path, node] : nodes) {
+            switch (node.type) {
+            case Node::Type::Directory:
+                log += make_record(make_payload(RecordType::CreateDirectories, path.string()));
+                break;
+            case Node::Type::File:
+                log += make_record(make_payload(RecordType::Write, path.string(), node.data));
+                break;
+            case Node::Type::Symlink:
+                log += make_record(make_payload(RecordType::CreateSymlink, path.string(), node.data));
+                break;
+            }
+        }
+    }
+
+    fs::path compacted_file = log_file;
+    compacted_file += ".tmp";
+
+    const int compacted_fd =
+        ::open(compacted_file.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+
+    if (compacted_fd < 0) {
+        EVLOG_error << "Could not create compacted storage log: " << compacted_file << ": " << std::strerror(errno);
+        return false;
+    }
+
+    // Replace the log in one step, so that a power loss leaves either the old or the new one
+    if (false == write_all(compacted_fd, log) || ::fsync(compacted_fd) != 0 ||
+        ::rename(compacted_file.c_str(), log_file.c_str()) != 0) {
+        EVLOG_error << "Could not write compacted storage log: " << compacted_file << ": " << std::strerror(errno);
+
+        ::close(compacted_fd);
+        ::unlink(compacted_file.c_str());
+        return false;
+    }
+
+    sync_directory(log_file.parent_path());
+
+    ::close(log_fd);
+    log_fd = compacted_fd;
+
+    EVSE_LOG_debug << "Compacted storage log: " << log_file << " from " << log_size << " to " << log.size() << " bytes";
+
+    log_size = log.size();
+    compacted_size = log_size;
+    log_outdated = false;
+
+    return true;
+}
+
+bool LogFileStorage::write(const fs::path& path, const std::string& data, bool append) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    if (false == append_record(make_payload(append ? RecordType::Append : RecordType::Write, path.string(), data))) {
+        return false;
+    }
+
+    const bool written = InMemoryStorage::write(path, data, append);
+    compact_if_grown();
+    return written;
+}
+
+bool LogFileStorage::remove(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    // Nothing to log for a missing entry
+    const StorageStatus status = stat(path);
+    if (false == status.exists() && false == status.symlink) {
+        return false;
+    }
+
+    if (false == append_record(make_payload(RecordType::Remove, path.string()))) {
+        return false;
+    }
+
+    const bool removed = InMemoryStorage::remove(path);
+    compact_if_grown();
+    return removed;
+}
+
+bool LogFileStorage::create_directories(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    // Existing directories are not logged again
+    if (stat(path).type == StorageEntryType::Directory) {
+        return true;
+    }
+
+    if (false == append_record(make_payload(RecordType::CreateDirectories, path.string()))) {
+        return false;
+    }
+
+    const bool created = InMemoryStorage::create_directories(path);
+    compact_if_grown();
+    return created;
+}
+
+bool LogFileStorage::create_symlink(const fs::path& target, const fs::path& link) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    if (false == append_record(make_payload(RecordType::CreateSymlink, link.string(), target.string()))) {
+        return false;
+    }
+
+    const bool created = InMemoryStorage::create_symlink(target, link);
+    compact_if_grown();
+    return created;
+}
+
+bool LogFileStorage::rename(const fs::path& from, const fs::path& to) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    if (false == append_record(make_payload(RecordType::Rename, from.string(), to.string()))) {
+        return false;
+    }
+
+    const bool renamed = InMemoryStorage::rename(from, to);
+    compact_if_grown();
+    return renamed;
+}
+
+bool LogFileStorage::compact() {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    return compact_internal();
+}
+
+bool LogFileStorage::export_to_filesystem(const fs::path& path, const fs::path& destination) {
+    PosixStorage filesystem;
+    std::vector<std::pair<fs::path, fs::path>> exports;
+
+    const auto status = stat(path);
+
+    if (status.type == StorageEntryType::File) {
+        exports.emplace_back(path, destination);
+    } else if (status.type == StorageEntryType::Directory) {
+        std::vector<fs::path> files;
+
+        if (false == list(path, true, files)) {
+            return false;
+        }
+
+        for (const auto& file : files) {
+            exports.emplace_back(file, destination / file.lexically_relative(path));
+        }
+    } else {
+        return false;
+    }
+
+    bool exported_all = true;
+
+    for (const auto& [source, target] : exports) {
+        std::string data;
+        std::string existing;
+
+        if (false == read(source, data)) {
+            exported_all = false;
+            continue;
+        }
+
+        // Do not rewrite unchanged files
+        if (filesystem.read(target, existing) && existing == data) {
+            continue;
+        }
+
+        const fs::path target_directory = target.parent_path();
+
+        if ((target_directory.empty() == false && false == filesystem.create_directories(target_directory)) ||
+            false == filesystem.write(target, data, false)) {
+            EVLOG_error << "Could not export " << source << " to: " << target;
+            exported_all = false;
+        }
+    }
+
+    return exported_all;
+}
+
+std::uintmax_t LogFileStorage::get_log_size() {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    return log_size;
+}
+
+} // namespace evse_security
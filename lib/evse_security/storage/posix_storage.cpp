@@ -0,0 +1,478 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/detail/directory_snapshot_cache.hpp>
+#include <evse_security/detail/file_content_cache.hpp>
+#include <evse_security/storage/posix_storage.hpp>
+
+#include <array>
+#include <cerrno>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <evse_security/utils/evse_logging.hpp>
+
+#ifdef LIBEVSE_SECURITY_USE_IO_URING
+#include <evse_security/detail/io_uring_backend.hpp>
+#endif
+
+namespace evse_security {
+
+static FileIdentity get_identity(const struct stat& file_stat) {
+    return FileIdentity{static_cast<std::uintmax_t>(file_stat.st_dev), static_cast<std::uintmax_t>(file_stat.st_ino),
+                        static_cast<std::int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec,
+                        static_cast<std::uintmax_t>(file_stat.st_size)};
+}
+
+static std::optional<FileIdentity> get_identity(const fs::path& path) {
+    struct stat file_stat;
+
+    if (::stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        return std::nullopt;
+    }
+
+    return get_identity(file_stat);
+}
+
+/// @brief Drops the cached content of a file before it is modified, and the listings containing it
+static void invalidate_cached(const fs::path& path) {
+    if (const auto identity = get_identity(path)) {
+        FileContentCache::instance().erase(identity->device, identity->inode);
+    }
+
+    DirectorySnapshotCache::instance().invalidate(path);
+}
+
+void PosixStorage::set_read_cache_capacity(std::size_t capacity_bytes) {
+    FileContentCache::instance().set_capacity(capacity_bytes);
+}
+
+StorageStatus PosixStorage::stat(const fs::path& path) {
+    StorageStatus status;
+    struct stat file_stat;
+
+    if (::lstat(path.c_str(), &file_stat) != 0) {
+        return status;
+    }
+
+    status.symlink = S_ISLNK(file_stat.st_mode);
+
+    // Follow the link, a dangling one does not exist
+    if (status.symlink && ::stat(path.c_str(), &file_stat) != 0) {
+        return status;
+    }
+
+    if (S_ISREG(file_stat.st_mode)) {
+        status.type = StorageEntryType::File;
+        status.size = static_cast<std::uintmax_t>(file_stat.st_size);
+    } else if (S_ISDIR(file_stat.st_mode)) {
+        status.type = StorageEntryType::Directory;
+    } else {
+        // Other special files are reported as files without content
+        status.type = StorageEntryType::File;
+    }
+
+    const auto identity = get_identity(file_stat);
+    status.modification_time = identity.modification_time;
+    status.device = identity.device;
+    status.inode = identity.inode;
+
+    return status;
+}
+
+/// @brief Walks the directory, each directory modification time is read before its content
+static std::shared_ptr<const DirectorySnapshot> walk_directory(PosixStorage& storage, const fs::path& directory) {
+    const StorageStatus root = storage.stat(directory);
+
+    if (root.type != StorageEntryType::Directory) {
+        return nullptr;
+    }
+
+    auto snapshot = std::make_shared<DirectorySnapshot>();
+    snapshot->directories.emplace(fs::path(), root.modification_time);
+
+    try {
+        for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+            const StorageStatus status = storage.stat(entry.path());
+            const fs::path relative = entry.path().lexically_relative(directory);
+
+            if (status.type == StorageEntryType::Directory) {
+                // Symlinks to directories are not followed by the iterator
+                if (status.symlink == false) {
+                    snapshot->directories.emplace(relative, status.modification_time);
+                }
+            } else if (status.type == StorageEntryType::File && entry.is_regular_file()) {
+                snapshot->files.emplace_back(relative, status);
+            }
+        }
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+        return nullptr;
+    }
+
+    return snapshot;
+}
+
+static std::shared_ptr<const DirectorySnapshot> get_snapshot(PosixStorage& storage, const fs::path& directory) {
+    auto& cache = DirectorySnapshotCache::instance();
+    auto snapshot = cache.find(directory);
+
+    if (snapshot == nullptr) {
+        snapshot = walk_directory(storage, directory);
+
+        if (snapshot != nullptr) {
+            cache.insert(directory, snapshot);
+        }
+    }
+
+    return snapshot;
+}
+
+bool PosixStorage::list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) {
+    out_files.clear();
+
+    const auto snapshot = get_snapshot(*this, directory);
+    if (snapshot == nullptr) {
+        return false;
+    }
+
+    for (const auto& [relative, status] : snapshot->files) {
+        if (recursive || relative.parent_path().empty()) {
+            out_files.push_back(directory / relative);
+        }
+    }
+
+    return true;
+}
+
+bool PosixStorage::list_entries(const fs::path& directory, bool recursive,
+                                std::vector<std::pair<fs::path, StorageStatus>>& out_entries) {
+    out_entries.clear();
+
+    const auto snapshot = get_snapshot(*this, directory);
+    if (snapshot == nullptr) {
+        return false;
+    }
+
+    for (const auto& [relative, status] : snapshot->files) {
+        if (recursive || relative.parent_path().empty()) {
+            out_entries.emplace_back(directory / relative, status);
+        }
+    }
+
+    return true;
+}
+
+std::optional<std::uint64_t> PosixStorage::get_change_generation(const std::vector<fs::path>& directories) {
+    auto& cache = DirectorySnapshotCache::instance();
+
+    // Without inotify the snapshots are checked file by file, the callers list the directories instead
+    if (cache.is_watching() == false) {
+        return std::nullopt;
+    }
+
+    // The directories are walked if they have no snapshot yet
+    for (const auto& directory : directories) {
+        if (get_snapshot(*this, directory) == nullptr) {
+            return std::nullopt;
+        }
+    }
+
+    return cache.get_watched_generation(directories);
+}
+
+/// @brief Reads the whole file from the descriptor
+static bool read_all(int fd, std::string& out_data) {
+    std::array<char, 16 * 1024> buffer;
+    out_data.clear();
+
+    for (;;) {
+        const ssize_t result = ::read(fd, buffer.data(), buffer.size());
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        if (result == 0) {
+            return true;
+        }
+
+        out_data.append(buffer.data(), static_cast<std::size_t>(result));
+    }
+}
+
+std::shared_ptr<const std::string> PosixStorage::read_shared(const fs::path& path) {
+    // Non blocking, so that opening a FIFO does not wait for a writer before the type is checked
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    auto& cache = FileContentCache::instance();
+    std::shared_ptr<const std::string> content;
+    struct stat file_stat;
+
+    if (::fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+        const auto identity = get_identity(file_stat);
+        content = cache.find(identity);
+
+        if (content == nullptr) {
+            std::string data;
+
+            if (read_all(fd, data)) {
+                content = std::make_shared<const std::string>(std::move(data));
+
+                // Only cached if it was not modified while reading
+                if (::fstat(fd, &file_stat) == 0 && get_identity(file_stat) == identity &&
+                    content->size() == identity.size) {
+                    cache.insert(identity, content);
+                }
+            }
+        }
+    }
+
+    ::close(fd);
+    return content;
+}
+
+bool PosixStorage::read(const fs::path& path, std::string& out_data) {
+    const auto content = read_shared(path);
+
+    if (content == nullptr) {
+        return false;
+    }
+
+    out_data = *content;
+    return true;
+}
+
+bool PosixStorage::write(const fs::path& path, const std::string& data, bool append) {
+    invalidate_cached(path);
+
+    try {
+        fsstd::ofstream file(path, (append ? std::ios::app : std::ios::trunc) | std::ios::out | std::ios::binary);
+
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.write(data.c_str(), data.size());
+        return static_cast<bool>(file);
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::remove(const fs::path& path) {
+    invalidate_cached(path);
+
+    try {
+        return fs::remove(path);
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::create_directories(const fs::path& path) {
+    DirectorySnapshotCache::instance().invalidate(path);
+
+    try {
+        fs::create_directories(path);
+        return fs::is_directory(path);
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::create_symlink(const fs::path& target, const fs::path& link) {
+    DirectorySnapshotCache::instance().invalidate(link);
+
+    try {
+        fs::create_symlink(target, link);
+        return true;
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::read_symlink(const fs::path& link, fs::path& out_target) {
+    try {
+        out_target = fs::read_symlink(link);
+        return true;
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::rename(const fs::path& from, const fs::path& to) {
+    // The renamed file keeps its identity, only the replaced one is dropped
+    invalidate_cached(to);
+    DirectorySnapshotCache::instance().invalidate(from);
+
+    try {
+        fs::rename(from, to);
+        return true;
+    } catch (const std::exception& e) {
+        EVSE_LOG_debug << "Filesystem error: " << e.what();
+    }
+
+    return false;
+}
+
+bool PosixStorage::sync(const fs::path& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    const bool synced = (::fsync(fd) == 0);
+    ::close(fd);
+
+    return synced;
+}
+
+void PosixStorage::read_files(const std::vector<fs::path>& paths, std::vector<std::optional<std::string>>& out_data) {
+    auto& cache = FileContentCache::instance();
+
+    if (cache.is_enabled() == false) {
+#ifdef LIBEVSE_SECURITY_USE_IO_URING
+        if (filesystem_utils::io_uring::read_files(paths, out_data)) {
+            return;
+        }
+#endif
+
+        CertificateStorage::read_files(paths, out_data);
+        return;
+    }
+
+    out_data.assign(paths.size(), std::nullopt);
+
+    // Only the files that are not cached are read
+    std::vector<fs::path> read_paths;
+    std::vector<std::size_t> read_indices;
+    std::vector<std::optional<FileIdentity>> read_identities;
+
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        const auto identity = get_identity(paths[i]);
+
+        if (identity.has_value()) {
+            if (const auto content = cache.find(identity.value())) {
+                out_data[i] = *content;
+                continue;
+            }
+        }
+
+        read_paths.push_back(paths[i]);
+        read_indices.push_back(i);
+        read_identities.push_back(identity);
+    }
+
+    if (read_paths.empty()) {
+        return;
+    }
+
+#ifdef LIBEVSE_SECURITY_USE_IO_URING
+    std::vector<std::optional<std::string>> read_data;
+
+    if (filesystem_utils::io_uring::read_files(read_paths, read_data)) {
+        for (std::size_t i = 0; i < read_paths.size(); i++) {
+            if (read_data[i].has_value() && read_identities[i].has_value()) {
+                // Only cached if it was not modified while reading
+                const auto identity = get_identity(read_paths[i]);
+
+                if (identity == read_identities[i] && read_data[i]->size() == identity->size) {
+                    cache.insert(identity.value(), std::make_shared<const std::string>(read_data[i].value()));
+                }
+            }
+
+            out_data[read_indices[i]] = std::move(read_data[i]);
+        }
+
+        return;
+    }
+#endif
+
+    for (std::size_t i = 0; i < read_paths.size(); i++) {
+        if (const auto content = read_shared(read_paths[i])) {
+            out_data[read_indices[i]] = *content;
+        }
+    }
+}
+
+void PosixStorage::write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                               std::vector<bool>& out_written) {
+    for (const auto& file : files) {
+        invalidate_cached(file.first);
+    }
+
+#ifdef LIBEVSE_SECURITY_USE_IO_URING
+    if (filesystem_utils::io_uring::write_files(files, out_written)) {
+        return;
+    }
+#endif
+
+    CertificateStorage::write_files(files, out_written);
+}
+
+void PosixStorage::remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed) {
+    for (const auto& path : paths) {
+        invalidate_cached(path);
+    }
+
+#ifdef LIBEVSE_SECURITY_USE_IO_URING
+    if (filesystem_utils::io_uring::delete_files(paths, out_removed)) {
+        return;
+    }
+#endif
+
+    CertificateStorage::remove_files(paths, out_removed);
+}
+
+bool PosixStorage::process_file(const fs::path& path, std::size_t buffer_size,
+                                const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) {
+    // Streamed, the processed files (e.g. firmware images) can be large
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> buffer(buffer_size);
+    bool interupted = false;
+
+    while (file.read(reinterpret_cast<char*>(buffer.data()), buffer_size)) {
+        interupted = func(buffer.data(), buffer_size, false);
+
+        if (interupted) {
+            break;
+        }
+    }
+
+    // Process the remaining bytes
+    if (interupted == false) {
+        size_t remaining = file.gcount();
+        func(buffer.data(), remaining, true);
+    }
+
+    return true;
+}
+
+} // namespace evse_security
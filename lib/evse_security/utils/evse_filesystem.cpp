@@ -1,12 +1,16 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2023 Pionix GmbH and Contributors to EVerest
 #include <evse_security/evse_types.hpp>
+#include <evse_security/storage/certificate_storage.hpp>
 #include <evse_security/utils/evse_filesystem.hpp>
 
-#include <fstream>
+#include <atomic>
+#include <ctime>
+#include <iomanip>
 #include <iostream>
 #include <limits>
 #include <random>
+#include <sstream>
 
 #include <everest/logging.hpp>
 
@@ -17,13 +21,32 @@ bool is_subdirectory(const fs::path& base, const fs::path& subdir) {
     return !relativePath.empty();
 }
 
+bool exists(const fs::path& path) {
+    return get_active_storage().stat(path).exists();
+}
+
+bool is_regular_file(const fs::path& path) {
+    return get_active_storage().stat(path).type == StorageEntryType::File;
+}
+
+bool is_directory(const fs::path& path) {
+    return get_active_storage().stat(path).type == StorageEntryType::Directory;
+}
+
+bool list_files(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) {
+    return get_active_storage().list(directory, recursive, out_files);
+}
+
+bool list_file_entries(const fs::path& directory, bool recursive,
+                       std::vector<std::pair<fs::path, StorageStatus>>& out_entries) {
+    return get_active_storage().list_entries(directory, recursive, out_entries);
+}
+
 bool delete_file(const fs::path& file_path) {
-    try {
-        if (fs::is_regular_file(file_path)) {
-            return fs::remove(file_path);
-        }
-    } catch (const std::exception& e) {
-        EVLOG_error << "Filesystem error: " << e.what();
+    auto& storage = get_active_storage();
+
+    if (storage.stat(file_path).type == StorageEntryType::File && storage.remove(file_path)) {
+        return true;
     }
 
     EVLOG_error << "Error deleting file: " << file_path;
@@ -31,39 +54,42 @@ bool delete_file(const fs::path& file_path) {
 }
 
 bool read_from_file(const fs::path& file_path, std::string& out_data) {
-    try {
-        if (fs::is_regular_file(file_path)) {
-            fsstd::ifstream file(file_path, std::ios::binary);
-
-            if (file.is_open()) {
-                out_data = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-                return true;
-            }
-        }
-    } catch (const std::exception& e) {
-        EVLOG_error << "Error while reading from file: " << e.what();
+    if (get_active_storage().read(file_path, out_data)) {
+        return true;
     }
 
     EVLOG_error << "Error reading file: " << file_path;
     return false;
 }
 
+std::shared_ptr<const std::string> read_shared_from_file(const fs::path& file_path) {
+    auto data = get_active_storage().read_shared(file_path);
+
+    if (data == nullptr) {
+        EVLOG_error << "Error reading file: " << file_path;
+    }
+
+    return data;
+}
+
 bool create_file_if_nonexistent(const fs::path& file_path) {
     if (file_path.empty()) {
         EVLOG_warning << "Provided empty path!";
         return false;
     }
 
-    try {
-        if (!fs::exists(file_path)) {
-            std::ofstream file(file_path);
-            return true;
-        } else if (fs::is_directory(file_path)) {
-            EVLOG_error << "Attempting to create file over existing directory: " << file_path;
-            return false;
+    auto& storage = get_active_storage();
+    const auto status = storage.stat(file_path);
+
+    if (status.exists() == false) {
+        if (false == storage.write(file_path, {}, false)) {
+            EVLOG_error << "Error while creating file: " << file_path;
         }
-    } catch (const std::exception& e) {
-        EVLOG_error << "Error while creating file: " << e.what();
+
+        return true;
+    } else if (status.type == StorageEntryType::Directory) {
+        EVLOG_error << "Attempting to create file over existing directory: " << file_path;
+        return false;
     }
 
     return true;
@@ -75,89 +101,106 @@ bool create_file_or_dir_if_nonexistent(const fs::path& path) {
         return false;
     }
 
-    try {
-        // In case the path is missing, create it
-        if (fs::exists(path) == false) {
-            if (path.has_extension()) {
-                std::ofstream new_file(path.c_str());
-                new_file.close();
-                return true;
-            } else {
-                // Else create a directory
-                fs::create_directories(path);
-                return true;
-            }
+    auto& storage = get_active_storage();
+
+    // In case the path is missing, create it
+    if (storage.stat(path).exists() == false) {
+        bool created;
+
+        if (path.has_extension()) {
+            created = storage.write(path, {}, false);
+        } else {
+            // Else create a directory
+            created = storage.create_directories(path);
         }
-    } catch (const std::exception& e) {
-        EVLOG_error << "Error while creating dir/file: " << e.what();
+
+        if (false == created) {
+            EVLOG_error << "Error while creating dir/file: " << path;
+        }
+
+        return created;
     }
 
     return false;
 }
 
 bool write_to_file(const fs::path& file_path, const std::string& data, std::ios::openmode mode) {
-    try {
-        fsstd::ofstream fs(file_path, mode | std::ios::binary);
-        if (!fs.is_open()) {
-            EVLOG_error << "Error opening file: " << file_path;
-            return false;
-        }
-        fs.write(data.c_str(), data.size());
+    const bool append = (mode & std::ios::app) != 0;
 
-        if (!fs) {
-            EVLOG_error << "Error writing to file: " << file_path;
-            return false;
-        }
+    if (get_active_storage().write(file_path, data, append)) {
         return true;
-    } catch (const std::exception& e) {
-        EVLOG_error << "Unknown error occurred while writing to file: " << file_path;
-        return false;
     }
 
-    return true;
+    EVLOG_error << "Error writing to file: " << file_path;
+    return false;
 }
 
-bool process_file(const fs::path& file_path, size_t buffer_size,
-                  std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>&& func) {
-    std::ifstream file(file_path, std::ios::binary);
+bool read_from_files(const std::vector<fs::path>& file_paths, std::vector<std::optional<std::string>>& out_data) {
+    get_active_storage().read_files(file_paths, out_data);
+    bool read_all = true;
 
-    if (!file) {
-        EVLOG_error << "Error opening file: " << file_path;
-        return false;
+    for (std::size_t i = 0; i < file_paths.size(); i++) {
+        if (out_data[i].has_value() == false) {
+            EVLOG_error << "Error reading file: " << file_paths[i];
+            read_all = false;
+        }
     }
 
-    std::vector<std::uint8_t> buffer(buffer_size);
-    bool interupted = false;
+    return read_all;
+}
 
-    while (file.read(reinterpret_cast<char*>(buffer.data()), buffer_size)) {
-        interupted = func(buffer.data(), buffer_size, false);
+bool write_to_files(const std::vector<std::pair<fs::path, std::string>>& files, std::vector<bool>& out_written) {
+    get_active_storage().write_files(files, out_written);
+    bool written_all = true;
 
-        if (interupted) {
-            break;
+    for (std::size_t i = 0; i < files.size(); i++) {
+        if (out_written[i] == false) {
+            EVLOG_error << "Error writing to file: " << files[i].first;
+            written_all = false;
         }
     }
 
-    // Process the remaining bytes
-    if (interupted == false) {
-        size_t remaining = file.gcount();
-        func(buffer.data(), remaining, true);
+    return written_all;
+}
+
+bool delete_files(const std::vector<fs::path>& file_paths, std::vector<bool>& out_deleted) {
+    get_active_storage().remove_files(file_paths, out_deleted);
+    bool deleted_all = true;
+
+    for (std::size_t i = 0; i < file_paths.size(); i++) {
+        if (out_deleted[i] == false) {
+            EVLOG_error << "Error deleting file: " << file_paths[i];
+            deleted_all = false;
+        }
     }
 
-    return true;
+    return deleted_all;
+}
+
+bool process_file(const fs::path& file_path, size_t buffer_size,
+                  std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>&& func) {
+    if (get_active_storage().process_file(file_path, buffer_size, func)) {
+        return true;
+    }
+
+    EVLOG_error << "Error opening file: " << file_path;
+    return false;
 }
 
 std::string get_random_file_name(const std::string& extension) {
-    static std::random_device rd;
-    static std::mt19937 generator(rd());
-    static std::uniform_int_distribution<int> distribution(1, std::numeric_limits<int>::max());
+    // Per thread, the instances of different directories generate names concurrently
+    static thread_local std::mt19937 generator(std::random_device{}());
+    static thread_local std::uniform_int_distribution<int> distribution(1, std::numeric_limits<int>::max());
 
-    static int increment = 0;
+    static std::atomic<int> increment{0};
 
     std::ostringstream buff;
 
     auto now = std::chrono::system_clock::now();
     std::time_t time = std::chrono::system_clock::to_time_t(now);
-    buff << std::put_time(std::gmtime(&time), "M%m_D%d_Y%Y_H%H_M%M_S%S_") << "i" << std::to_string(++increment) << "_r"
+    std::tm time_utc;
+    gmtime_r(&time, &time_utc);
+    buff << std::put_time(&time_utc, "M%m_D%d_Y%Y_H%H_M%M_S%S_") << "i" << std::to_string(++increment) << "_r"
          << distribution(generator) << extension;
 
     return buff.str();
@@ -165,15 +208,21 @@ std::string get_random_file_name(const std::string& extension) {
 
 bool read_hash_from_file(const fs::path& file_path, CertificateHashData& out_hash) {
     if (file_path.extension() == CERT_HASH_EXTENSION) {
+        std::string hash_data;
+
+        if (false == get_active_storage().read(file_path, hash_data)) {
+            EVLOG_error << "Unknown error occurred while reading cert hash file: " << file_path;
+            return false;
+        }
+
         try {
-            std::ifstream hs(file_path);
+            std::istringstream hs(hash_data);
             std::string algo;
 
             hs >> algo;
             hs >> out_hash.issuer_name_hash;
             hs >> out_hash.issuer_key_hash;
             hs >> out_hash.serial_number;
-            hs.close();
 
             out_hash.hash_algorithm = conversions::string_to_hash_algorithm(algo);
 
@@ -187,30 +236,91 @@ bool read_hash_from_file(const fs::path& file_path, CertificateHashData& out_has
     return false;
 }
 
-bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash) {
+static bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash,
+                               const OCSPVerdict* verdict) {
     auto real_path = file_path;
 
     if (file_path.has_extension() == false || file_path.extension() != CERT_HASH_EXTENSION) {
         real_path.replace_extension(CERT_HASH_EXTENSION);
     }
 
+    // Write out the related hash
+    std::ostringstream hs;
+
+    hs << conversions::hash_algorithm_to_string(hash.hash_algorithm) << "\n";
+    hs << hash.issuer_name_hash << "\n";
+    hs << hash.issuer_key_hash << "\n";
+    hs << hash.serial_number << "\n";
+
+    if (verdict != nullptr) {
+        hs << conversions::ocsp_certificate_status_to_string(verdict->status) << "\n";
+
+        // Seconds since epoch, or '-' if the response has no next update
+        if (verdict->next_update.has_value()) {
+            hs << std::chrono::duration_cast<std::chrono::seconds>(verdict->next_update->time_since_epoch()).count()
+               << "\n";
+        } else {
+            hs << "-\n";
+        }
+    }
+
+    if (false == get_active_storage().write(real_path, hs.str(), false)) {
+        EVLOG_error << "Unknown error occurred writing cert hash file: " << file_path;
+        return false;
+    }
+
+    return true;
+}
+
+bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash) {
+    return write_hash_to_file(file_path, hash, nullptr);
+}
+
+bool write_hash_to_file(const fs::path& file_path, const CertificateHashData& hash, const OCSPVerdict& verdict) {
+    return write_hash_to_file(file_path, hash, &verdict);
+}
+
+bool read_ocsp_verdict_from_file(const fs::path& file_path, OCSPVerdict& out_verdict) {
+    if (file_path.extension() != CERT_HASH_EXTENSION) {
+        return false;
+    }
+
+    std::string hash_data;
+
+    if (false == get_active_storage().read(file_path, hash_data)) {
+        EVLOG_error << "Unknown error occurred while reading cert hash file: " << file_path;
+        return false;
+    }
+
+    std::istringstream hs(hash_data);
+    std::string skipped;
+    std::string status;
+    std::string next_update;
+
+    // Skip the hash
+    for (int i = 0; i < 4; i++) {
+        hs >> skipped;
+    }
+
+    if (!(hs >> status >> next_update)) {
+        return false;
+    }
+
     try {
-        // Write out the related hash
-        std::ofstream hs(real_path.c_str());
+        out_verdict.status = conversions::string_to_ocsp_certificate_status(status);
 
-        hs << conversions::hash_algorithm_to_string(hash.hash_algorithm) << "\n";
-        hs << hash.issuer_name_hash << "\n";
-        hs << hash.issuer_key_hash << "\n";
-        hs << hash.serial_number << "\n";
-        hs.close();
+        if (next_update == "-") {
+            out_verdict.next_update = std::nullopt;
+        } else {
+            out_verdict.next_update =
+                std::chrono::system_clock::time_point(std::chrono::seconds(std::stoll(next_update)));
+        }
 
         return true;
     } catch (const std::exception& e) {
-        EVLOG_error << "Unknown error occurred writing cert hash file: " << file_path << " err: " << e.what();
+        EVLOG_error << "Invalid OCSP verdict in cert hash file: " << file_path << " err: " << e.what();
         return false;
     }
-
-    return false;
 }
 
 } // namespace evse_security::filesystem_utils
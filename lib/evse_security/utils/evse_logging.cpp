@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security {
+
+namespace detail {
+std::atomic<int> log_level{static_cast<int>(LogLevel::Verbose)};
+} // namespace detail
+
+void set_log_level(LogLevel level) {
+    detail::log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel get_log_level() {
+    return static_cast<LogLevel>(detail::log_level.load(std::memory_order_relaxed));
+}
+
+} // namespace evse_security
@@ -0,0 +1,596 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/detail/io_uring_backend.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <evse_security/utils/evse_logging.hpp>
+
+namespace evse_security::filesystem_utils::io_uring {
+
+// Requested submission queue size, also the maximum count of files opened by a batch
+static constexpr unsigned RING_ENTRIES = 64;
+// User data of the cancellations, outside of the result indices
+static constexpr std::uint64_t CANCEL_USER_DATA = UINT64_MAX;
+// Wait between the checks of the completion queue, when the ring can not be entered
+static constexpr useconds_t DRAIN_POLL_US = 1000;
+
+/// @brief Minimal io_uring wrapper on top of the raw syscalls, without liburing. Entries are queued
+/// with 'get_sqe' and submitted together, a batch is always completed before a new one is started
+class Ring {
+public:
+    Ring() = default;
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    /// @brief Creates and maps the ring
+    bool init();
+    /// @brief Checks that the kernel supports all the operations we are using
+    bool supports_required_operations();
+
+    /// @brief Queues a new cleared entry, the @p user_data is the result index in 'submit_and_wait'
+    io_uring_sqe* get_sqe(std::uint64_t user_data);
+    /// @brief Submits all queued entries and waits for their completion, each result
+    /// is stored at its user data index. On failure, the entries that were submitted are cancelled
+    /// and waited for, so that none of them still uses the memory of the batch once it returns
+    bool submit_and_wait(std::vector<int>& results);
+
+    unsigned get_capacity() const {
+        return sq_entries;
+    }
+
+private:
+    /// @brief Retracts the entries not consumed by the kernel, cancels the @p in_flight submitted ones and
+    /// waits for their completion
+    void drain(unsigned in_flight, std::vector<int>& results);
+    /// @brief Stores the available completions, returns the count of the completed entries of the batch
+    unsigned reap(std::vector<int>& results);
+
+    int ring_fd{-1};
+    unsigned sq_entries{0};
+    unsigned sq_local_tail{0};
+    unsigned queued{0};
+
+    void* sq_ring{MAP_FAILED};
+    std::size_t sq_ring_size{0};
+    void* cq_ring{MAP_FAILED};
+    std::size_t cq_ring_size{0};
+    void* sqes_ring{MAP_FAILED};
+    std::size_t sqes_size{0};
+
+    unsigned* sq_head{nullptr};
+    unsigned* sq_tail{nullptr};
+    unsigned* sq_mask{nullptr};
+    unsigned* sq_array{nullptr};
+    io_uring_sqe* sqes{nullptr};
+
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned* cq_mask{nullptr};
+    io_uring_cqe* cqes{nullptr};
+};
+
+Ring::~Ring() {
+    if (sqes_ring != MAP_FAILED) {
+        munmap(sqes_ring, sqes_size);
+    }
+
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+}
+
+bool Ring::init() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+
+    if (ring_fd < 0) {
+        EVSE_LOG_debug << "io_uring_setup failed: " << std::strerror(errno);
+        return false;
+    }
+
+    sq_entries = params.sq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels map both rings with a single call
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                   IORING_OFF_SQ_RING);
+
+    if (sq_ring == MAP_FAILED) {
+        return false;
+    }
+
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                       IORING_OFF_CQ_RING);
+
+        if (cq_ring == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ring = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (sqes_ring == MAP_FAILED) {
+        return false;
+    }
+
+    auto* sq = static_cast<std::uint8_t*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqes = static_cast<io_uring_sqe*>(sqes_ring);
+    sq_local_tail = *sq_tail;
+
+    auto* cq = static_cast<std::uint8_t*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+bool Ring::supports_required_operations() {
+    static constexpr unsigned PROBE_OPS = 256;
+
+    std::vector<std::uint8_t> buffer(sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op), 0);
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0) {
+        EVSE_LOG_debug << "io_uring probe failed: " << std::strerror(errno);
+        return false;
+    }
+
+    for (const unsigned op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE,
+                              IORING_OP_UNLINKAT}) {
+        if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+            EVSE_LOG_debug << "io_uring operation not supported: " << op;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+io_uring_sqe* Ring::get_sqe(std::uint64_t user_data) {
+    const unsigned index = sq_local_tail & *sq_mask;
+
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->user_data = user_data;
+
+    sq_array[index] = index;
+    sq_local_tail++;
+    queued++;
+
+    return sqe;
+}
+
+unsigned Ring::reap(std::vector<int>& results) {
+    unsigned completed = 0;
+    unsigned head = *cq_head;
+    const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+
+        if (cqe.user_data == CANCEL_USER_DATA) {
+            continue;
+        }
+
+        if (cqe.user_data < results.size()) {
+            results[cqe.user_data] = cqe.res;
+        }
+
+        completed++;
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return completed;
+}
+
+bool Ring::submit_and_wait(std::vector<int>& results) {
+    unsigned to_submit = queued;
+    unsigned pending = queued;
+    queued = 0;
+
+    // Publish the queued entries to the kernel
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+    while (pending > 0) {
+        const long submitted =
+            syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (submitted >= 0) {
+            to_submit -= std::min(static_cast<unsigned>(submitted), to_submit);
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            EVLOG_warning << "io_uring_enter failed: " << std::strerror(errno);
+
+            pending -= std::min(reap(results), pending);
+            drain(pending - std::min(to_submit, pending), results);
+            return false;
+        }
+
+        pending -= std::min(reap(results), pending);
+    }
+
+    return true;
+}
+
+void Ring::drain(unsigned in_flight, std::vector<int>& results) {
+    // Without a polling thread the kernel only consumes entries on enter, the remaining ones can be retracted
+    sq_local_tail = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+    if (in_flight == 0) {
+        return;
+    }
+
+    // Cancel each entry of the batch, the completed ones are not found
+    for (std::uint64_t user_data = 0; user_data < results.size() && user_data < sq_entries; user_data++) {
+        io_uring_sqe* sqe = get_sqe(CANCEL_USER_DATA);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = user_data;
+    }
+
+    unsigned to_submit = queued;
+    queued = 0;
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+    while (in_flight > 0) {
+        const long submitted =
+            syscall(__NR_io_uring_enter, ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+        if (submitted >= 0) {
+            to_submit -= std::min(static_cast<unsigned>(submitted), to_submit);
+        } else if (errno != EINTR) {
+            // The entries still complete, the wait also runs the completion work of the thread
+            usleep(DRAIN_POLL_US);
+        }
+
+        in_flight -= std::min(reap(results), in_flight);
+    }
+
+    // Cancellations that were not submitted are dropped with the ring
+}
+
+// Set once the kernel refused io_uring, no further attempts are made
+static std::atomic<bool> ring_unavailable{false};
+// Each thread uses its own ring, so that batches of different threads do not mix
+static thread_local std::unique_ptr<Ring> thread_ring;
+
+static Ring* get_ring() {
+    if (thread_ring == nullptr && ring_unavailable == false) {
+        auto ring = std::make_unique<Ring>();
+
+        if (ring->init() && ring->supports_required_operations()) {
+            thread_ring = std::move(ring);
+        } else {
+            EVSE_LOG_info << "io_uring is not available, using blocking file I/O";
+            ring_unavailable = true;
+        }
+    }
+
+    return thread_ring.get();
+}
+
+/// @brief Releases a ring that failed in the middle of a batch, a new one is created on the next use
+static void reset_ring() {
+    thread_ring.reset();
+}
+
+static void close_files(const std::vector<int>& fds) {
+    for (const int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool is_available() {
+    return (get_ring() != nullptr);
+}
+
+bool read_files(const std::vector<fs::path>& file_paths, std::vector<std::optional<std::string>>& out_data) {
+    Ring* ring = get_ring();
+
+    if (ring == nullptr) {
+        return false;
+    }
+
+    std::vector<std::optional<std::string>> data(file_paths.size());
+    const std::size_t batch_size = ring->get_capacity();
+
+    for (std::size_t first = 0; first < file_paths.size(); first += batch_size) {
+        const std::size_t count = std::min(batch_size, file_paths.size() - first);
+
+        std::vector<int> fds(count, -1);
+        std::vector<int> results(count, -1);
+        std::vector<struct statx> stats(count);
+
+        for (std::size_t i = 0; i < count; i++) {
+            io_uring_sqe* sqe = ring->get_sqe(i);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(file_paths[first + i].c_str());
+            // Non blocking, so that a special file can not stall the whole batch
+            sqe->open_flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK;
+        }
+
+        if (false == ring->submit_and_wait(fds)) {
+            // The files opened before the failure are still closed
+            close_files(fds);
+            reset_ring();
+            return false;
+        }
+
+        // Only regular files are read, same as 'read_from_file'
+        for (std::size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                io_uring_sqe* sqe = ring->get_sqe(i);
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = fds[i];
+                sqe->addr = reinterpret_cast<std::uintptr_t>("");
+                sqe->statx_flags = AT_EMPTY_PATH;
+                sqe->len = STATX_TYPE | STATX_SIZE;
+                sqe->addr2 = reinterpret_cast<std::uintptr_t>(&stats[i]);
+            }
+        }
+
+        if (false == ring->submit_and_wait(results)) {
+            close_files(fds);
+            reset_ring();
+            return false;
+        }
+
+        // Bytes read of each file, a short read is continued at its offset until the end of the file
+        std::vector<std::size_t> offsets(count, 0);
+        std::vector<bool> reading(count, false);
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (fds[i] < 0 || results[i] < 0 || S_ISREG(stats[i].stx_mode) == false) {
+                continue;
+            }
+
+            auto& file_data = data[first + i];
+            file_data.emplace(static_cast<std::size_t>(stats[i].stx_size), '\0');
+            reading[i] = (file_data->empty() == false);
+        }
+
+        while (std::find(reading.begin(), reading.end(), true) != reading.end()) {
+            for (std::size_t i = 0; i < count; i++) {
+                if (reading[i]) {
+                    auto& file_data = data[first + i];
+
+                    io_uring_sqe* sqe = ring->get_sqe(i);
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->fd = fds[i];
+                    sqe->addr = reinterpret_cast<std::uintptr_t>(file_data->data() + offsets[i]);
+                    sqe->len = static_cast<std::uint32_t>(file_data->size() - offsets[i]);
+                    sqe->off = offsets[i];
+                }
+            }
+
+            std::fill(results.begin(), results.end(), 0);
+
+            if (false == ring->submit_and_wait(results)) {
+                close_files(fds);
+                reset_ring();
+                return false;
+            }
+
+            for (std::size_t i = 0; i < count; i++) {
+                if (reading[i] == false) {
+                    continue;
+                }
+
+                auto& file_data = data[first + i];
+
+                if (results[i] < 0) {
+                    file_data.reset();
+                    reading[i] = false;
+                } else if (results[i] == 0) {
+                    // The file was truncated since the stat
+                    file_data->resize(offsets[i]);
+                    reading[i] = false;
+                } else {
+                    offsets[i] += static_cast<std::size_t>(results[i]);
+                    reading[i] = (offsets[i] < file_data->size());
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                io_uring_sqe* sqe = ring->get_sqe(i);
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+            }
+        }
+
+        if (false == ring->submit_and_wait(results)) {
+            reset_ring();
+            return false;
+        }
+    }
+
+    out_data = std::move(data);
+    return true;
+}
+
+bool write_files(const std::vector<std::pair<fs::path, std::string>>& files, std::vector<bool>& out_written) {
+    Ring* ring = get_ring();
+
+    if (ring == nullptr) {
+        return false;
+    }
+
+    std::vector<bool> written(files.size(), false);
+    const std::size_t batch_size = ring->get_capacity();
+
+    for (std::size_t first = 0; first < files.size(); first += batch_size) {
+        const std::size_t count = std::min(batch_size, files.size() - first);
+
+        std::vector<int> fds(count, -1);
+        std::vector<int> results(count, 0);
+
+        for (std::size_t i = 0; i < count; i++) {
+            io_uring_sqe* sqe = ring->get_sqe(i);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(files[first + i].first.c_str());
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            // Same permissions as a std::ofstream, the umask is applied by the kernel
+            sqe->len = 0666;
+        }
+
+        if (false == ring->submit_and_wait(fds)) {
+            // The files opened before the failure are still closed
+            close_files(fds);
+            reset_ring();
+            return false;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            const auto& file_data = files[first + i].second;
+
+            if (fds[i] >= 0 && file_data.empty() == false) {
+                io_uring_sqe* sqe = ring->get_sqe(i);
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = fds[i];
+                sqe->addr = reinterpret_cast<std::uintptr_t>(file_data.data());
+                sqe->len = static_cast<std::uint32_t>(file_data.size());
+                sqe->off = 0;
+            }
+        }
+
+        if (false == ring->submit_and_wait(results)) {
+            close_files(fds);
+            reset_ring();
+            return false;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (fds[i] < 0 || results[i] < 0) {
+                continue;
+            }
+
+            // Complete short writes with blocking calls
+            const auto& file_data = files[first + i].second;
+            std::size_t offset = static_cast<std::size_t>(results[i]);
+
+            while (offset < file_data.size()) {
+                const ssize_t res = pwrite(fds[i], file_data.data() + offset, file_data.size() - offset, offset);
+
+                if (res <= 0) {
+                    break;
+                }
+
+                offset += static_cast<std::size_t>(res);
+            }
+
+            written[first + i] = (offset == file_data.size());
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            if (fds[i] >= 0) {
+                io_uring_sqe* sqe = ring->get_sqe(i);
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = fds[i];
+            }
+        }
+
+        std::fill(results.begin(), results.end(), 0);
+
+        if (false == ring->submit_and_wait(results)) {
+            reset_ring();
+            return false;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            // A close can report a delayed write error
+            if (results[i] < 0) {
+                written[first + i] = false;
+            }
+        }
+    }
+
+    out_written = std::move(written);
+    return true;
+}
+
+bool delete_files(const std::vector<fs::path>& file_paths, std::vector<bool>& out_deleted) {
+    Ring* ring = get_ring();
+
+    if (ring == nullptr) {
+        return false;
+    }
+
+    std::vector<bool> deleted(file_paths.size(), false);
+    const std::size_t batch_size = ring->get_capacity();
+
+    for (std::size_t first = 0; first < file_paths.size(); first += batch_size) {
+        const std::size_t count = std::min(batch_size, file_paths.size() - first);
+        std::vector<int> results(count, -1);
+
+        for (std::size_t i = 0; i < count; i++) {
+            io_uring_sqe* sqe = ring->get_sqe(i);
+            sqe->opcode = IORING_OP_UNLINKAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<std::uintptr_t>(file_paths[first + i].c_str());
+            // No AT_REMOVEDIR, directories are not deleted, same as 'delete_file'
+            sqe->unlink_flags = 0;
+        }
+
+        if (false == ring->submit_and_wait(results)) {
+            reset_ring();
+            return false;
+        }
+
+        for (std::size_t i = 0; i < count; i++) {
+            deleted[first + i] = (results[i] == 0);
+        }
+    }
+
+    out_deleted = std::move(deleted);
+    return true;
+}
+
+} // namespace evse_security::filesystem_utils::io_uring
@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include <evse_security/utils/path_locks.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace evse_security {
+
+/// @brief Mutex of each directory that is locked by at least one 'PathLocks'
+static std::mutex registry_mutex;
+static std::map<fs::path, std::weak_ptr<std::shared_mutex>> registry;
+
+static fs::path get_key(const fs::path& directory) {
+    fs::path key = fs::absolute(directory).lexically_normal();
+
+    if (!key.has_filename() && key.has_parent_path() && key != key.root_path()) {
+        key = key.parent_path();
+    }
+
+    return key;
+}
+
+PathLocks::PathLocks(const std::vector<std::vector<fs::path>>& shards) {
+    std::map<fs::path, Entry> keys;
+
+    for (std::size_t shard = 0; shard < shards.size(); shard++) {
+        for (const auto& directory : shards[shard]) {
+            if (directory.empty()) {
+                continue;
+            }
+
+            const fs::path key = get_key(directory);
+            keys[key].shards |= PathShards{1} << shard;
+
+            // Up to the root directory
+            for (fs::path ancestor = key; ancestor.has_relative_path();) {
+                ancestor = ancestor.parent_path();
+                keys[ancestor].nested_shards |= PathShards{1} << shard;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // Releases the directories that are not locked anymore
+    for (auto it = registry.begin(); it != registry.end();) {
+        it = it->second.expired() ? registry.erase(it) : std::next(it);
+    }
+
+    for (auto& [key, key_entry] : keys) {
+        auto& entry = registry[key];
+        auto mutex = entry.lock();
+
+        if (mutex == nullptr) {
+            mutex = std::make_shared<std::shared_mutex>();
+            entry = mutex;
+        }
+
+        key_entry.mutex = std::move(mutex);
+        entries.push_back(std::move(key_entry));
+    }
+}
+
+void PathLocks::lock(PathShards shards) {
+    for (const auto& entry : entries) {
+        if (entry.shards & shards) {
+            entry.mutex->lock();
+        } else if (entry.nested_shards & shards) {
+            entry.mutex->lock_shared();
+        }
+    }
+}
+
+bool PathLocks::try_lock(PathShards shards) {
+    for (std::size_t i = 0; i < entries.size(); i++) {
+        bool locked = true;
+
+        if (entries[i].shards & shards) {
+            locked = entries[i].mutex->try_lock();
+        } else if (entries[i].nested_shards & shards) {
+            locked = entries[i].mutex->try_lock_shared();
+        }
+
+        if (!locked) {
+            while (i > 0) {
+                unlock(entries[--i], shards);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PathLocks::unlock(PathShards shards) {
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        unlock(*it, shards);
+    }
+}
+
+void PathLocks::unlock(const Entry& entry, PathShards shards) {
+    if (entry.shards & shards) {
+        entry.mutex->unlock();
+    } else if (entry.nested_shards & shards) {
+        entry.mutex->unlock_shared();
+    }
+}
+
+} // namespace evse_security
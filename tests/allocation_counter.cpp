@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#include <openssl/crypto.h>
+
+namespace {
+
+thread_local std::uint64_t heap_allocations = 0;
+thread_local std::uint64_t crypto_allocations = 0;
+
+void* count_heap_allocation(std::size_t size) {
+    heap_allocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* crypto_malloc(std::size_t size, const char*, int) {
+    crypto_allocations++;
+    return std::malloc(size);
+}
+
+void* crypto_realloc(void* ptr, std::size_t size, const char*, int) {
+    // A reallocation of an existing block is not a new allocation
+    if (ptr == nullptr) {
+        crypto_allocations++;
+    }
+    return std::realloc(ptr, size);
+}
+
+void crypto_free(void* ptr, const char*, int) {
+    std::free(ptr);
+}
+
+// Registered before the first allocation of OpenSSL, that happens on its first use
+const bool crypto_functions_set = CRYPTO_set_mem_functions(crypto_malloc, crypto_realloc, crypto_free) == 1;
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* ptr = count_heap_allocation(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* ptr = count_heap_allocation(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return count_heap_allocation(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return count_heap_allocation(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace evse_security {
+
+AllocationCount get_allocation_count() {
+    return {heap_allocations, crypto_allocations};
+}
+
+bool is_counting_crypto_allocations() {
+    return crypto_functions_set;
+}
+
+AllocationCounter::AllocationCounter() : start(get_allocation_count()) {
+}
+
+AllocationCount AllocationCounter::get_count() const {
+    const AllocationCount now = get_allocation_count();
+    return {now.heap - start.heap, now.crypto - start.crypto};
+}
+
+} // namespace evse_security
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <cstdint>
+
+namespace evse_security {
+
+/// @brief Allocations of the current thread, counted by the replaced global operator new and by the allocator
+/// registered to OpenSSL. Per thread, so that the allocations of unrelated threads (e.g. a daemon) are not counted
+struct AllocationCount {
+    std::uint64_t heap{0};
+    std::uint64_t crypto{0};
+};
+
+/// @brief Allocations of the current thread since its start
+AllocationCount get_allocation_count();
+
+/// @brief If the allocations of OpenSSL are counted. False if OpenSSL allocated before its allocator could be
+/// registered, the crypto count stays zero then
+bool is_counting_crypto_allocations();
+
+/// @brief Counts the allocations of the current thread while an instance is alive. Instances can be nested, each
+/// counts from its own construction
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    /// @brief Allocations since the construction
+    AllocationCount get_count() const;
+
+private:
+    AllocationCount start;
+};
+
+} // namespace evse_security
@@ -93,3 +93,28 @@ create_certificate INSTALL_TEST_ROOT_CA2 "${TO_BE_INSTALLED_PATH}" install_test.
 create_certificate INSTALL_TEST_ROOT_CA3 "${TO_BE_INSTALLED_PATH}" install_test.cnf 21236
 create_certificate INSTALL_TEST_ROOT_CA3_SUBCA1 "${TO_BE_INSTALLED_PATH}" install_test_subca1.cnf 21237 "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3.pem" "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3.key"
 create_certificate INSTALL_TEST_ROOT_CA3_SUBCA2 "${TO_BE_INSTALLED_PATH}" install_test_subca2.cnf 21238 "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3_SUBCA1.pem" "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3_SUBCA1.key"
+
+# Revocation lists, an empty one of a CA that is not installed and one of the CPO Sub-CA 2 revoking the SECC leaf.
+# The database also holds the CPO Sub-CA 2 as valid, for the OCSP responses
+CRL_PATH="$CERT_PATH/crl"
+mkdir -p "$CRL_PATH"
+rm -f "$CRL_PATH"/index.txt*
+touch "$CRL_PATH/index.txt"
+openssl ca -config configs/crl.cnf -gencrl -cert "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3.pem" -keyfile "${TO_BE_INSTALLED_PATH}/INSTALL_TEST_ROOT_CA3.key" -passin pass:"$password" -out "$CRL_PATH/INSTALL_TEST_ROOT_CA3.crl"
+openssl ca -config configs/crl.cnf -valid "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -cert "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -keyfile "$CA_CSMS_PATH/CPO_SUB_CA1.key" -passin pass:"$password"
+openssl ca -config configs/crl.cnf -valid "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -cert "$CA_V2G_PATH/V2G_ROOT_CA.pem" -keyfile "$CA_V2G_PATH/V2G_ROOT_CA.key" -passin pass:"$password"
+openssl ca -config configs/crl.cnf -revoke "$CLIENT_CSO_PATH/SECC_LEAF.pem" -cert "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -keyfile "$CA_CSMS_PATH/CPO_SUB_CA2.key" -passin pass:"$password"
+openssl ca -config configs/crl.cnf -gencrl -cert "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -keyfile "$CA_CSMS_PATH/CPO_SUB_CA2.key" -passin pass:"$password" -out "$CRL_PATH/CPO_SUB_CA2.crl"
+
+# OCSP responses of the same database, good for the CPO Sub-CAs (a second version with another validity) and revoked
+# for the SECC leaf
+OCSP_PATH="$CERT_PATH/ocsp"
+mkdir -p "$OCSP_PATH"
+openssl ocsp -issuer "$CA_V2G_PATH/V2G_ROOT_CA.pem" -cert "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -no_nonce -reqout "$OCSP_PATH/CPO_SUB_CA1.req"
+openssl ocsp -index "$CRL_PATH/index.txt" -CA "$CA_V2G_PATH/V2G_ROOT_CA.pem" -rsigner "$CA_V2G_PATH/V2G_ROOT_CA.pem" -rkey "$CA_V2G_PATH/V2G_ROOT_CA.key" -passin pass:"$password" -reqin "$OCSP_PATH/CPO_SUB_CA1.req" -respout "$OCSP_PATH/CPO_SUB_CA1_GOOD.der" -ndays 7
+openssl ocsp -index "$CRL_PATH/index.txt" -CA "$CA_V2G_PATH/V2G_ROOT_CA.pem" -rsigner "$CA_V2G_PATH/V2G_ROOT_CA.pem" -rkey "$CA_V2G_PATH/V2G_ROOT_CA.key" -passin pass:"$password" -reqin "$OCSP_PATH/CPO_SUB_CA1.req" -respout "$OCSP_PATH/CPO_SUB_CA1_GOOD_V2.der" -ndays 14
+openssl ocsp -issuer "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -cert "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -no_nonce -reqout "$OCSP_PATH/CPO_SUB_CA2.req"
+openssl ocsp -index "$CRL_PATH/index.txt" -CA "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -rsigner "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -rkey "$CA_CSMS_PATH/CPO_SUB_CA1.key" -passin pass:"$password" -reqin "$OCSP_PATH/CPO_SUB_CA2.req" -respout "$OCSP_PATH/CPO_SUB_CA2_GOOD.der" -ndays 7
+openssl ocsp -index "$CRL_PATH/index.txt" -CA "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -rsigner "$CA_CSMS_PATH/CPO_SUB_CA1.pem" -rkey "$CA_CSMS_PATH/CPO_SUB_CA1.key" -passin pass:"$password" -reqin "$OCSP_PATH/CPO_SUB_CA2.req" -respout "$OCSP_PATH/CPO_SUB_CA2_GOOD_V2.der" -ndays 14
+openssl ocsp -sha256 -issuer "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -cert "$CLIENT_CSO_PATH/SECC_LEAF.pem" -no_nonce -reqout "$OCSP_PATH/SECC_LEAF.req"
+openssl ocsp -index "$CRL_PATH/index.txt" -CA "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -rsigner "$CA_CSMS_PATH/CPO_SUB_CA2.pem" -rkey "$CA_CSMS_PATH/CPO_SUB_CA2.key" -passin pass:"$password" -reqin "$OCSP_PATH/SECC_LEAF.req" -respout "$OCSP_PATH/SECC_LEAF_REVOKED.der" -ndays 7
@@ -0,0 +1,42 @@
+# cmake -DBINARY_DIR=<dir> -DPREFIX=<dir> -DCOMPILER=<c++> -DINCLUDE_DIRECTORIES=<dirs> -P install_check.cmake
+#
+# Installs the build in BINARY_DIR to PREFIX and compiles each installed header of 'evse_security' against the
+# installed include directory and the INCLUDE_DIRECTORIES of the dependencies, without the source tree. Fails if a
+# public header includes a header that is not installed (e.g. one of 'detail').
+file(REMOVE_RECURSE "${PREFIX}")
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} --install "${BINARY_DIR}" --prefix "${PREFIX}"
+    OUTPUT_QUIET
+    RESULT_VARIABLE INSTALL_RESULT
+)
+
+if(NOT INSTALL_RESULT EQUAL 0)
+    message(FATAL_ERROR "Install to ${PREFIX} failed")
+endif()
+
+set(INCLUDE_FLAGS "-I${PREFIX}/include")
+foreach(DIRECTORY ${INCLUDE_DIRECTORIES})
+    list(APPEND INCLUDE_FLAGS "-I${DIRECTORY}")
+endforeach()
+
+file(GLOB_RECURSE HEADERS RELATIVE "${PREFIX}/include" "${PREFIX}/include/evse_security/*.hpp")
+
+if(NOT HEADERS)
+    message(FATAL_ERROR "No headers installed to ${PREFIX}/include/evse_security")
+endif()
+
+foreach(HEADER ${HEADERS})
+    set(SOURCE "${PREFIX}/consumer.cpp")
+    file(WRITE "${SOURCE}" "#include <${HEADER}>\n")
+
+    execute_process(
+        COMMAND ${COMPILER} -std=c++17 -fsyntax-only ${INCLUDE_FLAGS} "${SOURCE}"
+        RESULT_VARIABLE COMPILE_RESULT
+        ERROR_VARIABLE COMPILE_ERROR
+    )
+
+    if(NOT COMPILE_RESULT EQUAL 0)
+        message(FATAL_ERROR "Installed header ${HEADER} does not compile:\n${COMPILE_ERROR}")
+    endif()
+endforeach()
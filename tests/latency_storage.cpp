@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#include "latency_storage.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace evse_security {
+
+using std::chrono::microseconds;
+
+// Latency injected but not slept yet by the thread, negative after a sleep that overshot. Sleeping once the debt
+// reached a millisecond keeps the total accurate despite the timer slack of short sleeps
+static thread_local std::chrono::steady_clock::duration latency_debt{0};
+static constexpr std::chrono::milliseconds MIN_SLEEP{1};
+
+StorageLatencyProfile StorageLatencyProfile::none() {
+    return {};
+}
+
+StorageLatencyProfile StorageLatencyProfile::emmc() {
+    StorageLatencyProfile profile;
+    profile.open = microseconds(150);
+    profile.stat = microseconds(50);
+    profile.readdir = microseconds(300);
+    profile.fsync = microseconds(5000);
+    profile.unlink = microseconds(1000);
+    profile.read_bandwidth = 40 * 1024 * 1024;
+    profile.write_bandwidth = 10 * 1024 * 1024;
+    profile.queue_depth = 32;
+    return profile;
+}
+
+StorageLatencyProfile StorageLatencyProfile::sd_card() {
+    StorageLatencyProfile profile;
+    profile.open = microseconds(500);
+    profile.stat = microseconds(150);
+    profile.readdir = microseconds(1000);
+    profile.fsync = microseconds(20000);
+    profile.unlink = microseconds(3000);
+    profile.read_bandwidth = 10 * 1024 * 1024;
+    profile.write_bandwidth = 2 * 1024 * 1024;
+    profile.queue_depth = 1;
+    return profile;
+}
+
+LatencyStorage::LatencyStorage(const std::shared_ptr<CertificateStorage>& backend,
+                               const StorageLatencyProfile& profile) :
+    backend(backend), profile(profile) {
+}
+
+microseconds LatencyStorage::batched(microseconds latency, std::size_t requests) const {
+    const std::size_t queue_depth = std::max<std::size_t>(profile.queue_depth, 1);
+    return latency * static_cast<microseconds::rep>((requests + queue_depth - 1) / queue_depth);
+}
+
+microseconds LatencyStorage::transfer(std::uintmax_t bytes, std::uintmax_t bandwidth) {
+    if (bandwidth == 0) {
+        return microseconds(0);
+    }
+
+    return microseconds(static_cast<microseconds::rep>(bytes * 1000000 / bandwidth));
+}
+
+void LatencyStorage::inject(microseconds latency) {
+    if (latency.count() <= 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        injected_latency += latency;
+    }
+
+    latency_debt += latency;
+
+    if (latency_debt >= MIN_SLEEP) {
+        const auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(latency_debt);
+        latency_debt -= std::chrono::steady_clock::now() - start;
+    }
+}
+
+StorageStatus LatencyStorage::stat(const fs::path& path) {
+    const StorageStatus status = backend->stat(path);
+    inject(profile.stat);
+    return status;
+}
+
+bool LatencyStorage::list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) {
+    const bool listed = backend->list(directory, recursive, out_files);
+    inject(profile.readdir);
+    return listed;
+}
+
+bool LatencyStorage::list_entries(const fs::path& directory, bool recursive,
+                                  std::vector<std::pair<fs::path, StorageStatus>>& out_entries) {
+    const bool listed = backend->list_entries(directory, recursive, out_entries);
+    inject(profile.readdir + profile.stat * static_cast<microseconds::rep>(listed ? out_entries.size() : 0));
+    return listed;
+}
+
+bool LatencyStorage::read(const fs::path& path, std::string& out_data) {
+    const bool read = backend->read(path, out_data);
+    inject(profile.open + transfer(read ? out_data.size() : 0, profile.read_bandwidth));
+    return read;
+}
+
+std::shared_ptr<const std::string> LatencyStorage::read_shared(const fs::path& path) {
+    auto data = backend->read_shared(path);
+
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& buffer = shared_buffers[path.lexically_normal()];
+        cached = data != nullptr && buffer.lock() == data;
+        buffer = data;
+    }
+
+    // The cached content is still opened to check its identity, but not transferred
+    if (cached) {
+        inject(profile.open);
+    } else {
+        inject(profile.open + transfer(data ? data->size() : 0, profile.read_bandwidth));
+    }
+
+    return data;
+}
+
+bool LatencyStorage::write(const fs::path& path, const std::string& data, bool append) {
+    const bool written = backend->write(path, data, append);
+    inject(profile.open + transfer(data.size(), profile.write_bandwidth) + profile.fsync);
+    return written;
+}
+
+bool LatencyStorage::remove(const fs::path& path) {
+    const bool removed = backend->remove(path);
+    inject(profile.unlink);
+    return removed;
+}
+
+bool LatencyStorage::create_directories(const fs::path& path) {
+    const bool created = backend->create_directories(path);
+    inject(profile.unlink);
+    return created;
+}
+
+bool LatencyStorage::create_symlink(const fs::path& target, const fs::path& link) {
+    const bool created = backend->create_symlink(target, link);
+    inject(profile.unlink);
+    return created;
+}
+
+bool LatencyStorage::read_symlink(const fs::path& link, fs::path& out_target) {
+    const bool read = backend->read_symlink(link, out_target);
+    inject(profile.stat);
+    return read;
+}
+
+bool LatencyStorage::rename(const fs::path& from, const fs::path& to) {
+    const bool renamed = backend->rename(from, to);
+    inject(profile.unlink);
+    return renamed;
+}
+
+bool LatencyStorage::sync(const fs::path& path) {
+    const bool synced = backend->sync(path);
+    inject(profile.fsync);
+    return synced;
+}
+
+void LatencyStorage::read_files(const std::vector<fs::path>& paths,
+                                std::vector<std::optional<std::string>>& out_data) {
+    backend->read_files(paths, out_data);
+
+    std::uintmax_t bytes = 0;
+    for (const auto& data : out_data) {
+        bytes += data ? data->size() : 0;
+    }
+
+    inject(batched(profile.open, paths.size()) + transfer(bytes, profile.read_bandwidth));
+}
+
+void LatencyStorage::write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                                 std::vector<bool>& out_written) {
+    backend->write_files(files, out_written);
+
+    std::uintmax_t bytes = 0;
+    for (const auto& [path, data] : files) {
+        bytes += data.size();
+    }
+
+    inject(batched(profile.open + profile.fsync, files.size()) + transfer(bytes, profile.write_bandwidth));
+}
+
+void LatencyStorage::remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed) {
+    backend->remove_files(paths, out_removed);
+    inject(batched(profile.unlink, paths.size()));
+}
+
+bool LatencyStorage::process_file(const fs::path& path, std::size_t buffer_size,
+                                  const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) {
+    std::uintmax_t bytes = 0;
+    const bool processed =
+        backend->process_file(path, buffer_size, [&](const std::uint8_t* data, std::size_t size, bool last_chunk) {
+            bytes += size;
+            return func(data, size, last_chunk);
+        });
+
+    inject(profile.open + transfer(bytes, profile.read_bandwidth));
+    return processed;
+}
+
+microseconds LatencyStorage::get_injected_latency() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return injected_latency;
+}
+
+} // namespace evse_security
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include <evse_security/storage/certificate_storage.hpp>
+
+namespace evse_security {
+
+/// @brief Latencies and bandwidths of a storage device, injected by the 'LatencyStorage'
+struct StorageLatencyProfile {
+    std::chrono::microseconds open{0};    ///< Opening a file for a read or a write
+    std::chrono::microseconds stat{0};    ///< Status of an entry, also charged per entry of a listing with status
+    std::chrono::microseconds readdir{0}; ///< Listing of a directory
+    std::chrono::microseconds fsync{0};   ///< Syncing a written file
+    std::chrono::microseconds unlink{0};  ///< Metadata change: remove, rename, symlink or directory creation
+    std::uintmax_t read_bandwidth{0};     ///< Bytes per second read, 0 for unlimited
+    std::uintmax_t write_bandwidth{0};    ///< Bytes per second written, 0 for unlimited
+    std::size_t queue_depth{1};           ///< Requests of a batch operation that the device serves in parallel
+
+    /// @brief No injected latency
+    static StorageLatencyProfile none();
+    /// @brief Typical eMMC of a charger, with command queueing
+    static StorageLatencyProfile emmc();
+    /// @brief Typical SD card, without command queueing
+    static StorageLatencyProfile sd_card();
+};
+
+/// @brief Storage decorator for tests and benchmarks, that delays each operation of the backing storage by the
+/// latency of a slow storage device. A batch operation is charged once per 'queue_depth' files, plus the
+/// transfer time of all the files. A read served from the read cache of the backing storage (the same shared
+/// buffer returned again) is charged the open only. The latencies are added to the time of the backing storage,
+/// and slept by the calling thread once they add up to a millisecond
+class LatencyStorage : public CertificateStorage {
+public:
+    LatencyStorage(const std::shared_ptr<CertificateStorage>& backend, const StorageLatencyProfile& profile);
+
+    LatencyStorage(const LatencyStorage&) = delete;
+    LatencyStorage& operator=(const LatencyStorage&) = delete;
+
+    StorageStatus stat(const fs::path& path) override;
+    bool list(const fs::path& directory, bool recursive, std::vector<fs::path>& out_files) override;
+    bool list_entries(const fs::path& directory, bool recursive,
+                      std::vector<std::pair<fs::path, StorageStatus>>& out_entries) override;
+
+    bool read(const fs::path& path, std::string& out_data) override;
+    std::shared_ptr<const std::string> read_shared(const fs::path& path) override;
+    bool write(const fs::path& path, const std::string& data, bool append) override;
+    bool remove(const fs::path& path) override;
+    bool create_directories(const fs::path& path) override;
+    bool create_symlink(const fs::path& target, const fs::path& link) override;
+    bool read_symlink(const fs::path& link, fs::path& out_target) override;
+    bool rename(const fs::path& from, const fs::path& to) override;
+    bool sync(const fs::path& path) override;
+
+    void read_files(const std::vector<fs::path>& paths, std::vector<std::optional<std::string>>& out_data) override;
+    void write_files(const std::vector<std::pair<fs::path, std::string>>& files,
+                     std::vector<bool>& out_written) override;
+    void remove_files(const std::vector<fs::path>& paths, std::vector<bool>& out_removed) override;
+
+    bool process_file(const fs::path& path, std::size_t buffer_size,
+                      const std::function<bool(const std::uint8_t*, std::size_t, bool last_chunk)>& func) override;
+
+    /// @brief Total latency injected since the construction
+    std::chrono::microseconds get_injected_latency();
+
+private:
+    /// @brief Latency of @p requests requests of a batch
+    std::chrono::microseconds batched(std::chrono::microseconds latency, std::size_t requests) const;
+    /// @brief Transfer time of @p bytes at @p bandwidth
+    static std::chrono::microseconds transfer(std::uintmax_t bytes, std::uintmax_t bandwidth);
+    /// @brief Sleeps for @p latency and accounts it
+    void inject(std::chrono::microseconds latency);
+
+    std::shared_ptr<CertificateStorage> backend;
+    StorageLatencyProfile profile;
+
+    std::mutex mutex;
+    std::chrono::microseconds injected_latency{0};
+    /// @brief Last buffer returned by 'read_shared' per path, to recognize the cached reads
+    std::map<fs::path, std::weak_ptr<const std::string>> shared_buffers;
+};
+
+} // namespace evse_security
@@ -3,8 +3,12 @@
 #include <gtest/gtest.h>
 
 #include <evse_security/crypto/openssl/openssl_crypto_supplier.hpp>
+#include <evse_security/crypto/openssl/openssl_types.hpp>
 #include <optional>
 
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
 // #define OUTPUT_CSR
 
 using namespace evse_security;
@@ -16,6 +20,13 @@ static std::string getFile(const std::string name) {
     return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 }
 
+static X509_REQ_ptr read_csr(const std::string& csr) {
+    BIO* bio = BIO_new_mem_buf(csr.data(), static_cast<int>(csr.size()));
+    X509_REQ_ptr req(PEM_read_bio_X509_REQ(bio, nullptr, nullptr, nullptr));
+    BIO_free(bio);
+    return req;
+}
+
 class OpenSSLSupplierTest : public testing::Test {
 protected:
     static void SetUpTestSuite() {
@@ -179,4 +190,61 @@ TEST_F(OpenSSLSupplierTest, x509_generate_csr_dns_ip) {
     ASSERT_GT(csr.size(), 0);
 }
 
+TEST_F(OpenSSLSupplierTest, x509_generate_csr_template_reuse) {
+    CertificateSigningRequestInfo csr_info = {
+        0,
+        "UK",
+        "Pionix",
+        "0123456789",
+        .dns_name = "cs.pionix.de",
+        .ip_address = std::nullopt,
+        {CryptoKeyType::EC_prime256v1, false, std::nullopt, "pki/csr_key.pem", std::nullopt}};
+
+    std::string csr_first;
+    std::string csr_second;
+    ASSERT_EQ(OpenSSLSupplier::x509_generate_csr(csr_info, csr_first), CertificateSignRequestResult::Valid);
+    ASSERT_EQ(OpenSSLSupplier::x509_generate_csr(csr_info, csr_second), CertificateSignRequestResult::Valid);
+
+    csr_info.commonName = "9876543210";
+    std::string csr_other;
+    ASSERT_EQ(OpenSSLSupplier::x509_generate_csr(csr_info, csr_other), CertificateSignRequestResult::Valid);
+
+    // More distinct subjects than cached templates, the first one is prepared again
+    for (int serial = 0; serial < 8; serial++) {
+        csr_info.commonName = "serial" + std::to_string(serial);
+        std::string csr_serial;
+        ASSERT_EQ(OpenSSLSupplier::x509_generate_csr(csr_info, csr_serial), CertificateSignRequestResult::Valid);
+    }
+
+    csr_info.commonName = "0123456789";
+    std::string csr_third;
+    ASSERT_EQ(OpenSSLSupplier::x509_generate_csr(csr_info, csr_third), CertificateSignRequestResult::Valid);
+
+    X509_REQ_ptr first = read_csr(csr_first);
+    X509_REQ_ptr second = read_csr(csr_second);
+    X509_REQ_ptr other = read_csr(csr_other);
+    X509_REQ_ptr third = read_csr(csr_third);
+
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_NE(other, nullptr);
+    ASSERT_NE(third, nullptr);
+
+    // Same prepared subject, but a fresh key and signature for each request
+    ASSERT_EQ(X509_NAME_cmp(X509_REQ_get_subject_name(first.get()), X509_REQ_get_subject_name(second.get())), 0);
+    ASSERT_EQ(X509_NAME_cmp(X509_REQ_get_subject_name(first.get()), X509_REQ_get_subject_name(third.get())), 0);
+    ASSERT_NE(X509_NAME_cmp(X509_REQ_get_subject_name(first.get()), X509_REQ_get_subject_name(other.get())), 0);
+    ASSERT_NE(EVP_PKEY_eq(X509_REQ_get0_pubkey(first.get()), X509_REQ_get0_pubkey(second.get())), 1);
+
+    for (X509_REQ* req : {first.get(), second.get(), other.get(), third.get()}) {
+        ASSERT_EQ(X509_REQ_verify(req, X509_REQ_get0_pubkey(req)), 1);
+
+        STACK_OF(X509_EXTENSION)* extensions = X509_REQ_get_extensions(req);
+        const int extension_count = sk_X509_EXTENSION_num(extensions);
+        sk_X509_EXTENSION_pop_free(extensions, X509_EXTENSION_free);
+
+        ASSERT_EQ(extension_count, 3);
+    }
+}
+
 } // namespace
@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: Apache-2.0
 // Copyright 2020 - 2023 Pionix GmbH and Contributors to EVerest
 
+#include <csignal>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <gtest/gtest.h>
 #include <openssl/crypto.h>
 #include <regex>
@@ -9,10 +12,35 @@
 #include <string>
 #include <thread>
 
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <evse_security/certificate/shared_certificate_cache.hpp>
 #include <evse_security/certificate/x509_bundle.hpp>
+#include <evse_security/certificate/x509_trust_index.hpp>
 #include <evse_security/certificate/x509_wrapper.hpp>
+#include <evse_security/daemon/evse_security_client.hpp>
+#include <evse_security/daemon/evse_security_server.hpp>
+#include <evse_security/detail/directory_snapshot_cache.hpp>
+#include <evse_security/detail/file_content_cache.hpp>
 #include <evse_security/evse_security.hpp>
+#include <evse_security/storage/coalescing_storage.hpp>
+#include <evse_security/storage/in_memory_storage.hpp>
+#include <evse_security/storage/log_file_storage.hpp>
+#include <evse_security/storage/posix_storage.hpp>
 #include <evse_security/utils/evse_filesystem.hpp>
+#include <evse_security/utils/evse_logging.hpp>
+#include <evse_security/utils/path_locks.hpp>
+
+#include <test_v2g_roots.hpp>
+
+#include "allocation_counter.hpp"
+#include "latency_storage.hpp"
 
 #include <evse_security/crypto/evse_crypto.hpp>
 
@@ -52,9 +80,29 @@ bool equal_certificate_strings(const std::string& cert1, const std::string& cert
 
 namespace evse_security {
 
+/// @brief Generated OCSP response for the V2G sub-CA with the @p hash_data, see 'generate_test_certs.sh'
+/// @param version "GOOD", or "GOOD_V2" for a response with a later next update
+static std::string read_subca_ocsp_response(const CertificateHashData& hash_data, const std::string& version = "GOOD") {
+    const X509Wrapper root(read_file_to_string("certs/ca/v2g/V2G_ROOT_CA.pem"), EncodingFormat::PEM);
+    const X509Wrapper subca1(read_file_to_string("certs/ca/csms/CPO_SUB_CA1.pem"), EncodingFormat::PEM);
+    const std::string subca = hash_data == subca1.get_certificate_hash_data(root) ? "CPO_SUB_CA1" : "CPO_SUB_CA2";
+
+    return read_file_to_string("certs/ocsp/" + subca + "_" + version + ".der");
+}
+
+/// @brief Polls the @p condition of a background operation until it is met or a generous deadline passed
+static bool wait_for(const std::function<bool()>& condition) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!condition() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return condition();
+}
+
 class EvseSecurityTests : public ::testing::Test {
 protected:
     std::unique_ptr<EvseSecurity> evse_security;
+    FilePaths file_paths;
 
     void SetUp() override {
         fs::remove_all("certs");
@@ -65,7 +113,6 @@ protected:
         if (!fs::exists("key"))
             fs::create_directory("key");
 
-        FilePaths file_paths;
         file_paths.csms_ca_bundle = fs::path("certs/ca/v2g/V2G_CA_BUNDLE.pem");
         file_paths.mf_ca_bundle = fs::path("certs/ca/v2g/V2G_CA_BUNDLE.pem");
         file_paths.mo_ca_bundle = fs::path("certs/ca/mo/MO_CA_BUNDLE.pem");
@@ -754,16 +801,27 @@ TEST_F(EvseSecurityTests, verify_full_filesystem_install_reject) {
 }
 
 TEST_F(EvseSecurityTests, verify_oscp_cache) {
-    std::string ocsp_mock_response_data = "OCSP_MOCK_RESPONSE_DATA";
-    std::string ocsp_mock_response_data_v2 = "OCSP_MOCK_RESPONSE_DATA_V2";
-
     OCSPRequestDataList data = this->evse_security->get_v2g_ocsp_request_data();
 
     ASSERT_EQ(data.ocsp_request_data_list.size(), 2);
 
-    // Mock a response
+    std::vector<std::string> responses;
+    std::vector<std::string> responses_v2;
     for (auto& ocsp : data.ocsp_request_data_list) {
-        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(), ocsp_mock_response_data);
+        responses.push_back(read_subca_ocsp_response(ocsp.certificate_hash_data.value()));
+        responses_v2.push_back(read_subca_ocsp_response(ocsp.certificate_hash_data.value(), "GOOD_V2"));
+    }
+
+    // A response that can not be verified is not stored
+    this->evse_security->update_ocsp_cache(data.ocsp_request_data_list[0].certificate_hash_data.value(),
+                                           "OCSP_MOCK_RESPONSE_DATA");
+    ASSERT_FALSE(
+        this->evse_security->retrieve_ocsp_cache(data.ocsp_request_data_list[0].certificate_hash_data.value())
+            .has_value());
+
+    for (std::size_t i = 0; i < data.ocsp_request_data_list.size(); i++) {
+        this->evse_security->update_ocsp_cache(data.ocsp_request_data_list[i].certificate_hash_data.value(),
+                                               responses[i]);
     }
 
     // Make sure all info was written and that it is correct
@@ -771,10 +829,11 @@ TEST_F(EvseSecurityTests, verify_oscp_cache) {
 
     ASSERT_TRUE(fs::exists(ocsp_path));
 
-    for (auto& ocsp : data.ocsp_request_data_list) {
-        std::optional<std::string> data = this->evse_security->retrieve_ocsp_cache(ocsp.certificate_hash_data.value());
-        ASSERT_TRUE(data.has_value());
-        ASSERT_EQ(read_file_to_string(data.value()), ocsp_mock_response_data);
+    for (std::size_t i = 0; i < data.ocsp_request_data_list.size(); i++) {
+        std::optional<std::string> cached =
+            this->evse_security->retrieve_ocsp_cache(data.ocsp_request_data_list[i].certificate_hash_data.value());
+        ASSERT_TRUE(cached.has_value());
+        ASSERT_EQ(read_file_to_string(cached.value()), responses[i]);
     }
 
     int entries = 0;
@@ -787,7 +846,8 @@ TEST_F(EvseSecurityTests, verify_oscp_cache) {
         ASSERT_TRUE(ext == DER_EXTENSION || ext == CERT_HASH_EXTENSION);
 
         if (ext == DER_EXTENSION) {
-            ASSERT_EQ(read_file_to_string(ocsp_entry.path()), ocsp_mock_response_data);
+            ASSERT_NE(std::find(responses.begin(), responses.end(), read_file_to_string(ocsp_entry.path())),
+                      responses.end());
         } else if (ext == CERT_HASH_EXTENSION) {
             CertificateHashData hash;
             ASSERT_TRUE(filesystem_utils::read_hash_from_file(ocsp_entry.path(), hash));
@@ -806,14 +866,16 @@ TEST_F(EvseSecurityTests, verify_oscp_cache) {
     ASSERT_EQ(entries, 4); // 2 for hash, 2 for data
 
     // Write data again to test over-writing
-    for (auto& ocsp : data.ocsp_request_data_list) {
-        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(), ocsp_mock_response_data_v2);
+    for (std::size_t i = 0; i < data.ocsp_request_data_list.size(); i++) {
+        this->evse_security->update_ocsp_cache(data.ocsp_request_data_list[i].certificate_hash_data.value(),
+                                               responses_v2[i]);
     }
 
-    for (auto& ocsp : data.ocsp_request_data_list) {
-        std::optional<std::string> data = this->evse_security->retrieve_ocsp_cache(ocsp.certificate_hash_data.value());
-        ASSERT_TRUE(data.has_value());
-        ASSERT_EQ(read_file_to_string(data.value()), ocsp_mock_response_data_v2);
+    for (std::size_t i = 0; i < data.ocsp_request_data_list.size(); i++) {
+        std::optional<std::string> cached =
+            this->evse_security->retrieve_ocsp_cache(data.ocsp_request_data_list[i].certificate_hash_data.value());
+        ASSERT_TRUE(cached.has_value());
+        ASSERT_EQ(read_file_to_string(cached.value()), responses_v2[i]);
     }
 
     // Make sure the info was over-written
@@ -827,7 +889,8 @@ TEST_F(EvseSecurityTests, verify_oscp_cache) {
         ASSERT_TRUE(ext == DER_EXTENSION || ext == CERT_HASH_EXTENSION);
 
         if (ext == DER_EXTENSION) {
-            ASSERT_EQ(read_file_to_string(ocsp_entry.path()), ocsp_mock_response_data_v2);
+            ASSERT_NE(std::find(responses_v2.begin(), responses_v2.end(), read_file_to_string(ocsp_entry.path())),
+                      responses_v2.end());
         } else if (ext == CERT_HASH_EXTENSION) {
             CertificateHashData hash;
             ASSERT_TRUE(filesystem_utils::read_hash_from_file(ocsp_entry.path(), hash));
@@ -862,19 +925,110 @@ TEST_F(EvseSecurityTests, verify_oscp_cache) {
         auto& ocsp = info.ocsp[i];
 
         ASSERT_TRUE(ocsp.ocsp_path.has_value());
-        ASSERT_EQ(read_file_to_string(ocsp.ocsp_path.value()), ocsp_mock_response_data_v2);
+        ASSERT_EQ(read_file_to_string(ocsp.ocsp_path.value()), read_subca_ocsp_response(ocsp.hash, "GOOD_V2"));
     }
 }
 
-TEST_F(EvseSecurityTests, verify_ocsp_garbage_collect) {
-    std::string ocsp_mock_response_data = "OCSP_MOCK_RESPONSE_DATA";
+TEST_F(EvseSecurityTests, verify_ocsp_stapling_payload) {
+    const auto empty_payload = this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G);
+    ASSERT_NE(empty_payload, nullptr);
+    ASSERT_EQ(empty_payload->ocsp.size(), 3);
+
+    for (const auto& ocsp : empty_payload->ocsp) {
+        ASSERT_FALSE(ocsp.has_value());
+    }
+
+    OCSPRequestDataList data = this->evse_security->get_v2g_ocsp_request_data();
+    for (auto& ocsp : data.ocsp_request_data_list) {
+        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(),
+                                               read_subca_ocsp_response(ocsp.certificate_hash_data.value()));
+    }
+
+    const auto payload = this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G);
+    ASSERT_NE(payload, empty_payload);
+    ASSERT_EQ(payload->ocsp.size(), 3);
+
+    // The leaf has no response, the sub-CAs have one
+    const auto info =
+        this->evse_security->get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM, true);
+    ASSERT_EQ(info.info->ocsp.size(), 3);
+    ASSERT_FALSE(payload->ocsp[0].has_value());
+    for (std::size_t i = 1; i < payload->ocsp.size(); i++) {
+        ASSERT_EQ(payload->ocsp[i], read_subca_ocsp_response(info.info->ocsp[i].hash));
+    }
+
+    // Kept while nothing changed
+    ASSERT_EQ(this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G), payload);
+
+    for (auto& ocsp : data.ocsp_request_data_list) {
+        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(),
+                                               read_subca_ocsp_response(ocsp.certificate_hash_data.value(), "GOOD_V2"));
+    }
 
+    const auto updated_payload = this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G);
+    ASSERT_NE(updated_payload, payload);
+    ASSERT_EQ(updated_payload->ocsp[1], read_subca_ocsp_response(info.info->ocsp[1].hash, "GOOD_V2"));
+
+    // A revoked leaf and a response past its next update are not stapled
+    this->evse_security->update_ocsp_cache(info.info->ocsp[0].hash,
+                                           read_file_to_string("certs/ocsp/SECC_LEAF_REVOKED.der"));
+    ASSERT_EQ(this->evse_security->get_ocsp_verdict(info.info->ocsp[0].hash)->status, OCSPCertificateStatus::Revoked);
+
+    fs::path hash_file = info.info->ocsp[2].ocsp_path.value();
+    hash_file.replace_extension(CERT_HASH_EXTENSION);
+    ASSERT_TRUE(filesystem_utils::write_hash_to_file(
+        hash_file, info.info->ocsp[2].hash,
+        OCSPVerdict{OCSPCertificateStatus::Good, std::chrono::system_clock::now() - std::chrono::hours(1)}));
+
+    const auto filtered_payload = this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G);
+    ASSERT_FALSE(filtered_payload->ocsp[0].has_value());
+    ASSERT_TRUE(filtered_payload->ocsp[1].has_value());
+    ASSERT_FALSE(filtered_payload->ocsp[2].has_value());
+
+    ASSERT_EQ(this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::MO), nullptr);
+}
+
+TEST_F(EvseSecurityTests, verify_ocsp_verdict) {
+    const X509Wrapper subca1(read_file_to_string("certs/ca/csms/CPO_SUB_CA1.pem"), EncodingFormat::PEM);
+    const X509Wrapper subca2(read_file_to_string("certs/ca/csms/CPO_SUB_CA2.pem"), EncodingFormat::PEM);
+    const X509Wrapper leaf(read_file_to_string("certs/client/cso/SECC_LEAF.pem"), EncodingFormat::PEM);
+
+    const CertificateHashData subca2_hash = subca2.get_certificate_hash_data(subca1);
+    const CertificateHashData leaf_hash = leaf.get_certificate_hash_data(subca2);
+
+    ASSERT_FALSE(this->evse_security->get_ocsp_verdict(subca2_hash).has_value());
+
+    // Verified against the issuer of the sub-CA
+    this->evse_security->update_ocsp_cache(subca2_hash, read_file_to_string("certs/ocsp/CPO_SUB_CA2_GOOD.der"));
+    auto verdict = this->evse_security->get_ocsp_verdict(subca2_hash);
+    ASSERT_TRUE(verdict.has_value());
+    ASSERT_EQ(verdict->status, OCSPCertificateStatus::Good);
+    ASSERT_TRUE(verdict->next_update.has_value());
+    ASSERT_GT(verdict->next_update.value(), std::chrono::system_clock::now());
+
+    // The response of another certificate, or one that can not be parsed, is not stored
+    this->evse_security->update_ocsp_cache(subca2_hash, read_file_to_string("certs/ocsp/SECC_LEAF_REVOKED.der"));
+    this->evse_security->update_ocsp_cache(subca2_hash, "OCSP_MOCK_RESPONSE_DATA");
+    verdict = this->evse_security->get_ocsp_verdict(subca2_hash);
+    ASSERT_TRUE(verdict.has_value());
+    ASSERT_EQ(verdict->status, OCSPCertificateStatus::Good);
+    ASSERT_EQ(read_file_to_string(this->evse_security->retrieve_ocsp_cache(subca2_hash).value()),
+              read_file_to_string("certs/ocsp/CPO_SUB_CA2_GOOD.der"));
+
+    // Leaf response with a SHA256 certificate ID
+    this->evse_security->update_ocsp_cache(leaf_hash, read_file_to_string("certs/ocsp/SECC_LEAF_REVOKED.der"));
+    verdict = this->evse_security->get_ocsp_verdict(leaf_hash);
+    ASSERT_TRUE(verdict.has_value());
+    ASSERT_EQ(verdict->status, OCSPCertificateStatus::Revoked);
+}
+
+TEST_F(EvseSecurityTests, verify_ocsp_garbage_collect) {
     OCSPRequestDataList data = this->evse_security->get_v2g_ocsp_request_data();
     ASSERT_EQ(data.ocsp_request_data_list.size(), 2);
 
-    // Mock a response
     for (auto& ocsp : data.ocsp_request_data_list) {
-        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(), ocsp_mock_response_data);
+        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(),
+                                               read_subca_ocsp_response(ocsp.certificate_hash_data.value()));
     }
 
     // Make sure all info was written and that it is correct
@@ -886,7 +1040,7 @@ TEST_F(EvseSecurityTests, verify_ocsp_garbage_collect) {
     for (auto& ocsp : data.ocsp_request_data_list) {
         std::optional<fs::path> data = this->evse_security->retrieve_ocsp_cache(ocsp.certificate_hash_data.value());
         ASSERT_TRUE(data.has_value());
-        ASSERT_EQ(read_file_to_string(data.value()), ocsp_mock_response_data);
+        ASSERT_EQ(read_file_to_string(data.value()), read_subca_ocsp_response(ocsp.certificate_hash_data.value()));
     }
 
     evse_security->max_fs_certificate_store_entries = 1;
@@ -1038,19 +1192,27 @@ TEST_F(EvseSecurityTests, verify_expired_csr_deletion) {
     ASSERT_FALSE(fs::exists(csr_key_path));
     ASSERT_EQ(evse_security->managed_csr.size(), 0);
 
-    // Delete unmanaged, future expired CSRs
+    // Pending CSRs are restored after a reboot
     csr = evse_security->generate_certificate_signing_request(LeafCertificateType::CSMS, "DE", "Pionix", "NA");
     csr_key_path = evse_security->managed_csr.begin()->first;
+    const auto created = evse_security->managed_csr.begin()->second.created;
 
     ASSERT_EQ(evse_security->managed_csr.size(), 1);
+    ASSERT_TRUE(fs::exists(fs::path("certs/client/csms") / MANAGED_CSR_JOURNAL_FILE));
 
-    // Remove from managed (simulate a reboot/reinit)
-    evse_security->managed_csr.clear();
+    // Simulate a reboot/reinit, the journal restores the key without a rescan
+    evse_security = std::make_unique<EvseSecurity>(file_paths, "123456");
+    evse_security->max_fs_usage_bytes = 1;
+
+    ASSERT_EQ(evse_security->managed_csr.size(), 1);
+    ASSERT_EQ(evse_security->managed_csr.begin()->first, csr_key_path);
+    ASSERT_EQ(std::chrono::duration_cast<std::chrono::seconds>(evse_security->managed_csr.begin()->second.created -
+                                                               created)
+                  .count(),
+              0);
 
-    // at this GC the should re-add the key to our managed list
     evse_security->csr_expiry = std::chrono::seconds(10);
     evse_security->garbage_collect();
-    ASSERT_EQ(evse_security->managed_csr.size(), 1);
     ASSERT_TRUE(fs::exists(csr_key_path));
 
     // Now it is technically expired again
@@ -1060,6 +1222,47 @@ TEST_F(EvseSecurityTests, verify_expired_csr_deletion) {
     // Garbage collect should delete the expired managed key
     evse_security->garbage_collect();
     ASSERT_FALSE(fs::exists(csr_key_path));
+
+    // The removal is persisted too
+    evse_security = std::make_unique<EvseSecurity>(file_paths, "123456");
+    ASSERT_EQ(evse_security->managed_csr.size(), 0);
+
+    // An unchanged journal is not rewritten on start
+    const fs::path journal_path = fs::path("certs/client/csms") / MANAGED_CSR_JOURNAL_FILE;
+    struct stat journal_before {};
+    struct stat journal_after {};
+    ASSERT_EQ(::stat(journal_path.c_str(), &journal_before), 0);
+    evse_security = std::make_unique<EvseSecurity>(file_paths, "123456");
+    ASSERT_EQ(::stat(journal_path.c_str(), &journal_after), 0);
+    ASSERT_EQ(journal_before.st_ino, journal_after.st_ino);
+
+    // A failed CSR does not leave a managed key, neither in memory nor in the journal
+    const auto keys_before = std::distance(fs::directory_iterator("certs/client/csms"), fs::directory_iterator());
+    CertificateSigningRequestInfo failing_info;
+    failing_info.n_version = 0;
+    failing_info.commonName = "NA";
+    failing_info.country = "DE";
+    failing_info.organization = "Pionix";
+    failing_info.key_info.key_type = CryptoKeyType::EC_prime256v1;
+    failing_info.key_info.private_key_file = fs::path("certs/client/csms/CSMS_FAILED.key");
+    // The private key is written, the public key export to a missing directory fails
+    failing_info.key_info.public_key_file = fs::path("certs/client/csms/missing/CSMS_FAILED.pub");
+    csr = evse_security->generate_certificate_signing_request_internal(LeafCertificateType::CSMS, failing_info);
+    ASSERT_NE(csr.status, GetCertificateSignRequestStatus::Accepted);
+    ASSERT_EQ(evse_security->managed_csr.size(), 0);
+    ASSERT_EQ(std::distance(fs::directory_iterator("certs/client/csms"), fs::directory_iterator()), keys_before);
+
+    evse_security = std::make_unique<EvseSecurity>(file_paths, "123456");
+    ASSERT_EQ(evse_security->managed_csr.size(), 0);
+
+    // Without a journal (older installation) the orphaned keys are found by a scan
+    csr = evse_security->generate_certificate_signing_request(LeafCertificateType::CSMS, "DE", "Pionix", "NA");
+    csr_key_path = evse_security->managed_csr.begin()->first;
+    fs::remove(fs::path("certs/client/csms") / MANAGED_CSR_JOURNAL_FILE);
+
+    evse_security = std::make_unique<EvseSecurity>(file_paths, "123456");
+    ASSERT_EQ(evse_security->managed_csr.size(), 1);
+    ASSERT_EQ(evse_security->managed_csr.begin()->first, csr_key_path);
 }
 
 TEST_F(EvseSecurityTests, verify_base64) {
@@ -1078,6 +1281,1143 @@ TEST_F(EvseSecurityTests, verify_base64) {
     ASSERT_EQ(test_string1, out_encoded);
 }
 
+TEST_F(EvseSecurityTests, verify_batch_file_operations) {
+    const fs::path batch_dir = "certs/batch";
+    fs::create_directories(batch_dir / "subdir");
+
+    // More files than a single io_uring submission
+    std::vector<std::pair<fs::path, std::string>> files;
+    for (int i = 0; i < 150; i++) {
+        files.emplace_back(batch_dir / ("file_" + std::to_string(i) + ".pem"), std::string(i * 7, 'a' + (i % 26)));
+    }
+
+    std::vector<bool> written;
+    ASSERT_TRUE(filesystem_utils::write_to_files(files, written));
+    ASSERT_EQ(written.size(), files.size());
+
+    std::vector<fs::path> paths;
+    for (const auto& file : files) {
+        paths.push_back(file.first);
+    }
+
+    // Missing files and directories are reported per entry
+    paths.push_back(batch_dir / "missing.pem");
+    paths.push_back(batch_dir / "subdir");
+
+    std::vector<std::optional<std::string>> data;
+    ASSERT_FALSE(filesystem_utils::read_from_files(paths, data));
+    ASSERT_EQ(data.size(), paths.size());
+
+    for (std::size_t i = 0; i < files.size(); i++) {
+        ASSERT_TRUE(data[i].has_value());
+        ASSERT_EQ(data[i].value(), files[i].second);
+    }
+
+    ASSERT_FALSE(data[files.size()].has_value());
+    ASSERT_FALSE(data[files.size() + 1].has_value());
+
+    // Overwrite truncates
+    files.resize(1);
+    files[0].second = "short";
+    ASSERT_TRUE(filesystem_utils::write_to_files(files, written));
+    ASSERT_EQ(read_file_to_string(files[0].first), "short");
+
+    std::vector<bool> deleted;
+    ASSERT_FALSE(filesystem_utils::delete_files(paths, deleted));
+    ASSERT_EQ(deleted.size(), paths.size());
+    ASSERT_EQ(std::count(deleted.begin(), deleted.end(), true), 150);
+    ASSERT_TRUE(fs::is_directory(batch_dir / "subdir"));
+    ASSERT_FALSE(fs::exists(paths[0]));
+}
+
+TEST_F(EvseSecurityTests, verify_in_memory_storage_operations) {
+    InMemoryStorage storage;
+    std::string data;
+
+    ASSERT_TRUE(storage.create_directories("certs/ca/v2g"));
+    ASSERT_EQ(storage.stat("certs/ca/").type, StorageEntryType::Directory);
+
+    // The parent directory must exist
+    ASSERT_FALSE(storage.write("certs/missing/file.pem", "data", false));
+    ASSERT_TRUE(storage.write("certs/ca/v2g/ROOT.pem", "root", false));
+    ASSERT_TRUE(storage.write("certs/ca/v2g/ROOT.pem", "_appended", true));
+    ASSERT_TRUE(storage.read("certs/ca/v2g/ROOT.pem", data));
+    ASSERT_EQ(data, "root_appended");
+    ASSERT_EQ(storage.stat("certs/ca/v2g/ROOT.pem").size, data.size());
+
+    // Symlinks are followed, relative to the directory of the link
+    ASSERT_TRUE(storage.create_directories("certs/links"));
+    ASSERT_TRUE(storage.create_symlink("../ca/v2g/ROOT.pem", "certs/links/root_link.pem"));
+    ASSERT_TRUE(storage.read("certs/links/root_link.pem", data));
+    ASSERT_EQ(data, "root_appended");
+
+    const auto link_status = storage.stat("certs/links/root_link.pem");
+    ASSERT_TRUE(link_status.symlink);
+    ASSERT_EQ(link_status.type, StorageEntryType::File);
+
+    std::vector<fs::path> files;
+    ASSERT_TRUE(storage.list("certs", true, files));
+    ASSERT_EQ(files.size(), 2);
+    ASSERT_TRUE(storage.list("certs/ca", false, files));
+    ASSERT_TRUE(files.empty());
+
+    // Renaming a directory moves its content
+    ASSERT_TRUE(storage.rename("certs/ca", "certs/ca_moved"));
+    ASSERT_FALSE(storage.stat("certs/ca/v2g/ROOT.pem").exists());
+    ASSERT_TRUE(storage.read("certs/ca_moved/v2g/ROOT.pem", data));
+    ASSERT_EQ(storage.stat("certs/links/root_link.pem").type, StorageEntryType::None);
+
+    // Removing a link does not remove its target, and only empty directories are removed
+    ASSERT_TRUE(storage.remove("certs/links/root_link.pem"));
+    ASSERT_FALSE(storage.remove("certs/ca_moved/v2g"));
+    ASSERT_TRUE(storage.remove("certs/ca_moved/v2g/ROOT.pem"));
+    ASSERT_TRUE(storage.remove("certs/ca_moved/v2g"));
+
+    // Nothing was written to the filesystem
+    ASSERT_FALSE(fs::exists("certs/ca_moved"));
+}
+
+TEST_F(EvseSecurityTests, verify_in_memory_storage_evse_security) {
+    auto storage = std::make_shared<InMemoryStorage>();
+
+    // Start from the same certificates as the filesystem
+    for (const auto& entry : fs::recursive_directory_iterator("certs")) {
+        if (entry.is_directory()) {
+            ASSERT_TRUE(storage->create_directories(entry.path()));
+        } else if (entry.is_regular_file()) {
+            ASSERT_TRUE(storage->create_directories(entry.path().parent_path()));
+            ASSERT_TRUE(storage->write(entry.path(), read_file_to_string(entry.path()), false));
+        }
+    }
+
+    const auto filesystem_bundle = read_file_to_string(file_paths.v2g_ca_bundle);
+    auto memory_security = std::make_unique<EvseSecurity>(file_paths, "123456", std::nullopt, std::nullopt,
+                                                          std::nullopt, std::nullopt, storage);
+
+    ASSERT_EQ(memory_security->get_count_of_installed_certificates({CertificateType::V2GRootCertificate}),
+              this->evse_security->get_count_of_installed_certificates({CertificateType::V2GRootCertificate}));
+
+    const auto client_certificate = read_file_to_string(fs::path("certs/client/csms/CSMS_LEAF.pem"));
+    ASSERT_EQ(memory_security->verify_certificate(client_certificate, LeafCertificateType::CSMS),
+              CertificateValidationResult::Valid);
+
+    const auto new_root_ca =
+        read_file_to_string(std::filesystem::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA1.pem"));
+    ASSERT_EQ(memory_security->install_ca_certificate(new_root_ca, CaCertificateType::V2G),
+              InstallCertificateResult::Accepted);
+    ASSERT_TRUE(memory_security->is_ca_certificate_installed(CaCertificateType::V2G));
+
+    // The key of a CSR is generated in the storage too
+    const auto csr = memory_security->generate_certificate_signing_request(LeafCertificateType::CSMS, "DE", "Pionix",
+                                                                           "NA");
+    ASSERT_EQ(csr.status, GetCertificateSignRequestStatus::Accepted);
+
+    std::vector<fs::path> memory_files;
+    ASSERT_TRUE(storage->list(file_paths.directories.csms_leaf_key_directory, false, memory_files));
+
+    std::size_t filesystem_files = 0;
+    for (const auto& entry : fs::directory_iterator(file_paths.directories.csms_leaf_key_directory)) {
+        filesystem_files += entry.is_regular_file() ? 1 : 0;
+    }
+
+    // Only the new key was added
+    ASSERT_EQ(memory_files.size(), filesystem_files + 1);
+
+    // The filesystem was not modified
+    ASSERT_EQ(read_file_to_string(file_paths.v2g_ca_bundle), filesystem_bundle);
+
+    std::string memory_bundle;
+    ASSERT_TRUE(storage->read(file_paths.v2g_ca_bundle, memory_bundle));
+    ASSERT_NE(memory_bundle, filesystem_bundle);
+}
+
+TEST_F(EvseSecurityTests, verify_log_file_storage) {
+    const fs::path log_file = "certs/store.log";
+
+    {
+        LogFileStorage storage(log_file);
+
+        ASSERT_TRUE(storage.create_directories("ca/v2g"));
+        ASSERT_TRUE(storage.write("ca/v2g/ROOT.pem", "root", false));
+        ASSERT_TRUE(storage.write("ca/v2g/ROOT.pem", "_appended", true));
+        ASSERT_TRUE(storage.create_symlink("v2g/ROOT.pem", "ca/root_link.pem"));
+        ASSERT_TRUE(storage.write("ca/v2g/REMOVED.pem", "removed", false));
+        ASSERT_TRUE(storage.remove("ca/v2g/REMOVED.pem"));
+        ASSERT_TRUE(storage.rename("ca/v2g", "ca/v2g_renamed"));
+        ASSERT_TRUE(storage.create_symlink("v2g_renamed/ROOT.pem", "ca/renamed_link.pem"));
+    }
+
+    const auto replayed = [&](LogFileStorage& storage) {
+        std::string data;
+
+        ASSERT_TRUE(storage.read("ca/v2g_renamed/ROOT.pem", data));
+        ASSERT_EQ(data, "root_appended");
+        ASSERT_TRUE(storage.read("ca/renamed_link.pem", data));
+        ASSERT_EQ(data, "root_appended");
+        ASSERT_TRUE(storage.stat("ca/root_link.pem").symlink);
+        ASSERT_FALSE(storage.stat("ca/v2g").exists());
+        ASSERT_FALSE(storage.stat("ca/v2g_renamed/REMOVED.pem").exists());
+    };
+
+    // A power loss while appending a record, the incomplete record is discarded
+    const auto log_size = fs::file_size(log_file);
+    {
+        std::ofstream log(log_file, std::ios::app | std::ios::binary);
+        log << std::string("\x40\x00\x00\x00\x12\x34", 6);
+    }
+
+    {
+        LogFileStorage storage(log_file);
+        replayed(storage);
+
+        ASSERT_EQ(fs::file_size(log_file), log_size);
+        ASSERT_EQ(storage.get_log_size(), log_size);
+
+        // A corrupted record is discarded with everything after it
+        ASSERT_TRUE(storage.write("ca/CORRUPTED.pem", "corrupted", false));
+    }
+
+    {
+        std::fstream log(log_file, std::ios::in | std::ios::out | std::ios::binary);
+        log.seekp(-1, std::ios::end);
+        log.put('X');
+    }
+
+    {
+        LogFileStorage storage(log_file);
+        replayed(storage);
+        ASSERT_FALSE(storage.stat("ca/CORRUPTED.pem").exists());
+
+        // Overwrites grow the log until it is compacted
+        for (int i = 0; i < 100; i++) {
+            ASSERT_TRUE(storage.write("ca/v2g_renamed/ROOT.pem", std::string(1000, 'a' + (i % 26)), false));
+        }
+
+        ASSERT_TRUE(storage.compact());
+        ASSERT_LT(storage.get_log_size(), 2000);
+        ASSERT_TRUE(storage.write("ca/v2g_renamed/ROOT.pem", "root_appended", false));
+
+        // Exported for external consumers
+        ASSERT_TRUE(storage.export_to_filesystem("ca", "certs/exported"));
+    }
+
+    ASSERT_EQ(read_file_to_string("certs/exported/v2g_renamed/ROOT.pem"), "root_appended");
+    ASSERT_EQ(read_file_to_string("certs/exported/renamed_link.pem"), "root_appended");
+
+    {
+        LogFileStorage storage(log_file);
+        replayed(storage);
+
+        // A modification that can not be logged does not take effect
+        struct rlimit limit {};
+        ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &limit), 0);
+
+        struct rlimit reduced = limit;
+        reduced.rlim_cur = storage.get_log_size() + 16;
+
+        const auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+        ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &reduced), 0);
+        const bool written = storage.write("ca/FAILED.pem", std::string(1000, 'f'), false);
+        ::setrlimit(RLIMIT_FSIZE, &limit);
+        std::signal(SIGXFSZ, previous_handler);
+
+        ASSERT_FALSE(written);
+        ASSERT_FALSE(storage.stat("ca/FAILED.pem").exists());
+
+        // The partial record is dropped before the next one
+        ASSERT_TRUE(storage.write("ca/AFTER.pem", "after", false));
+    }
+
+    {
+        LogFileStorage storage(log_file);
+        replayed(storage);
+        ASSERT_FALSE(storage.stat("ca/FAILED.pem").exists());
+        ASSERT_TRUE(storage.stat("ca/AFTER.pem").exists());
+    }
+
+    // Not a log
+    ASSERT_THROW(LogFileStorage("certs/ca/v2g/V2G_ROOT_CA.pem"), std::runtime_error);
+}
+
+TEST_F(EvseSecurityTests, verify_coalescing_storage) {
+    auto backend = std::make_shared<InMemoryStorage>();
+    ASSERT_TRUE(backend->create_directories("ocsp"));
+
+    {
+        CoalescingStorage storage(backend);
+
+        // Unchanged content is not written again
+        ASSERT_TRUE(storage.write("ocsp/response.der", "response", false));
+        ASSERT_TRUE(storage.write("ocsp/response.der", "response", false));
+        ASSERT_TRUE(storage.write("ocsp/response.der", "response_v2", false));
+        ASSERT_TRUE(storage.write("ocsp/response.der", "_appended", true));
+
+        const auto statistics = storage.get_statistics();
+        ASSERT_EQ(statistics.writes, 3);
+        ASSERT_EQ(statistics.skipped_writes, 1);
+        ASSERT_EQ(statistics.bytes_written, std::string("responseresponse_v2_appended").size());
+    }
+
+    std::string data;
+
+    {
+        CoalescingStorage storage(backend, std::chrono::milliseconds(100));
+
+        // Repeated writes within the window are merged
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(storage.write("ocsp/new.der", "new_" + std::to_string(i), false));
+        }
+
+        // Visible before being written
+        ASSERT_TRUE(storage.read("ocsp/new.der", data));
+        ASSERT_EQ(data, "new_9");
+        ASSERT_EQ(storage.stat("ocsp/new.der").type, StorageEntryType::File);
+
+        // A same size rewrite is still reported as modified
+        const auto modification_time = storage.stat("ocsp/new.der").modification_time;
+        ASSERT_TRUE(storage.write("ocsp/new.der", "new_8", false));
+        ASSERT_TRUE(storage.write("ocsp/new.der", "new_9", false));
+        ASSERT_GT(storage.stat("ocsp/new.der").modification_time, modification_time);
+
+        std::vector<fs::path> files;
+        ASSERT_TRUE(storage.list("ocsp", false, files));
+        ASSERT_EQ(files.size(), 2);
+
+        ASSERT_FALSE(backend->stat("ocsp/new.der").exists());
+        ASSERT_FALSE(storage.write("missing/new.der", "new", false));
+
+        // Written once the window elapsed
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        ASSERT_TRUE(backend->read("ocsp/new.der", data));
+        ASSERT_EQ(data, "new_9");
+
+        auto statistics = storage.get_statistics();
+        ASSERT_EQ(statistics.writes, 1);
+        ASSERT_EQ(statistics.coalesced_writes, 11);
+        ASSERT_EQ(statistics.failed_writes, 0);
+
+        // Pending writes are written on destruction, a removed one is dropped
+        ASSERT_TRUE(storage.write("ocsp/last.der", "last", false));
+        ASSERT_TRUE(storage.write("ocsp/dropped.der", "dropped", false));
+        ASSERT_TRUE(storage.remove("ocsp/dropped.der"));
+    }
+
+    ASSERT_TRUE(backend->read("ocsp/last.der", data));
+    ASSERT_EQ(data, "last");
+    ASSERT_FALSE(backend->stat("ocsp/dropped.der").exists());
+
+    // A failed delayed write is retried without another write or flush
+    ASSERT_TRUE(backend->create_directories("retry"));
+    {
+        CoalescingStorage storage(backend, std::chrono::milliseconds(20));
+        ASSERT_TRUE(storage.write("retry/response.der", "retried", false));
+        ASSERT_TRUE(backend->remove("retry"));
+
+        ASSERT_TRUE(wait_for([&storage]() { return storage.get_statistics().failed_writes > 0; }));
+        ASSERT_TRUE(backend->create_directories("retry"));
+        ASSERT_TRUE(wait_for([&backend]() { return backend->stat("retry/response.der").exists(); }));
+    }
+}
+
+TEST_F(EvseSecurityTests, verify_latency_storage) {
+    StorageLatencyProfile profile;
+    profile.open = std::chrono::milliseconds(5);
+    profile.stat = std::chrono::milliseconds(1);
+    profile.readdir = std::chrono::milliseconds(2);
+    profile.read_bandwidth = 1000;
+    profile.queue_depth = 4;
+
+    LatencyStorage storage(std::make_shared<InMemoryStorage>(), profile);
+    ASSERT_TRUE(storage.create_directories("certs"));
+    ASSERT_TRUE(storage.write("certs/cert.pem", "0123456789", false));
+
+    const auto start_latency = storage.get_injected_latency();
+    const auto start = std::chrono::steady_clock::now();
+
+    // Open and 10 bytes at 1000 bytes per second
+    std::string data;
+    ASSERT_TRUE(storage.read("certs/cert.pem", data));
+    ASSERT_EQ(data, "0123456789");
+    ASSERT_EQ(storage.get_injected_latency() - start_latency, std::chrono::milliseconds(15));
+    // Less the overshoot of the previous sleeps of the thread, that is credited
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(14));
+
+    std::vector<std::pair<fs::path, StorageStatus>> entries;
+    ASSERT_TRUE(storage.list_entries("certs", false, entries));
+    ASSERT_EQ(entries.size(), 1);
+    ASSERT_EQ(storage.get_injected_latency() - start_latency, std::chrono::milliseconds(18));
+
+    // A batch of 5 files is served in 2 rounds of the queue depth
+    std::vector<fs::path> paths(5, "certs/cert.pem");
+    std::vector<std::optional<std::string>> batch;
+    storage.read_files(paths, batch);
+    ASSERT_EQ(batch.size(), 5);
+    ASSERT_EQ(storage.get_injected_latency() - start_latency, std::chrono::milliseconds(18 + 10 + 50));
+
+    // The profiles of the charger storage
+    ASSERT_GT(StorageLatencyProfile::sd_card().fsync, StorageLatencyProfile::emmc().fsync);
+    ASSERT_EQ(StorageLatencyProfile::none().open.count(), 0);
+}
+
+TEST_F(EvseSecurityTests, verify_path_locks) {
+    PathLocks locks({{"certs/ca/v2g"}, {"certs/client/cso/"}});
+    std::lock_guard<PathLocks> guard(locks);
+
+    // Locked from another thread, since the mutexes are not recursive
+    auto try_lock = [](const std::vector<fs::path>& directories) {
+        bool locked = false;
+        std::thread([&]() {
+            PathLocks other({directories});
+            locked = other.try_lock();
+            if (locked) {
+                other.unlock();
+            }
+        }).join();
+        return locked;
+    };
+
+    // Disjoint directories do not contend, a common one (also by another spelling) excludes
+    ASSERT_TRUE(try_lock({"certs/ca/csms", "certs/client/csms"}));
+    ASSERT_FALSE(try_lock({"certs/ca/csms", "certs/client/cso"}));
+    ASSERT_FALSE(try_lock({fs::absolute("certs/ca/v2g")}));
+
+    // Overlapping directories exclude, in both directions
+    ASSERT_FALSE(try_lock({"certs/ca"}));
+    ASSERT_FALSE(try_lock({"certs"}));
+    ASSERT_FALSE(try_lock({"certs/ca/v2g/ocsp"}));
+    ASSERT_TRUE(try_lock({"certs/ca/v2gx"}));
+
+    // Only the directories of the held shards exclude
+    PathLocks shards({{"certs/ca/csms"}, {"certs/client/csms", "certs/ca/mf"}});
+    {
+        PathShardGuard shard_guard(shards, 1 << 1);
+        ASSERT_TRUE(try_lock({"certs/ca/csms"}));
+        ASSERT_FALSE(try_lock({"certs/ca/mf"}));
+    }
+    ASSERT_TRUE(try_lock({"certs/ca/mf"}));
+
+    // A held ancestor excludes its nested directories
+    PathLocks ancestor({{"certs/ca/mo"}});
+    {
+        std::lock_guard<PathLocks> ancestor_guard(ancestor);
+        ASSERT_FALSE(try_lock({"certs/ca/mo/ocsp"}));
+    }
+    ASSERT_TRUE(try_lock({"certs/ca/mo/ocsp"}));
+}
+
+TEST_F(EvseSecurityTests, verify_lock_sharding) {
+    // Another user of the SECC leaf directory, e.g. a long V2G garbage collect
+    PathLocks secc({{"certs/client/cso/"}});
+    secc.lock();
+
+    // The CSMS and MO operations do not wait for it
+    auto csms = std::async(std::launch::async, [this]() {
+        return this->evse_security->get_leaf_certificate_info(LeafCertificateType::CSMS, EncodingFormat::PEM).status;
+    });
+    auto mo = std::async(std::launch::async, [this]() {
+        return this->evse_security->is_ca_certificate_installed(CaCertificateType::MO);
+    });
+
+    const bool completed = csms.wait_for(std::chrono::seconds(10)) == std::future_status::ready &&
+                           mo.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+    secc.unlock();
+
+    ASSERT_TRUE(completed);
+    ASSERT_EQ(csms.get(), GetCertificateInfoStatus::Accepted);
+
+    // A bundle directory is its own shard, also if its name has an extension, and not the directory of the others
+    fs::create_directories("certs/ca/mo.d");
+    FilePaths directory_paths = file_paths;
+    directory_paths.mo_ca_bundle = "certs/ca/mo.d";
+    EvseSecurity directory_security(directory_paths, "123456");
+
+    PathLocks v2g({{"certs/ca/v2g"}});
+    v2g.lock();
+
+    auto mo_directory = std::async(std::launch::async, [&directory_security]() {
+        return directory_security.is_ca_certificate_installed(CaCertificateType::MO);
+    });
+
+    const bool directory_completed = mo_directory.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+    v2g.unlock();
+
+    ASSERT_TRUE(directory_completed);
+    ASSERT_FALSE(mo_directory.get());
+}
+
+TEST_F(EvseSecurityTests, verify_root_summary) {
+    EvseSecurity::RootSummary summary;
+    summary.validity = {{100, 200}, {150, 300}};
+
+    // Recounted at each activation and expiry
+    summary.update(50);
+    ASSERT_EQ(summary.valid_roots, 0);
+    ASSERT_EQ(summary.next_transition, 100);
+    summary.update(160);
+    ASSERT_EQ(summary.valid_roots, 2);
+    ASSERT_EQ(summary.next_transition, 201);
+    summary.update(201);
+    ASSERT_EQ(summary.valid_roots, 1);
+    ASSERT_EQ(summary.next_transition, 301);
+    summary.update(301);
+    ASSERT_EQ(summary.valid_roots, 0);
+    ASSERT_EQ(summary.next_transition, std::numeric_limits<std::int64_t>::max());
+
+    // Rebuilt once the bundle changed
+    ASSERT_FALSE(this->evse_security->is_ca_certificate_installed(CaCertificateType::MO));
+
+    const auto mo_root = read_file_to_string("certs/ca/v2g/V2G_ROOT_CA.pem");
+    ASSERT_EQ(this->evse_security->install_ca_certificate(mo_root, CaCertificateType::MO),
+              InstallCertificateResult::Accepted);
+    ASSERT_TRUE(this->evse_security->is_ca_certificate_installed(CaCertificateType::MO));
+
+    std::ofstream("certs/ca/mo/MO_CA_BUNDLE.pem", std::ios::trunc);
+    ASSERT_FALSE(this->evse_security->is_ca_certificate_installed(CaCertificateType::MO));
+}
+
+TEST_F(EvseSecurityTests, verify_expiry_watch) {
+    const int leaf_days = this->evse_security->get_leaf_expiry_days_count(LeafCertificateType::V2G);
+    ASSERT_GT(leaf_days, 0);
+    ASSERT_EQ(this->evse_security->get_leaf_expiry_days_count(LeafCertificateType::V2G), leaf_days);
+
+    using ExpiryType = std::variant<LeafCertificateType, CaCertificateType>;
+    std::vector<CertificateExpiry> events;
+    const auto watch_id = this->evse_security->register_expiry_watch(
+        {1, 1000000}, [&events](const CertificateExpiry& expiry) { events.push_back(expiry); });
+
+    // Checked on registration, with the smallest threshold crossed
+    const auto leaf_event = std::find_if(events.begin(), events.end(), [](const CertificateExpiry& expiry) {
+        return expiry.certificate_type == ExpiryType(LeafCertificateType::V2G);
+    });
+    ASSERT_NE(leaf_event, events.end());
+    ASSERT_EQ(leaf_event->threshold_days, 1000000);
+    ASSERT_EQ(leaf_event->days_left, leaf_days);
+
+    const auto root_event = std::find_if(events.begin(), events.end(), [](const CertificateExpiry& expiry) {
+        return expiry.certificate_type == ExpiryType(CaCertificateType::V2G);
+    });
+    ASSERT_NE(root_event, events.end());
+
+    // Notified once per threshold
+    const std::size_t count = events.size();
+    const auto other_id = this->evse_security->register_expiry_watch({}, [](const CertificateExpiry&) {});
+    ASSERT_EQ(events.size(), count);
+
+    this->evse_security->unregister_expiry_watch(other_id);
+    this->evse_security->unregister_expiry_watch(watch_id);
+
+    // The selection is validated by the change generation of the storage, the leafs removed by another process
+    // are seen without a request to the instance
+    for (const auto& entry : fs::directory_iterator("certs/client/cso")) {
+        fs::remove(entry.path());
+    }
+    ASSERT_EQ(this->evse_security->get_leaf_expiry_days_count(LeafCertificateType::V2G), 0);
+}
+
+TEST_F(EvseSecurityTests, verify_certificate_links) {
+    fs::create_directories("certs/links");
+
+    FilePaths linked_paths = file_paths;
+    linked_paths.links.secc_leaf_cert_link = "certs/links/secc_leaf.pem";
+    linked_paths.links.secc_leaf_key_link = "certs/links/secc_leaf.key";
+    linked_paths.links.cpo_cert_chain_link = "certs/links/cpo_chain.pem";
+
+    auto linked_security = std::make_unique<EvseSecurity>(linked_paths, "123456");
+    const auto info = linked_security->get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM);
+    ASSERT_EQ(info.status, GetCertificateInfoStatus::Accepted);
+
+    // Created with the first selection, then unchanged
+    linked_security->update_certificate_links(LeafCertificateType::V2G);
+    ASSERT_EQ(fs::read_symlink(linked_paths.links.secc_leaf_key_link), info.info->key);
+    ASSERT_EQ(fs::read_symlink(linked_paths.links.secc_leaf_cert_link), info.info->certificate_single.value());
+    ASSERT_FALSE(linked_security->update_certificate_links(LeafCertificateType::V2G));
+
+    // A stale link is replaced, without a temporary link left
+    fs::remove(linked_paths.links.secc_leaf_key_link);
+    fs::create_symlink(fs::path("certs/ca/v2g/V2G_ROOT_CA.pem"), linked_paths.links.secc_leaf_key_link);
+
+    linked_security = std::make_unique<EvseSecurity>(linked_paths, "123456");
+    ASSERT_TRUE(linked_security->update_certificate_links(LeafCertificateType::V2G));
+    ASSERT_EQ(fs::read_symlink(linked_paths.links.secc_leaf_key_link), info.info->key);
+    ASSERT_FALSE(fs::exists(fs::symlink_status("certs/links/.secc_leaf.key.tmp")));
+}
+
+TEST_F(EvseSecurityTests, verify_read_fifo) {
+    const fs::path fifo = "certs/client/cso/fifo.pem";
+    ASSERT_EQ(::mkfifo(fifo.c_str(), 0600), 0);
+
+    // Not a regular file, rejected without waiting for a writer
+    auto read = std::async(std::launch::async, [&fifo]() { return PosixStorage().read_shared(fifo); });
+    ASSERT_EQ(read.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    ASSERT_EQ(read.get(), nullptr);
+
+    // The leafs next to it are still found
+    const auto info = this->evse_security->get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM);
+    ASSERT_EQ(info.status, GetCertificateInfoStatus::Accepted);
+}
+
+TEST_F(EvseSecurityTests, verify_read_cache) {
+    const fs::path file = "certs/cached.pem";
+    const fs::path link = "certs/cached_link.pem";
+    PosixStorage storage;
+
+    ASSERT_TRUE(storage.write(file, "cached", false));
+    ASSERT_TRUE(storage.create_symlink(fs::absolute(file), link));
+
+    // An unchanged file is not read again, from any path
+    const auto first = storage.read_shared(file);
+    ASSERT_NE(first, nullptr);
+    ASSERT_EQ(*first, "cached");
+    ASSERT_EQ(storage.read_shared(file), first);
+    ASSERT_EQ(storage.read_shared(link), first);
+
+    // Modified through the storage, and outside of it with the same size
+    ASSERT_TRUE(storage.write(file, "modified", false));
+    ASSERT_EQ(*storage.read_shared(file), "modified");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    {
+        std::ofstream out(file, std::ios::trunc);
+        out << "external";
+    }
+    ASSERT_EQ(*storage.read_shared(file), "external");
+    ASSERT_EQ(*first, "cached");
+
+    // Batch reads use the cache too
+    std::vector<std::optional<std::string>> data;
+    storage.read_files({file, link, "certs/missing.pem"}, data);
+    ASSERT_EQ(data[0].value(), "external");
+    ASSERT_EQ(data[1].value(), "external");
+    ASSERT_FALSE(data[2].has_value());
+
+    // Files larger than the cache are not cached
+    PosixStorage::set_read_cache_capacity(4);
+    ASSERT_NE(storage.read_shared(file), storage.read_shared(file));
+    PosixStorage::set_read_cache_capacity(DEFAULT_FILE_CONTENT_CACHE_CAPACITY);
+}
+
+TEST_F(EvseSecurityTests, verify_directory_snapshot) {
+    const fs::path directory = "certs/snapshot";
+    auto& cache = DirectorySnapshotCache::instance();
+    PosixStorage storage;
+
+    ASSERT_TRUE(storage.create_directories(directory / "sub"));
+    ASSERT_TRUE(storage.write(directory / "a.pem", "a", false));
+
+    std::vector<fs::path> files;
+    ASSERT_TRUE(storage.list(directory, true, files));
+    ASSERT_EQ(files.size(), 1);
+
+    // Unchanged, listed from the snapshot
+    const auto generation = cache.get_generation();
+    ASSERT_NE(cache.find(directory), nullptr);
+    ASSERT_TRUE(storage.list(directory, true, files));
+    ASSERT_EQ(cache.get_generation(), generation);
+
+    // Written through the storage
+    ASSERT_TRUE(storage.write(directory / "sub" / "b.pem", "bb", false));
+    ASSERT_TRUE(storage.list(directory, true, files));
+    ASSERT_EQ(files.size(), 2);
+    ASSERT_GT(cache.get_generation(), generation);
+
+    ASSERT_TRUE(storage.list(directory, false, files));
+    ASSERT_EQ(files.size(), 1);
+    ASSERT_EQ(files[0], directory / "a.pem");
+
+    // Modified outside of the storage
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    {
+        std::ofstream out(directory / "sub" / "c.pem");
+        out << "ccc";
+    }
+    fs::remove(directory / "a.pem");
+
+    std::vector<std::pair<fs::path, StorageStatus>> entries;
+    ASSERT_TRUE(storage.list_entries(directory, true, entries));
+    ASSERT_EQ(entries.size(), 2);
+
+    std::uintmax_t total_size = 0;
+    for (const auto& [file, status] : entries) {
+        total_size += status.size;
+    }
+    ASSERT_EQ(total_size, 5);
+
+    // Missing directories are not cached
+    ASSERT_FALSE(storage.list("certs/snapshot_missing", true, files));
+    ASSERT_EQ(cache.find("certs/snapshot_missing"), nullptr);
+
+    // The store generation only changes with the stores
+    const auto store_generation = this->evse_security->get_store_generation();
+    ASSERT_TRUE(store_generation.has_value());
+    ASSERT_EQ(this->evse_security->get_store_generation(), store_generation);
+    std::ofstream("certs/client/cso/OTHER_PROCESS.pem") << "leaf";
+    ASSERT_NE(this->evse_security->get_store_generation(), store_generation);
+
+    // Without inotify, an in-place rewrite by another process does not change the directory modification time
+    cache.set_inotify_enabled(false);
+    ASSERT_FALSE(this->evse_security->get_store_generation().has_value());
+    ASSERT_TRUE(storage.list_entries(directory, false, entries));
+    ASSERT_NE(cache.find(directory), nullptr);
+
+    const auto rewrite_in_place = [&directory](const std::string& data) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::ofstream out(directory / "sub" / "c.pem", std::ios::in | std::ios::out);
+        out << data;
+    };
+
+    const auto get_status = [&]() {
+        EXPECT_TRUE(storage.list_entries(directory / "sub", false, entries));
+        const auto found = std::find_if(entries.begin(), entries.end(),
+                                        [](const auto& entry) { return entry.first.filename() == "c.pem"; });
+        EXPECT_NE(found, entries.end());
+        return found->second;
+    };
+
+    const auto before = get_status();
+    rewrite_in_place("CCC");
+    const auto same_size = get_status();
+    ASSERT_EQ(same_size.size, 3);
+    ASSERT_GT(same_size.modification_time, before.modification_time);
+
+    rewrite_in_place("CCCC");
+    ASSERT_EQ(get_status().size, 4);
+
+    cache.set_inotify_enabled(true);
+}
+
+TEST_F(EvseSecurityTests, verify_embedded_trust_anchors) {
+    const auto& anchors = trust_anchors::test_v2g_roots;
+    ASSERT_EQ(anchors.count, 1);
+
+    // The metadata generated at build time matches the decoded certificate
+    X509CertificateBundle bundle(anchors, file_paths.mo_ca_bundle);
+    ASSERT_TRUE(bundle.is_using_embedded());
+    ASSERT_EQ(bundle.get_certificate_count(), 1);
+
+    const auto root = bundle.split().at(0);
+    const auto hash_data = root.get_certificate_hash_data();
+    ASSERT_EQ(root.get_common_name(), anchors.anchors[0].common_name);
+    ASSERT_EQ(hash_data.issuer_name_hash, anchors.anchors[0].issuer_name_hash);
+    ASSERT_EQ(hash_data.issuer_key_hash, anchors.anchors[0].issuer_key_hash);
+    ASSERT_EQ(hash_data.serial_number, anchors.anchors[0].serial_number);
+    ASSERT_FALSE(bundle.export_certificates());
+
+    // Used as the read-only MO store
+    auto embedded_security =
+        std::make_unique<EvseSecurity>(file_paths, "123456", std::nullopt, std::nullopt, std::nullopt, std::nullopt,
+                                       nullptr, std::map<CaCertificateType, EmbeddedTrustAnchorSet>{
+                                                    {CaCertificateType::MO, anchors}});
+
+    ASSERT_TRUE(embedded_security->is_ca_certificate_installed(CaCertificateType::MO));
+    ASSERT_EQ(embedded_security->get_count_of_installed_certificates({CertificateType::MORootCertificate}), 1);
+
+    const auto installed = embedded_security->get_installed_certificates({CertificateType::MORootCertificate});
+    ASSERT_EQ(installed.certificate_hash_data_chain.size(), 1);
+    ASSERT_EQ(installed.certificate_hash_data_chain[0].certificate_hash_data, hash_data);
+
+    const auto new_root_ca =
+        read_file_to_string(std::filesystem::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA1.pem"));
+    ASSERT_EQ(embedded_security->install_ca_certificate(new_root_ca, CaCertificateType::MO),
+              InstallCertificateResult::WriteError);
+    ASSERT_EQ(embedded_security->delete_certificate(hash_data), DeleteCertificateResult::Failed);
+    ASSERT_TRUE(embedded_security->get_verify_file(CaCertificateType::MO).empty());
+
+    // The other stores are unchanged
+    ASSERT_EQ(embedded_security->get_count_of_installed_certificates({CertificateType::V2GRootCertificate}),
+              this->evse_security->get_count_of_installed_certificates({CertificateType::V2GRootCertificate}));
+}
+
+TEST_F(EvseSecurityTests, verify_shared_certificate_cache) {
+    const fs::path segment = "shared_certificate_cache";
+    auto& cache = SharedCertificateCache::instance();
+
+    ASSERT_TRUE(cache.open(segment, 64 * 1024));
+    ASSERT_TRUE(cache.is_writer());
+
+    // Published when parsed, then loaded from the segment
+    X509CertificateBundle parsed(file_paths.v2g_ca_bundle, EncodingFormat::PEM);
+    PosixStorage storage;
+    const StorageStatus status = storage.stat(file_paths.v2g_ca_bundle);
+
+    std::vector<std::string> der;
+    ASSERT_TRUE(cache.find(status, der));
+    ASSERT_EQ(der.size(), parsed.get_certificate_count());
+
+    X509CertificateBundle shared(file_paths.v2g_ca_bundle, EncodingFormat::PEM);
+    ASSERT_EQ(shared.to_export_string(), parsed.to_export_string());
+
+    // Another process maps it read-only
+    const pid_t child = fork();
+    if (child == 0) {
+        auto& child_cache = SharedCertificateCache::instance();
+        child_cache.close();
+
+        std::vector<std::string> child_der;
+        const bool read = child_cache.open(segment, 64 * 1024) && !child_cache.is_writer() &&
+                          child_cache.find(status, child_der) && child_der == der &&
+                          !child_cache.insert(StorageStatus{StorageEntryType::File, false, 1, 1, 1, 1}, {"x"});
+        _exit(read ? 0 : 1);
+    }
+
+    int child_status = -1;
+    ASSERT_EQ(waitpid(child, &child_status, 0), child);
+    ASSERT_TRUE(WIFEXITED(child_status));
+    ASSERT_EQ(WEXITSTATUS(child_status), 0);
+
+    // A modified file is a new version
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    {
+        std::ofstream out(file_paths.v2g_ca_bundle, std::ios::app);
+        out << "\n";
+    }
+    ASSERT_FALSE(cache.find(storage.stat(file_paths.v2g_ca_bundle), der));
+
+    // Full segments are dropped
+    const auto generation = cache.get_generation();
+    for (std::uint64_t inode = 1; inode < 64; inode++) {
+        ASSERT_TRUE(cache.insert(StorageStatus{StorageEntryType::File, false, 1, 1, 1, inode},
+                                 {std::string(2048, 'x')}));
+    }
+    ASSERT_GT(cache.get_generation(), generation);
+    ASSERT_FALSE(cache.find(status, der));
+
+    cache.close();
+    ASSERT_FALSE(cache.is_open());
+
+    // A segment or lock file writable by others is not trusted
+    ASSERT_EQ(chmod(segment.c_str(), 0666), 0);
+    ASSERT_FALSE(cache.open(segment, 64 * 1024));
+    cache.close();
+
+    ASSERT_EQ(chmod(segment.c_str(), 0600), 0);
+    ASSERT_EQ(chmod((segment.string() + ".lock").c_str(), 0622), 0);
+    ASSERT_FALSE(cache.open(segment, 64 * 1024));
+    cache.close();
+
+    fs::remove(segment);
+    fs::remove(segment.string() + ".lock");
+}
+
+TEST_F(EvseSecurityTests, verify_security_daemon) {
+    const fs::path socket_path = "evse_security_daemon.sock";
+
+    EvseSecurityServer server(*this->evse_security, socket_path);
+    ASSERT_TRUE(server.start());
+
+    // Only the user of the server can connect
+    ASSERT_EQ(fs::status(socket_path).permissions(), fs::perms::owner_read | fs::perms::owner_write);
+
+    EvseSecurityClient client(socket_path);
+    EvseSecurityClient other_client(socket_path);
+
+    // Same results as the in-process API
+    ASSERT_EQ(client.get_verify_file(CaCertificateType::V2G),
+              this->evse_security->get_verify_file(CaCertificateType::V2G));
+    ASSERT_EQ(client.get_count_of_installed_certificates({CertificateType::V2GRootCertificate}),
+              this->evse_security->get_count_of_installed_certificates({CertificateType::V2GRootCertificate}));
+
+    const auto leaf_info = client.get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM, true);
+    const auto direct_leaf_info =
+        this->evse_security->get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM, true);
+    ASSERT_EQ(leaf_info.status, direct_leaf_info.status);
+    ASSERT_TRUE(leaf_info.info.has_value());
+    ASSERT_EQ(leaf_info.info->key, direct_leaf_info.info->key);
+    ASSERT_EQ(leaf_info.info->certificate, direct_leaf_info.info->certificate);
+    ASSERT_EQ(leaf_info.info->ocsp.size(), direct_leaf_info.info->ocsp.size());
+
+    // The verify location is cached until the stores are modified, the results depending on the time are not
+    const auto verify_location = client.get_verify_location(CaCertificateType::V2G);
+    ASSERT_EQ(client.get_verify_location(CaCertificateType::V2G), verify_location);
+    ASSERT_EQ(client.get_verify_location(CaCertificateType::V2G), verify_location);
+    ASSERT_TRUE(client.is_ca_certificate_installed(CaCertificateType::V2G));
+    ASSERT_TRUE(client.is_ca_certificate_installed(CaCertificateType::V2G));
+    ASSERT_EQ(client.get_verify_file(CaCertificateType::V2G), file_paths.v2g_ca_bundle.string());
+    ASSERT_EQ(client.get_cache_hits(), 2);
+
+    // Modified by the other client, the update is pushed
+    const auto generation = client.get_generation();
+    const auto v2g_root_ca = read_file_to_string(fs::path("certs/ca/v2g/V2G_ROOT_CA_NEW.pem"));
+    ASSERT_EQ(other_client.install_ca_certificate(v2g_root_ca, CaCertificateType::V2G),
+              InstallCertificateResult::Accepted);
+    ASSERT_EQ(other_client.get_generation(), server.get_generation());
+
+    ASSERT_TRUE(wait_for([&]() { return client.get_generation() > generation; }));
+    ASSERT_EQ(client.get_verify_location(CaCertificateType::V2G), verify_location);
+    ASSERT_EQ(client.get_cache_hits(), 2);
+
+    // The changes made outside the requests are detected by the server and pushed too
+    const std::vector<CertificateType> root_types = {CertificateType::V2GRootCertificate};
+    const auto root_count = client.get_count_of_installed_certificates(root_types);
+    ASSERT_EQ(client.get_count_of_installed_certificates(root_types), root_count);
+    ASSERT_EQ(client.get_cache_hits(), 3);
+
+    const auto update_generation = client.get_generation();
+    const auto root = read_file_to_string(fs::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA3.pem"));
+    ASSERT_EQ(this->evse_security->install_ca_certificate(root, CaCertificateType::V2G),
+              InstallCertificateResult::Accepted);
+    ASSERT_TRUE(wait_for([&]() { return client.get_generation() > update_generation; }));
+    ASSERT_EQ(client.get_count_of_installed_certificates(root_types), root_count + 1);
+
+    // Failures of the API are forwarded
+    ASSERT_THROW(client.update_certificate_links(LeafCertificateType::CSMS), std::runtime_error);
+    ASSERT_TRUE(client.is_ca_certificate_installed(CaCertificateType::V2G));
+
+    // The expiry watches are checked by the daemon, the crossed thresholds are notified with the registration
+    std::vector<CertificateExpiry> expiries;
+    const auto watch_id = client.register_expiry_watch(
+        {1, 1000000}, [&expiries](const CertificateExpiry& expiry) { expiries.push_back(expiry); });
+
+    const auto leaf_expiry = std::find_if(expiries.begin(), expiries.end(), [](const CertificateExpiry& expiry) {
+        using ExpiryType = std::variant<LeafCertificateType, CaCertificateType>;
+        return expiry.certificate_type == ExpiryType(LeafCertificateType::V2G);
+    });
+    ASSERT_NE(leaf_expiry, expiries.end());
+    ASSERT_EQ(leaf_expiry->threshold_days, 1000000);
+    ASSERT_EQ(leaf_expiry->days_left, this->evse_security->get_leaf_expiry_days_count(LeafCertificateType::V2G));
+
+    const std::size_t expiry_count = expiries.size();
+    client.unregister_expiry_watch(watch_id);
+    client.process_notifications();
+    ASSERT_EQ(expiries.size(), expiry_count);
+
+    // Clients sending a partial request or not reading their responses do not block the others
+    const auto connect_raw = [&socket_path]() {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        EXPECT_EQ(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+        return fd;
+    };
+
+    const int partial_fd = connect_raw();
+    ASSERT_EQ(::send(partial_fd, "\x10\x00", 2, 0), 2);
+
+    const int reading_nothing_fd = connect_raw();
+    daemon::MessageWriter writer;
+    writer.write(CaCertificateType::V2G);
+    std::string requests;
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(daemon::append_message(requests, {daemon::Opcode::GetCaCertificateInfo, 0, writer.get_data()}));
+    }
+    ASSERT_GT(::send(reading_nothing_fd, requests.data(), requests.size(), MSG_DONTWAIT), 0);
+
+    // Once the first responses are waiting, the server stalls on that client
+    ASSERT_TRUE(wait_for([reading_nothing_fd]() {
+        int available = 0;
+        return ::ioctl(reading_nothing_fd, FIONREAD, &available) == 0 && available > 0;
+    }));
+    ASSERT_EQ(client.get_v2g_ocsp_request_data().ocsp_request_data_list.size(),
+              this->evse_security->get_v2g_ocsp_request_data().ocsp_request_data_list.size());
+
+    ::close(partial_fd);
+    ::close(reading_nothing_fd);
+
+    server.stop();
+    ASSERT_THROW(client.get_v2g_ocsp_request_data(), DaemonConnectionException);
+    ASSERT_FALSE(fs::exists(socket_path));
+
+    // Only a stale socket is replaced
+    std::ofstream(socket_path) << "not a socket";
+    EvseSecurityServer other_server(*this->evse_security, socket_path);
+    ASSERT_FALSE(other_server.start());
+    ASSERT_EQ(read_file_to_string(socket_path), "not a socket");
+    fs::remove(socket_path);
+}
+
+TEST_F(EvseSecurityTests, verify_trust_index_precheck) {
+    X509CertificateBundle roots(file_paths.v2g_ca_bundle, EncodingFormat::PEM);
+    const X509TrustIndex index(roots.split());
+    ASSERT_EQ(index.size(), roots.get_certificate_count());
+
+    // A chain of the PKI requires the full verification
+    const auto chain = read_file_to_string(fs::path("certs/client/cso/CPO_CERT_CHAIN.pem"));
+    ASSERT_EQ(index.precheck(X509CertificateBundle(chain, EncodingFormat::PEM).split()),
+              CertificateValidationResult::Valid);
+
+    // The bundle contains the sub-CAs, the leaf alone is anchored too
+    const auto leaf = read_file_to_string(fs::path("certs/client/cso/SECC_LEAF.pem"));
+    ASSERT_EQ(index.precheck(X509CertificateBundle(leaf, EncodingFormat::PEM).split()),
+              CertificateValidationResult::Valid);
+
+    // Another PKI
+    X509CertificateBundle mo_roots(file_paths.mo_ca_bundle, EncodingFormat::PEM);
+    const X509TrustIndex mo_index(mo_roots.split());
+    ASSERT_EQ(mo_index.precheck(X509CertificateBundle(chain, EncodingFormat::PEM).split()),
+              CertificateValidationResult::IssuerNotFound);
+
+    const auto expired = read_file_to_string(fs::path("expired_leaf/SECC_LEAF_EXPIRED.pem"));
+    ASSERT_EQ(index.precheck(X509CertificateBundle(expired, EncodingFormat::PEM).split()),
+              CertificateValidationResult::Expired);
+
+    // The index of the instance follows the installed roots
+    const auto subca = read_file_to_string(fs::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA3_SUBCA1.pem"));
+    ASSERT_EQ(this->evse_security->verify_certificate(subca, LeafCertificateType::V2G),
+              CertificateValidationResult::IssuerNotFound);
+
+    const auto root = read_file_to_string(fs::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA3.pem"));
+    ASSERT_EQ(this->evse_security->install_ca_certificate(root, CaCertificateType::V2G),
+              InstallCertificateResult::Accepted);
+    ASSERT_EQ(this->evse_security->verify_certificate(subca, LeafCertificateType::V2G),
+              CertificateValidationResult::Valid);
+}
+
+TEST_F(EvseSecurityTests, verify_crl_revocation) {
+    const auto chain = read_file_to_string(fs::path("certs/client/cso/CPO_CERT_CHAIN.pem"));
+    ASSERT_EQ(this->evse_security->verify_certificate(chain, LeafCertificateType::V2G),
+              CertificateValidationResult::Valid);
+    ASSERT_FALSE(this->evse_security->get_crl_next_update(CaCertificateType::V2G).has_value());
+
+    ASSERT_EQ(this->evse_security->install_crl("invalid", CaCertificateType::V2G),
+              InstallCertificateResult::InvalidFormat);
+
+    // Signed by a CA that is not in the bundle
+    const auto other_crl = read_file_to_string(fs::path("certs/crl/INSTALL_TEST_ROOT_CA3.crl"));
+    ASSERT_EQ(this->evse_security->install_crl(other_crl, CaCertificateType::V2G),
+              InstallCertificateResult::InvalidSignature);
+
+    // Revokes the SECC leaf
+    const auto crl = read_file_to_string(fs::path("certs/crl/CPO_SUB_CA2.crl"));
+    ASSERT_EQ(this->evse_security->install_crl(crl, CaCertificateType::MO),
+              InstallCertificateResult::NoRootCertificateInstalled);
+    ASSERT_EQ(this->evse_security->install_crl(crl, CaCertificateType::V2G), InstallCertificateResult::Accepted);
+
+    const auto next_update = this->evse_security->get_crl_next_update(CaCertificateType::V2G);
+    ASSERT_TRUE(next_update.has_value());
+    ASSERT_GT(next_update.value(), std::chrono::system_clock::now());
+
+    ASSERT_EQ(this->evse_security->verify_certificate(chain, LeafCertificateType::V2G),
+              CertificateValidationResult::Revoked);
+    ASSERT_EQ(this->evse_security->update_leaf_certificate(chain, LeafCertificateType::V2G),
+              InstallCertificateResult::InvalidCertificateChain);
+
+    // The sub-CAs are not revoked
+    const auto subca = read_file_to_string(fs::path("certs/ca/csms/CPO_SUB_CA2.pem"));
+    ASSERT_EQ(this->evse_security->verify_certificate(subca, LeafCertificateType::V2G),
+              CertificateValidationResult::Valid);
+
+    // The installed list is loaded by another instance
+    EvseSecurity other_security(file_paths, "123456");
+    ASSERT_EQ(other_security.verify_certificate(chain, LeafCertificateType::V2G), CertificateValidationResult::Revoked);
+}
+
+TEST_F(EvseSecurityTests, verify_crl_of_supplied_subca) {
+    // The MO bundle only holds the root, the list is issued by the Sub-CA 2 of the SECC leaf
+    const auto root = read_file_to_string(fs::path("certs/ca/v2g/V2G_ROOT_CA.pem"));
+    ASSERT_EQ(this->evse_security->install_ca_certificate(root, CaCertificateType::MO),
+              InstallCertificateResult::Accepted);
+
+    const auto crl = read_file_to_string(fs::path("certs/crl/CPO_SUB_CA2.crl"));
+    ASSERT_EQ(this->evse_security->install_crl(crl, CaCertificateType::MO), InstallCertificateResult::InvalidSignature);
+
+    // A supplied CA that does not verify to the bundle is not an issuer
+    const auto other_crl = read_file_to_string(fs::path("certs/crl/INSTALL_TEST_ROOT_CA3.crl"));
+    const auto other_root = read_file_to_string(fs::path("certs/to_be_installed/INSTALL_TEST_ROOT_CA3.pem"));
+    ASSERT_EQ(this->evse_security->install_crl(other_crl + other_root, CaCertificateType::MO),
+              InstallCertificateResult::InvalidSignature);
+
+    // Sub-CA 2 alone does not verify, with its issuer Sub-CA 1 it does
+    const auto subca2 = read_file_to_string(fs::path("certs/ca/csms/CPO_SUB_CA2.pem"));
+    const auto subca1 = read_file_to_string(fs::path("certs/ca/csms/CPO_SUB_CA1.pem"));
+    ASSERT_EQ(this->evse_security->install_crl(crl + subca2, CaCertificateType::MO),
+              InstallCertificateResult::InvalidSignature);
+    ASSERT_EQ(this->evse_security->install_crl(crl + subca2 + subca1, CaCertificateType::MO),
+              InstallCertificateResult::Accepted);
+
+    const auto chain = read_file_to_string(fs::path("certs/client/cso/CPO_CERT_CHAIN.pem"));
+    ASSERT_EQ(this->evse_security->verify_certificate(chain, LeafCertificateType::MO),
+              CertificateValidationResult::Revoked);
+}
+
+TEST_F(EvseSecurityTests, verify_allocation_budgets) {
+    OCSPRequestDataList data = this->evse_security->get_v2g_ocsp_request_data();
+    for (auto& ocsp : data.ocsp_request_data_list) {
+        this->evse_security->update_ocsp_cache(ocsp.certificate_hash_data.value(),
+                                               read_subca_ocsp_response(ocsp.certificate_hash_data.value()));
+    }
+
+    const CertificateHashData hash = data.ocsp_request_data_list.at(0).certificate_hash_data.value();
+    const std::string chain = read_file_to_string(fs::path("certs/client/cso/CPO_CERT_CHAIN.pem"));
+
+    // Allocations of the first call, that fills the caches, and of the steady state
+    const auto count_allocations = [](const auto& call) {
+        AllocationCounter cold_counter;
+        call();
+        const AllocationCount cold = cold_counter.get_count();
+
+        AllocationCounter counter;
+        call();
+        return std::make_pair(cold, counter.get_count());
+    };
+
+    const auto [leaf_info_cold, leaf_info] = count_allocations([this]() {
+        return this->evse_security->get_leaf_certificate_info(LeafCertificateType::V2G, EncodingFormat::PEM, true);
+    });
+    const auto [ocsp_cache_cold, ocsp_cache] =
+        count_allocations([this, &hash]() { return this->evse_security->retrieve_ocsp_cache(hash); });
+    const auto [verify_cold, verify] = count_allocations(
+        [this, &chain]() { return this->evse_security->verify_certificate(chain, LeafCertificateType::V2G); });
+
+    // Baseline of the current allocations, in the test report. They are dominated by the parsing and verification
+    // in OpenSSL, whose allocations depend on its version and build, so they are only bounded by the first call
+    RecordProperty("allocations_get_leaf_certificate_info", std::to_string(leaf_info.heap));
+    RecordProperty("allocations_retrieve_ocsp_cache", std::to_string(ocsp_cache.heap));
+    RecordProperty("allocations_verify_certificate", std::to_string(verify.heap));
+    RecordProperty("crypto_allocations_get_leaf_certificate_info", std::to_string(leaf_info.crypto));
+    RecordProperty("crypto_allocations_retrieve_ocsp_cache", std::to_string(ocsp_cache.crypto));
+    RecordProperty("crypto_allocations_verify_certificate", std::to_string(verify.crypto));
+
+    EXPECT_LE(leaf_info.heap, leaf_info_cold.heap);
+    EXPECT_LE(ocsp_cache.heap, ocsp_cache_cold.heap);
+    EXPECT_LE(verify.heap, verify_cold.heap);
+    EXPECT_LE(leaf_info.crypto, leaf_info_cold.crypto);
+    EXPECT_LE(ocsp_cache.crypto, ocsp_cache_cold.crypto);
+    EXPECT_LE(verify.crypto, verify_cold.crypto);
+
+    // The cache hits only allocate for the status checks of the store files, and never in OpenSSL. Budgets of about
+    // twice the baseline, for other standard libraries, only raise them with a reason
+    const auto ocsp_verdict =
+        count_allocations([this, &hash]() { return this->evse_security->get_ocsp_verdict(hash); });
+    const auto expiry = count_allocations(
+        [this]() { return this->evse_security->get_leaf_expiry_days_count(LeafCertificateType::V2G); });
+    const auto stapling = count_allocations(
+        [this]() { return this->evse_security->get_ocsp_stapling_payload(LeafCertificateType::V2G); });
+    const auto crl_next_update =
+        count_allocations([this]() { return this->evse_security->get_crl_next_update(CaCertificateType::V2G); });
+
+    EXPECT_LE(ocsp_verdict.second.heap, 250);
+    EXPECT_LE(expiry.second.heap, 150);
+    EXPECT_LE(stapling.second.heap, 250);
+    EXPECT_LE(crl_next_update.second.heap, 20);
+    EXPECT_EQ(ocsp_verdict.second.crypto, 0);
+    EXPECT_EQ(expiry.second.crypto, 0);
+    EXPECT_EQ(stapling.second.crypto, 0);
+    EXPECT_EQ(crl_next_update.second.crypto, 0);
+}
+
+TEST_F(EvseSecurityTests, verify_log_level_gating) {
+    int evaluated = 0;
+    const auto operand = [&evaluated]() {
+        evaluated++;
+        return "operand";
+    };
+
+    set_log_level(LogLevel::Info);
+    ASSERT_EQ(get_log_level(), LogLevel::Info);
+
+    // The operands of a disabled level are not evaluated
+    EVSE_LOG_debug << operand();
+    ASSERT_EQ(evaluated, 0);
+
+    EVSE_LOG_info << operand();
+    ASSERT_EQ(evaluated, 1);
+
+    set_log_level(LogLevel::Verbose);
+    EVSE_LOG_debug << operand();
+    ASSERT_EQ(evaluated, 2);
+}
+
 } // namespace evse_security
 
 // FIXME(piet): Add more tests for getRootCertificateHashData (incl. V2GCertificateChain etc.)
\ No newline at end of file
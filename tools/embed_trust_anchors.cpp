@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+
+// Build-time generator of the embedded trust anchors, see 'evse_security_embed_trust_anchors'.
+// Usage: embed_trust_anchors <name> <output directory> <PEM files...>
+// Generates '<name>.hpp' and '<name>.cpp' that define the 'evse_security::trust_anchors::<name>' set
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <evse_security/certificate/x509_wrapper.hpp>
+
+using namespace evse_security;
+
+namespace {
+
+struct Anchor {
+    std::vector<unsigned char> der;
+    std::string common_name;
+    CertificateHashData hash_data;
+    std::int64_t not_before;
+    std::int64_t not_after;
+};
+
+bool read_file(const std::string& path, std::string& out_data) {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file) {
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    out_data = buffer.str();
+
+    return true;
+}
+
+bool to_epoch_seconds(const ASN1_TIME* time, std::int64_t& out_seconds) {
+    std::tm tm{};
+
+    if (ASN1_TIME_to_tm(time, &tm) != 1) {
+        return false;
+    }
+
+    out_seconds = static_cast<std::int64_t>(timegm(&tm));
+    return true;
+}
+
+bool load_anchors(const std::string& path, std::vector<Anchor>& out_anchors) {
+    std::string pem;
+
+    if (!read_file(path, pem)) {
+        std::cerr << "Could not read: " << path << std::endl;
+        return false;
+    }
+
+    BIO* bio = BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size()));
+    bool loaded = false;
+
+    while (X509* x509 = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr)) {
+        Anchor anchor;
+
+        const int der_size = i2d_X509(x509, nullptr);
+        anchor.der.resize(der_size > 0 ? der_size : 0);
+        unsigned char* der_out = anchor.der.data();
+        i2d_X509(x509, &der_out);
+
+        const bool valid_times = to_epoch_seconds(X509_get0_notBefore(x509), anchor.not_before) &&
+                                 to_epoch_seconds(X509_get0_notAfter(x509), anchor.not_after);
+        X509_free(x509);
+
+        if (der_size <= 0 || !valid_times) {
+            std::cerr << "Invalid certificate in: " << path << std::endl;
+            BIO_free(bio);
+            return false;
+        }
+
+        // The metadata is computed by the library, so that it matches the runtime format
+        const X509Wrapper certificate(std::string(anchor.der.begin(), anchor.der.end()), EncodingFormat::DER);
+
+        if (!certificate.is_selfsigned()) {
+            std::cerr << "Not a self-signed root: " << certificate.get_common_name() << " in: " << path << std::endl;
+            BIO_free(bio);
+            return false;
+        }
+
+        anchor.common_name = certificate.get_common_name();
+        anchor.hash_data = certificate.get_certificate_hash_data();
+
+        out_anchors.push_back(std::move(anchor));
+        loaded = true;
+    }
+
+    BIO_free(bio);
+
+    if (!loaded) {
+        std::cerr << "No certificate found in: " << path << std::endl;
+    }
+
+    return loaded;
+}
+
+std::string to_string_literal(const std::string& value) {
+    std::stringstream literal;
+    literal << '"';
+
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            literal << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20 || static_cast<unsigned char>(c) >= 0x7f) {
+            // Octal, a hex escape would consume the following characters
+            literal << '\\' << std::oct << std::setw(3) << std::setfill('0')
+                    << static_cast<int>(static_cast<unsigned char>(c)) << std::dec;
+        } else {
+            literal << c;
+        }
+    }
+
+    literal << '"';
+    return literal.str();
+}
+
+bool write_file(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+
+    return static_cast<bool>(file);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <name> <output directory> <PEM files...>" << std::endl;
+        return 1;
+    }
+
+    const std::string name = argv[1];
+    const std::string output_directory = argv[2];
+
+    std::vector<Anchor> anchors;
+    for (int i = 3; i < argc; i++) {
+        if (!load_anchors(argv[i], anchors)) {
+            return 1;
+        }
+    }
+
+    std::stringstream header;
+    header << "// Generated by embed_trust_anchors, do not edit\n"
+           << "#pragma once\n\n"
+           << "#include <evse_security/certificate/embedded_trust_anchors.hpp>\n\n"
+           << "namespace evse_security::trust_anchors {\n\n"
+           << "extern const EmbeddedTrustAnchorSet " << name << ";\n\n"
+           << "} // namespace evse_security::trust_anchors\n";
+
+    std::stringstream source;
+    source << "// Generated by embed_trust_anchors, do not edit\n"
+           << "#include \"" << name << ".hpp\"\n\n"
+           << "namespace evse_security::trust_anchors {\n\n"
+           << "namespace {\n\n";
+
+    for (std::size_t i = 0; i < anchors.size(); i++) {
+        source << "constexpr std::uint8_t der_" << i << "[] = {";
+
+        for (std::size_t j = 0; j < anchors[i].der.size(); j++) {
+            source << ((j % 16 == 0) ? "\n    " : " ") << "0x" << std::hex << std::setw(2) << std::setfill('0')
+                   << static_cast<int>(anchors[i].der[j]) << std::dec << ",";
+        }
+
+        source << "\n};\n\n";
+    }
+
+    source << "constexpr EmbeddedTrustAnchor anchors[] = {\n";
+
+    for (std::size_t i = 0; i < anchors.size(); i++) {
+        const auto& anchor = anchors[i];
+
+        source << "    {der_" << i << ", sizeof(der_" << i << "), " << to_string_literal(anchor.common_name) << ", "
+               << to_string_literal(anchor.hash_data.issuer_name_hash) << ", "
+               << to_string_literal(anchor.hash_data.issuer_key_hash) << ", "
+               << to_string_literal(anchor.hash_data.serial_number) << ", " << anchor.not_before << ", "
+               << anchor.not_after << "},\n";
+    }
+
+    source << "};\n\n"
+           << "} // namespace\n\n"
+           << "const EmbeddedTrustAnchorSet " << name << "{anchors, " << anchors.size() << "};\n\n"
+           << "} // namespace evse_security::trust_anchors\n";
+
+    if (!write_file(output_directory + "/" + name + ".hpp", header.str()) ||
+        !write_file(output_directory + "/" + name + ".cpp", source.str())) {
+        std::cerr << "Could not write the sources to: " << output_directory << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
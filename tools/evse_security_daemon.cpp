@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright Pionix GmbH and Contributors to EVerest
+
+// Security daemon, serves one EvseSecurity instance to the 'EvseSecurityClient's of the system.
+// Usage: evse_security_daemon --socket <path> [--<file path option> <path>...] [--private-key-password-file <path>]
+// [--socket-group <name>]
+// The socket is only accessible by the user of the daemon, and by the members of the socket group if one is given.
+// The password of the private keys is read from the first line of the password file, or from the
+// EVSE_SECURITY_PRIVATE_KEY_PASSWORD environment variable, never from the command line that all users can read.
+// Runs until SIGINT or SIGTERM
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+
+#include <grp.h>
+#include <pthread.h>
+
+#include <evse_security/daemon/evse_security_server.hpp>
+#include <evse_security/evse_security.hpp>
+
+using namespace evse_security;
+
+namespace {
+
+constexpr const char* PRIVATE_KEY_PASSWORD_VARIABLE = "EVSE_SECURITY_PRIVATE_KEY_PASSWORD";
+
+std::optional<std::string> read_password_file(const char* path) {
+    std::ifstream file(path);
+    std::string password;
+
+    if (!file.is_open() || !std::getline(file, password)) {
+        return std::nullopt;
+    }
+
+    return password;
+}
+
+void print_usage(const char* name, const std::map<std::string, std::function<void(const char*)>>& options) {
+    std::cerr << "Usage: " << name << " --socket <path>";
+
+    for (const auto& [option, setter] : options) {
+        if (option != "--socket") {
+            std::cerr << " [" << option << " <value>]";
+        }
+    }
+
+    std::cerr << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    FilePaths file_paths;
+    fs::path socket_path;
+    std::optional<std::string> private_key_password;
+    const char* private_key_password_file = nullptr;
+    const char* socket_group_name = nullptr;
+
+    const std::map<std::string, std::function<void(const char*)>> options = {
+        {"--socket", [&](const char* value) { socket_path = value; }},
+        {"--csms-ca-bundle", [&](const char* value) { file_paths.csms_ca_bundle = value; }},
+        {"--mf-ca-bundle", [&](const char* value) { file_paths.mf_ca_bundle = value; }},
+        {"--mo-ca-bundle", [&](const char* value) { file_paths.mo_ca_bundle = value; }},
+        {"--v2g-ca-bundle", [&](const char* value) { file_paths.v2g_ca_bundle = value; }},
+        {"--csms-leaf-cert-directory",
+         [&](const char* value) { file_paths.directories.csms_leaf_cert_directory = value; }},
+        {"--csms-leaf-key-directory",
+         [&](const char* value) { file_paths.directories.csms_leaf_key_directory = value; }},
+        {"--secc-leaf-cert-directory",
+         [&](const char* value) { file_paths.directories.secc_leaf_cert_directory = value; }},
+        {"--secc-leaf-key-directory",
+         [&](const char* value) { file_paths.directories.secc_leaf_key_directory = value; }},
+        {"--secc-leaf-cert-link", [&](const char* value) { file_paths.links.secc_leaf_cert_link = value; }},
+        {"--secc-leaf-key-link", [&](const char* value) { file_paths.links.secc_leaf_key_link = value; }},
+        {"--cpo-cert-chain-link", [&](const char* value) { file_paths.links.cpo_cert_chain_link = value; }},
+        {"--private-key-password-file", [&](const char* value) { private_key_password_file = value; }},
+        {"--socket-group", [&](const char* value) { socket_group_name = value; }},
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const auto option = options.find(argv[i]);
+
+        if (option == options.end() || i + 1 >= argc) {
+            print_usage(argv[0], options);
+            return 1;
+        }
+
+        option->second(argv[++i]);
+    }
+
+    if (socket_path.empty()) {
+        print_usage(argv[0], options);
+        return 1;
+    }
+
+    if (private_key_password_file != nullptr) {
+        private_key_password = read_password_file(private_key_password_file);
+
+        if (!private_key_password.has_value()) {
+            std::cerr << "Could not read the private key password file: " << private_key_password_file << std::endl;
+            return 1;
+        }
+    } else if (const char* password = std::getenv(PRIVATE_KEY_PASSWORD_VARIABLE)) {
+        private_key_password = password;
+        // Not inherited by the processes started later
+        ::unsetenv(PRIVATE_KEY_PASSWORD_VARIABLE);
+    }
+
+    std::optional<gid_t> socket_group;
+
+    if (socket_group_name != nullptr) {
+        const group* entry = ::getgrnam(socket_group_name);
+
+        if (entry == nullptr) {
+            std::cerr << "Unknown socket group: " << socket_group_name << std::endl;
+            return 1;
+        }
+
+        socket_group = entry->gr_gid;
+    }
+
+    // Blocked before any thread is started, so that only 'sigwait' receives them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    try {
+        EvseSecurity security(file_paths, private_key_password);
+        EvseSecurityServer server(security, socket_path, socket_group);
+
+        if (!server.start()) {
+            return 1;
+        }
+
+        int signal;
+        sigwait(&signals, &signal);
+    } catch (const std::exception& e) {
+        std::cerr << "Could not start the security daemon: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}